@@ -15,6 +15,7 @@ uniform float echo_decay;
 uniform float echo_speed;
 uniform float audio_peak;
 uniform float audio_transient;
+uniform float beat_pulse;
 
 varying vec4 varying_color;
 varying vec2 varying_texcoord;
@@ -39,7 +40,7 @@ void main()
   float dist = length(delta);
   vec2 dir = (dist > 0.0001) ? (delta / dist) : vec2(0.0, 0.0);
 
-  float burst = smoothstep(0.02, 0.60, audio_peak) + smoothstep(0.01, 0.30, audio_transient) * 0.75;
+  float burst = smoothstep(0.02, 0.60, audio_peak) + smoothstep(0.01, 0.30, audio_transient) * 0.75 + beat_pulse * 0.6;
   float speed = echo_speed * (1.0 + burst * 1.6);
   vec2 historyUv = uv - dir * speed;
 
@@ -0,0 +1,110 @@
+#ifdef GL_ES
+precision highp float;
+#endif
+
+// Draws the mirror bars over the whole visualization area from the audio
+// texture (vis::AudioTexture): spectrum bands when there are any, otherwise
+// evenly spaced mono samples.
+
+uniform bool al_alpha_test;
+uniform int al_alpha_func;
+uniform float al_alpha_test_val;
+
+uniform sampler2D audio_tex;
+uniform vec2 audio_tex_size;   // GL texture size, may exceed the bitmap's
+uniform vec2 audio_tex_offset; // bitmap's top-left texel in the texture
+uniform float mono_count;
+uniform float band_count;
+
+uniform vec2 vis_size;
+uniform vec3 tint;
+uniform float time;
+
+varying vec4 varying_color;
+varying vec2 varying_texcoord; // pixels from the area's top-left corner
+
+bool alpha_test_func(float x, int op, float compare)
+{
+   if (op == 0) return false;
+   else if (op == 1) return true;
+   else if (op == 2) return x < compare;
+   else if (op == 3) return x == compare;
+   else if (op == 4) return x <= compare;
+   else if (op == 5) return x > compare;
+   else if (op == 6) return x != compare;
+   else if (op == 7) return x >= compare;
+   return false;
+}
+
+// Value `index` of texture row `row`, four per texel. Allegro keeps bitmaps
+// bottom-up in GL textures, so row 0 is at the top of texture space and the
+// offset counts down from there, as in the primitives addon.
+float packedValue(float row, float index)
+{
+   float texel = floor(index / 4.0);
+   float lane = index - texel * 4.0;
+   vec2 texelPos = audio_tex_offset + vec2(texel, row) + 0.5;
+   vec2 uv = vec2(texelPos.x / audio_tex_size.x, 1.0 - texelPos.y / audio_tex_size.y);
+   vec4 lanes = texture2D(audio_tex, uv);
+   return dot(lanes, vec4(equal(vec4(lane), vec4(0.0, 1.0, 2.0, 3.0))));
+}
+
+void main()
+{
+   // Same layout as the CPU path in MirrorBarsVisualization::draw.
+   vec2 p = varying_texcoord;
+   float columnWidth = max(1.0, vis_size.x / 160.0);
+   float spacing = max(1.0, columnWidth * 1.35);
+   float barCount = max(8.0, floor(vis_size.x / spacing));
+   float bar = floor(p.x / spacing);
+   if (bar >= barCount || p.x - bar * spacing > columnWidth)
+      discard;
+
+   float level = 0.0;
+   if (band_count > 0.0) {
+      float bandPos = barCount > 1.0 ? (band_count - 1.0) * bar / (barCount - 1.0) : 0.0;
+      float lower = floor(bandPos);
+      float upper = min(lower + 1.0, band_count - 1.0);
+      level = mix(packedValue(3.0, lower), packedValue(3.0, upper), bandPos - lower);
+   } else if (mono_count > 0.0) {
+      float stride = max(1.0, floor(mono_count / barCount));
+      float index = min(mono_count - 1.0, bar * stride);
+      level = abs(packedValue(0.0, index) * 2.0 - 1.0);
+   }
+   float halfHeight = max(1.0, level * vis_size.y * 0.45);
+   if (abs(p.y - vis_size.y * 0.5) > halfHeight)
+      discard;
+
+   vec3 base = varying_color.rgb * tint;
+
+   // Screen-space phase keeps the effect stable on primitive rectangles.
+   float phase = (gl_FragCoord.x + gl_FragCoord.y) * 0.02 + (time * 0.8);
+   float angle = 6.2831853 * fract(phase);
+   float s = sin(angle);
+   float c = cos(angle);
+
+   mat3 rgbToYiq = mat3(
+      0.299,  0.587,  0.114,
+      0.596, -0.274, -0.322,
+      0.211, -0.523,  0.312
+   );
+
+   mat3 yiqToRgb = mat3(
+      1.0,  0.956,  0.621,
+      1.0, -0.272, -0.647,
+      1.0, -1.106,  1.703
+   );
+
+   vec3 yiq = rgbToYiq * base;
+   mat2 chromaRotation = mat2(c, -s, s, c);
+   yiq.yz = chromaRotation * yiq.yz;
+
+   vec3 rotated = clamp(yiqToRgb * yiq, 0.0, 1.0);
+   float shimmer = 0.92 + 0.08 * sin(phase * 8.0);
+   vec4 outColor = vec4(rotated * shimmer, varying_color.a);
+
+   if (!al_alpha_test || alpha_test_func(outColor.a, al_alpha_func, al_alpha_test_val))
+      gl_FragColor = outColor;
+   else
+      discard;
+}
@@ -0,0 +1,131 @@
+#ifdef GL_ES
+precision highp float;
+#endif
+
+// Draws the polar waveform over the whole visualization area from the audio
+// texture (vis::AudioTexture) instead of CPU-built line vertices.
+
+uniform bool al_alpha_test;
+uniform int al_alpha_func;
+uniform float al_alpha_test_val;
+
+uniform sampler2D audio_tex;
+uniform vec2 audio_tex_size;   // GL texture size, may exceed the bitmap's
+uniform vec2 audio_tex_offset; // bitmap's top-left texel in the texture
+uniform float mono_count;
+
+uniform vec2 vis_size;
+uniform float time;
+uniform float vis_radius;
+
+uniform float audio_rms;
+uniform float audio_peak;
+uniform float audio_transient;
+
+varying vec4 varying_color;
+varying vec2 varying_texcoord; // pixels from the area's top-left corner
+
+const float TWO_PI = 6.28318530718;
+const int SPAN_TAPS = 8;
+
+bool alpha_test_func(float x, int op, float compare);
+
+// Mono sample `index`: four per texel in row 0. Allegro keeps bitmaps
+// bottom-up in GL textures, so row 0 is at the top of texture space and the
+// offset counts down from there, as in the primitives addon.
+float monoSample(float index)
+{
+  float texel = floor(index / 4.0);
+  float lane = index - texel * 4.0;
+  vec2 texelPos = audio_tex_offset + vec2(texel, 0.0) + 0.5;
+  vec2 uv = vec2(texelPos.x / audio_tex_size.x, 1.0 - texelPos.y / audio_tex_size.y);
+  vec4 lanes = texture2D(audio_tex, uv);
+  return dot(lanes, vec4(equal(vec4(lane), vec4(0.0, 1.0, 2.0, 3.0)))) * 2.0 - 1.0;
+}
+
+// Waveform radius at fractional sample position t, linear between samples
+// like the line loop of the CPU path.
+float radiusAt(float t, float baseRadius, float maxRadius)
+{
+  t = mod(t, mono_count);
+  float i0 = floor(t);
+  float i1 = mod(i0 + 1.0, mono_count);
+  float a0 = abs(clamp(monoSample(i0), -1.0, 1.0));
+  float a1 = abs(clamp(monoSample(i1), -1.0, 1.0));
+  return baseRadius + mix(a0, a1, t - i0) * maxRadius;
+}
+
+void main()
+{
+  float minSide = min(vis_size.x, vis_size.y);
+  float baseRadius = minSide * 0.15;
+  float maxRadius = minSide * 0.35;
+
+  vec2 p = varying_texcoord - vis_size * 0.5;
+  float dist = length(p);
+  if (mono_count < 2.0 || dist < baseRadius - 2.0 || dist > baseRadius + maxRadius + 2.0)
+    discard;
+
+  float angle = atan(p.y, p.x);
+  if (angle < 0.0)
+    angle += TWO_PI;
+
+  // The samples this pixel spans along the circle; the line loop covers
+  // everything between the smallest and largest radius among them.
+  float t = angle / TWO_PI * mono_count;
+  float span = mono_count / (TWO_PI * max(dist, 1.0));
+  float rMin = baseRadius + maxRadius;
+  float rMax = baseRadius;
+  for (int k = 0; k < SPAN_TAPS; ++k) {
+    float offset = (float(k) + 0.5) / float(SPAN_TAPS) - 0.5;
+    float r = radiusAt(t + span * offset, baseRadius, maxRadius);
+    rMin = min(rMin, r);
+    rMax = max(rMax, r);
+  }
+  float lineDist = max(max(rMin - dist, dist - rMax), 0.0);
+  float coverage = 1.0 - smoothstep(0.5, 1.5, lineDist);
+  if (coverage <= 0.0)
+    discard;
+
+  float pulse = smoothstep(0.02, 0.72, audio_peak);
+  float energy = smoothstep(0.01, 0.30, audio_rms);
+  float hit = smoothstep(0.008, 0.22, audio_transient);
+
+  float ringDelta = abs(dist - vis_radius);
+  float innerBand = exp(-pow(ringDelta / (2.8 + energy * 8.5), 2.0));
+  float outerGlow = exp(-ringDelta / (20.0 + energy * 34.0));
+  float angularSweep = 0.5 + 0.5 * sin((angle * 8.0) - (time * (2.8 + pulse * 6.8)) + energy * 6.5);
+  float spark = pow(max(0.0, sin((angle * 14.0) + (time * 11.0))), 9.0) * hit;
+
+  vec3 base = varying_color.rgb;
+  vec3 cool = vec3(0.08, 0.55, 1.0);
+  vec3 hot = vec3(0.85, 0.20, 1.0);
+  vec3 plasma = mix(cool, hot, 0.25 + 0.75 * pulse);
+
+  vec3 color = base * (0.24 + 0.55 * energy);
+  color += plasma * (innerBand * (0.85 + 1.10 * angularSweep));
+  color += vec3(0.70, 0.94, 1.0) * outerGlow * (0.38 + 0.72 * pulse);
+  color += vec3(1.0, 0.98, 0.85) * spark * (0.95 + 1.25 * pulse);
+  color = clamp(color, 0.0, 1.0);
+
+  float alphaBoost = clamp(innerBand * 1.05 + outerGlow * 0.55 + spark * 1.15, 0.38, 1.0);
+  vec4 outColor = vec4(color, varying_color.a * alphaBoost * coverage);
+
+  if (!al_alpha_test || alpha_test_func(outColor.a, al_alpha_func, al_alpha_test_val))
+    gl_FragColor = outColor;
+  else
+    discard;
+}
+
+bool alpha_test_func(float x, int op, float compare)
+{
+  if (op == 0) return false;
+  else if (op == 1) return true;
+  else if (op == 2) return x < compare;
+  else if (op == 3) return x == compare;
+  else if (op == 4) return x <= compare;
+  else if (op == 5) return x > compare;
+  else if (op == 6) return x != compare;
+  else if (op == 7) return x >= compare;
+  return false;
+}
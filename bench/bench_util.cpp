@@ -0,0 +1,153 @@
+#include "bench_util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#if defined(_WIN32) || defined(WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace bench {
+
+std::atomic<uint64_t> allocation_count{0};
+
+bool peakRssResettable() {
+#if defined(__linux__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void resetPeakRss() {
+#if defined(__GLIBC__)
+    // Freed heap stays resident until trimmed, and would count against the
+    // next measurement.
+    malloc_trim(0);
+#endif
+#if defined(__linux__)
+    std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+size_t peakRssBytes() {
+#if defined(__linux__)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return static_cast<size_t>(std::strtoull(line.c_str() + 6, nullptr, 10)) * 1024;
+        }
+    }
+    return 0;
+#elif defined(_WIN32) || defined(WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+PageFaults pageFaults() {
+    PageFaults faults;
+#if !defined(_WIN32) && !defined(WIN32)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        faults.minor = static_cast<uint64_t>(usage.ru_minflt);
+        faults.major = static_cast<uint64_t>(usage.ru_majflt);
+    }
+#endif
+    return faults;
+}
+
+uint64_t fnv1a(uint64_t hash, const unsigned char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::string jsonString(const std::string& value) {
+    std::string out = "\"";
+    for (unsigned char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out + "\"";
+}
+
+std::string fixed(double value, int decimals) {
+    char number[64];
+    std::snprintf(number, sizeof(number), "%.*f", decimals, value);
+    return number;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+}
+
+std::string distributionJson(std::vector<double>& samples, int decimals) {
+    std::sort(samples.begin(), samples.end());
+    return "{\"p50\": " + fixed(percentile(samples, 0.50), decimals) +
+           ", \"p95\": " + fixed(percentile(samples, 0.95), decimals) +
+           ", \"p99\": " + fixed(percentile(samples, 0.99), decimals) +
+           ", \"max\": " + fixed(samples.empty() ? 0.0 : samples.back(), decimals) + "}";
+}
+
+} // namespace bench
+
+// GCC pairs the inlined new and delete below and flags malloc/free as a mismatch.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t n) {
+    bench::allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(n ? n : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](size_t n) {
+    return operator new(n);
+}
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Helpers shared by the benchmark executables. Linking bench_util.cpp also
+// replaces the global operator new/delete with versions that count
+// allocations in `allocation_count`.
+namespace bench {
+
+extern std::atomic<uint64_t> allocation_count;
+
+// Peak resident set size. On Linux the high-water mark can be reset, so a
+// measurement covers the work since resetPeakRss(); elsewhere it is the
+// process's peak.
+bool peakRssResettable();
+void resetPeakRss();
+size_t peakRssBytes();
+
+// Minor and major page faults of the process so far; 0 where unsupported.
+struct PageFaults {
+    uint64_t minor = 0;
+    uint64_t major = 0;
+};
+PageFaults pageFaults();
+
+uint64_t fnv1a(uint64_t hash, const unsigned char* data, size_t size);
+
+std::string jsonString(const std::string& value);
+std::string fixed(double value, int decimals);
+
+// `sorted` must be in ascending order.
+double percentile(const std::vector<double>& sorted, double p);
+
+// {"p50": .., "p95": .., "p99": .., "max": ..} of `samples`, which is sorted.
+std::string distributionJson(std::vector<double>& samples, int decimals = 1);
+
+} // namespace bench
@@ -0,0 +1,574 @@
+// Headless benchmarks of the audio-thread and analysis code in src/core, and
+// of the CPU side of the visualizations in src/vis.
+//
+// Nothing opens a display or an audio device, and the suites only use the
+// core and vis classes directly. Prints one JSON document on stdout with one object
+// per suite.
+//
+//   audiovis_bench_core [--suite NAME]... [--seconds N]
+//
+// --seconds is the time each timed case runs for; without --suite every
+// suite runs. Timings are wall-clock, so compare runs on the same machine
+// only.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "bench_util.hpp"
+#include "core/dsp_chain.hpp"
+#include "core/parametric_eq.hpp"
+#include "core/polyphase_resampler.hpp"
+#include "core/sample_kernels.hpp"
+#include "core/sample_ring.hpp"
+#include "core/spectrum_analyzer.hpp"
+#include "vis/audio_texture.hpp"
+#include "vis/polar_loop.hpp"
+
+namespace {
+
+using namespace bench;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::vector<std::string> suites;
+    double seconds = 2.0;
+};
+
+double microsecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+std::vector<int16_t> noiseInt16(size_t count, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> sample(-20000, 20000);
+    std::vector<int16_t> out(count);
+    for (auto& value : out) {
+        value = static_cast<int16_t>(sample(rng));
+    }
+    return out;
+}
+
+// ---- capture: mixer callback latency while the UI reads ------------------
+
+// One mixer block at 48 kHz stereo, the size Allegro hands the postprocess
+// callback by default.
+constexpr size_t kCaptureBlockFrames = 1024;
+constexpr size_t kCaptureChannels = 2;
+constexpr size_t kCaptureCapacity = 16384 * kCaptureChannels;
+
+// The capture ring as it was before SampleRing: one mutex around a vector,
+// converted and wrapped one sample at a time.
+class MutexCaptureRing {
+public:
+    explicit MutexCaptureRing(size_t capacity) : buffer(capacity) {}
+
+    void writeInt16(const int16_t* src, size_t count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < count; ++i) {
+            buffer[write_pos] = static_cast<float>(src[i]) / 32768.0f;
+            write_pos = (write_pos + 1) % buffer.size();
+            if (size < buffer.size()) {
+                ++size;
+            }
+        }
+    }
+
+    std::vector<float> copyRecentMono(size_t max_frames, size_t channels) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        const size_t frame_count = std::min(max_frames, size / channels);
+        std::vector<float> out(frame_count);
+        const size_t start = (write_pos + buffer.size() - frame_count * channels) % buffer.size();
+        for (size_t frame = 0; frame < frame_count; ++frame) {
+            float sum = 0.0f;
+            for (size_t channel = 0; channel < channels; ++channel) {
+                sum += buffer[(start + frame * channels + channel) % buffer.size()];
+            }
+            out[frame] = sum / static_cast<float>(channels);
+        }
+        return out;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::vector<float> buffer;
+    size_t write_pos = 0;
+    size_t size = 0;
+};
+
+// Calls `write` back to back for `seconds` while `readers` threads call
+// `read` as fast as they can; returns the latency of every write, in us.
+template <typename WriteFn, typename ReadFn>
+std::vector<double> captureLatencies(double seconds, int readers, WriteFn&& write, ReadFn&& read) {
+    std::atomic<bool> running{true};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < readers; ++i) {
+        threads.emplace_back([&]() {
+            while (running.load(std::memory_order_relaxed)) {
+                read();
+            }
+        });
+    }
+
+    std::vector<double> latencies;
+    latencies.reserve(1 << 20);
+    const auto end = Clock::now() + std::chrono::duration<double>(seconds);
+    while (Clock::now() < end) {
+        const auto start = Clock::now();
+        write();
+        latencies.push_back(microsecondsSince(start));
+    }
+
+    running = false;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return latencies;
+}
+
+void runCapture(const Options& options, std::ostream& out) {
+    const std::vector<int16_t> block = noiseInt16(kCaptureBlockFrames * kCaptureChannels, 11);
+    constexpr int kReaders = 2;
+
+    core::SampleRing ring;
+    ring.setCapacity(kCaptureCapacity);
+    std::vector<float> mono(kCaptureCapacity / kCaptureChannels);
+    auto ringWrite = [&]() { ring.writeInt16(block.data(), block.size()); };
+    auto ringRead = [&]() { ring.readRecentMono(mono.data(), mono.size(), kCaptureChannels); };
+
+    MutexCaptureRing locked(kCaptureCapacity);
+    auto lockedWrite = [&]() { locked.writeInt16(block.data(), block.size()); };
+    auto lockedRead = [&]() { locked.copyRecentMono(kCaptureCapacity / kCaptureChannels, kCaptureChannels); };
+
+    std::vector<double> ringIdle = captureLatencies(options.seconds, 0, ringWrite, ringRead);
+    std::vector<double> ringBusy = captureLatencies(options.seconds, kReaders, ringWrite, ringRead);
+    std::vector<double> lockedIdle = captureLatencies(options.seconds, 0, lockedWrite, lockedRead);
+    std::vector<double> lockedBusy = captureLatencies(options.seconds, kReaders, lockedWrite, lockedRead);
+
+    out << "{\"block_frames\": " << kCaptureBlockFrames << ", \"channels\": " << kCaptureChannels
+        << ", \"reader_threads\": " << kReaders << ", \"read_frames\": " << mono.size()
+        << ",\n     \"sample_ring\": {\"callbacks\": " << ringBusy.size()
+        << ", \"idle_us\": " << distributionJson(ringIdle, 2)
+        << ", \"contended_us\": " << distributionJson(ringBusy, 2) << "}"
+        << ",\n     \"mutex_ring\": {\"callbacks\": " << lockedBusy.size()
+        << ", \"idle_us\": " << distributionJson(lockedIdle, 2)
+        << ", \"contended_us\": " << distributionJson(lockedBusy, 2) << "}}";
+}
+
+// ---- reads: per-frame sample reads, vector vs caller buffer ---------------
+
+// Runs `fn` repeatedly for `seconds`; returns ns per call and allocations
+// per call.
+template <typename Fn>
+std::pair<double, double> timePerCall(double seconds, Fn&& fn) {
+    uint64_t calls = 0;
+    const uint64_t allocations_before = allocation_count.load();
+    const auto start = Clock::now();
+    const auto end = start + std::chrono::duration<double>(seconds);
+    do {
+        for (int i = 0; i < 64; ++i) {
+            fn();
+        }
+        calls += 64;
+    } while (Clock::now() < end);
+    const double elapsed_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    return {elapsed_ns / calls, static_cast<double>(allocation_count.load() - allocations_before) / calls};
+}
+
+void runReads(const Options& options, std::ostream& out) {
+    constexpr size_t kChannels = 2;
+    core::SampleRing ring;
+    ring.setCapacity(32768);
+    const std::vector<int16_t> block = noiseInt16(32768, 12);
+    ring.writeInt16(block.data(), block.size());
+
+    std::vector<float> reused(16384);
+    volatile float sink = 0.0f;
+    const double seconds = options.seconds / 8.0;
+
+    out << "[";
+    const size_t sizes[] = {1024, 4096, 16384};
+    for (size_t i = 0; i < std::size(sizes); ++i) {
+        const size_t n = sizes[i];
+        // copyRecentSamples()/copyRecentMonoSamples(): a fresh vector per read.
+        const auto vector = timePerCall(seconds, [&]() {
+            std::vector<float> samples(std::min(n, ring.getSize()));
+            samples.resize(ring.readRecent(samples.data(), samples.size()));
+            sink = sink + samples[0];
+        });
+        const auto vectorMono = timePerCall(seconds, [&]() {
+            std::vector<float> samples(std::min(n, ring.getSize() / kChannels));
+            samples.resize(ring.readRecentMono(samples.data(), samples.size(), kChannels));
+            sink = sink + samples[0];
+        });
+        // readRecentInto()/readRecentMonoInto(): the caller's buffer.
+        const auto into = timePerCall(seconds, [&]() {
+            ring.readRecent(reused.data(), n);
+            sink = sink + reused[0];
+        });
+        const auto intoMono = timePerCall(seconds, [&]() {
+            ring.readRecentMono(reused.data(), n, kChannels);
+            sink = sink + reused[0];
+        });
+
+        out << (i ? ",\n     " : "") << "{\"samples\": " << n
+            << ", \"copy_ns\": " << fixed(vector.first, 0) << ", \"copy_allocations\": " << fixed(vector.second, 2)
+            << ", \"into_ns\": " << fixed(into.first, 0) << ", \"into_allocations\": " << fixed(into.second, 2)
+            << ", \"copy_mono_ns\": " << fixed(vectorMono.first, 0) << ", \"copy_mono_allocations\": " << fixed(vectorMono.second, 2)
+            << ", \"into_mono_ns\": " << fixed(intoMono.first, 0) << ", \"into_mono_allocations\": " << fixed(intoMono.second, 2) << "}";
+    }
+    out << "]";
+}
+
+// ---- kernels: every sample-kernel table the CPU supports -----------------
+
+void runKernels(const Options& options, std::ostream& out) {
+    constexpr size_t kBlock = 4096; // samples per call, one engine postprocess chunk
+    const std::vector<int16_t> pcm = noiseInt16(kBlock, 13);
+    std::vector<float> floats(kBlock);
+    std::vector<int16_t> shorts(kBlock);
+    std::vector<float> mono(kBlock / 2);
+    core::scalarSampleKernels().int16ToFloat(pcm.data(), floats.data(), kBlock);
+    const double seconds = options.seconds / 6.0;
+
+    // Millions of input samples per second.
+    auto rate = [&](double ns_per_call) { return fixed(kBlock / ns_per_call * 1000.0, 0); };
+
+    out << "{\"block_samples\": " << kBlock << ", \"dispatched\": " << jsonString(core::sampleKernels().name)
+        << ", \"msamples_per_second\": [";
+    bool first = true;
+    for (const char* name : {"scalar", "sse2", "avx2"}) {
+        const core::SampleKernels* kernels = core::sampleKernelsNamed(name);
+        if (!kernels) {
+            continue;
+        }
+        const auto toFloat = timePerCall(seconds, [&]() { kernels->int16ToFloat(pcm.data(), floats.data(), kBlock); });
+        const auto toInt16 = timePerCall(seconds, [&]() { kernels->floatToInt16(floats.data(), shorts.data(), kBlock); });
+        const auto downmix = timePerCall(seconds, [&]() { kernels->downmixToMono(floats.data(), mono.data(), kBlock / 2, 2); });
+        out << (first ? "\n       " : ",\n       ") << "{\"kernels\": " << jsonString(name)
+            << ", \"int16_to_float\": " << rate(toFloat.first)
+            << ", \"float_to_int16\": " << rate(toInt16.first)
+            << ", \"downmix_stereo\": " << rate(downmix.first) << "}";
+        first = false;
+    }
+    out << "]}";
+}
+
+// ---- resampler: CPU cost of each [audio] resampler mode ------------------
+
+// Allegro's mixer cannot be pumped without a voice, so "linear" and "cubic"
+// are timed as the interpolation it applies per output sample, in a plain
+// loop. Allegro's own loop goes through a call per sample, so read those two
+// as lower bounds. "polyphase" is core::PolyphaseResampler as the engine's
+// feed thread drives it, in 1024-frame input chunks.
+constexpr size_t kResampleChannels = 2;
+constexpr size_t kResampleBlockFrames = 1024; // output frames per call
+
+// Interpolates `frames` output frames starting `position` input frames into
+// `in`, which must hold position + frames * step + 3 frames.
+template <bool Cubic>
+void interpolate(const float* in, double position, double step, float* out, size_t frames) {
+    for (size_t f = 0; f < frames; ++f, position += step) {
+        const size_t i = static_cast<size_t>(position);
+        const float t = static_cast<float>(position - static_cast<double>(i));
+        for (size_t c = 0; c < kResampleChannels; ++c) {
+            const float* s = in + i * kResampleChannels + c;
+            if (Cubic) {
+                const float s0 = s[0], s1 = s[kResampleChannels], s2 = s[2 * kResampleChannels],
+                            s3 = s[3 * kResampleChannels];
+                const float a0 = s3 - s2 - s0 + s1;
+                const float a1 = s0 - s1 - a0;
+                const float a2 = s2 - s0;
+                out[f * kResampleChannels + c] = ((a0 * t + a1) * t + a2) * t + s1;
+            } else {
+                out[f * kResampleChannels + c] = s[0] + (s[kResampleChannels] - s[0]) * t;
+            }
+        }
+    }
+}
+
+void runResampler(const Options& options, std::ostream& out) {
+    const std::vector<int16_t> pcm = noiseInt16(65536 * kResampleChannels, 14);
+    std::vector<float> input(pcm.size());
+    core::scalarSampleKernels().int16ToFloat(pcm.data(), input.data(), input.size());
+    const size_t input_frames = input.size() / kResampleChannels;
+    std::vector<float> output(kResampleBlockFrames * kResampleChannels);
+    volatile float sink = 0.0f;
+    const double seconds = options.seconds / 9.0;
+
+    struct Conversion {
+        double from;
+        double to;
+    };
+    const Conversion conversions[] = {{44100, 48000}, {48000, 44100}, {96000, 48000}};
+
+    out << "{\"channels\": " << kResampleChannels << ", \"block_frames\": " << kResampleBlockFrames
+        << ", \"conversions\": [";
+    for (size_t i = 0; i < std::size(conversions); ++i) {
+        const Conversion conversion = conversions[i];
+        const double step = conversion.from / conversion.to;
+        const size_t block_input = static_cast<size_t>(kResampleBlockFrames * step) + 4;
+
+        double position = 0.0;
+        auto interpolated = [&](auto cubic) {
+            return timePerCall(seconds, [&]() {
+                if (position + block_input >= input_frames) {
+                    position = 0.0;
+                }
+                interpolate<decltype(cubic)::value>(input.data(), position, step, output.data(), kResampleBlockFrames);
+                position += kResampleBlockFrames * step;
+                sink = sink + output[0];
+            });
+        };
+        const auto linear = interpolated(std::false_type{});
+        const auto cubic = interpolated(std::true_type{});
+
+        core::PolyphaseResampler resampler(conversion.from, conversion.to, kResampleChannels);
+        size_t next_input = 0;
+        const auto polyphase = timePerCall(seconds, [&]() {
+            size_t produced = 0;
+            while (produced < kResampleBlockFrames) {
+                produced += resampler.pull(output.data() + produced * kResampleChannels, kResampleBlockFrames - produced);
+                if (produced < kResampleBlockFrames) {
+                    if (next_input + 1024 > input_frames) {
+                        next_input = 0;
+                    }
+                    resampler.push(input.data() + next_input * kResampleChannels, 1024);
+                    next_input += 1024;
+                }
+            }
+            sink = sink + output[0];
+        });
+
+        // Share of one core needed to keep up with playback.
+        auto mode = [&](const char* name, double ns_per_block) {
+            const double ns_per_frame = ns_per_block / kResampleBlockFrames;
+            return std::string("{\"mode\": ") + jsonString(name) + ", \"ns_per_frame\": " + fixed(ns_per_frame, 2) +
+                   ", \"cpu_percent\": " + fixed(ns_per_frame * conversion.to / 1e7, 3) + "}";
+        };
+        out << (i ? ",\n       " : "\n       ") << "{\"from_hz\": " << fixed(conversion.from, 0)
+            << ", \"to_hz\": " << fixed(conversion.to, 0) << ", \"modes\": [" << mode("linear", linear.first) << ", "
+            << mode("cubic", cubic.first) << ", " << mode("polyphase", polyphase.first) << "]}";
+    }
+    out << "]}";
+}
+
+// ---- eq: mixer DSP chain cost per block -----------------------------------
+
+// The chain as MusicEngine runs it in the mixer postprocess callback, at
+// 48 kHz stereo: a ParametricEq with every band and the preamp active (no
+// band is skipped), and the same chain with a flat EQ, which the chain
+// bypasses.
+void runEq(const Options& options, std::ostream& out) {
+    constexpr double kRate = 48000.0;
+    constexpr size_t kChannels = 2;
+    const std::vector<int16_t> pcm = noiseInt16(4096 * kChannels, 15);
+    std::vector<float> source(pcm.size());
+    core::scalarSampleKernels().int16ToFloat(pcm.data(), source.data(), source.size());
+    std::vector<float> block(source.size());
+    const double seconds = options.seconds / 6.0;
+
+    auto eq = std::make_shared<core::ParametricEq>();
+    core::DspChain chain;
+    chain.configure(kRate, kChannels);
+    chain.add(eq);
+    core::ParametricEq::Settings active = eq->getSettings();
+    active.preamp_db = -6.0f;
+    for (size_t band = 0; band < active.bands.size(); ++band) {
+        active.bands[band].gain_db = band % 2 ? -4.5f : 6.0f;
+    }
+    const core::ParametricEq::Settings flat;
+
+    out << "{\"sample_rate\": " << fixed(kRate, 0) << ", \"channels\": " << kChannels << ", \"blocks\": [";
+    const size_t sizes[] = {256, 1024, 4096};
+    for (size_t i = 0; i < std::size(sizes); ++i) {
+        const size_t frames = sizes[i];
+        // Fresh audio each call so the filters never settle into denormals.
+        auto run = [&]() {
+            std::copy(source.begin(), source.begin() + frames * kChannels, block.begin());
+            chain.process(block.data(), frames);
+        };
+        eq->setSettings(active);
+        const auto processed = timePerCall(seconds, run);
+        eq->setSettings(flat);
+        const auto bypassed = timePerCall(seconds, run);
+
+        const double deadline_us = frames / kRate * 1e6;
+        out << (i ? ",\n       " : "\n       ") << "{\"frames\": " << frames
+            << ", \"deadline_us\": " << fixed(deadline_us, 1)
+            << ", \"eq_us\": " << fixed(processed.first / 1000.0, 2)
+            << ", \"eq_deadline_percent\": " << fixed(processed.first / 10.0 / deadline_us, 3)
+            << ", \"bypassed_us\": " << fixed(bypassed.first / 1000.0, 2)
+            << ", \"allocations_per_block\": " << fixed(processed.second, 2) << "}";
+    }
+    out << "]}";
+}
+
+// ---- waveform: polar waveform vertices per frame ---------------------------
+
+// The polar waveform as it was drawn before PolarLoop: a fresh line list each
+// frame, two vertices per sample, with cos and sin for both ends.
+void polarLineList(const std::vector<float>& samples, float centerX, float centerY, float baseRadius,
+                   float maxRadius, ALLEGRO_COLOR color, std::vector<ALLEGRO_VERTEX>& result) {
+    const float twoPi = 2.0f * 3.14159265359f;
+    std::vector<ALLEGRO_VERTEX> vertices;
+    vertices.reserve(samples.size() * 2);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const size_t next = (i + 1) % samples.size();
+        const float angle1 = (static_cast<float>(i) / samples.size()) * twoPi;
+        const float angle2 = (static_cast<float>(next) / samples.size()) * twoPi;
+        const float radius1 = baseRadius + std::abs(std::clamp(samples[i], -1.0f, 1.0f)) * maxRadius;
+        const float radius2 = baseRadius + std::abs(std::clamp(samples[next], -1.0f, 1.0f)) * maxRadius;
+        vertices.push_back({centerX + radius1 * std::cos(angle1), centerY + radius1 * std::sin(angle1), 0.0f, 0.0f,
+                            0.0f, color});
+        vertices.push_back({centerX + radius2 * std::cos(angle2), centerY + radius2 * std::sin(angle2), 0.0f, 0.0f,
+                            0.0f, color});
+    }
+    result.swap(vertices);
+}
+
+// CPU time to build one frame of polar waveform vertices for an 800 x 600
+// area, before PolarLoop and with it. Submitting them to the GPU is not
+// included; that needs a display.
+void runWaveform(const Options& options, std::ostream& out) {
+    constexpr float kCenterX = 400.0f;
+    constexpr float kCenterY = 300.0f;
+    constexpr float kBaseRadius = 600.0f * 0.15f;
+    constexpr float kMaxRadius = 600.0f * 0.35f;
+    const ALLEGRO_COLOR color = {1.0f, 1.0f, 1.0f, 220.0f / 255.0f};
+    const std::vector<int16_t> pcm = noiseInt16(8192, 16);
+    volatile float sink = 0.0f;
+    const double seconds = options.seconds / 4.0;
+
+    out << "{\"windows\": [";
+    const size_t sizes[] = {1024, 8192};
+    for (size_t i = 0; i < std::size(sizes); ++i) {
+        std::vector<float> samples(sizes[i]);
+        core::scalarSampleKernels().int16ToFloat(pcm.data(), samples.data(), samples.size());
+
+        std::vector<ALLEGRO_VERTEX> list;
+        const auto before = timePerCall(seconds, [&]() {
+            polarLineList(samples, kCenterX, kCenterY, kBaseRadius, kMaxRadius, color, list);
+            sink = sink + list[0].x;
+        });
+        vis::PolarLoop loop;
+        std::vector<ALLEGRO_VERTEX> vertices(samples.size());
+        const auto after = timePerCall(seconds, [&]() {
+            loop.build(samples.data(), samples.size(), kCenterX, kCenterY, kBaseRadius, kMaxRadius, color,
+                       vertices.data());
+            sink = sink + vertices[0].x;
+        });
+
+        out << (i ? ",\n       " : "\n       ") << "{\"samples\": " << sizes[i]
+            << ", \"line_list_us\": " << fixed(before.first / 1000.0, 2)
+            << ", \"line_list_vertices\": " << list.size()
+            << ", \"line_list_allocations\": " << fixed(before.second, 2)
+            << ", \"polar_loop_us\": " << fixed(after.first / 1000.0, 2)
+            << ", \"polar_loop_vertices\": " << vertices.size()
+            << ", \"polar_loop_allocations\": " << fixed(after.second, 2) << "}";
+    }
+    out << "]";
+
+    // What the shader path costs the CPU instead: packing the mono, left and
+    // right windows and the spectrum into vis::AudioTexture's rows, as
+    // upload() does each frame between locking and unlocking the texture.
+    // The polar waveform's window fills a row.
+    std::vector<float> window(vis::AudioTexture::kMaxValues);
+    core::scalarSampleKernels().int16ToFloat(pcm.data(), window.data(), window.size());
+    core::SpectrumSnapshot spectrum;
+    spectrum.band_count = 64;
+    for (size_t band = 0; band < spectrum.band_count; ++band) {
+        spectrum.band_level[band] = static_cast<float>(band) / spectrum.band_count;
+    }
+    std::vector<float> texels(vis::AudioTexture::kWidth * 4 * vis::AudioTexture::kRows);
+    out << ", \"audio_texture\": {\"samples\": " << window.size() << ", \"bands\": " << spectrum.band_count;
+    for (const bool float_texels : {true, false}) {
+        const auto fill = timePerCall(seconds, [&]() {
+            for (int row = vis::AudioTexture::Mono; row <= vis::AudioTexture::Right; ++row) {
+                vis::AudioTexture::packRow(static_cast<vis::AudioTexture::Row>(row), window.data(), window.size(),
+                                           float_texels, texels.data() + row * vis::AudioTexture::kWidth * 4);
+            }
+            vis::AudioTexture::packRow(vis::AudioTexture::Spectrum, spectrum.band_level.data(), spectrum.band_count,
+                                       float_texels, texels.data() + vis::AudioTexture::Spectrum * vis::AudioTexture::kWidth * 4);
+            sink = sink + texels[0];
+        });
+        out << (float_texels ? ", \"float_fill_us\": " : ", \"rgba8_fill_us\": ") << fixed(fill.first / 1000.0, 2);
+    }
+    out << "}}";
+}
+
+// --------------------------------------------------------------------------
+
+struct Suite {
+    const char* name;
+    void (*run)(const Options& options, std::ostream& out);
+};
+
+const Suite kSuites[] = {
+    {"capture", runCapture},
+    {"reads", runReads},
+    {"kernels", runKernels},
+    {"resampler", runResampler},
+    {"eq", runEq},
+    {"waveform", runWaveform},
+};
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "usage: audiovis_bench_core [--suite NAME]... [--seconds N]\n";
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--suite") {
+            const bool known = std::any_of(std::begin(kSuites), std::end(kSuites),
+                                           [value](const Suite& suite) { return suite.name == std::string(value); });
+            if (!known) {
+                std::cerr << "core bench: unknown suite " << value << "\n";
+                return false;
+            }
+            options.suites.push_back(value);
+        } else if (arg == "--seconds") {
+            options.seconds = std::max(0.1, std::atof(value));
+        } else {
+            std::cerr << "core bench: unknown option " << arg << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    std::cout << "{\n  \"benchmark\": \"core\",\n  \"schema\": 1,\n  \"seconds_per_case\": "
+              << fixed(options.seconds, 1) << ",\n  \"hardware_threads\": " << std::thread::hardware_concurrency();
+    for (const Suite& suite : kSuites) {
+        if (!options.suites.empty() &&
+            std::find(options.suites.begin(), options.suites.end(), suite.name) == options.suites.end()) {
+            continue;
+        }
+        std::cerr << suite.name << "...\n";
+        std::cout << ",\n  " << jsonString(suite.name) << ": ";
+        suite.run(options, std::cout);
+    }
+    std::cout << "\n}\n";
+    return 0;
+}
@@ -0,0 +1,1028 @@
+// Headless decode benchmark.
+//
+// Generates a small corpus (a synthetic Layer III stream for MP3, plus
+// WAV/FLAC/OGG written by Allegro's acodec encoders where the build has
+// them), decodes every file to memory through core::openDecoder() and prints
+// one JSON document on stdout. Nothing opens a display or an audio device.
+//
+//   audiovis_bench_decode [--seconds N] [--runs N] [--seeks N] [--corpus DIR]
+//                         [--long-seconds N]
+//
+// --corpus adds every file in DIR (real music decodes slower than the
+// generated signal, so compare runs against the same corpus only).
+//
+// The MP3 loader is measured separately on one long generated file
+// (--long-seconds, 30 minutes by default; 0 skips it), where costs that grow
+// with file length show.
+//
+// Each file is also run once through core::analyzeTrack(), the library
+// scanner's loudness and tempo pass, to report its throughput in MB/s.
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(_WIN32) || defined(WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_audio.h>
+#include <allegro5/allegro_acodec.h>
+
+#include "bench_util.hpp"
+#include "core/decode_scheduler.hpp"
+#include "core/decoder.hpp"
+#include "core/stream_source.hpp"
+#include "core/track_analysis.hpp"
+#include "mp3/minimp3.h"
+#include "mp3/mp3_streaming.hpp"
+#include "mp3/mp3_support.hpp"
+#include "util/config.hpp"
+
+namespace {
+
+// Every operator new (bench_util.cpp) and al_malloc/al_calloc/al_realloc.
+// Allocations made by codec libraries with plain malloc (libFLAC, libvorbis)
+// are not seen.
+using bench::allocation_count;
+
+void* countedMalloc(size_t n, int, const char*, const char*) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(n);
+}
+void* countedCalloc(size_t count, size_t n, int, const char*, const char*) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return std::calloc(count, n);
+}
+void* countedRealloc(void* ptr, size_t n, int, const char*, const char*) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return std::realloc(ptr, n);
+}
+void countedFree(void* ptr, int, const char*, const char*) {
+    std::free(ptr);
+}
+
+ALLEGRO_MEMORY_INTERFACE counted_memory = {countedMalloc, countedFree, countedRealloc, countedCalloc};
+
+using namespace bench;
+
+constexpr unsigned int kSampleRate = 44100;
+// Same block size as the engine's decode workers.
+constexpr size_t kReadFrames = 4096;
+// Audio decoded after each seek before the clock stops, so decoders that
+// defer work past seek() are measured fairly.
+constexpr size_t kSeekReadFrames = 1024;
+
+// The MP3 loader's memory budget by default ([audio] stream_memory_kb).
+constexpr size_t kDefaultMemoryBudget = 2 * 1024 * 1024;
+
+struct Options {
+    double seconds = 30.0;
+    int runs = 3;
+    int seeks = 200;
+    std::string corpus;
+    double long_seconds = 1800.0;
+};
+
+struct CorpusFile {
+    std::string format; // lowercase extension without the dot
+    std::string path;
+    bool generated = false;
+    std::string skipped; // why there is no file, if empty there is one
+};
+
+struct Result {
+    double audio_seconds = 0.0;
+    double best_seconds = 0.0;
+    double total_seconds = 0.0;
+    uint64_t pcm_bytes = 0;
+    uint64_t pcm_frames = 0;
+    uint64_t allocations = 0;
+    uint64_t checksum = 0;
+    bool checksum_stable = true;
+    size_t peak_rss = 0;
+    std::vector<double> seek_us;
+    double analysis_seconds = 0.0; // one core::analyzeTrack() pass, 0 if it failed
+    core::DecoderFormat format;
+    std::string error;
+};
+
+// Two detuned partials under a slow envelope plus a little noise: enough
+// structure that FLAC and Vorbis cannot collapse it to nothing.
+std::vector<int16_t> generateSignal(double seconds) {
+    const size_t frames = static_cast<size_t>(seconds * kSampleRate);
+    std::vector<int16_t> pcm(frames * 2);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+    const double tau = 6.283185307179586;
+    for (size_t i = 0; i < frames; ++i) {
+        const double t = static_cast<double>(i) / kSampleRate;
+        const double envelope = 0.55 + 0.35 * std::sin(tau * 0.25 * t);
+        const double left = std::sin(tau * 220.0 * t) + 0.5 * std::sin(tau * 1761.0 * t);
+        const double right = std::sin(tau * 220.7 * t) + 0.5 * std::sin(tau * 2637.0 * t);
+        pcm[i * 2] = static_cast<int16_t>(12000.0 * envelope * left + 300.0f * noise(rng));
+        pcm[i * 2 + 1] = static_cast<int16_t>(12000.0 * envelope * right + 300.0f * noise(rng));
+    }
+    return pcm;
+}
+
+// The tree has no MP3 encoder, so this writes a valid MPEG-1 Layer III
+// stream (44.1 kHz stereo, 128 kbps) with random scalefactors and
+// count1 spectra, and main data that leans on the bit reservoir the way
+// encoded music does. It decodes as noise; Huffman decoding is lighter than
+// for real music, which --corpus covers.
+bool writeSyntheticMp3(const std::string& path, double seconds) {
+    constexpr int kFrameBytes = 417; // 144 * 128000 / 44100, no padding
+    constexpr int kPayload = kFrameBytes - 36; // after the header and side info
+    static const int kTables[] = {1, 2, 3, 5, 6, 7, 8, 9, 10, 11, 12, 13, 15, 16, 17, 20, 24, 28};
+
+    const int frames = std::max(1, static_cast<int>(seconds * kSampleRate / 1152));
+    std::vector<unsigned char> file(static_cast<size_t>(frames) * kFrameBytes);
+    std::mt19937 rng(7);
+    for (auto& byte : file) {
+        byte = static_cast<unsigned char>(rng());
+    }
+
+    long data_end = 0; // reservoir position where the previous frame's main data ended
+    for (int i = 0; i < frames; ++i) {
+        unsigned char* frame = &file[static_cast<size_t>(i) * kFrameBytes];
+        frame[0] = 0xFF;
+        frame[1] = 0xFB;
+        frame[2] = 0x90;
+        frame[3] = 0x00;
+
+        const long payload_start = static_cast<long>(i) * kPayload;
+        const long data_start = std::max(data_end, payload_start - 511);
+        const long available = payload_start + kPayload - data_start;
+        const long wanted = std::min<long>(150 + rng() % 560, available);
+        int bits[4];
+        long total_bits = 0;
+        for (int& granule_bits : bits) {
+            granule_bits = static_cast<int>(wanted * 8 / 4 - static_cast<long>(rng() % 8));
+            total_bits += granule_bits;
+        }
+        data_end = data_start + (total_bits + 7) / 8;
+
+        int bit = 0;
+        auto put = [&](unsigned value, int count) {
+            for (int b = count - 1; b >= 0; --b, ++bit) {
+                unsigned char& byte = frame[4 + bit / 8];
+                const int shift = 7 - bit % 8;
+                byte = static_cast<unsigned char>((byte & ~(1 << shift)) | (((value >> b) & 1) << shift));
+            }
+        };
+        put(static_cast<unsigned>(payload_start - data_start), 9); // main_data_begin
+        put(0, 3);                                                 // private bits
+        put(0, 8);                                                 // scfsi
+        for (int granule = 0; granule < 4; ++granule) {
+            put(static_cast<unsigned>(bits[granule]), 12);        // part2_3_length
+            put(0, 9);                                             // big_values
+            put(140 + rng() % 40, 8);                              // global_gain
+            put(rng() % 16, 4);                                    // scalefac_compress
+            put(0, 1);                                             // window_switching_flag
+            for (int region = 0; region < 3; ++region) {
+                put(static_cast<unsigned>(kTables[rng() % 18]), 5);
+            }
+            put(rng() % 16, 4);                                    // region0_count
+            put(rng() % 8, 3);                                     // region1_count
+            put(0, 1);                                             // preflag
+            put(0, 1);                                             // scalefac_scale
+            put(rng() % 2, 1);                                     // count1table_select
+        }
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+    return static_cast<bool>(out);
+}
+
+std::vector<CorpusFile> buildCorpus(const Options& options, const std::filesystem::path& work_dir) {
+    std::vector<CorpusFile> corpus;
+
+    CorpusFile mp3{"mp3", (work_dir / "generated.mp3").string(), true, ""};
+    if (!writeSyntheticMp3(mp3.path, options.seconds)) {
+        mp3.skipped = "could not write " + mp3.path;
+    }
+    corpus.push_back(mp3);
+
+    std::vector<int16_t> pcm = generateSignal(options.seconds);
+    ALLEGRO_SAMPLE* sample = al_create_sample(pcm.data(), static_cast<unsigned int>(pcm.size() / 2), kSampleRate,
+                                              ALLEGRO_AUDIO_DEPTH_INT16, ALLEGRO_CHANNEL_CONF_2, false);
+    for (const char* format : {"wav", "flac", "ogg"}) {
+        CorpusFile file{format, (work_dir / (std::string("generated.") + format)).string(), true, ""};
+        if (!sample || !al_save_sample(file.path.c_str(), sample)) {
+            file.skipped = std::string("this Allegro build cannot encode .") + format + "; use --corpus";
+        }
+        corpus.push_back(file);
+    }
+    if (sample) {
+        al_destroy_sample(sample);
+    }
+
+    if (!options.corpus.empty()) {
+        std::error_code ec;
+        std::vector<std::filesystem::path> paths;
+        for (const auto& entry : std::filesystem::directory_iterator(options.corpus, ec)) {
+            if (entry.is_regular_file()) {
+                paths.push_back(entry.path());
+            }
+        }
+        if (ec) {
+            std::cerr << "decode bench: cannot read corpus " << options.corpus << ": " << ec.message() << "\n";
+        }
+        std::sort(paths.begin(), paths.end());
+        for (const auto& path : paths) {
+            std::string format = path.extension().string();
+            format.erase(0, format.empty() ? 0 : 1);
+            std::transform(format.begin(), format.end(), format.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            corpus.push_back({format, path.string(), false, ""});
+        }
+    }
+    return corpus;
+}
+
+Result benchmarkFile(const CorpusFile& file, const Options& options) {
+    Result result;
+    std::vector<unsigned char> buffer;
+    resetPeakRss();
+
+    for (int run = 0; run < options.runs; ++run) {
+        const uint64_t allocations_before = allocation_count.load();
+        const auto start = std::chrono::steady_clock::now();
+
+        std::unique_ptr<core::Decoder> decoder = core::openDecoder(file.path);
+        if (!decoder) {
+            result.error = "no decoder accepted the file";
+            return result;
+        }
+        const core::DecoderFormat& format = decoder->getFormat();
+        const size_t frame_size = format.frameSize();
+        buffer.resize(kReadFrames * frame_size);
+
+        uint64_t checksum = 0xcbf29ce484222325ull;
+        uint64_t frames = 0;
+        while (size_t decoded = decoder->read(buffer.data(), kReadFrames)) {
+            checksum = fnv1a(checksum, buffer.data(), decoded * frame_size);
+            frames += decoded;
+        }
+
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.allocations += allocation_count.load() - allocations_before;
+        result.total_seconds += elapsed;
+        if (run == 0 || elapsed < result.best_seconds) {
+            result.best_seconds = elapsed;
+        }
+        if (run > 0 && checksum != result.checksum) {
+            result.checksum_stable = false;
+        }
+        result.checksum = checksum;
+        result.format = format;
+        result.pcm_bytes = frames * frame_size;
+        result.pcm_frames = frames;
+        result.audio_seconds = static_cast<double>(frames) / format.frequency;
+    }
+
+    if (options.seeks > 0 && result.audio_seconds > 1.0) {
+        std::unique_ptr<core::Decoder> decoder = core::openDecoder(file.path);
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<double> position(0.0, result.audio_seconds - 1.0);
+        for (int i = 0; decoder && i < options.seeks; ++i) {
+            const double target = position(rng);
+            const auto start = std::chrono::steady_clock::now();
+            if (decoder->seek(target)) {
+                decoder->read(buffer.data(), kSeekReadFrames);
+                result.seek_us.push_back(
+                    std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            }
+        }
+        std::sort(result.seek_us.begin(), result.seek_us.end());
+    }
+
+    const auto analysis_start = std::chrono::steady_clock::now();
+    if (core::analyzeTrack(file.path)) {
+        result.analysis_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - analysis_start).count();
+    }
+
+    result.peak_rss = peakRssBytes();
+    return result;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The MP3 loader before it streamed (_al_load_mp3_audio_stream_f): read the
+// whole file, walk every frame to build the offset table, then decode the
+// first frame. Returns the samples per channel of that frame; `peak_rss` is
+// taken before anything is freed.
+int legacyMp3FirstFrame(const std::string& path, size_t& peak_rss) {
+    ALLEGRO_FILE* f = al_fopen(path.c_str(), "rb");
+    if (!f) {
+        return 0;
+    }
+    const int64_t file_size = al_fsize(f);
+    auto* file_buffer = static_cast<uint8_t*>(al_malloc(static_cast<size_t>(std::max<int64_t>(file_size, 1))));
+    const bool complete = al_fread(f, file_buffer, static_cast<size_t>(file_size)) == static_cast<size_t>(file_size);
+    al_fclose(f);
+
+    mp3dec_t dec;
+    mp3dec_init(&dec);
+    mp3dec_frame_info_t info;
+    int* frame_offsets = nullptr;
+    int capacity = 0;
+    int num_frames = 0;
+    int offset = 0;
+    while (complete) {
+        if (num_frames + 1 > capacity) {
+            capacity = num_frames * 3 / 2 + 1;
+            frame_offsets = static_cast<int*>(al_realloc(frame_offsets, sizeof(int) * capacity));
+        }
+        if (mp3dec_decode_frame(&dec, file_buffer + offset, static_cast<int>(file_size - offset), nullptr, &info) == 0) {
+            break;
+        }
+        frame_offsets[num_frames++] = offset;
+        offset += info.frame_bytes;
+    }
+
+    int samples = 0;
+    if (num_frames > 0) {
+        std::vector<mp3d_sample_t> pcm(MINIMP3_MAX_SAMPLES_PER_FRAME);
+        mp3dec_init(&dec);
+        samples = mp3dec_decode_frame(&dec, file_buffer + frame_offsets[0],
+                                      static_cast<int>(file_size - frame_offsets[0]), pcm.data(), &info);
+    }
+    peak_rss = peakRssBytes();
+    al_free(frame_offsets);
+    al_free(file_buffer);
+    return samples;
+}
+
+// Time to first sample and the memory held at that point, for the current
+// streaming MP3 loader (cold index cache, so the seek index is still being
+// built in the background) against the legacy one.
+std::string benchmarkMp3Loader(const std::string& path, const Options& options,
+                               const std::filesystem::path& cache_dir) {
+    double legacy_seconds = 0.0;
+    double streaming_seconds = 0.0;
+    size_t legacy_rss = 0;
+    size_t streaming_rss = 0;
+    std::vector<unsigned char> buffer;
+    for (int run = 0; run < options.runs; ++run) {
+        size_t rss = 0;
+        resetPeakRss();
+        auto start = std::chrono::steady_clock::now();
+        if (legacyMp3FirstFrame(path, rss) == 0) {
+            return "{\"skipped\": \"the legacy loader found no frames\"}";
+        }
+        const double legacy = secondsSince(start);
+        if (run == 0 || legacy < legacy_seconds) {
+            legacy_seconds = legacy;
+        }
+        legacy_rss = std::max(legacy_rss, rss);
+
+        std::error_code ec;
+        std::filesystem::remove_all(cache_dir, ec);
+        resetPeakRss();
+        start = std::chrono::steady_clock::now();
+        std::unique_ptr<core::Decoder> decoder = core::openDecoder(path);
+        if (!decoder) {
+            return "{\"skipped\": \"no decoder accepted the file\"}";
+        }
+        buffer.resize(kSeekReadFrames * decoder->getFormat().frameSize());
+        if (decoder->read(buffer.data(), kSeekReadFrames) == 0) {
+            return "{\"skipped\": \"the streaming loader decoded nothing\"}";
+        }
+        const double streaming = secondsSince(start);
+        if (run == 0 || streaming < streaming_seconds) {
+            streaming_seconds = streaming;
+        }
+        streaming_rss = std::max(streaming_rss, peakRssBytes());
+    }
+
+    std::error_code ec;
+    const auto file_bytes = std::filesystem::file_size(path, ec);
+    std::ostringstream out;
+    out << "{\"file_bytes\": " << (ec ? 0 : file_bytes)
+        << ", \"legacy\": {\"first_sample_ms\": " << fixed(legacy_seconds * 1000.0, 3)
+        << ", \"peak_rss_bytes\": " << legacy_rss << "}"
+        << ", \"streaming\": {\"first_sample_ms\": " << fixed(streaming_seconds * 1000.0, 3)
+        << ", \"peak_rss_bytes\": " << streaming_rss << "}}";
+    return out.str();
+}
+
+// Opens `path`, seeks to `position` of its length and decodes one block, as
+// resuming a long file does. Returns the seconds taken, or a negative value
+// on failure; `decoder` is left open.
+double timeResume(const std::string& path, double position, std::unique_ptr<core::Decoder>& decoder,
+                  std::vector<unsigned char>& buffer) {
+    const auto start = std::chrono::steady_clock::now();
+    decoder = core::openDecoder(path);
+    if (!decoder) {
+        return -1.0;
+    }
+    buffer.resize(kSeekReadFrames * decoder->getFormat().frameSize());
+    if (!decoder->seek(decoder->getLength() * position) || decoder->read(buffer.data(), kSeekReadFrames) == 0) {
+        return -1.0;
+    }
+    return secondsSince(start);
+}
+
+// Size of the first entry in the MP3 index cache directory, or 0 if empty.
+uintmax_t indexCacheEntryBytes(const std::filesystem::path& directory) {
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        if (entry.is_regular_file(ec)) {
+            return entry.file_size(ec);
+        }
+    }
+    return 0;
+}
+
+std::filesystem::path indexCacheDirectory() {
+    return std::filesystem::path(util::Config::getCacheDir()) / "mp3index";
+}
+
+// The MP3 loader stores a file's index once its background scan finishes.
+// Waits for that from `start`, the open, and returns the seconds it took, or
+// a negative value if nothing was stored in time.
+double waitForCachedIndex(std::chrono::steady_clock::time_point start) {
+    constexpr double kScanTimeoutSeconds = 300.0;
+    const std::filesystem::path index_dir = indexCacheDirectory();
+    while (indexCacheEntryBytes(index_dir) == 0) {
+        if (secondsSince(start) > kScanTimeoutSeconds) {
+            return -1.0;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return secondsSince(start);
+}
+
+// Reopening a long MP3 at 90% of its length, with the seek index cache
+// cleared (the seek is estimated while the background scan runs) and with the
+// index the first open stored.
+std::string benchmarkMp3Reopen(const std::string& path, const Options& options,
+                               const std::filesystem::path& cache_dir) {
+    constexpr double kResumePosition = 0.9;
+    std::unique_ptr<core::Decoder> decoder;
+    std::vector<unsigned char> buffer;
+    double cold_seconds = 0.0;
+    double scan_seconds = 0.0;
+    for (int run = 0; run < options.runs; ++run) {
+        std::error_code ec;
+        std::filesystem::remove_all(cache_dir, ec);
+        const auto start = std::chrono::steady_clock::now();
+        const double seconds = timeResume(path, kResumePosition, decoder, buffer);
+        if (seconds < 0.0) {
+            return "{\"skipped\": \"the file could not be opened and sought\"}";
+        }
+        if (run == 0 || seconds < cold_seconds) {
+            cold_seconds = seconds;
+        }
+        const double scan = waitForCachedIndex(start);
+        decoder.reset();
+        if (scan < 0.0) {
+            return "{\"skipped\": \"no index was cached\"}";
+        }
+        if (run == 0 || scan < scan_seconds) {
+            scan_seconds = scan;
+        }
+    }
+    const uintmax_t entry_bytes = indexCacheEntryBytes(indexCacheDirectory());
+
+    double cached_seconds = 0.0;
+    for (int run = 0; run < options.runs; ++run) {
+        const double seconds = timeResume(path, kResumePosition, decoder, buffer);
+        decoder.reset();
+        if (seconds < 0.0) {
+            return "{\"skipped\": \"the file could not be reopened\"}";
+        }
+        if (run == 0 || seconds < cached_seconds) {
+            cached_seconds = seconds;
+        }
+    }
+
+    std::ostringstream out;
+    out << "{\"resume_position\": " << fixed(kResumePosition, 2)
+        << ", \"cold_resume_ms\": " << fixed(cold_seconds * 1000.0, 3)
+        << ", \"cached_resume_ms\": " << fixed(cached_seconds * 1000.0, 3)
+        << ", \"index_scan_ms\": " << fixed(scan_seconds * 1000.0, 1)
+        << ", \"index_entry_bytes\": " << entry_bytes << "}";
+    return out.str();
+}
+
+// A drag along the progress bar: one seek request per millisecond (a 1 kHz
+// mouse) for a quarter of a second.
+constexpr int kScrubRequests = 250;
+constexpr auto kScrubInterval = std::chrono::milliseconds(1);
+
+// Feeds a scrub burst to a thread that seeks `decoder` and decodes a block
+// per request, the way MusicEngine's feed thread serves requestSeek().
+// Coalesced, a request still waiting is replaced by a newer one, as in the
+// engine's pending_seek slot; otherwise every request runs in order.
+// MusicEngine itself needs an audio device, so its slot is reproduced here.
+std::string scrubJson(core::Decoder& decoder, bool coalesce) {
+    using Clock = std::chrono::steady_clock;
+    struct Request {
+        double position;
+        Clock::time_point posted;
+        bool last;
+    };
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Request> requests;
+    bool posting = true;
+    std::vector<double> latency_us;
+    double settle_us = 0.0;
+
+    std::thread feeder([&]() {
+        std::vector<unsigned char> buffer(kSeekReadFrames * decoder.getFormat().frameSize());
+        for (;;) {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return !requests.empty() || !posting; });
+                if (requests.empty()) {
+                    return;
+                }
+                request = coalesce ? requests.back() : requests.front();
+                if (coalesce) {
+                    requests.clear();
+                } else {
+                    requests.pop_front();
+                }
+            }
+            if (decoder.seek(request.position)) {
+                decoder.read(buffer.data(), kSeekReadFrames);
+            }
+            const double us = std::chrono::duration<double, std::micro>(Clock::now() - request.posted).count();
+            latency_us.push_back(us);
+            if (request.last) {
+                settle_us = us;
+            }
+        }
+    });
+
+    const double length = decoder.getLength();
+    auto next = Clock::now();
+    for (int i = 0; i < kScrubRequests; ++i) {
+        std::this_thread::sleep_until(next);
+        next += kScrubInterval;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back({length * (0.1 + 0.8 * i / kScrubRequests), Clock::now(), i == kScrubRequests - 1});
+        }
+        cv.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        posting = false;
+    }
+    cv.notify_one();
+    feeder.join();
+
+    std::ostringstream out;
+    out << "{\"requests\": " << kScrubRequests << ", \"seeks\": " << latency_us.size()
+        << ", \"latency_us\": " << distributionJson(latency_us)
+        << ", \"settle_us\": " << fixed(settle_us, 1) << "}";
+    return out.str();
+}
+
+// `seeks` random seeks in `decoder`, each checked bit for bit against
+// `reference` decoding into the same position from a second earlier, as
+// JSON members: "seeks", "bit_exact" and "seek_us".
+std::string randomSeeksJson(core::Decoder& decoder, core::Decoder& reference, int seeks) {
+    const core::DecoderFormat& format = decoder.getFormat();
+    const size_t frame_size = format.frameSize();
+    std::vector<unsigned char> block(kSeekReadFrames * frame_size);
+    std::vector<unsigned char> expected(format.frequency * frame_size);
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> position(1.0, std::max(1.0, decoder.getLength() - 1.0));
+    std::vector<double> seek_us;
+    int exact = 0;
+    for (int i = 0; i < seeks; ++i) {
+        // Whole frames, so the target is a sample position in both decoders.
+        const double target = std::floor(position(rng) * format.frequency) / format.frequency;
+        const auto start = std::chrono::steady_clock::now();
+        if (!decoder.seek(target) || decoder.read(block.data(), kSeekReadFrames) != kSeekReadFrames) {
+            continue;
+        }
+        seek_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+
+        if (reference.seek(target - 1.0) && reference.read(expected.data(), format.frequency) == format.frequency &&
+            reference.read(expected.data(), kSeekReadFrames) == kSeekReadFrames &&
+            std::memcmp(expected.data(), block.data(), block.size()) == 0) {
+            ++exact;
+        }
+    }
+
+    std::ostringstream out;
+    out << "\"seeks\": " << seek_us.size() << ", \"bit_exact\": " << exact
+        << ", \"seek_us\": " << distributionJson(seek_us);
+    return out.str();
+}
+
+// Seeks in the long MP3 with its full index (cached by the reopen pass),
+// then a scrub burst with and without coalescing.
+std::string benchmarkMp3Seek(const std::string& path, const Options& options) {
+    std::unique_ptr<core::Decoder> decoder = core::openDecoder(path);
+    std::unique_ptr<core::Decoder> reference = core::openDecoder(path);
+    if (!decoder || !reference || decoder->getLength() < 2.0) {
+        return "{\"skipped\": \"the file could not be opened\"}";
+    }
+    std::ostringstream out;
+    out << "{" << randomSeeksJson(*decoder, *reference, options.seeks)
+        << ", \"scrub_coalesced\": " << scrubJson(*decoder, true)
+        << ", \"scrub_every_request\": " << scrubJson(*decoder, false) << "}";
+    return out.str();
+}
+
+// The long MP3 under shrinking memory budgets ([audio] stream_memory_kb),
+// which thin its seek index: peak RSS while the index is built, the size of
+// the cached index, reopening at 90% from it, and random seeks from it
+// checked against a decoder with the default budget.
+std::string benchmarkMp3Budget(const std::string& path, const Options& options,
+                               const std::filesystem::path& cache_dir) {
+    constexpr double kResumePosition = 0.9;
+    const size_t budgets_kb[] = {kDefaultMemoryBudget / 1024, 200, 80};
+    std::ostringstream out;
+    out << "[";
+    for (const size_t budget_kb : budgets_kb) {
+        std::error_code ec;
+        std::filesystem::remove_all(cache_dir, ec);
+        mp3streaming::setMemoryBudget(budget_kb * 1024);
+
+        resetPeakRss();
+        const auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<core::Decoder> decoder = core::openDecoder(path);
+        const double scan_seconds = decoder ? waitForCachedIndex(start) : -1.0;
+        const size_t scan_rss = peakRssBytes();
+        decoder.reset();
+        if (scan_seconds < 0.0) {
+            out << (budget_kb == budgets_kb[0] ? "" : ",") << "\n    {\"budget_kb\": " << budget_kb
+                << ", \"skipped\": \"no index was cached\"}";
+            continue;
+        }
+
+        std::vector<unsigned char> buffer;
+        double resume_seconds = 0.0;
+        for (int run = 0; run < options.runs; ++run) {
+            const double seconds = timeResume(path, kResumePosition, decoder, buffer);
+            decoder.reset();
+            if (run == 0 || seconds < resume_seconds) {
+                resume_seconds = seconds;
+            }
+        }
+
+        decoder = core::openDecoder(path);
+        mp3streaming::setMemoryBudget(kDefaultMemoryBudget);
+        std::unique_ptr<core::Decoder> reference = core::openDecoder(path);
+        out << (budget_kb == budgets_kb[0] ? "" : ",") << "\n    {\"budget_kb\": " << budget_kb
+            << ", \"index_scan_ms\": " << fixed(scan_seconds * 1000.0, 1)
+            << ", \"scan_peak_rss_bytes\": " << scan_rss
+            << ", \"index_entry_bytes\": " << indexCacheEntryBytes(indexCacheDirectory())
+            << ", \"cached_resume_ms\": " << fixed(resume_seconds * 1000.0, 3);
+        if (decoder && reference) {
+            out << ", " << randomSeeksJson(*decoder, *reference, options.seeks);
+        }
+        out << "}";
+    }
+    mp3streaming::setMemoryBudget(kDefaultMemoryBudget);
+    out << "\n  ]";
+    return out.str();
+}
+
+// How the decode-ahead section reads: the engine's initial fragment size, at
+// ten times real time. A burst reads kAheadBurstReads fragments back to back
+// every kAheadBurstEvery reads, the way the feed thread catches up after it
+// was descheduled or an output stream was rebuilt larger.
+constexpr size_t kAheadReadFrames = 1024;
+constexpr double kAheadSpeed = 10.0;
+constexpr double kAheadSeconds = 60.0;
+constexpr int kAheadBurstEvery = 200;
+constexpr int kAheadBurstReads = 96;
+
+// Reads the first kAheadSeconds of `path` through a StreamSource, decoding
+// inline without a scheduler, or attached to a fresh one.
+std::string aheadJson(const std::string& path, bool scheduled, bool bursts, uint64_t& checksum) {
+    using Clock = std::chrono::steady_clock;
+    core::DecodeScheduler scheduler;
+    if (scheduled) {
+        scheduler.start();
+    }
+    std::unique_ptr<core::StreamSource> source = core::StreamSource::open(path, scheduled ? &scheduler : nullptr);
+    if (!source) {
+        return "{\"skipped\": \"the file could not be opened\"}";
+    }
+    const size_t initial_ahead = scheduler.getAheadFrames();
+    const auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(kAheadReadFrames / (source->getFrequency() * kAheadSpeed)));
+    const int reads = static_cast<int>(kAheadSeconds * source->getFrequency() / kAheadReadFrames);
+    std::vector<unsigned char> buffer(kAheadReadFrames * source->getFrameSize());
+    std::vector<double> read_us;
+    checksum = 0xcbf29ce484222325ull;
+    auto next = Clock::now();
+    for (int i = 0; i < reads; ++i) {
+        const bool in_burst = bursts && i % kAheadBurstEvery < kAheadBurstReads && i >= kAheadBurstEvery;
+        if (!in_burst) {
+            std::this_thread::sleep_until(next);
+        }
+        next = std::max(next + interval, in_burst ? Clock::now() : next);
+        const auto start = Clock::now();
+        const size_t frames = source->read(buffer.data(), kAheadReadFrames);
+        read_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        if (frames == 0) {
+            break;
+        }
+        checksum = fnv1a(checksum, buffer.data(), frames * source->getFrameSize());
+    }
+    source.reset();
+    scheduler.stop();
+
+    std::ostringstream out;
+    out << "{\"reads\": " << read_us.size() << ", \"read_us\": " << distributionJson(read_us);
+    if (scheduled) {
+        out << ", \"stalls\": " << scheduler.getStallCount() << ", \"ahead_frames_start\": " << initial_ahead
+            << ", \"ahead_frames_end\": " << scheduler.getAheadFrames();
+    }
+    out << "}";
+    return out.str();
+}
+
+// StreamSource reads of the long MP3 the way the feed thread does them:
+// decoded inline, from a DecodeScheduler's ahead buffer at a steady pace, and
+// from it with read bursts that catch up with the workers and grow the
+// buffer. The PCM must be identical in all three.
+std::string benchmarkDecodeAhead(const std::string& path) {
+    uint64_t inline_checksum = 0;
+    uint64_t steady_checksum = 0;
+    uint64_t burst_checksum = 0;
+    const std::string inline_json = aheadJson(path, false, false, inline_checksum);
+    const std::string steady_json = aheadJson(path, true, false, steady_checksum);
+    const std::string burst_json = aheadJson(path, true, true, burst_checksum);
+    std::ostringstream out;
+    out << "{\"read_frames\": " << kAheadReadFrames << ", \"speed\": " << fixed(kAheadSpeed, 1)
+        << ", \"inline\": " << inline_json << ", \"scheduled\": " << steady_json
+        << ", \"scheduled_bursts\": " << burst_json << ", \"pcm_identical\": "
+        << (inline_checksum == steady_checksum && inline_checksum == burst_checksum ? "true" : "false") << "}";
+    return out.str();
+}
+
+// Asks the kernel to evict `path` from the page cache, so the next pass reads
+// it from disk. Only clean pages go, which is all a benchmark file has.
+bool dropPageCache(const std::string& path) {
+#if defined(_WIN32) || defined(WIN32) || defined(__APPLE__)
+    (void)path;
+    return false;
+#else
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool dropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return dropped;
+#endif
+}
+
+// Decodes the long MP3 start to end through the memory-mapped input the
+// loader uses for regular files, and through the buffered window it falls
+// back to for anything else. Page faults are counted for the whole process,
+// so they include the background index scan. Each pass starts with the file
+// evicted from the page cache where the platform allows it.
+std::string benchmarkMp3Input(const std::string& path, const std::filesystem::path& cache_dir) {
+    std::ostringstream out;
+    out << "{";
+    for (const bool mapped : {true, false}) {
+        std::error_code ec;
+        std::filesystem::remove_all(cache_dir, ec);
+        const bool cold = dropPageCache(path);
+        resetPeakRss();
+        const PageFaults before = pageFaults();
+        const auto start = std::chrono::steady_clock::now();
+
+        mp3streaming::MP3FILE* file = nullptr;
+        if (mapped) {
+            file = mp3streaming::mp3_open_file(path.c_str(), kDefaultMemoryBudget);
+        } else if (ALLEGRO_FILE* f = al_fopen(path.c_str(), "rb")) {
+            file = mp3streaming::mp3_open(f, nullptr, kDefaultMemoryBudget);
+            if (!file) {
+                al_fclose(f);
+            }
+        }
+        if (!file) {
+            return "{\"skipped\": \"the file could not be opened\"}";
+        }
+        const bool is_mapped = file->map != nullptr;
+        std::vector<unsigned char> buffer(kSeekReadFrames * sizeof(mp3d_sample_t) * file->channels);
+        uint64_t bytes = 0;
+        while (size_t n = mp3streaming::mp3_stream_read(file, buffer.data(), buffer.size())) {
+            bytes += n;
+        }
+        const double seconds = secondsSince(start);
+        const PageFaults after = pageFaults();
+        const size_t rss = peakRssBytes();
+        mp3streaming::mp3_free(file);
+
+        out << (mapped ? "" : ", ") << (mapped ? "\"mapped\": " : "\"buffered\": ")
+            << "{\"input\": " << jsonString(is_mapped ? "mmap" : "buffered")
+            << ", \"page_cache_dropped\": " << (cold ? "true" : "false")
+            << ", \"decode_seconds\": " << fixed(seconds, 3)
+            << ", \"pcm_bytes\": " << bytes
+            << ", \"minor_faults\": " << (after.minor - before.minor)
+            << ", \"major_faults\": " << (after.major - before.major)
+            << ", \"peak_rss_bytes\": " << rss << "}";
+    }
+    out << "}";
+    return out.str();
+}
+
+void writeJson(std::ostream& out, const Options& options, const std::vector<CorpusFile>& corpus,
+               const std::vector<Result>& results, const std::vector<std::pair<std::string, std::string>>& sections) {
+    out << "{\n";
+    out << "  \"benchmark\": \"decode\",\n";
+    out << "  \"schema\": 1,\n";
+    out << "  \"runs\": " << options.runs << ",\n";
+    out << "  \"generated_seconds\": " << fixed(options.seconds, 1) << ",\n";
+    out << "  \"peak_rss_scope\": " << jsonString(peakRssResettable() ? "file" : "process") << ",\n";
+    out << "  \"files\": [";
+    for (size_t i = 0; i < corpus.size(); ++i) {
+        const CorpusFile& file = corpus[i];
+        const Result& result = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"format\": " << jsonString(file.format)
+            << ", \"source\": " << jsonString(file.generated ? "generated" : "corpus")
+            << ", \"path\": " << jsonString(file.path);
+        if (!file.skipped.empty() || !result.error.empty()) {
+            out << ", \"skipped\": " << jsonString(file.skipped.empty() ? result.error : file.skipped) << "}";
+            continue;
+        }
+
+        std::error_code ec;
+        const auto file_bytes = std::filesystem::file_size(file.path, ec);
+        char checksum[24];
+        std::snprintf(checksum, sizeof(checksum), "%016llx", static_cast<unsigned long long>(result.checksum));
+        out << ",\n     \"sample_rate\": " << result.format.frequency
+            << ", \"channels\": " << al_get_channel_count(result.format.channels)
+            << ", \"depth\": " << jsonString(result.format.depth == ALLEGRO_AUDIO_DEPTH_FLOAT32 ? "float32" : "int16")
+            << ", \"audio_seconds\": " << fixed(result.audio_seconds, 3)
+            << ", \"file_bytes\": " << (ec ? 0 : file_bytes)
+            << ",\n     \"decode_seconds\": " << fixed(result.best_seconds, 6)
+            << ", \"realtime_factor\": " << fixed(result.audio_seconds / result.best_seconds, 1)
+            << ", \"input_bytes_per_second\": " << fixed((ec ? 0 : file_bytes) / result.best_seconds, 0)
+            << ", \"pcm_bytes_per_second\": " << fixed(result.pcm_bytes / result.best_seconds, 0)
+            << ", \"pcm_frames_per_second\": " << fixed(result.pcm_frames / result.best_seconds, 0);
+        if (file.format == "mp3") {
+            // Layer III frames hold 1152 samples at MPEG-1 rates and 576 below.
+            const double samples_per_frame = result.format.frequency >= 32000 ? 1152.0 : 576.0;
+            out << ", \"mp3_frames_per_second\": "
+                << fixed(result.pcm_frames / samples_per_frame / result.best_seconds, 0);
+        }
+        out << ",\n     \"allocations_per_run\": " << result.allocations / options.runs
+            << ", \"allocations_per_second\": " << fixed(result.allocations / result.total_seconds, 0)
+            << ", \"peak_rss_bytes\": " << result.peak_rss
+            << ",\n     \"seeks\": " << result.seek_us.size()
+            << ", \"seek_us\": {\"p50\": " << fixed(percentile(result.seek_us, 0.50), 1)
+            << ", \"p95\": " << fixed(percentile(result.seek_us, 0.95), 1)
+            << ", \"p99\": " << fixed(percentile(result.seek_us, 0.99), 1)
+            << ", \"max\": " << fixed(result.seek_us.empty() ? 0.0 : result.seek_us.back(), 1) << "}"
+            << ",\n     \"analysis_seconds\": " << fixed(result.analysis_seconds, 6)
+            << ", \"analysis_mb_per_second\": "
+            << fixed(result.analysis_seconds > 0.0 ? (ec ? 0 : file_bytes) / (1024.0 * 1024.0) / result.analysis_seconds : 0.0, 2)
+            << ",\n     \"checksum\": " << jsonString(checksum)
+            << ", \"checksum_stable\": " << (result.checksum_stable ? "true" : "false") << "}";
+    }
+    out << "\n  ]";
+    for (const auto& [name, json] : sections) {
+        out << ",\n  " << jsonString(name) << ": " << json;
+    }
+    out << "\n}\n";
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "usage: audiovis_bench_decode [--seconds N] [--runs N] [--seeks N] [--corpus DIR] "
+                         "[--long-seconds N]\n";
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--seconds") {
+            options.seconds = std::max(1.0, std::atof(value));
+        } else if (arg == "--runs") {
+            options.runs = std::max(1, std::atoi(value));
+        } else if (arg == "--seeks") {
+            options.seeks = std::max(0, std::atoi(value));
+        } else if (arg == "--corpus") {
+            options.corpus = value;
+        } else if (arg == "--long-seconds") {
+            options.long_seconds = std::max(0.0, std::atof(value));
+        } else {
+            std::cerr << "decode bench: unknown option " << arg << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    al_set_memory_interface(&counted_memory);
+    if (!al_install_system(ALLEGRO_VERSION_INT, nullptr)) {
+        std::cerr << "decode bench: failed to initialize Allegro\n";
+        return 1;
+    }
+    // Fails on machines without a sound device; decoding does not need one.
+    al_install_audio();
+    if (!al_init_acodec_addon()) {
+        std::cerr << "decode bench: failed to initialize audio codec addon\n";
+        return 1;
+    }
+    mp3streaming::addMP3Support();
+
+    std::error_code ec;
+    const std::filesystem::path work_dir =
+        std::filesystem::temp_directory_path(ec) / ("audiovis-bench-" + std::to_string(
+#if defined(_WIN32) || defined(WIN32)
+            GetCurrentProcessId()
+#else
+            getpid()
+#endif
+        ));
+    std::filesystem::create_directories(work_dir, ec);
+    if (ec) {
+        std::cerr << "decode bench: cannot create " << work_dir << ": " << ec.message() << "\n";
+        return 1;
+    }
+#if !defined(_WIN32) && !defined(WIN32)
+    // Keep the MP3 frame index cache out of the user's cache: the first run
+    // of each file scans it, later runs hit the fresh cache.
+    setenv("XDG_CACHE_HOME", (work_dir / "cache").string().c_str(), 1);
+#endif
+
+    const std::vector<CorpusFile> corpus = buildCorpus(options, work_dir);
+    std::vector<Result> results(corpus.size());
+    for (size_t i = 0; i < corpus.size(); ++i) {
+        if (!corpus[i].skipped.empty()) {
+            std::cerr << corpus[i].format << ": skipped, " << corpus[i].skipped << "\n";
+            continue;
+        }
+        results[i] = benchmarkFile(corpus[i], options);
+        if (!results[i].error.empty()) {
+            std::cerr << corpus[i].path << ": " << results[i].error << "\n";
+        } else {
+            std::cerr << corpus[i].format << ": " << results[i].audio_seconds / results[i].best_seconds
+                      << "x realtime\n";
+        }
+    }
+
+    // Sections measured on the long MP3, as {"name", json}.
+    std::vector<std::pair<std::string, std::string>> sections;
+    const std::string long_mp3 = (work_dir / "long.mp3").string();
+    if (options.long_seconds > 0.0 && writeSyntheticMp3(long_mp3, options.long_seconds)) {
+        std::cerr << "mp3 loader...\n";
+        sections.emplace_back("mp3_loader", benchmarkMp3Loader(long_mp3, options, work_dir / "cache"));
+        std::cerr << "mp3 reopen...\n";
+        sections.emplace_back("mp3_reopen", benchmarkMp3Reopen(long_mp3, options, work_dir / "cache"));
+        std::cerr << "mp3 seek...\n";
+        sections.emplace_back("mp3_seek", benchmarkMp3Seek(long_mp3, options));
+        std::cerr << "mp3 memory budgets...\n";
+        sections.emplace_back("mp3_budget", benchmarkMp3Budget(long_mp3, options, work_dir / "cache"));
+        std::cerr << "decode ahead...\n";
+        sections.emplace_back("decode_ahead", benchmarkDecodeAhead(long_mp3));
+        std::cerr << "mp3 input...\n";
+        sections.emplace_back("mp3_input", benchmarkMp3Input(long_mp3, work_dir / "cache"));
+    }
+
+    writeJson(std::cout, options, corpus, results, sections);
+
+    std::filesystem::remove_all(work_dir, ec);
+    al_uninstall_system();
+    return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "core/decoder.hpp"
+
+namespace core {
+
+// Decodes any format Allegro's acodec addon can stream (FLAC, Ogg, WAV,
+// Opus, ...). Allegro has no public API for pulling PCM out of a stream, so
+// this drives the stream's feeder through the mirror of its private layout
+// in mp3/audio_stream_internals.hpp; it is the only code that still does.
+// Depths other than INT16 and FLOAT32 are converted to FLOAT32.
+std::unique_ptr<Decoder> openAllegroDecoder(const std::string& path);
+
+} // namespace core
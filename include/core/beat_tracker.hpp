@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "core/real_fft.hpp"
+
+namespace core {
+
+// Tempo and beat grid published by BeatTracker. Frames count mixer output
+// frames, the same timeline as PlaybackClock::getMixerFrames().
+struct BeatSnapshot {
+    uint64_t sequence = 0;       // 0 until the first hop has been analyzed
+    float bpm = 0.0f;            // 0 until a tempo has been found
+    float confidence = 0.0f;     // 0 to 1: strength of the tempo's periodicity
+    double beat_frame = 0.0;     // a beat on the current grid
+    double beat_period = 0.0;    // frames between beats; 0 without a tempo
+    uint64_t onset_frame = 0;    // latest detected onset
+    float onset_strength = 0.0f; // its spectral flux over the threshold (> 1)
+};
+
+// Onset detection and tempo tracking on the mixer output.
+//
+// Every hop of kHopFrames, the newest kFftSize mono samples are
+// transformed and their spectral flux (summed rise in log magnitude) is
+// compared against an adaptive threshold, the mean flux of the last half
+// second scaled by Settings::threshold_ratio; local maxima above it are
+// onsets. The flux above that mean forms the onset envelope. Twice a second
+// its autocorrelation over the last Settings::history_seconds, weighted
+// towards 120 BPM to settle octave ambiguity, gives the tempo, and a comb
+// over the envelope places the beat grid. Onsets close to a predicted beat
+// pull the grid towards them in between.
+//
+// push() runs on the audio thread and never allocates; readSnapshot() runs
+// on any other thread and publishes through two alternating slots guarded
+// by a sequence counter, like SpectrumAnalyzer. configure() allocates and
+// must not race with push().
+class BeatTracker {
+public:
+    static constexpr size_t kFftSize = 1024;
+    static constexpr size_t kHopFrames = 512;
+
+    struct Settings {
+        float min_bpm = 60.0f;
+        float max_bpm = 200.0f;
+        float history_seconds = 8.0f;
+        float threshold_ratio = 1.5f;
+        float min_onset_gap_seconds = 0.1f;
+    };
+
+    BeatTracker();
+
+    void configure(float sample_rate, const Settings& settings);
+
+    // Appends interleaved frames (downmixed to mono); `first_frame` is the
+    // timeline frame of the first of them.
+    void push(const float* interleaved, size_t frames, size_t channels, uint64_t first_frame);
+
+    // Copies the latest published state. Returns false if nothing has been
+    // published yet or a consistent copy could not be taken.
+    bool readSnapshot(BeatSnapshot& out) const;
+
+    // Tempo of everything pushed since configure(), from the autocorrelation
+    // summed over all of it; 0 if none was found. For offline analysis of a
+    // whole song; not for the audio thread.
+    float getOverallBpm() const;
+
+private:
+    static constexpr int kMaxReadAttempts = 4;
+    static constexpr size_t kPushChunkFrames = 512;
+    static constexpr float kPreferredBpm = 120.0f;
+    static constexpr size_t kRefineMultiples = 4;
+
+    void analyzeHop(uint64_t end_frame);
+    void detectOnset(float flux, float mean, uint64_t hop_frame);
+    void estimateTempo(uint64_t hop_frame);
+    float envelopeAt(size_t hops_ago) const;
+    float tempoWeight(float lag) const;
+    float pickLag(const std::vector<double>& correlation) const;
+    static double peakOffset(const std::vector<double>& values, size_t index);
+    void publish();
+
+    Settings settings;
+    float sample_rate = 44100.0f;
+    float hop_rate = 0.0f;       // envelope values per second
+    size_t min_lag = 0;          // in hops, for max_bpm
+    size_t max_lag = 0;          // in hops, for min_bpm
+    size_t history_hops = 0;     // envelope values correlated per estimate
+    size_t tempo_interval_hops = 0;
+    size_t threshold_hops = 0;
+    size_t min_onset_gap_hops = 0;
+
+    RealFft fft;
+    std::vector<float> window;
+    float magnitude_scale = 0.0f;    // full-scale sine to 1
+    std::vector<float> samples;      // circular mono history of kFftSize samples
+    size_t sample_pos = 0;
+    size_t pending_frames = 0;       // frames since the last hop
+    std::vector<float> mono_scratch;
+    std::vector<float> bin_power;
+    std::vector<float> log_magnitude;
+    std::vector<float> previous_log_magnitude;
+
+    std::vector<float> flux_history;     // circular, threshold_hops values
+    size_t flux_pos = 0;
+    double flux_sum = 0.0;
+    std::vector<float> envelope;         // circular, power-of-two length
+    std::vector<float> envelope_scratch; // history_hops values, for estimates
+    size_t envelope_pos = 0;
+    uint64_t hops = 0;
+
+    // The previous hop's flux is a peak candidate until this hop's is known.
+    float candidate_flux = 0.0f;
+    float candidate_threshold = 0.0f;
+    float before_candidate_flux = 0.0f;
+    uint64_t candidate_frame = 0;
+    uint64_t last_onset_hop = 0;
+    bool have_onset = false;
+
+    std::vector<double> correlation;       // per lag up to kRefineMultiples periods, this estimate
+    std::vector<double> total_correlation; // per lag, summed since configure()
+    double pending_period = 0.0;           // a new tempo waiting for confirmation, frames
+
+    BeatSnapshot state;
+    BeatSnapshot slots[2];
+    std::atomic<uint64_t> published{0};
+};
+
+} // namespace core
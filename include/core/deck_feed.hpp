@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <allegro5/allegro_audio.h>
+
+#include "core/gain_automation.hpp"
+#include "core/polyphase_resampler.hpp"
+#include "core/stream_source.hpp"
+
+namespace core {
+
+// What was written into one output fragment; used to tell which song and
+// position is audible once that fragment reaches the mixer.
+struct FragmentMark {
+    uint64_t source_serial = 0;
+    double position = 0.0;  // seconds into the source at the start of the fragment
+    bool has_audio = false; // false for lead-in or trailing silence
+};
+
+// The feeding side of one output stream: the source, its gain envelope and
+// the format fragments are written in. Holds no Allegro stream, so fragments
+// can be filled (and crossfades scheduled) without an audio device;
+// MusicEngine's decks hand the filled fragments to their streams.
+struct DeckFeed {
+    std::unique_ptr<StreamSource> source;
+    uint64_t serial = 0;          // bumped whenever source changes
+    double position = 0.0;        // decode position in source, seconds
+    bool ended = false;           // source ran out with nothing to splice
+    bool fading_out = false;      // crossfading out; don't splice at the end
+    uint64_t lead_in_frames = 0;  // silence written ahead of the source
+    uint64_t frames_written = 0;  // stream frame clock for `gain`
+    unsigned int fragment_frames = 0;
+    GainAutomation gain;
+
+    // Format of the output stream, which differs from the source's when
+    // the deck resamples.
+    ALLEGRO_AUDIO_DEPTH stream_depth = ALLEGRO_AUDIO_DEPTH_INT16;
+    ALLEGRO_CHANNEL_CONF stream_channels = ALLEGRO_CHANNEL_CONF_2;
+    unsigned int stream_frequency = 0;
+
+    // Set when this deck resamples to the mixer rate itself (polyphase
+    // mode); the stream is then float32 at the mixer rate.
+    std::unique_ptr<PolyphaseResampler> resampler;
+    bool resampler_flushed = false;
+    std::vector<unsigned char> decode_buffer;
+    std::vector<float> resample_input;
+};
+
+using RetiredSources = std::vector<std::unique_ptr<StreamSource>>;
+
+// Fills one fragment of `deck.fragment_frames` frames: lead-in silence, the
+// source, a splice to `next` (which takes serial ++`next_serial`) where the
+// source runs out in the same format, trailing silence once it has ended,
+// then the gain envelope. Sources replaced by a splice go to `retired`.
+void fillFragment(DeckFeed& deck, void* fragment, FragmentMark& mark, std::unique_ptr<StreamSource>& next,
+                  uint64_t& next_serial, RetiredSources& retired);
+
+// Seconds left of `outgoing` if a crossfade of `crossfade_seconds` should
+// start before its next fragment; nullopt while it is too early, or too late
+// to ramp (the end-of-song splice covers that).
+std::optional<double> crossfadeRemaining(const DeckFeed& outgoing, double crossfade_seconds);
+
+// Ramps `incoming` in over `remaining` seconds, held back by `queued_seconds`
+// of audio already queued on the outgoing stream so both ramps reach the
+// mixer together. Call before its first fragment is filled.
+void scheduleCrossfadeIn(DeckFeed& incoming, double remaining, double queued_seconds);
+
+// Ramps `outgoing` out over `remaining` seconds from its next fragment on
+// and stops it from splicing at the end.
+void scheduleCrossfadeOut(DeckFeed& outgoing, double remaining);
+
+} // namespace core
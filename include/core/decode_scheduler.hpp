@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace core {
+
+class StreamSource;
+
+// Keeps every attached StreamSource decoded ahead of its reader on one small
+// pool of worker threads, so the engine's feed thread mostly copies PCM and
+// opening a preload or crossfade source starts no thread of its own.
+//
+// Workers always serve the attached source with the least audio buffered.
+// A source whose reader catches up with the workers decodes the rest of that
+// read inline, so a slow pool costs latency on the feed thread, never audio.
+// Each such stall doubles how far ahead every source decodes, up to a few
+// seconds, so a disk busy with a library scan stops starving playback.
+class DecodeScheduler {
+public:
+    DecodeScheduler();
+    ~DecodeScheduler();
+
+    void start(size_t workers = defaultWorkerCount());
+    void stop();
+
+    void attach(StreamSource* source);
+    // Returns once no worker is decoding for `source`.
+    void detach(StreamSource* source);
+    // A source's buffer drained or was cleared.
+    void wake();
+
+    // A source's reader caught up with its buffer after it had filled.
+    void noteStall();
+    uint64_t getStallCount() const { return stalls; }
+    // Frames each source keeps decoded ahead of its reader.
+    size_t getAheadFrames() const { return ahead_frames; }
+
+    // One worker per deck that can be decoding at once (playing and
+    // crossfading in), fewer on small machines.
+    static size_t defaultWorkerCount();
+
+private:
+    void workerMain();
+    StreamSource* pickLocked() const;
+
+    std::mutex mutex;
+    std::condition_variable work_cv;
+    std::condition_variable idle_cv;
+    std::vector<StreamSource*> sources;
+    std::vector<StreamSource*> busy; // being decoded by a worker
+    std::vector<std::thread> workers;
+    bool quit = false;
+
+    std::atomic<uint64_t> stalls{0};
+    std::atomic<size_t> ahead_frames;
+};
+
+} // namespace core
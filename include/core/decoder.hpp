@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <allegro5/allegro_audio.h>
+
+namespace core {
+
+// PCM layout a decoder produces. `depth` is always INT16 or FLOAT32.
+struct DecoderFormat {
+    unsigned int frequency = 0;
+    ALLEGRO_AUDIO_DEPTH depth = ALLEGRO_AUDIO_DEPTH_INT16;
+    ALLEGRO_CHANNEL_CONF channels = ALLEGRO_CHANNEL_CONF_2;
+
+    size_t frameSize() const { return al_get_channel_count(channels) * al_get_audio_depth_size(depth); }
+};
+
+// One open audio file, decoded on demand. Closing is destruction. Not
+// thread-safe; StreamSource serializes access between the decode workers
+// and its reader.
+class Decoder {
+public:
+    virtual ~Decoder() = default;
+
+    // Decodes up to `frames` interleaved frames into dst. Returns the number
+    // of frames written; 0 means end of stream.
+    virtual size_t read(void* dst, size_t frames) = 0;
+    virtual bool seek(double seconds) = 0;
+    // In seconds; may be an estimate while the decoder is still scanning.
+    virtual double getLength() const = 0;
+
+    const DecoderFormat& getFormat() const { return format; }
+
+protected:
+    DecoderFormat format;
+};
+
+// Opens `path`, or returns nullptr if the file cannot be decoded.
+using DecoderFactory = std::unique_ptr<Decoder> (*)(const std::string& path);
+
+// Plugins are picked by file extension (".mp3", matched case-insensitively).
+// Files no plugin claims are decoded through Allegro's acodec loaders.
+void registerDecoder(const std::string& extension, DecoderFactory factory);
+std::unique_ptr<Decoder> openDecoder(const std::string& path);
+
+} // namespace core
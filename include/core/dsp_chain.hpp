@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace core {
+
+// One in-place processing stage run on the mixer output.
+//
+// process() runs on the audio thread and must not lock, allocate or free.
+// Parameters are changed from the UI thread through whatever lock-free
+// hand-off the node provides (see ParametricEq).
+class DspNode {
+public:
+    virtual ~DspNode() = default;
+
+    virtual const char* getName() const = 0;
+    // Called before the node is published to the audio thread.
+    virtual void prepare(double sample_rate, size_t channels) = 0;
+    virtual void process(float* interleaved, size_t frames) = 0;
+    // False when processing would leave the audio unchanged; the chain then
+    // skips the node (and int16 mixers skip the float round trip).
+    virtual bool isActive() const { return isEnabled(); }
+
+    void setEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<bool> enabled{true};
+};
+
+// Ordered list of DspNodes applied to interleaved float blocks.
+//
+// The node list is immutable once published: add/remove build a new list,
+// swap it in and wait for the audio thread to leave the old one before
+// freeing it, the same hand-off SampleRing uses for resizes. process()
+// therefore only ever loads a pointer.
+class DspChain {
+public:
+    DspChain() = default;
+    ~DspChain();
+
+    DspChain(const DspChain&) = delete;
+    DspChain& operator=(const DspChain&) = delete;
+
+    // Control side. configure() re-prepares every node for a new format.
+    void configure(double sample_rate, size_t channels);
+    void add(std::shared_ptr<DspNode> node);
+    void remove(const DspNode* node);
+    void clear();
+
+    // Audio thread. Returns false if no node touched the block.
+    bool process(float* interleaved, size_t frames);
+
+private:
+    using NodeList = std::vector<std::shared_ptr<DspNode>>;
+
+    void publish(NodeList* fresh);
+    void waitForProcessors() const;
+
+    double sample_rate = 44100.0;
+    size_t channels = 2;
+    std::atomic<NodeList*> nodes{nullptr};
+    std::atomic<int> active_processors{0};
+};
+
+} // namespace core
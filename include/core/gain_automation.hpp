@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <allegro5/allegro_audio.h>
+
+namespace core {
+
+// Gain envelope for one output stream, in that stream's frame clock.
+//
+// Holds a single scheduled ramp; before it starts the gain is the curve's
+// start value, after it ends the curve's end value. apply() evaluates the
+// curve once per block and interpolates linearly inside it, so gain moves
+// smoothly per sample while the curve itself is only computed per block.
+class GainAutomation {
+public:
+    enum class Curve {
+        EqualPowerIn,  // sin(t * pi/2): 0 -> 1
+        EqualPowerOut, // cos(t * pi/2): 1 -> 0
+    };
+
+    void clear();
+    void schedule(uint64_t start_frame, uint64_t length_frames, Curve curve);
+    bool isActive() const { return active; }
+
+    float gainAt(uint64_t frame) const;
+
+    // Scales `frames` interleaved frames of PCM in `depth` format, the first
+    // of which is stream frame `first_frame`.
+    void apply(void* pcm, size_t frames, size_t channels, ALLEGRO_AUDIO_DEPTH depth, uint64_t first_frame) const;
+
+private:
+    bool active = false;
+    Curve curve = Curve::EqualPowerIn;
+    uint64_t start_frame = 0;
+    uint64_t length_frames = 0;
+};
+
+} // namespace core
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include <allegro5/allegro_audio.h>
+
+namespace core {
+
+// Integrated loudness per ITU-R BS.1770-4 / EBU R128: K-weighting, 400 ms
+// gating blocks with 75% overlap, absolute gate at -70 LUFS and relative
+// gate 10 LU below the ungated level. Also tracks the linear sample peak.
+class LoudnessMeter {
+public:
+    // ReplayGain 2.0 reference level.
+    static constexpr double kReferenceLufs = -18.0;
+    static constexpr size_t kMaxChannels = 8;
+
+    LoudnessMeter(double sample_rate, size_t channels);
+
+    void addFrames(const float* interleaved, size_t frames);
+    // Converts PCM in any Allegro depth to float before metering.
+    void addPcm(const void* pcm, size_t frames, ALLEGRO_AUDIO_DEPTH depth);
+
+    // Empty when the input was shorter than one block or entirely below the
+    // absolute gate (silence).
+    std::optional<double> integratedLoudness() const;
+    double samplePeak() const { return peak; }
+
+    static double gainForLoudness(double loudness_lufs) { return kReferenceLufs - loudness_lufs; }
+
+private:
+    struct Biquad {
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+    };
+    struct FilterState {
+        double z1 = 0.0, z2 = 0.0;
+    };
+
+    static double run(const Biquad& f, FilterState& s, double x);
+    void finishSubBlock();
+
+    size_t channels;
+    size_t sub_block_frames;   // 100 ms
+    Biquad shelf;              // stage 1: high shelf (head effects)
+    Biquad highpass;           // stage 2: RLB high-pass
+    FilterState shelf_state[kMaxChannels];
+    FilterState highpass_state[kMaxChannels];
+    double channel_weight[kMaxChannels];
+
+    double sub_block_energy = 0.0;
+    size_t sub_block_fill = 0;
+    double recent_sub_blocks[4] = {}; // mean square of the last 100 ms steps
+    size_t sub_block_count = 0;
+    std::vector<double> block_energy; // 400 ms gating blocks
+    double peak = 0.0;
+    std::vector<float> scratch;
+};
+
+} // namespace core
@@ -1,18 +1,33 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
 #include <vector>
-#include <mutex>
 
+#include <allegro5/allegro.h>
+
+#include "core/decode_scheduler.hpp"
+#include "core/beat_tracker.hpp"
+#include "core/deck_feed.hpp"
+#include "core/dsp_chain.hpp"
+#include "core/parametric_eq.hpp"
+#include "core/playback_clock.hpp"
+#include "core/sample_ring.hpp"
+#include "core/spectrum_analyzer.hpp"
+#include "core/stream_source.hpp"
 #include "graphics/models/progress_bar.hpp"
 #include "music/play_queue.hpp"
 
-struct ALLEGRO_AUDIO_STREAM;
-struct ALLEGRO_MIXER;
-struct ALLEGRO_VOICE;
-struct ALLEGRO_EVENT_QUEUE;
+// Emitted by MusicEngine when playback ran gaplessly from one song into the
+// preloaded next one. The main loop treats it like ALLEGRO_EVENT_AUDIO_STREAM_FINISHED
+// (scrobble, then playNext()), and playNext() adopts the already-playing song.
+#define ALLEGRO_EVENT_MUSIC_TRACK_ADVANCED ALLEGRO_GET_EVENT_TYPE('M','U','S','A')
 
 // forward-declare Song
 namespace music { 
@@ -22,15 +37,36 @@ namespace music {
 }
 
 namespace core {
+// Which stored ReplayGain value playback uses.
+enum class ReplayGainMode {
+    Off,
+    Track,
+    Album, // falls back to the track gain for songs without an album value
+};
+
+// How streams whose rate differs from the mixer's are converted.
+enum class ResamplerQuality {
+    Linear,    // Allegro mixer, linear interpolation (Allegro's default)
+    Cubic,     // Allegro mixer, cubic interpolation
+    Polyphase, // windowed-sinc PolyphaseResampler on the feed thread
+};
+
 class MusicEngine {
 public:
     MusicEngine();
     ~MusicEngine();
 
+    // Output format for the voice and mixer; call before initialize().
+    // frequency 0 picks 48 kHz, falling back to 44.1 kHz if the device refuses.
+    // The voice falls back to int16 if it cannot take the mixer depth.
+    void configureOutput(unsigned int frequency, ALLEGRO_AUDIO_DEPTH depth, ResamplerQuality quality);
+    unsigned int getOutputFrequency() const { return mixer_frequency; }
+    ALLEGRO_AUDIO_DEPTH getOutputDepth() const { return mixer_depth; }
+
     bool initialize();
     void shutdown();
 
-    void playSound(const std::string& file_path);
+    void playSound(const music::SongView& song);
     void pauseSound();
     void resumeSound();
     void stopSound();
@@ -38,17 +74,47 @@ public:
     double getCurrentTime() const;
     double getDuration() const;
 
+    // Position in the current song that is audible at `wallTime` (an
+    // al_get_time() value), interpolated from the mixer's frame clock and
+    // corrected for output latency. Lets a renderer place the playhead at the
+    // time its frame will be shown rather than at the last 30 fps tick.
+    double getPlayheadAt(double wallTime) const;
+    // Seconds between the mixer rendering a block and it being heard.
+    double getOutputLatency() const;
+    // Device latency Allegro cannot see (Bluetooth sinks, external DACs).
+    void setOutputLatencyOffset(double seconds);
+
+    // Buffering counters since initialize(). Output streams start with small
+    // fragments for quick seeks and skips and get larger after an underrun;
+    // decode stalls grow the decode-ahead buffer (see DecodeScheduler).
+    struct BufferStats {
+        uint64_t underruns = 0;               // an output stream played out everything queued
+        uint64_t decode_stalls = 0;           // playback caught up with the decode workers
+        uint64_t fragments_played = 0;        // on the primary stream
+        double mean_fragment_interval = 0.0;  // seconds between fragments handed back
+        double max_fragment_interval = 0.0;
+        unsigned int fragment_frames = 0;     // shape of the next output stream
+        size_t fragment_count = 0;
+        size_t decode_ahead_frames = 0;
+    };
+    BufferStats getBufferStats() const;
+
     void setGain(float gain);
     float getGain() const;
     void setPan(float pan);
     void setSpeed(float speed);
     void setProgress(double position); // position in seconds
+    // Seeks on the feed thread instead of the caller's. Requests that arrive
+    // while one is running replace each other, so scrubbing only executes the
+    // latest; the progress bar shows the target meanwhile.
+    void requestSeek(double position);
     
     // Enable or disable audio sample capture from the active mixer output.
     void setSampleCaptureEnabled(bool enabled);
     bool isSampleCaptureEnabled() const;
 
-    // Capacity is expressed in individual PCM samples (interleaved channels).
+    // Capacity is expressed in individual PCM samples (interleaved channels)
+    // and rounded up to the next power of two.
     void setSampleBufferCapacity(size_t sample_count);
     size_t getSampleBufferCapacity() const;
     size_t getBufferedSampleCount() const;
@@ -62,6 +128,37 @@ public:
     // This is better for waveform visualization when the source is interleaved stereo.
     std::vector<float> copyRecentMonoSamples(size_t max_frames) const;
 
+    // Allocation-free variants of the above for per-frame readers: fill the
+    // caller's buffer (which must hold max_samples / max_frames floats) and
+    // return how many values were written.
+    size_t readRecentInto(float* dst, size_t max_samples) const;
+    size_t readRecentMonoInto(float* dst, size_t max_frames) const;
+
+    // Like readRecentInto/readRecentMonoInto, but ending at the frame audible
+    // at `wallTime` instead of the newest mixed one, so visualizations show
+    // what is being heard.
+    size_t readAudibleInto(float* dst, size_t max_samples, double wallTime) const;
+    size_t readAudibleMonoInto(float* dst, size_t max_frames, double wallTime) const;
+
+    // Copies the latest spectrum computed on the audio thread. Returns false
+    // until the first mixer block has been analyzed.
+    bool readSpectrum(SpectrumSnapshot& out) const;
+
+    struct BeatInfo {
+        float bpm = 0.0f;        // 0 until a tempo has been found
+        float confidence = 0.0f; // 0 to 1
+        float phase = 0.0f;      // 0 on a beat, rising towards 1 before the next
+    };
+
+    // Tempo and position within the beat of the audio heard at `wallTime`,
+    // from the beat tracker running on the mixer output.
+    BeatInfo getBeatAt(double wallTime) const;
+
+    // In-place processing of the mixer output, ahead of capture and analysis.
+    // The chain starts with the equalizer, which is flat until configured.
+    DspChain& getDspChain() { return dsp_chain; }
+    ParametricEq& getEqualizer() { return *equalizer; }
+
     void setPlayQueue(std::shared_ptr<music::PlayQueue> playQueue) {
         playQueueModel = playQueue;
     }
@@ -89,9 +186,23 @@ public:
     // Check if repeat mode is enabled
     bool isRepeating() const;
 
-    void setEventQueue(ALLEGRO_EVENT_QUEUE* queue) {
-        event_queue = queue;
-    }
+    // Registers the engine's playback event source (stream finished, track
+    // advanced) with the given queue.
+    void setEventQueue(ALLEGRO_EVENT_QUEUE* queue);
+
+    // How long before the end of a song the next queue entry is opened in the
+    // background, so it can follow without a gap.
+    void setPreloadSeconds(double seconds);
+
+    // Overlap between consecutive songs, 0 to 12 seconds. 0 keeps the gapless
+    // splice; otherwise the outgoing and incoming songs play together with
+    // equal-power gain ramps.
+    void setCrossfadeSeconds(double seconds);
+
+    // Loudness normalization applied to each song as it is decoded, from the
+    // gains LibraryScanner::analyzeLoudness stored in the library.
+    void setReplayGainMode(ReplayGainMode mode) { replay_gain_mode = mode; }
+    ReplayGainMode getReplayGainMode() const { return replay_gain_mode; }
 
     // Callback invoked when a new song begins playback. User can assign a
     // handler to update UI (NowPlayingView) or other systems.
@@ -100,6 +211,12 @@ public:
     // Callback invoked when the current song finishes playing.
     std::function<void()> onSongFinished;
 
+    // Long files (audiobooks, mixes) pick up where they were left.
+    // Called every few seconds while one plays and when it is left, with 0
+    // once it was played to the end; playSound() seeks to the position the
+    // library holds for the song.
+    std::function<void(const std::string& file_path, double position)> onResumePosition;
+
     // Advance to the next song in the injected play queue and start playback.
     // If there is no next song, this is a no-op.
     void playNext();
@@ -116,14 +233,12 @@ public:
 
     void update(); // Call periodically to update progress among other things
 private:
+    // Written from the mixer postprocess callback (audio thread), read from the
+    // UI thread. Neither side takes a lock; see SampleRing.
     struct SampleCaptureState {
-        bool enabled = true;
-        size_t channels = 2;
-        std::vector<float> ring_buffer;
-        size_t ring_capacity = 0;
-        size_t ring_write_pos = 0;
-        size_t ring_size = 0;
-        mutable std::mutex ring_mutex;
+        std::atomic<bool> enabled{true};
+        std::atomic<size_t> channels{2};
+        SampleRing ring;
 
         void setEnabled(bool value);
         bool isEnabled() const;
@@ -133,21 +248,153 @@ private:
         void clear();
         std::vector<float> copyRecent(size_t max_samples) const;
         std::vector<float> copyRecentMono(size_t max_frames) const;
-        void appendInterleavedInt16(const void* buf, unsigned int frames);
+        size_t readRecentInto(float* dst, size_t max_samples, size_t skip_frames = 0) const;
+        size_t readRecentMonoInto(float* dst, size_t max_frames, size_t skip_frames = 0) const;
+        void appendInterleaved(const float* samples, size_t sample_count);
+    };
+
+    // Mixer blocks are converted to float in chunks of this many samples so the
+    // postprocess callback works out of a fixed, preallocated scratch buffer.
+    static constexpr size_t kPostprocessChunkSamples = 4096;
+
+    // Output stream shapes, smallest first; see BufferStats.
+    struct OutputBufferShape {
+        unsigned int fragment_frames;
+        size_t fragment_count;
+    };
+    static constexpr OutputBufferShape kOutputBufferShapes[] = {
+        {1024, 4},
+        {2048, 4},
+        {2048, 8},
+        {4096, 8},
+    };
+    static constexpr size_t kMaxOutputFragmentCount = 8;
+
+    // One user-fed output stream attached to the mixer and the source feeding
+    // it (see DeckFeed). Normally only `primary` exists; during a crossfade
+    // the next song plays on `incoming` and the mixer sums both.
+    struct Deck : DeckFeed {
+        ALLEGRO_AUDIO_STREAM* stream = nullptr;
+        bool drained = false;         // the trailing silence is now playing
+        size_t fragment_count = 0;
+        uint64_t fragments_filled = 0;
+        FragmentMark marks[kMaxOutputFragmentCount];
+
+        // Mixer frame at which fragment `clock_fragment` started playing;
+        // extrapolated one fragment at a time to anchor the playback clock.
+        uint64_t clock_fragment = 0;
+        uint64_t clock_mixer_frame = 0;
     };
 
+    // The helpers below expect playback_mutex to be held.
+    bool startSourceLocked(std::unique_ptr<StreamSource> source, RetiredSources& retired);
+    bool createOutputStreamLocked(Deck& deck, RetiredSources& retired, bool keep_resampler = false);
+    bool noteUnderrunLocked(Deck& deck, RetiredSources& retired);
+    void resetDeckLocked(Deck& deck, RetiredSources& retired);
+    void stopDecksLocked(RetiredSources& retired);
+    void promoteIncomingLocked(RetiredSources& retired);
+    void serviceDecksLocked(RetiredSources& retired);
+    void fillAvailableFragmentsLocked(Deck& deck, RetiredSources& retired);
+    bool resamplesItself(const StreamSource& source) const;
+    unsigned int streamFrequencyFor(const StreamSource& source) const;
+    void notePlayingFragmentLocked(Deck& deck, uint64_t fragment_index);
+    uint64_t fragmentStartLocked(const Deck& deck, uint64_t fragment_index) const;
+    void maybeStartCrossfadeLocked(RetiredSources& retired);
+    bool seekLocked(double position, RetiredSources& retired);
+    Deck& audibleDeckLocked();
+    std::optional<double> takePendingSeek();
+
+    float replayGainFor(const music::SongView& song) const;
+    double resumePositionFor(int song_id) const;
+    void saveResumePosition(double position);
+    void requestPreload();
+    void feedThreadMain();
+    void preloadThreadMain();
+    void stopThreads();
+    void emitPlaybackEvent(unsigned int type);
+
     ALLEGRO_VOICE* voice = nullptr;
     ALLEGRO_MIXER* mixer = nullptr;
-    ALLEGRO_AUDIO_STREAM* current_stream = nullptr;
+    unsigned int requested_frequency = 0;
+    ALLEGRO_AUDIO_DEPTH requested_depth = ALLEGRO_AUDIO_DEPTH_FLOAT32;
+    ResamplerQuality resampler_quality = ResamplerQuality::Linear;
+    unsigned int mixer_frequency = 44100;
+    ALLEGRO_AUDIO_DEPTH mixer_depth = ALLEGRO_AUDIO_DEPTH_INT16;
     ALLEGRO_EVENT_QUEUE* event_queue = nullptr;
+    ALLEGRO_EVENT_SOURCE playback_events;
+    bool playback_events_ready = false;
 
     double current_time = 0.0;
     double duration = 0.0;
     float current_gain = 1.0f;
+    ReplayGainMode replay_gain_mode = ReplayGainMode::Track;
     bool is_shutdown = false;
     bool song_finished_fired = false; // Track if we already fired the callback
+    std::string resume_path;   // song whose position onResumePosition reports
+    double resume_saved_at = 0.0;
+
+    // Playback pipeline. feed_thread keeps the decks' output streams filled;
+    // when the primary source runs out, the preloaded source is spliced in at
+    // the same frame if it shares the format, or crossfaded in on a second deck
+    // when crossfade_seconds is set. Everything here is guarded by playback_mutex.
+    mutable std::mutex playback_mutex;
+    std::condition_variable feed_cv;
+    std::condition_variable preload_cv;
+    std::thread feed_thread;
+    std::thread preload_thread;
+    bool quit_threads = false;
+
+    // Latest requestSeek() target. Guarded by seek_mutex rather than
+    // playback_mutex so scrubbing never waits for a seek in progress; when
+    // both are held, playback_mutex is taken first.
+    std::mutex seek_mutex;
+    std::optional<double> pending_seek;
+
+    // Decodes ahead for every open source. Declared before the decks so it
+    // outlives their sources.
+    DecodeScheduler decode_scheduler;
+
+    Deck primary;
+    std::unique_ptr<Deck> incoming;
+    uint64_t next_serial = 0;
+    uint64_t announced_serial = 0;
+    bool end_announced = false;
+    double playing_position = 0.0;
+    bool gapless_advanced = false; // the next song is audible; playSound() adopts it
+    double crossfade_seconds = 0.0;
+
+    // Adaptive output buffering: index into kOutputBufferShapes, and the
+    // counters behind getBufferStats().
+    size_t output_buffer_level = 0;
+    double buffer_level_changed_at = 0.0; // al_get_time()
+    uint64_t underrun_count = 0;
+    uint64_t fragments_played = 0;
+    double fragment_interval_total = 0.0;
+    double fragment_interval_max = 0.0;
+    double last_fragment_time = 0.0; // 0 until the primary stream hands one back
+
+    PlaybackClock playback_clock;
+    float current_speed = 1.0f;
+    bool paused = false;
+    uint64_t paused_mixer_frame = 0;
+    // Mixer frame counts at the start of the last two feed passes; a fragment
+    // first seen as playing started between them.
+    uint64_t service_mixer_frame = 0;
+    uint64_t previous_service_mixer_frame = 0;
+
+    std::unique_ptr<StreamSource> preloaded_source;
+    std::string preload_request_path;
+    float preload_request_gain = 1.0f;
+    uint64_t preload_generation = 0;
+    bool preload_requested = false;
+    double preload_seconds = 10.0;
 
     SampleCaptureState sample_capture;
+    DspChain dsp_chain;
+    std::shared_ptr<ParametricEq> equalizer = std::make_shared<ParametricEq>();
+    SpectrumAnalyzer spectrum_analyzer;
+    BeatTracker beat_tracker;
+    std::vector<float> postprocess_scratch;
 
     static void mixerPostprocessCallback(void* buf, unsigned int samples, void* data);
 };
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "core/dsp_chain.hpp"
+
+namespace core {
+
+// Ten-band biquad equalizer (RBJ cookbook shelves and peaks) plus a preamp.
+//
+// Bands are cascaded transposed direct form II sections in float. Stereo
+// runs both channels through the same section together in SSE2 registers;
+// other layouts use the scalar path. Bands at 0 dB are skipped, and the node
+// reports itself inactive when every band and the preamp are flat.
+//
+// The UI thread edits a Settings copy and publishes it with setSettings();
+// the audio thread picks the latest one up at the start of its next block
+// and recomputes coefficients there, so neither side locks.
+class ParametricEq : public DspNode {
+public:
+    static constexpr size_t kBandCount = 10;
+    static constexpr size_t kMaxChannels = 8;
+
+    enum class BandType : uint8_t {
+        LowShelf,
+        Peaking,
+        HighShelf,
+    };
+
+    struct Band {
+        BandType type = BandType::Peaking;
+        float frequency = 1000.0f; // Hz
+        float gain_db = 0.0f;
+        float q = 1.41f;           // ~1 octave for peaks; shelf slope uses the same Q
+    };
+
+    struct Settings {
+        float preamp_db = 0.0f;
+        std::array<Band, kBandCount> bands = defaultBands();
+    };
+
+    // Octave-spaced 31 Hz .. 16 kHz, shelves at both ends.
+    static std::array<Band, kBandCount> defaultBands();
+
+    ParametricEq();
+
+    const char* getName() const override { return "parametric_eq"; }
+    void prepare(double sample_rate, size_t channels) override;
+    void process(float* interleaved, size_t frames) override;
+    bool isActive() const override;
+
+    // UI thread.
+    void setSettings(const Settings& settings);
+    Settings getSettings() const;
+
+private:
+    struct Coefficients {
+        float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+    };
+    struct State {
+        float z1 = 0.0f, z2 = 0.0f;
+    };
+
+    static bool isFlat(const Settings& settings);
+    void applyPendingSettings();
+    void computeCoefficients(const Settings& settings);
+    void processScalar(float* interleaved, size_t frames);
+    void processStereoSse2(float* interleaved, size_t frames);
+    void flushDenormals();
+
+    double sample_rate = 44100.0;
+    size_t channels = 2;
+    bool use_sse2 = false;
+
+    // Published by the UI thread through two alternating slots.
+    Settings slots[2];
+    std::atomic<uint64_t> published{1};
+    std::atomic<bool> flat{true};
+
+    // Audio thread only.
+    uint64_t applied = 0;
+    float preamp = 1.0f;
+    std::array<bool, kBandCount> band_active{};
+    std::array<Coefficients, kBandCount> coefficients{};
+    std::array<std::array<State, kMaxChannels>, kBandCount> state{};
+};
+
+} // namespace core
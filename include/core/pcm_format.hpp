@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+#include <allegro5/allegro_audio.h>
+
+namespace core {
+
+// Helpers for interleaved PCM in any of Allegro's sample depths. 24-bit
+// depths are stored in 32-bit words, as Allegro does.
+
+// Scales PCM in place, clamping integer formats. The gain starts at `gain`
+// and moves by `step` per frame.
+void scalePcm(void* pcm, size_t frames, size_t channels, ALLEGRO_AUDIO_DEPTH depth, float gain, float step = 0.0f);
+
+// Converts `count` samples to float in [-1, 1). Returns false for an
+// unsupported depth.
+bool pcmToFloat(const void* pcm, float* dst, size_t count, ALLEGRO_AUDIO_DEPTH depth);
+
+} // namespace core
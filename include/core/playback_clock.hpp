@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace core {
+
+// Sample-accurate playhead derived from the mixer output.
+//
+// The mixer postprocess callback calls advance() once per block; the block's
+// end frame and its render time (al_get_time(), which is monotonic) are
+// published together. The control side anchors a source position to a mixer
+// frame whenever the mapping changes (start, seek, fragment boundaries, pause).
+// positionAt() combines both to place the playhead at any wall-clock time,
+// shifted by the output latency so it reports what is audible rather than
+// what was last mixed.
+//
+// advance() runs on the audio thread and anchor()/hold() on one control
+// thread at a time; readers on any thread never lock. Each side publishes
+// through two alternating slots guarded by a sequence counter, like
+// SpectrumAnalyzer.
+class PlaybackClock {
+public:
+    // Mixer blocks are rendered this far ahead of the block being heard:
+    // one block queued at the device while the next one is mixed.
+    static constexpr unsigned int kQueuedBlocks = 1;
+
+    void configure(unsigned int mixer_frequency);
+
+    // Audio thread, once per mixer block.
+    void advance(unsigned int frames);
+
+    // Total mixer frames rendered so far.
+    uint64_t getMixerFrames() const;
+
+    // The source was at `position` seconds when mixer frame `mixer_frame`
+    // was rendered and moves at `speed` source seconds per second from there.
+    void anchor(double position, uint64_t mixer_frame, double speed);
+    // Stops the playhead at `position` (paused, stopped or not started).
+    void hold(double position);
+
+    // Extra device latency on top of the mixer's own queueing (e.g. Bluetooth).
+    void setLatencyOffset(double seconds);
+    // Seconds between a frame being mixed and being heard.
+    double getOutputLatency() const;
+
+    // Source position audible at `wall_time` (an al_get_time() value).
+    double positionAt(double wall_time) const;
+    // Source position being mixed at `mixer_frame`, ignoring latency.
+    double positionAtFrame(uint64_t mixer_frame) const;
+    // Mixer frames that have been rendered but are not yet audible at
+    // `wall_time`; readers of captured output skip this many newest frames.
+    uint64_t framesAheadOfAudible(double wall_time) const;
+
+private:
+    struct Block {
+        uint64_t end_frame = 0;   // mixer frames rendered including this block
+        unsigned int frames = 0;  // length of the block
+        double rendered_at = 0.0; // al_get_time() right after mixing
+    };
+    struct Anchor {
+        double position = 0.0;
+        uint64_t mixer_frame = 0;
+        double speed = 0.0;       // 0 while held
+    };
+
+    // Limits extrapolation when the device stops pulling blocks.
+    static constexpr double kMaxExtrapolation = 0.25;
+
+    Block readBlock() const;
+    Anchor readAnchor() const;
+    double audibleFrameAt(const Block& block, double wall_time) const;
+    double extrapolate(double mixer_frame) const;
+
+    std::atomic<unsigned int> frequency{44100};
+    std::atomic<double> latency_offset{0.0};
+
+    Block blocks[2];
+    std::atomic<uint64_t> block_sequence{0};
+    Anchor anchors[2];
+    std::atomic<uint64_t> anchor_sequence{0};
+};
+
+} // namespace core
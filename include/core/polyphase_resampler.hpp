@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace core {
+
+// Streaming sample-rate converter for interleaved float audio.
+//
+// Kaiser-windowed sinc kernel stored as a polyphase table; the fractional
+// position between two table phases is linearly interpolated, so any rate
+// ratio works without a rational approximation. When downsampling, the
+// cutoff moves below the output Nyquist frequency.
+class PolyphaseResampler {
+public:
+    static constexpr size_t kTaps = 32;      // per output sample, per channel
+    static constexpr size_t kPhases = 256;
+
+    PolyphaseResampler(double input_rate, double output_rate, size_t channels);
+
+    void push(const float* interleaved, size_t frames);
+    // Writes up to `frames` output frames and returns how many were written.
+    size_t pull(float* interleaved, size_t frames);
+    // Pads the input so the tail of the pushed audio can be pulled.
+    void flush();
+    void reset();
+
+    size_t getChannels() const { return channels; }
+
+private:
+    size_t channels;
+    double step;              // input frames per output frame
+    std::vector<float> table; // (kPhases + 1) x kTaps
+    std::vector<float> input; // interleaved history plus pending frames
+    size_t input_frames = 0;
+    double position = 0.0;    // next output's center, in input frames
+};
+
+} // namespace core
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace core {
+
+// Power spectrum of a real signal whose length is a power of two, computed
+// as a half-size complex FFT followed by a split step. Shared by
+// SpectrumAnalyzer and BeatTracker.
+//
+// configure() allocates; power() does not and is safe on the audio thread.
+class RealFft {
+public:
+    void configure(size_t size);
+    size_t getSize() const { return size; }
+
+    // Writes |X[k]|^2 for k = 0..getSize() / 2 to `out`. `sample(i)` returns
+    // input sample i (0 = oldest), with any window already applied.
+    template <typename SampleFn>
+    void power(SampleFn&& sample, float* out) {
+        // z[k] = x[2k] + i*x[2k+1]
+        for (size_t k = 0; k < half_size; ++k) {
+            buffer[k] = {sample(2 * k), sample(2 * k + 1)};
+        }
+        transform(out);
+    }
+
+private:
+    void transform(float* out);
+
+    size_t size = 0;
+    size_t half_size = 0;
+    std::vector<uint32_t> bit_reverse;
+    std::vector<std::complex<float>> fft_twiddles;  // for the half-size complex FFT
+    std::vector<std::complex<float>> real_twiddles; // for the real-FFT split step
+    std::vector<std::complex<float>> buffer;
+};
+
+} // namespace core
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace core {
+
+// Bulk sample conversion kernels used by the capture ring and DSP chain. The active table is
+// chosen once at runtime (AVX2, SSE2 or scalar) and every implementation
+// produces bit-identical output to the scalar one. Setting
+// AUDIOVIS_SAMPLE_KERNELS=scalar|sse2|avx2 forces a table the CPU supports.
+struct SampleKernels {
+    const char* name;
+
+    // dst[i] = src[i] / 32768.0f
+    void (*int16ToFloat)(const int16_t* src, float* dst, size_t count);
+
+    // dst[i] = round-to-nearest-even(src[i] * 32768), saturated to int16;
+    // NaN maps to -32768.
+    void (*floatToInt16)(const float* src, int16_t* dst, size_t count);
+
+    // Averages `channels` interleaved channels of each frame into dst[frame],
+    // summing channels in order starting from 0.0f.
+    void (*downmixToMono)(const float* src, float* dst, size_t frames, size_t channels);
+};
+
+const SampleKernels& sampleKernels();
+const SampleKernels& scalarSampleKernels();
+
+// The table called `name` ("scalar", "sse2" or "avx2"), or nullptr if this
+// build or CPU cannot run it. For tests and benchmarks that cover every path.
+const SampleKernels* sampleKernelsNamed(const char* name);
+
+} // namespace core
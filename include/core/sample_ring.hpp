@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace core {
+
+struct SampleKernels;
+
+// Wait-free single-producer/single-consumer ring of float samples.
+//
+// The producer (the mixer postprocess callback on the audio thread) only ever
+// appends. It never blocks, allocates or frees, so a slow UI frame cannot stall
+// audio output. The consumer (the UI thread) copies the newest samples without
+// removing them; it is also the only side allowed to resize or clear the ring.
+//
+// Indices are monotonically increasing sample counters; the slot for index i is
+// i & mask, which is why the capacity is always a power of two. Reads are
+// validated seqlock-style against the producer's reservation so that a copy
+// the producer lapped mid-read is retried instead of returned torn; if every
+// retry is lapped, only the newest part that is still intact is returned.
+class SampleRing {
+public:
+    SampleRing();
+    ~SampleRing();
+
+    SampleRing(const SampleRing&) = delete;
+    SampleRing& operator=(const SampleRing&) = delete;
+
+    // Consumer side. The capacity is rounded up to the next power of two and
+    // resizing discards buffered samples.
+    void setCapacity(size_t sample_count);
+    size_t getCapacity() const;
+    size_t getSize() const;
+    void clear();
+
+    // Copies up to max_samples of the newest samples into dst, oldest first,
+    // leaving out the skip_newest most recent ones. Returns the number of
+    // samples written to dst.
+    size_t readRecent(float* dst, size_t max_samples, size_t skip_newest = 0) const;
+
+    // Copies up to max_frames of the newest interleaved frames into dst,
+    // averaging the channels of each frame and leaving out the skip_newest
+    // most recent frames. Returns the number of frames written.
+    size_t readRecentMono(float* dst, size_t max_frames, size_t channels, size_t skip_newest = 0) const;
+
+    // Producer side.
+    void write(const float* src, size_t count);
+    void writeInt16(const int16_t* src, size_t count);
+
+private:
+    struct Storage {
+        explicit Storage(size_t capacity);
+
+        std::unique_ptr<float[]> samples;
+        size_t capacity;
+        size_t mask;
+    };
+
+    static constexpr int kMaxReadAttempts = 4;
+    static constexpr size_t kMaxChannels = 8; // ALLEGRO_CHANNEL_CONF_7_1
+
+    size_t availableSamples(const Storage& ring, uint64_t end) const;
+    // How many samples from `start` on a copy may hold overwritten data; 0 if
+    // the copy is intact.
+    size_t tornSamples(const Storage& ring, uint64_t start) const;
+    Storage* beginWrite();
+    void endWrite();
+    template <typename ConvertFn>
+    void writeRuns(Storage& ring, size_t count, ConvertFn&& convert);
+
+    const SampleKernels* kernels;
+
+    std::atomic<Storage*> storage{nullptr};
+    // Total samples ever published by the producer.
+    std::atomic<uint64_t> write_index{0};
+    // Producer's reservation: samples below this index may be mid-write.
+    std::atomic<uint64_t> write_reserve{0};
+    // Oldest sample the consumer still considers valid (moved by clear/resize).
+    std::atomic<uint64_t> read_index{0};
+    // Number of producers currently touching `storage`; resizes wait for zero.
+    std::atomic<int> active_producers{0};
+};
+
+} // namespace core
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "core/real_fft.hpp"
+
+namespace core {
+
+// Band energies published by SpectrumAnalyzer. Fixed-size so copying a
+// snapshot on the render thread never allocates.
+struct SpectrumSnapshot {
+    static constexpr size_t kMaxBands = 128;
+
+    uint64_t sequence = 0;     // 0 until the first analysis has been published
+    size_t band_count = 0;
+    float sample_rate = 0.0f;
+    float floor_db = 0.0f;
+    std::array<float, kMaxBands> band_center_hz{};
+    std::array<float, kMaxBands> band_db{};    // smoothed magnitude, dBFS
+    std::array<float, kMaxBands> band_level{}; // band_db mapped from [floor_db, 0] to [0, 1]
+};
+
+// Windowed real FFT with log-frequency band binning and per-band
+// attack/release smoothing.
+//
+// push()/analyze() run on the audio thread once per mixer block and never
+// allocate; readSnapshot() runs on the UI thread. Results are published through
+// two alternating slots guarded by a sequence counter, so neither side locks.
+// configure() allocates and must not race with push()/analyze().
+class SpectrumAnalyzer {
+public:
+    enum class Window {
+        Hann,
+        Blackman,
+    };
+
+    struct Settings {
+        size_t fft_size = 2048;      // power of two
+        size_t band_count = 64;      // clamped to SpectrumSnapshot::kMaxBands
+        float min_frequency = 30.0f;
+        float max_frequency = 16000.0f;
+        float attack_seconds = 0.015f;
+        float release_seconds = 0.25f;
+        float floor_db = -80.0f;
+        Window window = Window::Hann;
+    };
+
+    SpectrumAnalyzer();
+
+    void configure(float sample_rate, const Settings& settings);
+    const Settings& getSettings() const { return settings; }
+
+    // Appends interleaved frames (downmixed to mono) to the analysis window.
+    void push(const float* interleaved, size_t frames, size_t channels);
+
+    // Runs one FFT over the newest fft_size samples and publishes the result.
+    void analyze();
+
+    // Copies the latest published spectrum. Returns false if nothing has been
+    // published yet or a consistent copy could not be taken.
+    bool readSnapshot(SpectrumSnapshot& out) const;
+
+private:
+    struct Band {
+        size_t first_bin = 0;
+        size_t last_bin = 0;
+    };
+
+    static constexpr int kMaxReadAttempts = 4;
+    static constexpr size_t kPushChunkFrames = 512;
+
+    Settings settings;
+    float sample_rate = 44100.0f;
+    size_t fft_size = 0;
+    size_t half_size = 0;
+
+    std::vector<float> history; // circular mono history of fft_size samples
+    size_t history_pos = 0;
+    size_t pending_frames = 0;  // frames pushed since the last analyze()
+
+    std::vector<float> window;
+    float amplitude_scale = 0.0f;
+    RealFft fft;
+    std::vector<float> bin_power;
+    std::vector<float> mono_scratch;
+    std::vector<Band> bands;
+    std::array<float, SpectrumSnapshot::kMaxBands> smoothed_db{};
+
+    SpectrumSnapshot slots[2];
+    std::atomic<uint64_t> published{0};
+};
+
+} // namespace core
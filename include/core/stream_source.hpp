@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <allegro5/allegro_audio.h>
+
+#include "core/decoder.hpp"
+
+namespace core {
+
+class DecodeScheduler;
+
+// Pull-style PCM source for one audio file, decoded by the Decoder plugin
+// registered for its extension.
+//
+// Attached to a DecodeScheduler, the scheduler's workers keep a short buffer
+// decoded ahead and read() mostly copies from it; otherwise read() decodes
+// inline. read() and seek() must not be called concurrently; the engine
+// serializes them.
+class StreamSource {
+public:
+    ~StreamSource();
+
+    StreamSource(const StreamSource&) = delete;
+    StreamSource& operator=(const StreamSource&) = delete;
+
+    // Opens a source, attached to `scheduler` if one is given. Returns
+    // nullptr if no decoder accepts the file.
+    static std::unique_ptr<StreamSource> open(const std::string& path, DecodeScheduler* scheduler = nullptr);
+
+    // Decodes up to `frames` interleaved frames in the source format into dst.
+    // Returns the number of frames written; 0 means end of stream.
+    size_t read(void* dst, size_t frames);
+
+    bool seek(double seconds);
+    double getLength() const { return length; }
+
+    const std::string& getPath() const { return path; }
+    unsigned int getFrequency() const { return frequency; }
+    ALLEGRO_AUDIO_DEPTH getDepth() const { return depth; }
+    ALLEGRO_CHANNEL_CONF getChannels() const { return channels; }
+    size_t getFrameSize() const { return frame_size; }
+
+    // Linear loudness-normalization gain the engine applies to frames read
+    // from this source. 1 leaves them unchanged.
+    void setGain(float linear) { gain = linear; }
+    float getGain() const { return gain; }
+
+    // True when both sources can be played back-to-back through one output stream.
+    bool hasSameFormat(const StreamSource& other) const;
+
+private:
+    friend class DecodeScheduler;
+
+    StreamSource() = default;
+
+    // Share of the ahead buffer already decoded; 1 when there is nothing
+    // left to decode.
+    double aheadFill() const;
+    // Decodes one block into the ahead buffer. Called by scheduler workers.
+    void decodeAhead();
+    void growAheadLocked(size_t frames);
+
+    std::unique_ptr<Decoder> decoder;
+    DecodeScheduler* scheduler = nullptr;
+    std::string path;
+    unsigned int frequency = 0;
+    ALLEGRO_AUDIO_DEPTH depth = ALLEGRO_AUDIO_DEPTH_INT16;
+    ALLEGRO_CHANNEL_CONF channels = ALLEGRO_CHANNEL_CONF_2;
+    size_t frame_size = 0;
+    double length = 0.0;
+    float gain = 1.0f;
+
+    // Decoded frames not read yet, as a ring that grows to the scheduler's
+    // getAheadFrames(). decode_mutex guards the ring and the decoder; the
+    // atomics are also read unlocked by the scheduler.
+    std::mutex decode_mutex;
+    std::vector<unsigned char> ahead;
+    size_t ahead_start = 0;
+    std::atomic<size_t> ahead_capacity{0};
+    std::atomic<size_t> ahead_frames{0};
+    bool ahead_filled = false; // full at least once since opening or seeking
+    std::atomic<bool> decoder_ended{false};
+};
+
+} // namespace core
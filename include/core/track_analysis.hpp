@@ -0,0 +1,21 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <string>
+
+namespace core {
+
+// What the library scanner stores per song, measured in one decode pass.
+struct TrackAnalysis {
+    std::optional<double> loudness_lufs; // none when the track is digital silence
+    double peak = 0.0;                   // linear sample peak
+    double bpm = 0.0;                    // 0 when no steady tempo was found
+};
+
+// Decodes all of `path` through StreamSource, feeding a LoudnessMeter and a
+// BeatTracker. Returns nothing if the file cannot be decoded, or once
+// `cancel` is set.
+std::optional<TrackAnalysis> analyzeTrack(const std::string& path, const std::atomic<bool>* cancel = nullptr);
+
+} // namespace core
@@ -18,6 +18,28 @@ struct Song;
 }
 
 namespace database {
+// A song whose loudness or tempo has not been analyzed yet.
+struct LoudnessTask {
+    int64_t song_id;
+    int64_t album_id;
+    std::string path;
+};
+
+// Outcome of a song's loudness and tempo analysis, stored in
+// songs.analysis_state; NULL there means not analyzed yet.
+enum class AnalysisState {
+    Measured = 1,
+    Silent = 2, // gated out entirely; stored without a loudness, at 0 dB gain
+    Failed = 3, // could not be decoded; not retried
+};
+
+// Stored loudness of one analyzed track, used to derive album values.
+struct TrackLoudness {
+    double loudness_lufs;
+    double peak;
+    int duration;
+};
+
 class MusicDatabase {
 public:
     explicit MusicDatabase(const std::string& dbPath);
@@ -52,6 +74,19 @@ public:
     // Delete entities
     bool deleteSong(int64_t song_id);
 
+    // Loudness normalization (filled in by LibraryScanner::analyzeLoudness)
+    std::vector<LoudnessTask> getSongsMissingLoudness() const;
+    // A song without a loudness is stored as Silent
+    bool setSongLoudness(int64_t song_id, std::optional<double> loudness_lufs, double gain_db, double peak);
+    bool setSongAnalysisFailed(int64_t song_id);
+    // Only stores a tempo where none is yet; 0 records "analyzed, no steady tempo"
+    bool setSongBpm(int64_t song_id, double bpm);
+    std::vector<TrackLoudness> getAlbumTrackLoudness(int64_t album_id) const;
+    bool setAlbumLoudness(int64_t album_id, double loudness_lufs, double gain_db, double peak);
+
+    // Where playback of a long file resumes (MusicEngine::onResumePosition); 0 clears it
+    bool setSongResumePosition(int64_t song_id, double seconds);
+
     // Get last error message
     std::string lastError() const;
 
@@ -79,6 +114,8 @@ private:
     sqlite3* db = nullptr;
     mutable std::string lastErr;
 
+    bool migrateSchema();
+    bool hasColumn(const std::string& table, const std::string& column) const;
     bool addToJunctionTable(const std::string& table, const std::string& col1, const std::string& col2, int64_t id1, int64_t id2);
     int64_t getLastPositionInPlaylist(int64_t playlist_id);
 
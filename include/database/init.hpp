@@ -8,6 +8,12 @@ const char* INIT_SQL = "CREATE TABLE IF NOT EXISTS songs (" \
     "track INTEGER, " \
     "comment TEXT, " \
     "duration INTEGER, " \
+    "loudness_lufs REAL, " \
+    "track_gain_db REAL, " \
+    "track_peak REAL, " \
+    "resume_position REAL, " \
+    "bpm REAL, " \
+    "analysis_state INTEGER, " \
     "FOREIGN KEY(album_id) REFERENCES albums(id) ON DELETE CASCADE);" \
     \
     "CREATE TABLE IF NOT EXISTS artists (" \
@@ -25,6 +31,9 @@ const char* INIT_SQL = "CREATE TABLE IF NOT EXISTS songs (" \
     "musicbrainz_release_group_id TEXT, " \
     "cover_art_block BLOB, " \
     "cover_art_mime TEXT, " \
+    "loudness_lufs REAL, " \
+    "album_gain_db REAL, " \
+    "album_peak REAL, " \
     "artist_id INTEGER, " \
     "FOREIGN KEY(artist_id) REFERENCES artists(id) ON DELETE CASCADE);" \
     \
@@ -66,4 +75,24 @@ const char* INIT_SQL = "CREATE TABLE IF NOT EXISTS songs (" \
     "position INTEGER NOT NULL, " \
     "FOREIGN KEY(playlist_id) REFERENCES playlists(id) ON DELETE CASCADE, " \
     "FOREIGN KEY(song_id) REFERENCES songs(id) ON DELETE CASCADE, " \
-    "PRIMARY KEY(playlist_id, position));";
\ No newline at end of file
+    "PRIMARY KEY(playlist_id, position));";
+
+// Columns added after the initial schema. CREATE TABLE IF NOT EXISTS leaves
+// existing tables alone, so these are added with ALTER TABLE when missing.
+struct SchemaColumn {
+    const char* table;
+    const char* column;
+    const char* type;
+};
+
+const SchemaColumn SCHEMA_COLUMNS[] = {
+    { "songs", "loudness_lufs", "REAL" },
+    { "songs", "track_gain_db", "REAL" },
+    { "songs", "track_peak", "REAL" },
+    { "songs", "resume_position", "REAL" },
+    { "songs", "bpm", "REAL" },
+    { "songs", "analysis_state", "INTEGER" },
+    { "albums", "loudness_lufs", "REAL" },
+    { "albums", "album_gain_db", "REAL" },
+    { "albums", "album_peak", "REAL" },
+};
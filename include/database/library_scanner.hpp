@@ -27,7 +27,7 @@ struct SongMetadata {
     uint32_t year;
     uint32_t duration;
 
-    float bpm;
+    float bpm = 0.0f; // from the tags; 0 if untagged
 
     // Album art data
     std::vector<unsigned char> cover_art_data;
@@ -52,6 +52,22 @@ struct ScanResult {
 
 using ProgressCallback = std::function<void(size_t scanned, size_t imported)>;
 
+struct LoudnessOptions {
+	unsigned int workers = 0; // 0 = one per hardware thread
+};
+
+struct LoudnessResult {
+	size_t analyzed = 0;
+	size_t failed = 0;
+	size_t albums_updated = 0;
+	uint64_t bytes = 0;    // size of the analyzed files
+	double seconds = 0.0;  // wall time spent decoding and metering
+
+	double megabytesPerSecond() const {
+		return seconds > 0.0 ? static_cast<double>(bytes) / (1024.0 * 1024.0) / seconds : 0.0;
+	}
+};
+
 class LibraryScanner {
 public:
 	LibraryScanner() = default;
@@ -63,6 +79,20 @@ public:
 					ProgressCallback progress = nullptr,
 					std::atomic<bool>* cancel = nullptr);
 
+	// Measure integrated loudness (EBU R128) of every song that has none stored
+	// yet, on a pool of worker threads, then store track and album gains. The same
+	// pass estimates the tempo of songs whose tags gave none.
+	// Songs already analyzed are skipped, so repeated runs only cover new files;
+	// silent songs are stored at 0 dB and undecodable ones are marked so neither
+	// is decoded again. Results are written on the calling thread as songs
+	// finish, so a cancelled run keeps what it measured.
+	// The progress callback receives (finished, analyzed) and is called from
+	// worker threads, one at a time.
+	LoudnessResult analyzeLoudness(MusicDatabase& db,
+					const LoudnessOptions& opts = LoudnessOptions(),
+					ProgressCallback progress = nullptr,
+					std::atomic<bool>* cancel = nullptr);
+
 	// helpers
 	static bool isAudioFile(const std::string& path);
 	static bool isImageFile(const std::string& path);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 #include "graphics/models/progress_bar.hpp"
 #include <allegro5/color.h>
@@ -24,11 +25,20 @@ public:
     // render using your renderer implementation
     void draw(const graphics::RenderContext& context = {}) const override;
 
+    // Clicking or dragging along the bar scrubs; the callback gets the
+    // target in the model's units (seconds) on every move.
+    bool onMouseDown(const graphics::MouseEvent& event) override;
+    bool onMouseMove(const graphics::MouseEvent& event) override;
+    bool onMouseUp(const graphics::MouseEvent& event) override;
+    void setOnSeek(std::function<void(float)> callback) { onSeek = std::move(callback); }
+
     bool hitTest(float x, float y, const graphics::RenderContext& context) const override;
     bool isFocusable() const override { return false; }
     bool isEnabled() const override { return true; }
 private:
     std::shared_ptr<ProgressBar> model;
+    std::function<void(float)> onSeek;
+    bool dragging = false;
     ALLEGRO_COLOR bgColor = al_map_rgb(32, 32, 32);
     ALLEGRO_COLOR fgColor = al_map_rgb(0, 191, 255);
     ALLEGRO_COLOR borderColor = al_map_rgb(255, 255, 255);
@@ -36,5 +46,6 @@ private:
 
     void drawSquared(const graphics::RenderContext& context) const;
     void drawRounded(const graphics::RenderContext& context) const;
+    bool seekToMouseX(float x, const graphics::RenderContext& context);
 };
 };
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <memory>
 #include <vector>
 
+#include "core/spectrum_analyzer.hpp"
 #include "graphics/drawables/button.hpp"
 #include "graphics/uv.hpp"
 #include "graphics/drawable.hpp"
@@ -21,7 +22,9 @@ class EventDispatcher;
 }
 
 namespace vis {
+class AudioTexture;
 class Shader;
+class ShaderCache;
 }
 
 namespace util {
@@ -42,6 +45,8 @@ public:
         DualEchoWave = 2,
     };
 
+    // Reused across frames: buffers are resized in place so steady-state
+    // rendering keeps their capacity and does not allocate.
     struct SampleFrame {
         std::vector<float> mono;
         std::vector<float> interleaved;
@@ -57,7 +62,21 @@ public:
         float w = 0.0f;
         float h = 0.0f;
         float timeSeconds = 0.0f;
+        // Song position audible at timeSeconds.
+        float playheadSeconds = 0.0f;
         const SampleFrame* samples = nullptr;
+        // Null until the engine has published its first spectrum.
+        const core::SpectrumSnapshot* spectrum = nullptr;
+        // Tempo of the audio heard at timeSeconds; bpm is 0 until one is
+        // found. beatPhase is 0 on a beat and rises towards 1 before the next.
+        float bpm = 0.0f;
+        float beatPhase = 0.0f;
+        float beatConfidence = 0.0f;
+        // `samples` and `spectrum` uploaded for shaders; null when the
+        // display cannot hold the texture.
+        const vis::AudioTexture* audioTexture = nullptr;
+        // Every visualization program, compiled when the view was built.
+        const vis::ShaderCache* shaders = nullptr;
     };
 
     class Visualization {
@@ -67,6 +86,8 @@ public:
         virtual void update(const FrameContext& context);
         virtual void draw(const FrameContext& context) = 0;
 
+        // A shader set here replaces the visualization's program from the
+        // shader cache.
         virtual void setShader(vis::Shader* shader);
         virtual vis::Shader* getShader() const;
 
@@ -95,6 +116,9 @@ public:
     void setShader(vis::Shader* shader);
     vis::Shader* getShader() const;
 
+    // Rebuilds visualization shaders when their files change (Linux only).
+    void setShaderHotReload(bool enabled);
+
     void setVisualization(VisualizationType visualization);
     VisualizationType getVisualization() const { return activeVisualization; }
     void nextVisualization();
@@ -129,6 +153,10 @@ private:
     std::shared_ptr<ui::ButtonDrawable> previousButton;
     std::shared_ptr<ui::ButtonDrawable> nextButton;
     ALLEGRO_FONT* controlFont = nullptr;
+    SampleFrame sampleFrame;
+    core::SpectrumSnapshot spectrum;
+    std::unique_ptr<vis::AudioTexture> audioTexture;
+    std::unique_ptr<vis::ShaderCache> shaderCache;
 
 };
 
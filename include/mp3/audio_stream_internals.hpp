@@ -0,0 +1,203 @@
+#pragma once
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_audio.h>
+#include <cstddef>
+#include <cstdint>
+
+// Mirrors of Allegro's private audio stream layout (allegro5/internal/aintern_kcm.h).
+// Allegro has no public API for pulling decoded PCM out of a stream, so code
+// that needs to drive a stream's feeder directly reads these fields. They must
+// be kept in sync with the Allegro version the player is built against. Only
+// core/allegro_decoder.cpp still needs them.
+//
+// The layout below was checked against aintern_kcm.h of Allegro 5.2.8 and
+// 5.2.9. Any other version has to be compared field by field before it is
+// added to this range; a mismatch reads the wrong fields instead of failing.
+#if ALLEGRO_VERSION_INT < ((5 << 24) | (2 << 16) | (8 << 8)) || \
+    ALLEGRO_VERSION_INT >= ((5 << 24) | (2 << 16) | (10 << 8))
+#error "audio_stream_internals.hpp mirrors Allegro 5.2.8-5.2.9 stream internals; check aintern_kcm.h for this version"
+#endif
+namespace mp3streaming
+{
+    /* Forward declare AUDIO_STREAM so the function pointer typedefs can refer to it. */
+    struct AUDIO_STREAM;
+
+    typedef size_t (*stream_callback_t)(mp3streaming::AUDIO_STREAM *, void *, size_t);
+    typedef void (*unload_feeder_t)(mp3streaming::AUDIO_STREAM *);
+    typedef bool (*rewind_feeder_t)(mp3streaming::AUDIO_STREAM *);
+    typedef bool (*seek_feeder_t)(mp3streaming::AUDIO_STREAM *, double);
+    typedef double (*get_feeder_position_t)(mp3streaming::AUDIO_STREAM *);
+    typedef double (*get_feeder_length_t)(mp3streaming::AUDIO_STREAM *);
+    typedef bool (*set_feeder_loop_t)(mp3streaming::AUDIO_STREAM *, double, double);
+
+    struct ALLEGRO_SAMPLE
+    {
+        ALLEGRO_AUDIO_DEPTH depth;
+        ALLEGRO_CHANNEL_CONF chan_conf;
+        unsigned int frequency;
+        int len;
+        void *buffer;
+        bool free_buf;
+        /* Whether `buffer' needs to be freed when the sample
+         * is destroyed, or when `buffer' changes.
+         */
+        void *dtor_item;
+    };
+
+    /* Read some samples into a mixer buffer.
+     *
+     * source:
+     *    The object to read samples from.  This may be one of several types.
+     *
+     * *vbuf: (in-out parameter)
+     *    Pointer to pointer to destination buffer.
+     *    (should confirm what it means to change the pointer on return)
+     *
+     * *samples: (in-out parameter)
+     *    On input indicates the maximum number of samples that can fit into *vbuf.
+     *    On output indicates the actual number of samples that were read.
+     *
+     * buffer_depth:
+     *    The audio depth of the destination buffer.
+     *
+     * dest_maxc:
+     *    The number of channels in the destination.
+     */
+    typedef void (*stream_reader_t)(void *source, void **vbuf,
+                                    unsigned int *samples, ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc);
+
+    typedef struct
+    {
+        union
+        {
+            ALLEGRO_MIXER *mixer;
+            ALLEGRO_VOICE *voice;
+            void *ptr;
+        } u;
+        bool is_voice;
+    } sample_parent_t;
+
+    struct ALLEGRO_SAMPLE_INSTANCE
+    {
+        /* ALLEGRO_SAMPLE_INSTANCE does not generate any events yet but ALLEGRO_AUDIO_STREAM
+         * does, which can inherit only ALLEGRO_SAMPLE_INSTANCE. */
+        ALLEGRO_EVENT_SOURCE es;
+
+        ALLEGRO_SAMPLE spl_data;
+
+        volatile bool is_playing;
+        /* Is this sample is playing? */
+
+        ALLEGRO_PLAYMODE loop;
+        float speed;
+        float gain;
+        float pan;
+
+        /* When resampling an audio stream there will be fractional sample
+         * positions due to the difference in frequencies.
+         */
+        int pos;
+        int pos_bresenham_error;
+
+        int loop_start;
+        int loop_end;
+
+        int step;
+        int step_denom;
+        /* The numerator and denominator of the step are
+         * stored separately. The actual step is obtained by
+         * dividing step by step_denom */
+
+        float *matrix;
+        /* Used to convert from this format to the attached
+         * mixers, if any.  Otherwise is NULL.
+         * The gain is premultiplied in.
+         */
+
+        bool is_mixer;
+        stream_reader_t spl_read;
+        /* Reads sample data into the provided buffer, using
+         * the specified format, converting as necessary.
+         */
+
+        ALLEGRO_MUTEX *mutex;
+        /* Points to the parent object's mutex.  It is NULL if
+         * the sample is not directly or indirectly attached
+         * to a voice.
+         */
+
+        sample_parent_t parent;
+        /* The object that this sample is attached to, if any.
+         */
+        void *dtor_item;
+    };
+
+    struct AUDIO_STREAM
+    {
+        ALLEGRO_SAMPLE_INSTANCE spl;
+        /* ALLEGRO_AUDIO_STREAM is derived from
+         * ALLEGRO_SAMPLE_INSTANCE.
+         */
+
+        unsigned int buf_count;
+        /* The stream buffer is divided into a number of
+         * fragments; this is the number of fragments.
+         */
+
+        void *main_buffer;
+        /* Pointer to a single buffer big enough to hold all
+         * the fragments. Each fragment has additional samples
+         * at the start for linear/cubic interpolation.
+         */
+
+        void **pending_bufs;
+        void **used_bufs;
+        /* Arrays of offsets into the main_buffer.
+         * The arrays are each 'buf_count' long.
+         *
+         * 'pending_bufs' holds pointers to fragments supplied
+         * by the user which are yet to be handed off to the
+         * audio driver.
+         *
+         * 'used_bufs' holds pointers to fragments which
+         * have been sent to the audio driver and so are
+         * ready to receive new data.
+         */
+
+        volatile bool is_draining;
+        /* Set to true if sample data is not going to be passed
+         * to the stream any more. The stream must change its
+         * playing state to false after all buffers have been
+         * played.
+         */
+
+        uint64_t consumed_fragments;
+        /* Number of complete fragment buffers consumed since
+         * the stream was started.
+         */
+
+        ALLEGRO_THREAD *feed_thread;
+        ALLEGRO_MUTEX *feed_thread_started_mutex;
+        ALLEGRO_COND *feed_thread_started_cond;
+        bool feed_thread_started;
+        volatile bool quit_feed_thread;
+        mp3streaming::unload_feeder_t unload_feeder;
+        mp3streaming::rewind_feeder_t rewind_feeder;
+        mp3streaming::seek_feeder_t seek_feeder;
+        mp3streaming::get_feeder_position_t get_feeder_position;
+        mp3streaming::get_feeder_length_t get_feeder_length;
+        mp3streaming::set_feeder_loop_t set_feeder_loop;
+        mp3streaming::stream_callback_t feeder;
+        /* If ALLEGRO_AUDIO_STREAM has been created by
+         * al_load_audio_stream(), the stream will be fed
+         * by a thread using the 'feeder' callback. Such
+         * streams don't need to be fed by the user.
+         */
+
+        void *dtor_item;
+
+        void *extra;
+        /* Extra data for use by the flac/vorbis addons. */
+    };
+}
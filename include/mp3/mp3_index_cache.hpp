@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mp3streaming {
+
+// Frame offset table of one MP3 file, as built by the loader's header scan.
+struct FrameIndex {
+    std::vector<int64_t> frame_offsets; // of every stride-th frame, in bytes, strictly increasing
+    std::vector<int32_t> sync_frames;   // frames decoding can restart from, strictly increasing
+    int32_t stride = 1;                 // more than 1 once the index was thinned to its budget
+    int32_t frame_count = 0;
+    int64_t total_samples = 0;          // of the frame_count frames
+    // Where an interrupted scan continues, and the main data size of the
+    // frame before it. 0 once the whole file is indexed.
+    int64_t resume_offset = 0;
+    int32_t resume_main_data_bytes = -1;
+};
+
+// Persists frame indexes under <cache dir>/mp3index so reopening a file can
+// seek immediately instead of rescanning it.
+//
+// Entries are keyed by path, size and modification time, so an edited or
+// replaced file simply misses and is rescanned. Each entry repeats its key
+// in the header and is checked against it on load; entries that fail to
+// parse or match are deleted. Offsets and sync frames are stored as varint
+// deltas (about three bytes per frame). Loading an entry refreshes its timestamp, and storing
+// trims the directory to the kMaxEntries most recently used files. Partial
+// indexes of files whose scan was interrupted are stored too, so the scan
+// of a long file can resume.
+class FrameIndexCache {
+public:
+    static constexpr size_t kMaxEntries = 4096;
+
+    // False on a miss; `index` is only written on a hit.
+    static bool load(const std::string& path, int64_t file_size, FrameIndex& index);
+    static bool store(const std::string& path, int64_t file_size, const FrameIndex& index);
+
+private:
+    static std::string entryPath(const std::string& path, int64_t file_size, int64_t mtime);
+    static void trim(const std::string& directory);
+};
+
+} // namespace mp3streaming
@@ -1,720 +1,1263 @@
 #pragma once
 #include "minimp3_ex.h"
+#include "mp3/mp3_index_cache.hpp"
 
 #include <allegro5/allegro.h>
 #include <allegro5/allegro_audio.h>
-#include <allegro5/allegro_acodec.h>
 #include <new>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <algorithm>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define MP3_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace mp3streaming
 {
-    /* Forward declare AUDIO_STREAM so the function pointer typedefs can refer to it. */
-    struct AUDIO_STREAM;
-
-    typedef size_t (*stream_callback_t)(mp3streaming::AUDIO_STREAM *, void *, size_t);
-    typedef void (*unload_feeder_t)(mp3streaming::AUDIO_STREAM *);
-    typedef bool (*rewind_feeder_t)(mp3streaming::AUDIO_STREAM *);
-    typedef bool (*seek_feeder_t)(mp3streaming::AUDIO_STREAM *, double);
-    typedef double (*get_feeder_position_t)(mp3streaming::AUDIO_STREAM *);
-    typedef double (*get_feeder_length_t)(mp3streaming::AUDIO_STREAM *);
-    typedef bool (*set_feeder_loop_t)(mp3streaming::AUDIO_STREAM *, double, double);
+    /* Encoded input is read through a window of this many bytes. */
+    static const size_t MP3_INPUT_CHUNK = 64 * 1024;
+    /* Decoding never starts with less than this much input buffered (unless
+     * at the end of the file), so minimp3's sync check always sees whole
+     * frames: the largest layer III frame is 2881 bytes, and a resync looks
+     * at several consecutive headers. */
+    static const size_t MP3_INPUT_LOOKAHEAD = 16 * 1024;
+    /* With a mapped file, pages this far ahead of the decode cursor are
+     * requested from the kernel before the decoder touches them. */
+    static const int64_t MP3_MAP_PREFETCH = 256 * 1024;
 
     typedef struct MP3FILE
     {
         mp3dec_t dec;
 
-        uint8_t *file_buffer;      /* encoded MP3 file */
-        int64_t file_size;         /* in bytes */
-        int64_t next_frame_offset; /* next frame offset, in bytes */
-
-        int file_pos;     /* position in samples */
-        int file_samples; /* in samples */
-        double loop_start;
-        double loop_end;
+        ALLEGRO_FILE *fh;           /* owned; read in bounded chunks */
+        char *path;                 /* for the index thread's own handle, may be NULL */
+        int64_t file_size;          /* in bytes */
+        int64_t first_frame_offset; /* after any ID3v2 tag, in bytes */
+        int64_t next_frame_offset;  /* next frame offset, in bytes */
+
+        const uint8_t *map;     /* whole file mapped read-only, or NULL */
+        int64_t map_prefetched; /* end of the range last passed to MADV_WILLNEED */
+        int64_t map_released;   /* pages before this were dropped behind the cursor */
+
+        uint8_t *input;       /* MP3_INPUT_CHUNK bytes of the file, unless mapped */
+        int64_t input_offset; /* file offset of input[0], -1 if the file position is unknown */
+        size_t input_len;     /* valid bytes in input */
+
+        int64_t file_pos;     /* position in samples, counted from the first audio frame */
+        int64_t file_samples; /* in samples; estimated until the index is complete */
+
+        /* From a Xing/Info or VBRI tag, if the file has one. Positions seen by
+         * the stream are file_pos - start_delay, so the encoder and decoder
+         * delay is skipped and playback stops at end_pos for gapless output. */
+        bool length_from_tag; /* file_samples is exact from the start */
+        int64_t start_delay;  /* in samples */
+        int64_t end_pos;      /* in samples, 0 if unknown */
+        int64_t tag_samples;  /* untrimmed samples covered by the table of contents */
+        bool has_toc;
+        int64_t toc[101];     /* file offset at each percent of tag_samples */
 
         mp3d_sample_t frame_buffer[MINIMP3_MAX_SAMPLES_PER_FRAME]; /* decoded MP3 frame */
         int frame_pos;                                             /* position in the frame buffer, in samples */
-
-        int *frame_offsets; /* in bytes */
-        int num_frames;
         int frame_samples; /* in samples, same across all frames */
 
+        /* Seek index, filled in by index_thread while playback runs.
+         * Everything from here to index_complete is guarded by index_mutex. */
+        ALLEGRO_THREAD *index_thread;
+        ALLEGRO_MUTEX *index_mutex;
+        ALLEGRO_COND *index_cond;
+        int64_t *frame_offsets; /* in bytes, of every index_stride-th frame */
+        int num_frame_offsets;
+        int frame_offset_capacity;
+        int num_frames;         /* frames indexed so far */
+        int index_stride;       /* 1 until the index reaches max_index_entries */
+        int max_index_entries;  /* per array, from the memory budget */
+        int *sync_frames; /* ascending frame numbers, at most one per index_stride frames; see mp3_is_sync_frame */
+        int num_sync_frames;
+        int sync_frame_capacity;
+        int64_t indexed_samples;
+        int64_t scan_offset;      /* where the scan continues, after the last indexed frame */
+        int scan_main_data_bytes; /* of the last indexed frame; -1 if not layer III */
+        bool index_complete;
+        bool quit_index;
+
         int freq;
+        int bitrate_kbps; /* of the first frame; used for the length estimate */
         ALLEGRO_CHANNEL_CONF chan_conf;
+        int channels;
     } MP3FILE;
 
-    struct ALLEGRO_SAMPLE
+    static ALLEGRO_CHANNEL_CONF mp3_channel_conf(int channels)
     {
-        ALLEGRO_AUDIO_DEPTH depth;
-        ALLEGRO_CHANNEL_CONF chan_conf;
-        unsigned int frequency;
-        int len;
-        void *buffer;
-        bool free_buf;
-        /* Whether `buffer' needs to be freed when the sample
-         * is destroyed, or when `buffer' changes.
-         */
-        void *dtor_item;
-    };
+        return channels == 1 ? ALLEGRO_CHANNEL_CONF_1 : ALLEGRO_CHANNEL_CONF_2;
+    }
 
-    /* Read some samples into a mixer buffer.
-     *
-     * source:
-     *    The object to read samples from.  This may be one of several types.
-     *
-     * *vbuf: (in-out parameter)
-     *    Pointer to pointer to destination buffer.
-     *    (should confirm what it means to change the pointer on return)
-     *
-     * *samples: (in-out parameter)
-     *    On input indicates the maximum number of samples that can fit into *vbuf.
-     *    On output indicates the actual number of samples that were read.
-     *
-     * buffer_depth:
-     *    The audio depth of the destination buffer.
-     *
-     * dest_maxc:
-     *    The number of channels in the destination.
+#ifdef MP3_HAVE_MMAP
+    /* mp3_release_mapped:
+     *  Drops the mapped pages in [from, to) from the process. They fault back
+     *  in from the page cache if touched again; this only bounds RSS to a
+     *  window around each reader instead of the whole file.
      */
-    typedef void (*stream_reader_t)(void *source, void **vbuf,
-                                    unsigned int *samples, ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc);
-
-    typedef struct
-    {
-        union
-        {
-            ALLEGRO_MIXER *mixer;
-            ALLEGRO_VOICE *voice;
-            void *ptr;
-        } u;
-        bool is_voice;
-    } sample_parent_t;
-
-    struct ALLEGRO_SAMPLE_INSTANCE
-    {
-        /* ALLEGRO_SAMPLE_INSTANCE does not generate any events yet but ALLEGRO_AUDIO_STREAM
-         * does, which can inherit only ALLEGRO_SAMPLE_INSTANCE. */
-        ALLEGRO_EVENT_SOURCE es;
-
-        ALLEGRO_SAMPLE spl_data;
-
-        volatile bool is_playing;
-        /* Is this sample is playing? */
-
-        ALLEGRO_PLAYMODE loop;
-        float speed;
-        float gain;
-        float pan;
-
-        /* When resampling an audio stream there will be fractional sample
-         * positions due to the difference in frequencies.
-         */
-        int pos;
-        int pos_bresenham_error;
-
-        int loop_start;
-        int loop_end;
-
-        int step;
-        int step_denom;
-        /* The numerator and denominator of the step are
-         * stored separately. The actual step is obtained by
-         * dividing step by step_denom */
-
-        float *matrix;
-        /* Used to convert from this format to the attached
-         * mixers, if any.  Otherwise is NULL.
-         * The gain is premultiplied in.
-         */
-
-        bool is_mixer;
-        stream_reader_t spl_read;
-        /* Reads sample data into the provided buffer, using
-         * the specified format, converting as necessary.
-         */
-
-        ALLEGRO_MUTEX *mutex;
-        /* Points to the parent object's mutex.  It is NULL if
-         * the sample is not directly or indirectly attached
-         * to a voice.
-         */
-
-        sample_parent_t parent;
-        /* The object that this sample is attached to, if any.
-         */
-        void *dtor_item;
-    };
+    static void mp3_release_mapped(MP3FILE *mp3file, int64_t from, int64_t to)
+    {
+        const int64_t page = sysconf(_SC_PAGESIZE);
+        from = from / page * page;
+        to = to / page * page;
+        if (to > from)
+        {
+            madvise((void *)(mp3file->map + from), (size_t)(to - from), MADV_DONTNEED);
+        }
+    }
+#endif
+
+    /* mp3_fill_input:
+     *  Makes sure the input window holds the bytes at 'offset' plus the decode
+     *  lookahead (or everything up to the end of the file), reading from the
+     *  file as needed. Returns a pointer to the byte at 'offset' and stores the
+     *  number of bytes available from there in 'available'.
+     */
+    static const uint8_t *mp3_fill_input(MP3FILE *mp3file, int64_t offset, int *available)
+    {
+        *available = 0;
+        if (offset < 0 || offset >= mp3file->file_size)
+        {
+            return NULL;
+        }
 
-    struct AUDIO_STREAM
-    {
-        ALLEGRO_SAMPLE_INSTANCE spl;
-        /* ALLEGRO_AUDIO_STREAM is derived from
-         * ALLEGRO_SAMPLE_INSTANCE.
-         */
-
-        unsigned int buf_count;
-        /* The stream buffer is divided into a number of
-         * fragments; this is the number of fragments.
-         */
-
-        void *main_buffer;
-        /* Pointer to a single buffer big enough to hold all
-         * the fragments. Each fragment has additional samples
-         * at the start for linear/cubic interpolation.
-         */
-
-        void **pending_bufs;
-        void **used_bufs;
-        /* Arrays of offsets into the main_buffer.
-         * The arrays are each 'buf_count' long.
-         *
-         * 'pending_bufs' holds pointers to fragments supplied
-         * by the user which are yet to be handed off to the
-         * audio driver.
-         *
-         * 'used_bufs' holds pointers to fragments which
-         * have been sent to the audio driver and so are
-         * ready to receive new data.
-         */
-
-        volatile bool is_draining;
-        /* Set to true if sample data is not going to be passed
-         * to the stream any more. The stream must change its
-         * playing state to false after all buffers have been
-         * played.
-         */
-
-        uint64_t consumed_fragments;
-        /* Number of complete fragment buffers consumed since
-         * the stream was started.
-         */
-
-        ALLEGRO_THREAD *feed_thread;
-        ALLEGRO_MUTEX *feed_thread_started_mutex;
-        ALLEGRO_COND *feed_thread_started_cond;
-        bool feed_thread_started;
-        volatile bool quit_feed_thread;
-        mp3streaming::unload_feeder_t unload_feeder;
-        mp3streaming::rewind_feeder_t rewind_feeder;
-        mp3streaming::seek_feeder_t seek_feeder;
-        mp3streaming::get_feeder_position_t get_feeder_position;
-        mp3streaming::get_feeder_length_t get_feeder_length;
-        mp3streaming::set_feeder_loop_t set_feeder_loop;
-        mp3streaming::stream_callback_t feeder;
-        /* If ALLEGRO_AUDIO_STREAM has been created by
-         * al_load_audio_stream(), the stream will be fed
-         * by a thread using the 'feeder' callback. Such
-         * streams don't need to be fed by the user.
-         */
-
-        void *dtor_item;
-
-        void *extra;
-        /* Extra data for use by the flac/vorbis addons. */
+#ifdef MP3_HAVE_MMAP
+        if (mp3file->map)
+        {
+            /* Zero-copy: the decoder reads the page cache directly. Keep a
+             * window ahead of the cursor on its way in, and restart it after
+             * a seek. */
+            if (offset + MP3_MAP_PREFETCH / 2 > mp3file->map_prefetched ||
+                offset + MP3_MAP_PREFETCH < mp3file->map_prefetched - MP3_MAP_PREFETCH)
+            {
+                const int64_t page = sysconf(_SC_PAGESIZE);
+                const int64_t start = offset / page * page;
+                const int64_t end = std::min(offset + MP3_MAP_PREFETCH, mp3file->file_size);
+                madvise((void *)(mp3file->map + start), (size_t)(end - start), MADV_WILLNEED);
+                mp3file->map_prefetched = end;
+
+                const int64_t behind = offset - MP3_MAP_PREFETCH;
+                if (behind > mp3file->map_released)
+                {
+                    mp3_release_mapped(mp3file, mp3file->map_released, behind);
+                }
+                mp3file->map_released = std::max<int64_t>(0, behind);
+            }
+            *available = (int)std::min<int64_t>(mp3file->file_size - offset, MP3_INPUT_CHUNK);
+            return mp3file->map + offset;
+        }
+#endif
+
+        const int64_t window_end = mp3file->input_offset + (int64_t)mp3file->input_len;
+        const bool in_window = mp3file->input_offset >= 0 &&
+                               offset >= mp3file->input_offset && offset <= window_end;
+        const bool enough = window_end == mp3file->file_size ||
+                            window_end - offset >= (int64_t)MP3_INPUT_LOOKAHEAD;
+        if (!in_window || !enough)
+        {
+            size_t keep = 0;
+            if (in_window)
+            {
+                /* Slide the unread tail to the front; reads stay sequential. */
+                keep = (size_t)(window_end - offset);
+                memmove(mp3file->input, mp3file->input + (offset - mp3file->input_offset), keep);
+            }
+            else if (!al_fseek(mp3file->fh, offset, ALLEGRO_SEEK_SET))
+            {
+                mp3file->input_offset = -1;
+                mp3file->input_len = 0;
+                return NULL;
+            }
+            mp3file->input_offset = offset;
+            mp3file->input_len = keep + al_fread(mp3file->fh, mp3file->input + keep, MP3_INPUT_CHUNK - keep);
+            if (mp3file->input_len == 0)
+            {
+                return NULL;
+            }
+        }
+
+        *available = (int)(mp3file->input_offset + (int64_t)mp3file->input_len - offset);
+        return mp3file->input + (offset - mp3file->input_offset);
+    }
+
+    /* Decodes (or, with pcm == NULL, just parses) the frame at 'offset'. */
+    static int mp3_decode_at(MP3FILE *mp3file, int64_t offset, mp3d_sample_t *pcm, mp3dec_frame_info_t *info)
+    {
+        int available = 0;
+        const uint8_t *data = mp3_fill_input(mp3file, offset, &available);
+        if (!data)
+        {
+            info->frame_bytes = 0;
+            return 0;
+        }
+        return mp3dec_decode_frame(&mp3file->dec, data, available, pcm, info);
+    }
+
+    enum
+    {
+        MP3_FRAME_FOUND,
+        MP3_FRAME_PENDING, /* not indexed yet */
+        MP3_FRAME_MISSING  /* past the end of the file */
     };
 
-    /* Forward declaration so mp3_stream_close can call it before its definition. */
-    static ALLEGRO_MUTEX *maybe_lock_mutex(ALLEGRO_MUTEX *mutex);
-    static void maybe_unlock_mutex(ALLEGRO_MUTEX *mutex);
-    ALLEGRO_CHANNEL_CONF _al_count_to_channel_conf(int num_channels);
-    ALLEGRO_AUDIO_DEPTH _al_word_size_to_depth_conf(int word_size);
-    static bool mp3_stream_seek(AUDIO_STREAM *stream, double time);
-    static bool mp3_stream_rewind(AUDIO_STREAM *stream);
-    static double mp3_stream_get_position(AUDIO_STREAM *stream);
-    static double mp3_stream_get_length(AUDIO_STREAM *stream);
-    static bool mp3_stream_set_loop(AUDIO_STREAM *stream, double start, double end);
-    static size_t mp3_stream_update(AUDIO_STREAM *stream, void *data, size_t buf_size);
-    static void mp3_stream_close(AUDIO_STREAM *stream);
-    void *_al_kcm_feed_stream(ALLEGRO_THREAD *self, void *vstream);
-    void _al_acodec_start_feed_thread(AUDIO_STREAM *stream);
-    void _al_acodec_stop_feed_thread(AUDIO_STREAM *stream);
-
-    static ALLEGRO_MUTEX *maybe_lock_mutex(ALLEGRO_MUTEX *mutex)
-    {
-        if (mutex)
-        {
-            al_lock_mutex(mutex);
-        }
-        return mutex;
+    /* Frames decoded from a sync point before output is exact; see mp3_is_sync_frame. */
+    static int mp3_sync_warmup(MP3FILE *mp3file)
+    {
+        /* The frame after the sync point rebuilds the overlap and synthesis
+         * state in its second granule; MPEG-2 frames only have one. */
+        return mp3file->frame_samples >= 1152 ? 2 : 3;
     }
 
-    static void maybe_unlock_mutex(ALLEGRO_MUTEX *mutex)
+    /* mp3_find_frame:
+     *  Looks up the frame to start decoding from for 'frame' in the seek
+     *  index. '*sync_frame' is the earliest frame the caller will accept; it
+     *  is moved up to the latest indexed sync point that still leaves a full
+     *  warm-up before 'frame'. The index only holds every index_stride-th
+     *  offset, so this returns the last indexed frame at or before
+     *  '*sync_frame' and its offset.
+     *  With 'wait' set, blocks until the background scan gets that far;
+     *  otherwise reports MP3_FRAME_PENDING if it has not yet. Frame 0 is
+     *  always at first_frame_offset, so a '*sync_frame' of 0 is found even
+     *  before the scan reaches 'frame'.
+     */
+    static int mp3_find_frame(MP3FILE *mp3file, int frame, int *sync_frame, bool wait,
+                              int *start_frame, int64_t *start_offset)
     {
-        if (mutex)
+        al_lock_mutex(mp3file->index_mutex);
+        while (wait && *sync_frame > 0 && !mp3file->index_complete && mp3file->num_frames <= frame)
+        {
+            al_wait_cond(mp3file->index_cond, mp3file->index_mutex);
+        }
+        int result = MP3_FRAME_FOUND;
+        if (frame < mp3file->num_frames)
+        {
+            const int *sync_begin = mp3file->sync_frames;
+            const int *sync_end = sync_begin + mp3file->num_sync_frames;
+            const int *sync = std::upper_bound(sync_begin, sync_end, frame - mp3_sync_warmup(mp3file));
+            if (sync != sync_begin && sync[-1] > *sync_frame)
+            {
+                *sync_frame = sync[-1];
+            }
+            const int entry = *sync_frame / mp3file->index_stride;
+            if (entry < mp3file->num_frame_offsets)
+            {
+                *start_frame = entry * mp3file->index_stride;
+                *start_offset = mp3file->frame_offsets[entry];
+            }
+            else
+            {
+                result = MP3_FRAME_MISSING;
+            }
+        }
+        else if (*sync_frame == 0)
         {
-            al_unlock_mutex(mutex);
+            *start_frame = 0;
+            *start_offset = mp3file->first_frame_offset;
         }
+        else
+        {
+            result = mp3file->index_complete ? MP3_FRAME_MISSING : MP3_FRAME_PENDING;
+        }
+        al_unlock_mutex(mp3file->index_mutex);
+        return result;
     }
 
-    ALLEGRO_CHANNEL_CONF _al_count_to_channel_conf(int num_channels)
-    {
-        switch (num_channels)
-        {
-        case 1:
-            return ALLEGRO_CHANNEL_CONF_1;
-        case 2:
-            return ALLEGRO_CHANNEL_CONF_2;
-        case 3:
-            return ALLEGRO_CHANNEL_CONF_3;
-        case 4:
-            return ALLEGRO_CHANNEL_CONF_4;
-        case 6:
-            return ALLEGRO_CHANNEL_CONF_5_1;
-        case 7:
-            return ALLEGRO_CHANNEL_CONF_6_1;
-        case 8:
-            return ALLEGRO_CHANNEL_CONF_7_1;
-        default:
-            return (ALLEGRO_CHANNEL_CONF)0;
+    /* mp3_skip_frames:
+     *  Returns the offset of the frame 'count' frames after the one at
+     *  'offset', walking frame headers without decoding them, or -1 if the
+     *  file ends first. Frames are counted the way mp3_build_index counts them.
+     */
+    static int64_t mp3_skip_frames(MP3FILE *mp3file, int64_t offset, int count)
+    {
+        mp3dec_frame_info_t frame_info;
+        while (count > 0)
+        {
+            if (mp3_decode_at(mp3file, offset, NULL, &frame_info) > 0)
+            {
+                count--;
+            }
+            if (frame_info.frame_bytes == 0)
+            {
+                return -1;
+            }
+            offset += frame_info.frame_bytes;
         }
+        return offset;
     }
 
-    ALLEGRO_AUDIO_DEPTH _al_word_size_to_depth_conf(int word_size)
+    /* mp3_estimate_offset:
+     *  Guesses the file offset of 'frame' before the index gets there: from
+     *  the tag's table of contents if there is one, otherwise from the average
+     *  frame size indexed so far, or the first frame's bitrate before that.
+     */
+    static int64_t mp3_estimate_offset(MP3FILE *mp3file, int frame)
     {
-        switch (word_size)
+        const int64_t file_pos = (int64_t)frame * mp3file->frame_samples;
+        if (mp3file->has_toc)
         {
-        case 1:
-            return ALLEGRO_AUDIO_DEPTH_UINT8;
-        case 2:
-            return ALLEGRO_AUDIO_DEPTH_INT16;
-        case 3:
-            return ALLEGRO_AUDIO_DEPTH_INT24;
-        case 4:
-            return ALLEGRO_AUDIO_DEPTH_FLOAT32;
-        default:
-            return (ALLEGRO_AUDIO_DEPTH)0;
+            double percent = 100.0 * (double)file_pos / (double)mp3file->tag_samples;
+            percent = std::min(std::max(percent, 0.0), 99.999);
+            const int i = (int)percent;
+            return mp3file->toc[i] + (int64_t)((mp3file->toc[i + 1] - mp3file->toc[i]) * (percent - i));
         }
+
+        al_lock_mutex(mp3file->index_mutex);
+        const int last_frame = (mp3file->num_frame_offsets - 1) * mp3file->index_stride;
+        const int64_t last_offset = last_frame > 0 ? mp3file->frame_offsets[mp3file->num_frame_offsets - 1] : 0;
+        al_unlock_mutex(mp3file->index_mutex);
+        if (last_frame > 0)
+        {
+            const double frame_bytes = (double)(last_offset - mp3file->first_frame_offset) / last_frame;
+            return last_offset + (int64_t)(frame_bytes * (frame - last_frame));
+        }
+        return mp3file->first_frame_offset +
+               (int64_t)((double)file_pos / mp3file->freq * mp3file->bitrate_kbps * 125.0);
     }
 
-    static bool mp3_stream_seek(AUDIO_STREAM *stream, double time)
+    /* mp3_seek_approximate:
+     *  Seeks by an estimated offset while the exact index is still being
+     *  built. Decoding resyncs at the estimated offset and runs through the
+     *  same 10 frame warm-up as an exact seek; the position is as accurate as
+     *  the estimate (1% of the duration for a Xing table, a frame or so for
+     *  constant bitrate files).
+     */
+    static bool mp3_seek_approximate(MP3FILE *mp3file, int64_t file_pos)
     {
-        MP3FILE *mp3file = (MP3FILE *)stream->extra;
-        int file_pos = time * mp3file->freq;
-        int frame = file_pos / mp3file->frame_samples;
+        int frame = (int)(file_pos / mp3file->frame_samples);
+        int sync_frame = std::max(0, frame - 10);
+        int64_t offset = std::min(mp3_estimate_offset(mp3file, sync_frame), mp3file->file_size - 1);
+        int frames_left = frame - sync_frame + 1;
+
+        mp3dec_init(&mp3file->dec);
+        mp3dec_frame_info_t frame_info;
+        while (frames_left > 0)
+        {
+            int samples = mp3_decode_at(mp3file, offset, mp3file->frame_buffer, &frame_info);
+            if (frame_info.frame_bytes == 0)
+            {
+                return false;
+            }
+            offset += frame_info.frame_bytes;
+            if (samples > 0)
+            {
+                frames_left--;
+            }
+        }
+
+        mp3file->next_frame_offset = offset;
+        mp3file->file_pos = file_pos;
+        mp3file->frame_pos = (int)(file_pos - (int64_t)frame * mp3file->frame_samples);
+        return true;
+    }
+
+    static bool mp3_stream_seek(MP3FILE *mp3file, double time)
+    {
+        int64_t file_pos = (int64_t)(time * mp3file->freq) + mp3file->start_delay;
+        int frame = (int)(file_pos / mp3file->frame_samples);
         /* It is necessary to start decoding a little earlier than where we are
          * seeking to, because frames will reuse decoder state from previous frames.
-         * minimp3 assures us that 10 frames is sufficient. */
+         * minimp3 assures us that 10 frames is sufficient; a nearby sync point
+         * needs fewer and gives exact output. */
         int sync_frame = std::max(0, frame - 10);
-        int frame_pos = file_pos - frame * mp3file->frame_samples;
-        if (frame < 0 || frame > mp3file->num_frames)
+        int frame_pos = (int)(file_pos - (int64_t)frame * mp3file->frame_samples);
+        if (time < 0 || (mp3file->end_pos > 0 && file_pos >= mp3file->end_pos))
         {
             return false;
         }
-        int frame_offset = mp3file->frame_offsets[frame];
-        int sync_frame_offset = mp3file->frame_offsets[sync_frame];
+        /* Past the end of the index, an estimate beats waiting for the scan
+         * (a long file can take seconds to reach a resume point). Only free
+         * format files without a tag have nothing to estimate from. */
+        const bool wait = !mp3file->has_toc && mp3file->bitrate_kbps <= 0;
+        int start_frame = 0;
+        int64_t start_offset = 0;
+        switch (mp3_find_frame(mp3file, frame, &sync_frame, wait, &start_frame, &start_offset))
+        {
+        case MP3_FRAME_PENDING:
+            return mp3_seek_approximate(mp3file, file_pos);
+        case MP3_FRAME_MISSING:
+            return false;
+        }
 
+        /* A thinned index may start a few frames short of the sync point. */
+        int64_t offset = mp3_skip_frames(mp3file, start_offset, sync_frame - start_frame);
+        const int64_t frame_offset = offset < 0 ? -1 : mp3_skip_frames(mp3file, offset, frame - sync_frame);
+        if (frame_offset < 0)
+        {
+            return false;
+        }
+
+        /* Start from a clean decoder, so the output does not depend on where
+         * playback was before the seek. */
+        mp3dec_init(&mp3file->dec);
         mp3dec_frame_info_t frame_info;
         do
         {
-            mp3dec_decode_frame(&mp3file->dec,
-                                mp3file->file_buffer + sync_frame_offset,
-                                mp3file->file_size - sync_frame_offset,
-                                mp3file->frame_buffer, &frame_info);
-            sync_frame_offset += frame_info.frame_bytes;
-        } while (sync_frame_offset <= frame_offset);
+            mp3_decode_at(mp3file, offset, mp3file->frame_buffer, &frame_info);
+            if (frame_info.frame_bytes == 0)
+            {
+                return false;
+            }
+            offset += frame_info.frame_bytes;
+        } while (offset <= frame_offset);
 
-        mp3file->next_frame_offset = frame_offset + frame_info.frame_bytes;
+        mp3file->next_frame_offset = offset;
         mp3file->file_pos = file_pos;
         mp3file->frame_pos = frame_pos;
 
         return true;
     }
 
-    static bool mp3_stream_rewind(AUDIO_STREAM *stream)
+    static double mp3_stream_get_length(MP3FILE *mp3file)
     {
-        MP3FILE *mp3file = (MP3FILE *)stream->extra;
+        if (mp3file->length_from_tag)
+        {
+            return (double)mp3file->file_samples / mp3file->freq;
+        }
 
-        return mp3_stream_seek(stream, mp3file->loop_start);
+        al_lock_mutex(mp3file->index_mutex);
+        const int64_t samples = mp3file->index_complete
+            ? mp3file->file_samples
+            : std::max(mp3file->file_samples, mp3file->indexed_samples);
+        al_unlock_mutex(mp3file->index_mutex);
+        return (double)samples / mp3file->freq;
     }
 
-    static double mp3_stream_get_position(AUDIO_STREAM *stream)
+    /* mp3_stream_read:
+     *  Decodes up to 'buf_size' bytes of interleaved samples into 'data'.
+     *  Returns the actual number of bytes written; 0 at the end.
+     *
+     *  Whole frames that fit are decoded straight into 'data'; frame_buffer
+     *  only holds a frame split across two fragments (or the one a seek
+     *  landed in). The decoder state in 'mp3file->dec' carries over between
+     *  calls, as the bit reservoir requires.
+     */
+    static size_t mp3_stream_read(MP3FILE *mp3file, void *data, size_t buf_size)
     {
-        MP3FILE *mp3file = (MP3FILE *)stream->extra;
+        const int channels = mp3file->channels;
+        const int sample_size = sizeof(mp3d_sample_t) * channels;
+        int samples_needed = buf_size / sample_size;
 
-        return (double)mp3file->file_pos / mp3file->freq;
-    }
+        if (mp3file->end_pos > 0 && mp3file->file_pos + samples_needed > mp3file->end_pos)
+        {
+            samples_needed = (int)(mp3file->end_pos - mp3file->file_pos);
+        }
+        if (samples_needed < 0)
+            return 0;
 
-    static double mp3_stream_get_length(AUDIO_STREAM *stream)
-    {
-        MP3FILE *mp3file = (MP3FILE *)stream->extra;
+        mp3d_sample_t *out = (mp3d_sample_t *)data;
+        int samples_read = 0;
+        while (samples_read < samples_needed)
+        {
+            if (mp3file->frame_pos < mp3file->frame_samples)
+            {
+                int samples_from_this_frame = std::min(
+                    mp3file->frame_samples - mp3file->frame_pos,
+                    samples_needed - samples_read);
+                memcpy(out,
+                       mp3file->frame_buffer + mp3file->frame_pos * channels,
+                       samples_from_this_frame * sample_size);
+
+                mp3file->frame_pos += samples_from_this_frame;
+                mp3file->file_pos += samples_from_this_frame;
+                out += samples_from_this_frame * channels;
+                samples_read += samples_from_this_frame;
+                continue;
+            }
 
-        return (double)mp3file->file_samples / mp3file->freq;
+            /* minimp3 writes up to MINIMP3_MAX_SAMPLES_PER_FRAME values, so
+             * decode in place only when that much room is left. */
+            const bool direct = (samples_needed - samples_read) * channels >= MINIMP3_MAX_SAMPLES_PER_FRAME;
+            mp3dec_frame_info_t frame_info;
+            int frame_samples = mp3_decode_at(mp3file, mp3file->next_frame_offset,
+                                              direct ? out : mp3file->frame_buffer, &frame_info);
+            if (frame_samples == 0)
+            {
+                break;
+            }
+            mp3file->next_frame_offset += frame_info.frame_bytes;
+            if (direct)
+            {
+                mp3file->file_pos += frame_samples;
+                out += frame_samples * channels;
+                samples_read += frame_samples;
+            }
+            else
+            {
+                mp3file->frame_pos = 0;
+            }
+        }
+        return samples_read * sample_size;
     }
 
-    static bool mp3_stream_set_loop(AUDIO_STREAM *stream, double start, double end)
+    /* Returns the size of an ID3v2 tag at the start of 'data', or 0. Skipping
+     * it directly keeps a large embedded cover image out of the frame search. */
+    static int64_t mp3_id3v2_size(const uint8_t *data, int len)
     {
-        MP3FILE *mp3file = (MP3FILE *)stream->extra;
-        mp3file->loop_start = start;
-        mp3file->loop_end = end;
-        return true;
+        if (len < 10 || memcmp(data, "ID3", 3) != 0)
+        {
+            return 0;
+        }
+        const int64_t body = ((int64_t)(data[6] & 0x7f) << 21) | ((data[7] & 0x7f) << 14) |
+                             ((data[8] & 0x7f) << 7) | (data[9] & 0x7f);
+        const bool has_footer = (data[5] & 0x10) != 0;
+        return 10 + body + (has_footer ? 10 : 0);
     }
 
-    /* mp3_stream_update:
-     *  Updates 'stream' with the next chunk of data.
-     *  Returns the actual number of bytes written.
-     */
-    static size_t mp3_stream_update(AUDIO_STREAM *stream, void *data,
-                                    size_t buf_size)
+    static uint32_t mp3_read_be(const uint8_t *data, int bytes)
     {
-        MP3FILE *mp3file = (MP3FILE *)stream->extra;
-        int sample_size = sizeof(mp3d_sample_t) * al_get_channel_count(mp3file->chan_conf);
-        int samples_needed = buf_size / sample_size;
-        ;
-        double ctime = mp3_stream_get_position(stream);
-        double btime = (double)samples_needed / mp3file->freq;
-
-        if (stream->spl.loop != _ALLEGRO_PLAYMODE_STREAM_ONCE && ctime + btime > mp3file->loop_end)
+        uint32_t value = 0;
+        for (int i = 0; i < bytes; i++)
         {
-            samples_needed = (mp3file->loop_end - ctime) * mp3file->freq;
+            value = (value << 8) | data[i];
         }
-        if (samples_needed < 0)
-            return 0;
+        return value;
+    }
 
-        mp3dec_t dec;
-        mp3dec_init(&dec);
+    /* mp3_parse_vbr_tag:
+     *  Looks for a Xing/Info or VBRI tag in the first frame, which carries no
+     *  audio, and takes the frame count, table of contents and (for LAME style
+     *  Xing tags) the encoder delay and padding from it. Returns false if
+     *  there is no usable tag; 'frame' holds 'frame_bytes' bytes.
+     *  Table offsets are counted from the tag frame, but none points before
+     *  the first audio frame after it: minimp3 would decode the tag frame
+     *  as a frame of silence.
+     */
+    static bool mp3_parse_vbr_tag(MP3FILE *mp3file, const uint8_t *frame, int frame_bytes)
+    {
+        /* Side info size:   Mono  Stereo
+         *  MPEG1              17     32
+         *  MPEG2 & 2.5         9     17 */
+        const bool mpeg1 = (frame[1] & 0x08) != 0;
+        const bool mono = (frame[3] & 0xc0) == 0xc0;
+        const bool crc = (frame[1] & 0x01) == 0;
+        const int xing = 4 + (crc ? 2 : 0) + (mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17));
+        const int vbri = 4 + 32;
+        const uint8_t *end = frame + frame_bytes;
+        const int64_t tag_offset = mp3file->first_frame_offset;
+        int64_t frames = 0;
+        int64_t bytes = 0;
+        int delay = 0;
+        int padding = 0;
+
+        if (xing + 8 <= frame_bytes &&
+            (memcmp(frame + xing, "Xing", 4) == 0 || memcmp(frame + xing, "Info", 4) == 0))
+        {
+            const uint8_t *tag = frame + xing + 8;
+            const uint32_t flags = mp3_read_be(frame + xing + 4, 4);
+            const uint8_t *toc = NULL;
+            if (flags & 0x1)
+            {
+                if (tag + 4 > end)
+                    return false;
+                frames = mp3_read_be(tag, 4);
+                tag += 4;
+            }
+            if (flags & 0x2)
+            {
+                if (tag + 4 > end)
+                    return false;
+                bytes = mp3_read_be(tag, 4);
+                tag += 4;
+            }
+            if (flags & 0x4)
+            {
+                if (tag + 100 > end)
+                    return false;
+                toc = tag;
+                tag += 100;
+            }
+            if (flags & 0x8)
+            {
+                tag += 4;
+            }
+            /* LAME, Lavc and others append an extension with the same layout:
+             * 12 bit encoder delay and padding at byte 21. minimp3 adds the
+             * usual 529 samples of decoder delay, like the LAME decoder. */
+            if (tag + 24 <= end && tag[0])
+            {
+                delay = ((tag[21] << 4) | (tag[22] >> 4)) + 529;
+                padding = (((tag[22] & 0x0f) << 8) | tag[23]) - 529;
+            }
 
-        int samples_read = 0;
-        while (samples_read < samples_needed)
+            if (bytes <= 0 || tag_offset + bytes > mp3file->file_size)
+            {
+                bytes = mp3file->file_size - tag_offset;
+            }
+            if (toc && frames > 0)
+            {
+                for (int i = 0; i < 100; i++)
+                {
+                    mp3file->toc[i] = tag_offset + (int64_t)toc[i] * bytes / 256;
+                }
+                mp3file->toc[100] = tag_offset + bytes;
+                mp3file->has_toc = true;
+            }
+        }
+        else if (vbri + 26 <= frame_bytes && memcmp(frame + vbri, "VBRI", 4) == 0)
         {
-            int samples_from_this_frame = std::min(
-                mp3file->frame_samples - mp3file->frame_pos,
-                samples_needed - samples_read);
-            memcpy(data,
-                   mp3file->frame_buffer + mp3file->frame_pos * al_get_channel_count(mp3file->chan_conf),
-                   samples_from_this_frame * sample_size);
-
-            mp3file->frame_pos += samples_from_this_frame;
-            mp3file->file_pos += samples_from_this_frame;
-            data = (char *)(data) + samples_from_this_frame * sample_size;
-            samples_read += samples_from_this_frame;
-
-            if (mp3file->frame_pos >= mp3file->frame_samples)
-            {
-                mp3dec_frame_info_t frame_info;
-                int frame_samples = mp3dec_decode_frame(&mp3file->dec,
-                                                        mp3file->file_buffer + mp3file->next_frame_offset,
-                                                        mp3file->file_size - mp3file->next_frame_offset,
-                                                        mp3file->frame_buffer, &frame_info);
-                if (frame_samples == 0)
+            const uint8_t *tag = frame + vbri;
+            bytes = mp3_read_be(tag + 10, 4);
+            frames = mp3_read_be(tag + 14, 4);
+            const int entries = (int)mp3_read_be(tag + 18, 2);
+            const int scale = (int)mp3_read_be(tag + 20, 2);
+            const int entry_bytes = (int)mp3_read_be(tag + 22, 2);
+            const int frames_per_entry = (int)mp3_read_be(tag + 24, 2);
+            const uint8_t *table = tag + 26;
+
+            /* Entries are the byte sizes of consecutive runs of frames; turn
+             * them into offsets at each percent of the frame count. */
+            if (entries > 0 && frames > 0 && frames_per_entry > 0 && entry_bytes >= 1 && entry_bytes <= 4 &&
+                table + entries * entry_bytes <= end)
+            {
+                int64_t entry_start = tag_offset;
+                int entry = 0;
+                for (int i = 0; i <= 100; i++)
                 {
-                    // mp3_stream_rewind(stream);
-                    break;
+                    const double target = (double)frames * i / 100.0;
+                    while (entry < entries && (double)(entry + 1) * frames_per_entry <= target)
+                    {
+                        entry_start += (int64_t)mp3_read_be(table + entry * entry_bytes, entry_bytes) * scale;
+                        entry++;
+                    }
+                    int64_t offset = entry_start;
+                    if (entry < entries)
+                    {
+                        const int64_t size = (int64_t)mp3_read_be(table + entry * entry_bytes, entry_bytes) * scale;
+                        offset += (int64_t)(size * (target - (double)entry * frames_per_entry) / frames_per_entry);
+                    }
+                    mp3file->toc[i] = std::min(offset, mp3file->file_size);
                 }
-                mp3file->frame_pos = 0;
-                mp3file->next_frame_offset += frame_info.frame_bytes;
+                mp3file->has_toc = true;
             }
         }
-        return samples_read * sample_size;
-    }
+        else
+        {
+            return false;
+        }
 
-    static void mp3_stream_close(AUDIO_STREAM *stream)
-    {
-        MP3FILE *mp3file = (MP3FILE *)stream->extra;
+        if (frames <= 0)
+        {
+            mp3file->has_toc = false;
+            return false;
+        }
+        for (int i = 0; i <= 100; i++)
+        {
+            mp3file->toc[i] = std::max(mp3file->toc[i], std::min(tag_offset + frame_bytes, mp3file->file_size));
+        }
 
-        /* Prototype for stop function is declared below; ensure it's visible. */
-        _al_acodec_stop_feed_thread(stream);
+        mp3file->tag_samples = frames * mp3file->frame_samples;
+        mp3file->start_delay = std::min<int64_t>(delay, mp3file->tag_samples);
+        const int64_t trimmed = mp3file->tag_samples - mp3file->start_delay - std::max(padding, 0);
+        if (trimmed <= 0)
+        {
+            mp3file->has_toc = false;
+            mp3file->start_delay = 0;
+            return false;
+        }
+        mp3file->file_samples = trimmed;
+        mp3file->end_pos = mp3file->start_delay + trimmed;
+        mp3file->length_from_tag = true;
+        return true;
+    }
 
-        al_free(mp3file->frame_offsets);
-        al_free(mp3file->file_buffer);
-        al_free(mp3file);
-        stream->extra = NULL;
-        stream->feed_thread = NULL;
+    /* mp3_layer3_reservoir:
+     *  Reads main_data_begin (how many bytes of its main data a frame keeps
+     *  in earlier frames) from the layer III frame at 'hdr', and how many
+     *  main data bytes the frame itself carries. False for other layers.
+     */
+    static bool mp3_layer3_reservoir(const uint8_t *hdr, int frame_size, int *main_data_begin, int *main_data_bytes)
+    {
+        const bool mpeg1 = (hdr[1] & 0x08) != 0;
+        const bool mono = (hdr[3] & 0xc0) == 0xc0;
+        const int header_size = (hdr[1] & 0x01) ? 4 : 6; /* with CRC */
+        const int side_info_size = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+        if (((hdr[1] >> 1) & 3) != 1 || frame_size < header_size + side_info_size)
+        {
+            return false;
+        }
+        const uint8_t *side_info = hdr + header_size;
+        *main_data_begin = mpeg1 ? (side_info[0] << 1) | (side_info[1] >> 7) : side_info[0];
+        *main_data_bytes = frame_size - header_size - side_info_size;
+        return true;
     }
 
-    void *_al_kcm_feed_stream(ALLEGRO_THREAD *self, void *vstream)
+    /* mp3_is_sync_frame:
+     *  Layer III frames may keep part of their main data in earlier frames
+     *  (the bit reservoir), so decoding cannot restart at an arbitrary frame.
+     *  Frame s is a sync point when all of frame s+1's main data lies in s
+     *  and s+1: a decoder reset at s then holds everything s+1 needs, s+1
+     *  decodes correctly and rebuilds the overlap and synthesis state, and
+     *  output is bit exact from s + mp3_sync_warmup on. Called with the
+     *  reservoir fields of s (main_data_bytes) and s+1 (main_data_begin).
+     */
+    static bool mp3_is_sync_frame(int main_data_bytes, int next_main_data_begin)
     {
-        AUDIO_STREAM *stream = (AUDIO_STREAM *)vstream;
-        ALLEGRO_EVENT_QUEUE *queue;
-        bool finished_event_sent = false;
-        bool prefill = true;
-        (void)self;
+        return next_main_data_begin <= main_data_bytes;
+    }
 
-        queue = al_create_event_queue();
-        al_register_event_source(queue, &stream->spl.es);
+    /* mp3_grow:
+     *  Makes room for one more item in '*array', growing it by half at a
+     *  time up to 'limit' items. False if it is full or out of memory.
+     */
+    static bool mp3_grow(void **array, int *capacity, int count, int limit, size_t item_size)
+    {
+        if (count < *capacity)
+        {
+            return true;
+        }
+        if (count >= limit)
+        {
+            return false;
+        }
+        const int wanted = std::min(limit, std::max(count + 1, count / 2 * 3 + 16));
+        void *grown = al_realloc(*array, item_size * wanted);
+        if (!grown)
+        {
+            return false;
+        }
+        *array = grown;
+        *capacity = wanted;
+        return true;
+    }
 
-        stream->quit_feed_thread = false;
+    /* mp3_thin_index:
+     *  Halves the seek index once it fills its budget, so a file of any
+     *  length is indexed in bounded memory: every other offset is dropped,
+     *  and only the last sync point of each (now twice as long) stretch of
+     *  frames is kept. Seeks then walk up to index_stride frame headers and
+     *  may decode up to two strides more; see mp3_stream_seek.
+     *  Called with index_mutex held.
+     */
+    static void mp3_thin_index(MP3FILE *mp3file)
+    {
+        mp3file->index_stride *= 2;
+        for (int i = 0; 2 * i < mp3file->num_frame_offsets; i++)
+        {
+            mp3file->frame_offsets[i] = mp3file->frame_offsets[2 * i];
+        }
+        mp3file->num_frame_offsets = (mp3file->num_frame_offsets + 1) / 2;
 
-        while (!stream->quit_feed_thread)
+        int kept = 0;
+        for (int i = 0; i < mp3file->num_sync_frames; i++)
         {
-            char *fragment;
-            ALLEGRO_EVENT event;
+            const int frame = mp3file->sync_frames[i];
+            if (kept > 0 && mp3file->sync_frames[kept - 1] / mp3file->index_stride == frame / mp3file->index_stride)
+            {
+                mp3file->sync_frames[kept - 1] = frame;
+            }
+            else
+            {
+                mp3file->sync_frames[kept++] = frame;
+            }
+        }
+        mp3file->num_sync_frames = kept;
+    }
 
-            if (!prefill)
-                al_wait_for_event(queue, &event);
+    /* Called with index_mutex held, for each frame in order. */
+    static void mp3_add_frame_offset(MP3FILE *mp3file, int frame, int64_t offset)
+    {
+        while (frame % mp3file->index_stride == 0)
+        {
+            if (mp3_grow((void **)&mp3file->frame_offsets, &mp3file->frame_offset_capacity,
+                         mp3file->num_frame_offsets, mp3file->max_index_entries, sizeof(int64_t)))
+            {
+                mp3file->frame_offsets[mp3file->num_frame_offsets++] = offset;
+                return;
+            }
+            if (mp3file->num_frame_offsets == 0)
+            {
+                return;
+            }
+            mp3_thin_index(mp3file);
+        }
+    }
 
-            if ((prefill || event.type == ALLEGRO_EVENT_AUDIO_STREAM_FRAGMENT) && !stream->is_draining)
+    /* Called with index_mutex held, for each sync point in order. */
+    static void mp3_add_sync_frame(MP3FILE *mp3file, int frame)
+    {
+        while (true)
+        {
+            int *last = mp3file->num_sync_frames > 0 ? &mp3file->sync_frames[mp3file->num_sync_frames - 1] : NULL;
+            if (last && *last / mp3file->index_stride == frame / mp3file->index_stride)
+            {
+                *last = frame;
+                return;
+            }
+            if (mp3_grow((void **)&mp3file->sync_frames, &mp3file->sync_frame_capacity,
+                         mp3file->num_sync_frames, mp3file->max_index_entries, sizeof(int)))
+            {
+                mp3file->sync_frames[mp3file->num_sync_frames++] = frame;
+                return;
+            }
+            if (!last)
             {
-                unsigned long bytes;
-                unsigned long bytes_written;
-                ALLEGRO_MUTEX *stream_mutex;
+                return;
+            }
+            mp3_thin_index(mp3file);
+        }
+    }
 
-                fragment = (char *)al_get_audio_stream_fragment((ALLEGRO_AUDIO_STREAM *)stream);
-                if (!fragment)
-                {
-                    /* This is not an error. */
-                    continue;
-                }
+    static void mp3_append_offsets(MP3FILE *mp3file, const int64_t *offsets, int count, int64_t samples,
+                                   const int *syncs, int sync_count)
+    {
+        al_lock_mutex(mp3file->index_mutex);
+        for (int i = 0; i < count; i++)
+        {
+            mp3_add_frame_offset(mp3file, mp3file->num_frames + i, offsets[i]);
+        }
+        mp3file->num_frames += count;
+        mp3file->indexed_samples += samples;
+        for (int i = 0; i < sync_count; i++)
+        {
+            mp3_add_sync_frame(mp3file, syncs[i]);
+        }
+        al_broadcast_cond(mp3file->index_cond);
+        al_unlock_mutex(mp3file->index_mutex);
+    }
 
-                bytes = (stream->spl.spl_data.len) *
-                        al_get_channel_count(stream->spl.spl_data.chan_conf) *
-                        al_get_audio_depth_size(stream->spl.spl_data.depth);
+    /* mp3_build_index:
+     *  Walks every frame header from scan_offset on (the first frame, or
+     *  where an earlier scan of the file stopped), reading 'f' through a
+     *  buffer of its own, and publishes frame offsets and sync points in
+     *  batches. Frames are only parsed, not decoded. Returns false if it was
+     *  stopped early; scan_offset then says where to continue.
+     */
+    static bool mp3_build_index(MP3FILE *mp3file, ALLEGRO_FILE *f)
+    {
+        enum { BATCH = 256 };
+        int64_t batch[BATCH];
+        int batch_count = 0;
+        int64_t batch_samples = 0;
+        int syncs[BATCH];
+        int sync_count = 0;
+        int frames = mp3file->num_frames;
+        int last_main_data_bytes = mp3file->scan_main_data_bytes; /* of the previous frame */
 
-                stream_mutex = maybe_lock_mutex(stream->spl.mutex);
-                bytes_written = stream->feeder(stream, fragment, bytes);
-                maybe_unlock_mutex(stream_mutex);
+        mp3dec_t dec;
+        mp3dec_init(&dec);
+        uint8_t *owned = NULL;
+        const uint8_t *buffer = NULL;
+        int64_t buffer_offset = mp3file->scan_offset;
+        size_t buffer_len = 0;
+        size_t pos = 0;
+        size_t released = 0; /* mapped pages before buffer + released are dropped */
+        bool eof = true;
+        if (mp3file->map)
+        {
+            /* The whole file is one buffer; nothing to refill. */
+            buffer = mp3file->map + buffer_offset;
+            buffer_len = (size_t)(mp3file->file_size - buffer_offset);
+        }
+        else
+        {
+            owned = (uint8_t *)al_malloc(MP3_INPUT_CHUNK);
+            buffer = owned;
+            eof = !owned || !al_fseek(f, buffer_offset, ALLEGRO_SEEK_SET);
+        }
 
-                if (stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_ONEDIR)
-                {
-                    /* Keep rewinding until the fragment is filled. */
-                    while (bytes_written < bytes &&
-                           stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_ONEDIR)
-                    {
-                        size_t bw;
-                        al_rewind_audio_stream((ALLEGRO_AUDIO_STREAM *)stream);
-                        stream_mutex = maybe_lock_mutex(stream->spl.mutex);
-                        bw = stream->feeder(stream, fragment + bytes_written,
-                                            bytes - bytes_written);
-                        bytes_written += bw;
-                        maybe_unlock_mutex(stream_mutex);
-                    }
-                }
-                else if (bytes_written < bytes)
-                {
-                    /* Fill the rest of the fragment with silence. */
-                    int silence_samples = (bytes - bytes_written) /
-                                          (al_get_channel_count(stream->spl.spl_data.chan_conf) *
-                                           al_get_audio_depth_size(stream->spl.spl_data.depth));
-                    al_fill_silence(fragment + bytes_written, silence_samples,
-                                    stream->spl.spl_data.depth, stream->spl.spl_data.chan_conf);
-                }
+        while (buffer)
+        {
+            al_lock_mutex(mp3file->index_mutex);
+            const bool quit = mp3file->quit_index;
+            al_unlock_mutex(mp3file->index_mutex);
+            if (quit)
+            {
+                break;
+            }
 
-                if (!al_set_audio_stream_fragment((ALLEGRO_AUDIO_STREAM *)stream, fragment))
-                {
-                    continue;
-                }
+            if (!eof && buffer_len - pos < MP3_INPUT_LOOKAHEAD)
+            {
+                memmove(owned, owned + pos, buffer_len - pos);
+                buffer_offset += pos;
+                buffer_len -= pos;
+                pos = 0;
+                const size_t got = al_fread(f, owned + buffer_len, MP3_INPUT_CHUNK - buffer_len);
+                buffer_len += got;
+                eof = got == 0 || buffer_offset + (int64_t)buffer_len >= mp3file->file_size;
+            }
+            if (pos >= buffer_len)
+            {
+                break;
+            }
 
-                /* The streaming source doesn't feed any more, so drain the stream.
-                 * Don't quit in case the user decides to seek and then restart the
-                 * stream. */
-                if (bytes_written != bytes &&
-                    (stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_ONCE ||
-                     stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_LOOP_ONCE))
+            mp3dec_frame_info_t frame_info;
+            const int length = (int)std::min(buffer_len - pos, MP3_INPUT_CHUNK);
+            const int samples = mp3dec_decode_frame(&dec, buffer + pos, length, NULL, &frame_info);
+            if (frame_info.frame_bytes == 0)
+            {
+                break;
+            }
+            if (samples > 0)
+            {
+                int main_data_begin = 0;
+                int main_data_bytes = -1;
+                if (mp3_layer3_reservoir(buffer + pos + frame_info.frame_offset,
+                                         frame_info.frame_bytes - frame_info.frame_offset,
+                                         &main_data_begin, &main_data_bytes) &&
+                    last_main_data_bytes >= 0 && mp3_is_sync_frame(last_main_data_bytes, main_data_begin))
                 {
-                    /* Why not al_drain_audio_stream? We don't want to block on draining
-                     * because the user might adjust the stream loop points and restart
-                     * the stream. */
-                    stream->is_draining = true;
-
-                    if (!finished_event_sent)
-                    {
-                        ALLEGRO_EVENT fin_event;
-                        fin_event.user.type = ALLEGRO_EVENT_AUDIO_STREAM_FINISHED;
-                        fin_event.user.timestamp = al_get_time();
-                        al_emit_user_event(&stream->spl.es, &fin_event, NULL);
-                        finished_event_sent = true;
-                    }
+                    syncs[sync_count++] = frames - 1;
                 }
-                else
+                last_main_data_bytes = main_data_bytes;
+                frames++;
+
+                batch[batch_count++] = buffer_offset + (int64_t)pos + frame_info.frame_offset;
+                batch_samples += samples;
+                if (batch_count == BATCH)
                 {
-                    finished_event_sent = false;
+                    mp3_append_offsets(mp3file, batch, batch_count, batch_samples, syncs, sync_count);
+                    batch_count = 0;
+                    batch_samples = 0;
+                    sync_count = 0;
                 }
             }
-            else if (event.type == _KCM_STREAM_FEEDER_QUIT_EVENT_TYPE)
-            {
-                ALLEGRO_EVENT fin_event;
-                stream->quit_feed_thread = true;
-
-                fin_event.user.type = ALLEGRO_EVENT_AUDIO_STREAM_FINISHED;
-                fin_event.user.timestamp = al_get_time();
-                al_emit_user_event(&stream->spl.es, &fin_event, NULL);
-            }
-            if (prefill)
+            /* Otherwise this only skipped junk (a stray tag, garbage) before a frame. */
+            pos += frame_info.frame_bytes;
+#ifdef MP3_HAVE_MMAP
+            if (mp3file->map && pos - released >= (size_t)(4 * MP3_MAP_PREFETCH))
             {
-                al_lock_mutex(stream->feed_thread_started_mutex);
-                stream->feed_thread_started = true;
-                al_broadcast_cond(stream->feed_thread_started_cond);
-                al_unlock_mutex(stream->feed_thread_started_mutex);
+                mp3_release_mapped(mp3file, buffer_offset + (int64_t)released, buffer_offset + (int64_t)pos);
+                released = pos;
             }
-            prefill = false;
+#endif
         }
+        al_free(owned);
 
-        al_destroy_event_queue(queue);
+        if (batch_count > 0)
+        {
+            mp3_append_offsets(mp3file, batch, batch_count, batch_samples, syncs, sync_count);
+        }
 
-        return NULL;
+        al_lock_mutex(mp3file->index_mutex);
+        const bool finished = !mp3file->quit_index;
+        if (finished && !mp3file->length_from_tag)
+        {
+            mp3file->file_samples = mp3file->indexed_samples;
+        }
+        mp3file->scan_offset = buffer_offset + (int64_t)pos;
+        mp3file->scan_main_data_bytes = last_main_data_bytes;
+        mp3file->index_complete = true;
+        al_broadcast_cond(mp3file->index_cond);
+        al_unlock_mutex(mp3file->index_mutex);
+        return finished;
     }
 
-    void _al_acodec_start_feed_thread(AUDIO_STREAM *stream)
+    /* mp3_load_cached_index:
+     *  Fills in the seek index from the on-disk cache, thinned to this file's
+     *  budget if it was stored under a larger one. Entries that do not start
+     *  at the first frame found in the file are ignored. An entry from a scan
+     *  that was interrupted leaves index_complete unset, and the scan
+     *  continues from where it stopped.
+     */
+    static bool mp3_load_cached_index(MP3FILE *mp3file)
     {
-        stream->feed_thread = al_create_thread(_al_kcm_feed_stream, stream);
-        stream->feed_thread_started_cond = al_create_cond();
-        stream->feed_thread_started_mutex = al_create_mutex();
-        al_start_thread(stream->feed_thread);
+        FrameIndex index;
+        if (!FrameIndexCache::load(mp3file->path, mp3file->file_size, index) ||
+            index.frame_offsets.front() != mp3file->first_frame_offset)
+        {
+            return false;
+        }
+
+        const int count = (int)index.frame_offsets.size();
+        const int sync_count = (int)index.sync_frames.size();
+        int64_t *offsets = (int64_t *)al_malloc(sizeof(int64_t) * count);
+        int *syncs = (int *)al_malloc(sizeof(int) * std::max(sync_count, 1));
+        if (!offsets || !syncs)
+        {
+            al_free(offsets);
+            al_free(syncs);
+            return false;
+        }
+        memcpy(offsets, index.frame_offsets.data(), sizeof(int64_t) * count);
+        memcpy(syncs, index.sync_frames.data(), sizeof(int) * sync_count);
+
+        mp3file->frame_offsets = offsets;
+        mp3file->num_frame_offsets = count;
+        mp3file->frame_offset_capacity = count;
+        mp3file->num_frames = index.frame_count;
+        mp3file->index_stride = index.stride;
+        mp3file->sync_frames = syncs;
+        mp3file->num_sync_frames = sync_count;
+        mp3file->sync_frame_capacity = std::max(sync_count, 1);
+        while (mp3file->num_frame_offsets > mp3file->max_index_entries ||
+               mp3file->num_sync_frames > mp3file->max_index_entries)
+        {
+            mp3_thin_index(mp3file);
+        }
 
-        /* Need to wait for the thread to start, otherwise the quit event may be
-         * sent before the event source is registered with the queue.
-         *
-         * This also makes the pre-fill system thread safe, as it needs to operate
-         * before the mutexes are set up.
-         */
-        al_lock_mutex(stream->feed_thread_started_mutex);
-        while (!stream->feed_thread_started)
+        mp3file->indexed_samples = index.total_samples;
+        if (index.resume_offset > 0)
+        {
+            mp3file->scan_offset = index.resume_offset;
+            mp3file->scan_main_data_bytes = index.resume_main_data_bytes;
+            return true;
+        }
+        if (!mp3file->length_from_tag)
         {
-            al_wait_cond(stream->feed_thread_started_cond, stream->feed_thread_started_mutex);
+            mp3file->file_samples = index.total_samples;
         }
-        al_unlock_mutex(stream->feed_thread_started_mutex);
+        mp3file->index_complete = true;
+        return true;
     }
 
-    void _al_acodec_stop_feed_thread(AUDIO_STREAM *stream)
+    /* Called by the index thread once its scan ends, when the index no
+     * longer changes. A scan that was stopped early is stored too, so the
+     * next open of a long file picks it up where it left off. */
+    static void mp3_store_index(MP3FILE *mp3file, bool finished)
     {
-        ALLEGRO_EVENT quit_event;
+        FrameIndex index;
+        index.frame_offsets.assign(mp3file->frame_offsets, mp3file->frame_offsets + mp3file->num_frame_offsets);
+        index.sync_frames.assign(mp3file->sync_frames, mp3file->sync_frames + mp3file->num_sync_frames);
+        index.stride = mp3file->index_stride;
+        index.frame_count = mp3file->num_frames;
+        index.total_samples = mp3file->indexed_samples;
+        if (!finished)
+        {
+            index.resume_offset = mp3file->scan_offset;
+            index.resume_main_data_bytes = mp3file->scan_main_data_bytes;
+        }
+        FrameIndexCache::store(mp3file->path, mp3file->file_size, index);
+    }
 
-        quit_event.type = _KCM_STREAM_FEEDER_QUIT_EVENT_TYPE;
-        al_emit_user_event(al_get_audio_stream_event_source((ALLEGRO_AUDIO_STREAM *)stream), &quit_event, NULL);
-        al_join_thread(stream->feed_thread, NULL);
-        al_destroy_thread(stream->feed_thread);
-        al_destroy_cond(stream->feed_thread_started_cond);
-        al_destroy_mutex(stream->feed_thread_started_mutex);
+    static void *mp3_index_thread(ALLEGRO_THREAD *self, void *arg)
+    {
+        (void)self;
+        MP3FILE *mp3file = (MP3FILE *)arg;
+        ALLEGRO_FILE *f = mp3file->map ? NULL : al_fopen(mp3file->path, "rb");
+        if (mp3file->map || f)
+        {
+            const bool finished = mp3_build_index(mp3file, f);
+            if (f)
+                al_fclose(f);
+            if (mp3file->num_frames > 0)
+            {
+                mp3_store_index(mp3file, finished);
+            }
+        }
+        else
+        {
+            /* Seeks will fail; playback from the start still works. */
+            al_lock_mutex(mp3file->index_mutex);
+            mp3file->index_complete = true;
+            al_broadcast_cond(mp3file->index_cond);
+            al_unlock_mutex(mp3file->index_mutex);
+        }
+        return NULL;
+    }
 
-        stream->feed_thread = NULL;
+    static void mp3_free(MP3FILE *mp3file)
+    {
+        if (mp3file->index_thread)
+        {
+            al_lock_mutex(mp3file->index_mutex);
+            mp3file->quit_index = true;
+            al_unlock_mutex(mp3file->index_mutex);
+            al_join_thread(mp3file->index_thread, NULL);
+            al_destroy_thread(mp3file->index_thread);
+        }
+        if (mp3file->index_cond)
+            al_destroy_cond(mp3file->index_cond);
+        if (mp3file->index_mutex)
+            al_destroy_mutex(mp3file->index_mutex);
+        if (mp3file->fh)
+            al_fclose(mp3file->fh);
+#ifdef MP3_HAVE_MMAP
+        if (mp3file->map)
+            munmap((void *)mp3file->map, (size_t)mp3file->file_size);
+#endif
+        al_free(mp3file->frame_offsets);
+        al_free(mp3file->sync_frames);
+        al_free(mp3file->input);
+        al_free(mp3file->path);
+        al_free(mp3file);
     }
 
-    ALLEGRO_AUDIO_STREAM *_al_load_mp3_audio_stream_f(ALLEGRO_FILE *f, size_t buffer_count, unsigned int samples)
+    /* mp3_map_file:
+     *  Maps 'path' read-only for zero-copy decoding. Only regular files
+     *  that match the size of the open handle qualify; everything else
+     *  (pipes, devices, other platforms, failures) uses the buffered path.
+     */
+    static bool mp3_map_file(MP3FILE *mp3file, const char *path)
+    {
+#ifdef MP3_HAVE_MMAP
+        if (!path || (uint64_t)mp3file->file_size > (uint64_t)SIZE_MAX)
+        {
+            return false;
+        }
+        const int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        void *map = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size == mp3file->file_size)
+        {
+            map = mmap(NULL, (size_t)mp3file->file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd); /* the mapping keeps the file referenced */
+        if (map == MAP_FAILED)
+        {
+            return false;
+        }
+        madvise(map, (size_t)mp3file->file_size, MADV_SEQUENTIAL);
+        mp3file->map = (const uint8_t *)map;
+        return true;
+#else
+        (void)mp3file;
+        (void)path;
+        return false;
+#endif
+    }
+
+    /* mp3_open:
+     *  Playback can start as soon as the first frame is found: the file is
+     *  read through a MP3_INPUT_CHUNK window as it plays, and the seek index
+     *  is loaded from the index cache or built on a second handle opened
+     *  from 'path' in the background. Without a path the index is built up
+     *  front on 'f', still in chunks.
+     *  'memory_budget' bounds the read window plus the seek index, whatever
+     *  the length of the file; see mp3_thin_index.
+     *  On success the returned file owns 'f'.
+     */
+    static MP3FILE *mp3_open(ALLEGRO_FILE *f, const char *path, size_t memory_budget)
     {
         MP3FILE *mp3file = (MP3FILE *)al_calloc(sizeof(MP3FILE), 1);
         mp3dec_init(&mp3file->dec);
+        const size_t index_budget = memory_budget > 2 * MP3_INPUT_CHUNK ? memory_budget - MP3_INPUT_CHUNK : MP3_INPUT_CHUNK;
+        mp3file->index_stride = 1;
+        mp3file->max_index_entries = (int)std::min<size_t>(index_budget / (sizeof(int64_t) + sizeof(int)), INT32_MAX / 2);
 
         /* Variables declared up front to avoid crossing initializations with goto. */
-        int frame_offset_capacity = 0;
-        int offset_so_far = 0;
-        size_t readbytes = 0;
-        AUDIO_STREAM *stream = NULL;
+        int available = 0;
+        const uint8_t *head = NULL;
+        mp3dec_frame_info_t frame_info;
+        int first_samples = 0;
+        int tag_frame_bytes = 0;
+
+        mp3file->fh = f;
+        mp3file->input_offset = -1;
+        mp3file->index_mutex = al_create_mutex();
+        mp3file->index_cond = al_create_cond();
+        if (!mp3file->index_mutex || !mp3file->index_cond)
+        {
+            goto failure;
+        }
 
         /* Read our file size. */
         mp3file->file_size = al_fsize(f);
-        if (mp3file->file_size == -1)
+        if (mp3file->file_size <= 0)
         {
             goto failure;
         }
+        if (!mp3_map_file(mp3file, path))
+        {
+            mp3file->input = (uint8_t *)al_malloc(MP3_INPUT_CHUNK);
+            if (!mp3file->input)
+            {
+                goto failure;
+            }
+        }
 
-        /* Allocate buffer and read all the file. */
-        mp3file->file_buffer = (uint8_t *)al_malloc(mp3file->file_size);
-        readbytes = al_fread(f, mp3file->file_buffer, mp3file->file_size);
-        if (readbytes != (size_t)mp3file->file_size)
+        head = mp3_fill_input(mp3file, 0, &available);
+        if (!head)
         {
             goto failure;
         }
+        mp3file->first_frame_offset = std::min(mp3_id3v2_size(head, available), mp3file->file_size);
 
-        /* Go through all the frames, to build the offset table. */
+        /* Find the first frame and grab the file information from it. */
         while (true)
         {
-            if (mp3file->num_frames + 1 > frame_offset_capacity)
+            first_samples = mp3_decode_at(mp3file, mp3file->first_frame_offset, NULL, &frame_info);
+            if (frame_info.frame_bytes == 0)
             {
-                frame_offset_capacity = mp3file->num_frames * 3 / 2 + 1;
-                mp3file->frame_offsets = (int *)al_realloc(mp3file->frame_offsets,
-                                                           sizeof(int) * frame_offset_capacity);
+                goto failure;
             }
-            mp3dec_frame_info_t frame_info;
-            int frame_samples = mp3dec_decode_frame(&mp3file->dec,
-                                                    mp3file->file_buffer + offset_so_far,
-                                                    mp3file->file_size - offset_so_far, NULL, &frame_info);
-            if (frame_samples == 0)
+            if (first_samples > 0)
             {
-                if (mp3file->num_frames == 0)
-                {
-                    goto failure;
-                }
-                else
-                {
-                    break;
-                }
+                mp3file->first_frame_offset += frame_info.frame_offset;
+                break;
             }
-            /* Grab the file information from the first frame. */
-            if (offset_so_far == 0)
+            mp3file->first_frame_offset += frame_info.frame_bytes;
+        }
+        mp3file->chan_conf = mp3_channel_conf(frame_info.channels);
+        mp3file->channels = frame_info.channels;
+        mp3file->freq = frame_info.hz;
+        mp3file->frame_samples = first_samples;
+        mp3file->bitrate_kbps = frame_info.bitrate_kbps;
+
+        /* A VBR tag frame gives the exact length up front; audio starts after it. */
+        head = mp3_fill_input(mp3file, mp3file->first_frame_offset, &available);
+        tag_frame_bytes = frame_info.frame_bytes - frame_info.frame_offset;
+        if (head && frame_info.layer == 3 && tag_frame_bytes <= available &&
+            mp3_parse_vbr_tag(mp3file, head, tag_frame_bytes))
+        {
+            mp3file->first_frame_offset += tag_frame_bytes;
+        }
+        else if (mp3file->bitrate_kbps > 0)
+        {
+            /* Until the index is done, assume a constant bitrate. */
+            const double audio_bytes = (double)(mp3file->file_size - mp3file->first_frame_offset);
+            mp3file->file_samples = (int64_t)(audio_bytes * 8.0 / (mp3file->bitrate_kbps * 1000.0) * mp3file->freq);
+        }
+
+        mp3file->scan_offset = mp3file->first_frame_offset;
+        mp3file->scan_main_data_bytes = -1;
+        if (path)
+        {
+            const size_t path_len = strlen(path) + 1;
+            mp3file->path = (char *)al_malloc(path_len);
+            memcpy(mp3file->path, path, path_len);
+            if (!mp3_load_cached_index(mp3file) || !mp3file->index_complete)
             {
-                mp3file->chan_conf = _al_count_to_channel_conf(frame_info.channels);
-                mp3file->freq = frame_info.hz;
-                mp3file->frame_samples = frame_samples;
+                mp3file->index_thread = al_create_thread(mp3_index_thread, mp3file);
             }
-
-            mp3file->frame_offsets[mp3file->num_frames] = offset_so_far;
-            mp3file->num_frames += 1;
-            offset_so_far += frame_info.frame_bytes;
-            mp3file->file_samples += frame_samples;
         }
-        mp3file->loop_end = (double)mp3file->file_samples * mp3file->freq;
-
-        stream = (mp3streaming::AUDIO_STREAM *)al_create_audio_stream(
-            buffer_count, samples, mp3file->freq,
-            _al_word_size_to_depth_conf(sizeof(mp3d_sample_t)),
-            mp3file->chan_conf);
-        if (!stream)
+        if (mp3file->index_thread)
         {
-            goto failure;
+            al_start_thread(mp3file->index_thread);
         }
-
-        stream->extra = mp3file;
-        stream->feeder = mp3_stream_update;
-        stream->unload_feeder = mp3_stream_close;
-        stream->rewind_feeder = mp3_stream_rewind;
-        stream->seek_feeder = mp3_stream_seek;
-        stream->get_feeder_position = mp3_stream_get_position;
-        stream->get_feeder_length = mp3_stream_get_length;
-        stream->set_feeder_loop = mp3_stream_set_loop;
-
-        mp3_stream_rewind(stream);
-
-        _al_acodec_start_feed_thread(stream);
-
-        return (ALLEGRO_AUDIO_STREAM *)stream;
+        else if (!mp3file->index_complete)
+        {
+            mp3_build_index(mp3file, f);
+            mp3file->input_offset = -1; /* the scan moved the file position */
+            mp3file->input_len = 0;
+        }
+        mp3_stream_seek(mp3file, 0.0);
+        return mp3file;
     failure:
-        al_free(mp3file->frame_offsets);
-        al_free(mp3file->file_buffer);
-        al_free(mp3file);
+        mp3file->fh = NULL; /* still the caller's */
+        mp3_free(mp3file);
         return NULL;
     }
 
-    ALLEGRO_AUDIO_STREAM *_al_load_mp3_audio_stream(const char *filename, size_t buffer_count, unsigned int samples)
+    /* mp3_open_file:
+     *  Opens 'filename' for decoding; NULL if it is not a readable MP3.
+     */
+    static MP3FILE *mp3_open_file(const char *filename, size_t memory_budget)
     {
-        ALLEGRO_FILE *f;
-        ALLEGRO_AUDIO_STREAM *stream;
-
-        f = al_fopen(filename, "rb");
+        ALLEGRO_FILE *f = al_fopen(filename, "rb");
         if (!f)
         {
             return NULL;
         }
 
-        stream = _al_load_mp3_audio_stream_f(f, buffer_count, samples);
-        /* We load the entire file into memory. */
-        al_fclose(f);
-
-        return stream;
-    }
-
-    // Implementation: check for ID3 header or MP3 frame sync (0xFF 0xE0..0xFF)
-    static bool mp3_sample_identifier(ALLEGRO_FILE *f)
-    {
-        if (!f)
-            return false;
-
-        // Read the first 3 bytes to look for "ID3"
-        char header[3];
-        size_t read_bytes = al_fread(f, header, sizeof(header));
-        if (read_bytes < sizeof(header))
-            return false;
-
-        return (header[0] == 'I' && header[1] == 'D' && header[2] == '3');
-    }
-
-    void addMP3Support()
-    {
-        // Register our identifier for .mp3 files
-        auto result = al_register_sample_identifier(".mp3", mp3_sample_identifier);
-        std::cout << "Sample identifier registration result: " << result << "\n";
-        al_register_audio_stream_loader(".mp3", _al_load_mp3_audio_stream);
+        /* The decoder keeps the file open and reads it as it plays. */
+        MP3FILE *mp3file = mp3_open(f, filename, memory_budget);
+        if (!mp3file)
+        {
+            al_fclose(f);
+        }
+        return mp3file;
     }
 } // namespace mp3streaming
\ No newline at end of file
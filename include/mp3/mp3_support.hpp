@@ -1,5 +1,12 @@
 #pragma once
 
+#include <cstddef>
+
 namespace mp3streaming {
+// Registers the minimp3-based decoder for .mp3 files with core::registerDecoder.
 void addMP3Support();
+
+// Memory each MP3 opened afterwards may use for its read window and seek
+// index, however long the file is. Longer files get a sparser index.
+void setMemoryBudget(size_t bytes);
 }
@@ -16,6 +16,11 @@ struct Album {
     std::shared_ptr<ui::ImageModel> cover_art_model; // Manages album art bitmap loading/caching
     std::string cover_art_mime;                      // MIME type of embedded cover art
 
+    // Album loudness normalization (see ReplayGain in song.hpp)
+    bool has_replay_gain = false;
+    float album_gain_db = 0.0f;
+    float album_peak = 0.0f;
+
     // Constructor with path only (for backward compatibility)
     Album(int id, const std::string& title, int year, const std::string& cover_image_path, int artist_id)
         : id(id), title(title), year(year), cover_image_path(cover_image_path), artist_id(artist_id),
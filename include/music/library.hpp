@@ -58,6 +58,9 @@ public:
 
     // Get random song view (returns pointer; nullptr if empty)
     const SongView* getRandomSong() const;
+
+    // Keep the in-memory copy in step with MusicDatabase::setSongResumePosition
+    void setResumePosition(int song_id, double seconds);
 private:
     std::unordered_map<int, Album> albums;
     std::unordered_map<int, Artist> artists;
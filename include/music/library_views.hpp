@@ -6,6 +6,8 @@
 #include <unordered_map>
 #include <ctime>
 
+#include "music/song.hpp"
+
 namespace music {
 struct Song;
 struct Album;
@@ -51,6 +53,9 @@ struct SongView {
     // references
     int album_id;
 
+    ReplayGain replay_gain;
+    double resume_position = 0.0;
+
     SongView(int id, const std::string& title, const std::string& album,
              const std::string& artist, const std::string& album_artist, const std::string& genre,
              const std::string& comment, int track_number, int disc,
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <deque>
+#include <optional>
 #include <random>
 #include <vector>
 
@@ -32,6 +33,27 @@ struct PlayQueue {
         return song_ids[current_index];
     }
 
+    // return the id that next() would advance to, without advancing. Returns -1
+    // if there is no next song. In shuffle mode the random pick is made here and
+    // reused by the following next(), so a preloaded song is the one that plays.
+    int peekNext() {
+        if (song_ids.empty()) return -1;
+
+        if (is_shuffled) {
+            if (!shuffled_next_index || *shuffled_next_index >= song_ids.size()) {
+                shuffled_next_index = randomIndex();
+            }
+            return song_ids[*shuffled_next_index];
+        }
+        if (current_index + 1 < song_ids.size()) {
+            return song_ids[current_index + 1];
+        }
+        if (is_repeating) {
+            return song_ids[0];
+        }
+        return -1;
+    }
+
     // advance to next song and return its id. Returns -1 if there is no next song.
     int next() {
         if (song_ids.empty()) return -1;
@@ -40,10 +62,11 @@ struct PlayQueue {
         played_indices.push_back(current_index);
         
         if (is_shuffled) {
-            // pick a random index
-            std::uniform_int_distribution<size_t> dist(0, song_ids.size() - 1);
-            static thread_local std::mt19937 rng(std::random_device{}());
-            current_index = dist(rng);
+            // use the pick made by peekNext(), if any, otherwise pick now
+            current_index = (shuffled_next_index && *shuffled_next_index < song_ids.size())
+                ? *shuffled_next_index
+                : randomIndex();
+            shuffled_next_index.reset();
             return song_ids[current_index];
         }
         if (current_index + 1 < song_ids.size()) {
@@ -61,6 +84,7 @@ struct PlayQueue {
     // uses play history to return to previously played songs.
     int previous() {
         if (song_ids.empty()) return -1;
+        shuffled_next_index.reset();
         
         // if we have play history, go back to the last played index
         if (!played_indices.empty()) {
@@ -84,6 +108,7 @@ struct PlayQueue {
     void clear() {
         song_ids.clear();
         played_indices.clear();
+        shuffled_next_index.reset();
         current_index = 0;
         context_type = PlaybackContextType::Individual;
         context_id = -1;
@@ -101,6 +126,12 @@ struct PlayQueue {
         is_repeating = on;
     }
 
+    size_t randomIndex() const {
+        std::uniform_int_distribution<size_t> dist(0, song_ids.size() - 1);
+        static thread_local std::mt19937 rng(std::random_device{}());
+        return dist(rng);
+    }
+
     std::deque<int> song_ids;
     std::deque<size_t> played_indices;  // track indices that were actually played for reverse navigation
     size_t current_index;
@@ -108,6 +139,7 @@ struct PlayQueue {
     bool is_repeating;
     PlaybackContextType context_type;   // Track what kind of playback context we're in
     int context_id;                      // Track the album/playlist ID (or -1 for individual songs)
+    std::optional<size_t> shuffled_next_index; // shuffle pick made by peekNext()
 };
 } // namespace music
  
\ No newline at end of file
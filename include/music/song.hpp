@@ -2,6 +2,17 @@
 #include <string>
 
 namespace music {
+// Loudness normalization values computed at scan time (ReplayGain 2.0,
+// referenced to -18 LUFS). Peaks are linear sample peaks.
+struct ReplayGain {
+    bool has_track = false;
+    float track_gain_db = 0.0f;
+    float track_peak = 0.0f;
+    bool has_album = false;
+    float album_gain_db = 0.0f;
+    float album_peak = 0.0f;
+};
+
 struct Song {
     int id;                 // Unique identifier for the song
     std::string filename; // Filename or path to the song file
@@ -10,6 +21,8 @@ struct Song {
     int track_number;
     std::string comment;
     int duration; // Duration of the song in seconds
+    ReplayGain replay_gain; // track values only; album values live on Album
+    double resume_position = 0.0; // seconds; only set for long files left part way
 
     Song(int id, const std::string& filename, const std::string& title, int album_id,
          int track_number, const std::string& comment, int duration)
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <cstdint>
+#include <vector>
 
 struct ALLEGRO_CONFIG;
 
@@ -37,8 +38,21 @@ public:
     uint64_t getDiscordApplicationId() const;
     int getDisplayWidth() const;
     int getDisplayHeight() const;
+    bool getShaderHotReload() const;     // rebuild shaders when their files change
     int getVolumePercent() const;
     void setVolumePercent(int percent);
+    int getPreloadSeconds() const;
+    int getCrossfadeSeconds() const;
+    std::string getReplayGainMode() const; // "track", "album" or "off"
+    int getSampleRate() const;            // 0 = automatic
+    std::string getMixerDepth() const;    // "float32" or "int16"
+    std::string getResampler() const;     // "linear", "cubic" or "polyphase"
+    int getOutputLatencyMs() const;       // added to the mixer's own latency
+    int getStreamMemoryKb() const;        // per open MP3: read window plus seek index
+    bool getEqualizerEnabled() const;
+    float getEqualizerPreampDb() const;
+    std::vector<float> getEqualizerGains() const; // dB per band, comma separated in the file
+    bool getAnalyzeLoudness() const;
 
 private:
     ALLEGRO_CONFIG* config;
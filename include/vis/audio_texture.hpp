@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <allegro5/allegro.h>
+
+namespace core {
+struct SpectrumSnapshot;
+}
+
+namespace vis {
+
+// The latest audio window as a small texture, so shaders can draw waveforms
+// and bars themselves instead of the CPU building geometry per sample.
+//
+// Four values are packed per RGBA texel: sample i of a row sits in texel
+// i / 4, component i % 4. Row 0 holds mono samples, rows 1 and 2 left and
+// right, stored as s * 0.5 + 0.5; row 3 holds the spectrum band levels
+// (0 to 1). Float texels where the display supports them, 8-bit otherwise.
+class AudioTexture {
+public:
+    enum Row {
+        Mono = 0,
+        Left = 1,
+        Right = 2,
+        Spectrum = 3,
+    };
+
+    static constexpr int kWidth = 2048;
+    static constexpr int kRows = 4;
+    static constexpr std::size_t kMaxValues = kWidth * 4; // per row
+
+    AudioTexture() = default;
+    ~AudioTexture();
+
+    AudioTexture(const AudioTexture&) = delete;
+    AudioTexture& operator=(const AudioTexture&) = delete;
+
+    // Creates the texture on first use. Returns false if the display cannot
+    // make one; callers then keep drawing on the CPU.
+    bool ensure();
+
+    // Replaces the texture's contents; rows past the newest kMaxValues values
+    // are cut from the front. Empty vectors and a null spectrum leave a row empty.
+    void upload(const std::vector<float>& mono, const std::vector<float>& left,
+                const std::vector<float>& right, const core::SpectrumSnapshot* spectrum);
+
+    // Null until ensure() succeeds. Shaders get both through
+    // Shader::setAudio (vis::AudioUniforms::texture).
+    ALLEGRO_BITMAP* getBitmap() const { return bitmap; }
+    std::size_t getCount(Row row) const { return counts[row]; }
+
+    // Writes `count` values of `row` into one texture line the way upload()
+    // does, as float texels or, with `floatTexels` false, 8-bit ones.
+    static void packRow(Row row, const float* values, std::size_t count, bool floatTexels, void* line);
+
+private:
+    ALLEGRO_BITMAP* bitmap = nullptr;
+    bool failed = false;
+    bool floatTexels = false;
+    std::size_t counts[kRows] = {};
+};
+
+} // namespace vis
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <allegro5/allegro_primitives.h>
+
+namespace vis {
+
+// Vertices of the polar waveform: one per sample around a closed loop, at
+// baseRadius + |sample| * maxRadius from the center. The angle tables are
+// built once per sample count, so a frame only recomputes the radii.
+class PolarLoop {
+public:
+    // Writes `count` vertices to `out`, for drawing as a line loop.
+    void build(const float* samples, std::size_t count, float centerX, float centerY, float baseRadius,
+               float maxRadius, ALLEGRO_COLOR color, ALLEGRO_VERTEX* out);
+
+private:
+    std::vector<float> cosTable;
+    std::vector<float> sinTable;
+};
+
+} // namespace vis
@@ -5,12 +5,46 @@
 
 namespace vis {
 
+class AudioTexture;
+
+// A uniform of a Shader, looked up by name once and then set by location.
+// `name` must outlive the handle (string literals in practice). The location
+// belongs to the program it was resolved against; after the shader is
+// rebuilt the handle resolves again on its next use.
+class Uniform {
+public:
+    explicit Uniform(const char* name) : name(name) {}
+
+    const char* getName() const { return name; }
+
+private:
+    friend class Shader;
+
+    const char* name;
+    int location = -1;
+    unsigned link = 0;
+};
+
+// The audio values most visualization shaders read each frame, set in one
+// call by Shader::setAudio: time, audio_rms, audio_peak, audio_transient and,
+// with a texture, the samples and spectrum bands of vis::AudioTexture.
+struct AudioUniforms {
+    float time = 0.0f;
+    float rms = 0.0f;
+    float peak = 0.0f;
+    float transient = 0.0f;
+    float beatPulse = 0.0f; // 1 on a tracked beat, decaying until the next
+    const AudioTexture* texture = nullptr;
+    int textureUnit = 1;
+};
+
 class Shader {
 public:
     Shader();
     Shader(const std::string& vertexSource, const std::string& fragmentSource, bool fromFile = false);
     ~Shader();
 
+    // On failure the previously loaded program, if any, stays in place.
     bool load(const std::string& vertexSource, const std::string& fragmentSource, bool fromFile = false);
     void use() const;
 
@@ -22,12 +56,42 @@ public:
     bool setFloatVector(const char* name, int num_components, const float* values, int count);
     bool setTexture(const char* name, ALLEGRO_BITMAP* texture, int unit);
     bool setMatrix(const char* name, const ALLEGRO_TRANSFORM* matrix);
+
+    // Cached-location setters. Allegro's by-name setters above look the
+    // location up on every call; these do it once per link.
+    Uniform uniform(const char* name);
+    bool set(Uniform& uniform, float value);
+    bool set(Uniform& uniform, int value);
+    bool setVector(Uniform& uniform, int num_components, const float* values, int count);
+    // Skips programs without the sampler, but binds it by name.
+    bool setTexture(Uniform& uniform, ALLEGRO_BITMAP* texture, int unit);
+
+    // Sets every uniform in `audio` the program uses; the rest are skipped.
+    bool setAudio(const AudioUniforms& audio);
 private:
+    struct AudioHandles {
+        Uniform time{"time"};
+        Uniform rms{"audio_rms"};
+        Uniform peak{"audio_peak"};
+        Uniform transient{"audio_transient"};
+        Uniform beatPulse{"beat_pulse"};
+        Uniform texture{"audio_tex"};
+        Uniform textureSize{"audio_tex_size"};
+        Uniform textureOffset{"audio_tex_offset"};
+        Uniform monoCount{"mono_count"};
+        Uniform leftCount{"left_count"};
+        Uniform rightCount{"right_count"};
+        Uniform bandCount{"band_count"};
+    };
+
     bool isCurrentShader() const;
+    bool resolve(Uniform& uniform) const;
     bool loadFromSource(const std::string& vertexSource, const std::string& fragmentSource);
     bool loadFromFile(const std::string& vertexPath, const std::string& fragmentPath);
 
     ALLEGRO_SHADER* shader = nullptr;
+    unsigned linkSerial = 0; // 0 until built; new on every successful build
+    AudioHandles audioHandles;
 };
 
 };
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vis {
+
+class Shader;
+
+// Every visualization shader program, compiled together up front so that
+// neither startup of a visualization nor switching to one stalls on a
+// compile. With hot reload on, programs are rebuilt when their files under
+// assets/shaders change; a program that fails to compile keeps its last
+// working build, and one that never built leaves its visualization on the
+// CPU path.
+class ShaderCache {
+public:
+    enum class Program : std::size_t {
+        PolarWaveform = 0,        // CPU-built loop, shaders/pixel.glsl
+        MirrorBars = 1,           // CPU-built bars, shaders/rainbow.glsl
+        DualEchoFeedback = 2,     // shaders/dual_echo_feedback.glsl
+        PolarWaveformTexture = 3, // from vis::AudioTexture
+        MirrorBarsTexture = 4,    // from vis::AudioTexture
+    };
+
+    ShaderCache();
+    ~ShaderCache();
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    // Compiles every program. Needs the display's context to be current.
+    void compileAll();
+
+    // Non-null after compileAll(), and the same object for the cache's
+    // lifetime: reloads rebuild it in place. Check isLoaded() before use.
+    Shader* get(Program program) const;
+
+    // Starts or stops watching the shader files. Linux only (inotify);
+    // elsewhere enabling it just logs that it is unavailable.
+    void setHotReload(bool enabled);
+    bool getHotReload() const { return watchFd >= 0; }
+
+    // Rebuilds the programs whose files changed since the last call. Call
+    // once per frame with the display's context current; without hot
+    // reload, or with nothing changed, this is a single non-blocking read.
+    void poll();
+
+private:
+    static constexpr std::size_t kProgramCount = 5;
+
+    struct Entry {
+        const char* vertexAsset;
+        const char* fragmentAsset;
+        std::unique_ptr<Shader> shader;
+    };
+
+    bool compile(Entry& entry);
+
+    std::array<Entry, kProgramCount> entries;
+    int watchFd = -1;
+    std::vector<std::pair<int, std::string>> watches; // watch descriptor, directory
+};
+
+} // namespace vis
@@ -16,8 +16,10 @@ std::unique_ptr<ui::AudioVisualizerView::Visualization> createDualEchoWaveVisual
 // Utility used by the view to split interleaved stereo samples into left/right buffers.
 void splitInterleavedStereoSamples(const std::vector<float>& interleavedSamples, std::vector<float>& leftSamples, std::vector<float>& rightSamples);
 
-// Sample window sizes used by the visualizations and the view.
-constexpr std::size_t kPolarWaveformSampleWindow = 1024;
+// Sample window sizes used by the visualizations and the view. The polar
+// waveform is drawn from the audio texture, so its window costs no CPU
+// per sample there; it fills one texture row (vis::AudioTexture::kMaxValues).
+constexpr std::size_t kPolarWaveformSampleWindow = 8192;
 constexpr std::size_t kMirrorBarsSampleWindow = 768;
 constexpr std::size_t kDualEchoStereoSampleWindow = 1024;
 constexpr std::size_t kDualEchoMonoFallbackWindow = 512;
@@ -0,0 +1,77 @@
+#include "core/allegro_decoder.hpp"
+#include <iostream>
+#include <vector>
+#include "core/pcm_format.hpp"
+#include "mp3/audio_stream_internals.hpp"
+
+namespace core {
+namespace {
+// Kept small: al_load_audio_stream() decodes one fragment of this size before
+// returning, which the decoder then rewinds over.
+constexpr size_t kLoaderFragmentCount = 2;
+constexpr unsigned int kLoaderFragmentFrames = 1024;
+
+// Wraps a stream returned by al_load_audio_stream() that is never attached to
+// a mixer: Allegro's own feed thread parks after its one-fragment prefill, and
+// read() calls the stream's feeder directly.
+class AllegroDecoder : public Decoder {
+public:
+    explicit AllegroDecoder(ALLEGRO_AUDIO_STREAM* stream) : stream(stream) {
+        stream_depth = al_get_audio_stream_depth(stream);
+        format.frequency = al_get_audio_stream_frequency(stream);
+        format.channels = al_get_audio_stream_channels(stream);
+        format.depth = stream_depth == ALLEGRO_AUDIO_DEPTH_INT16 ? ALLEGRO_AUDIO_DEPTH_INT16 : ALLEGRO_AUDIO_DEPTH_FLOAT32;
+        stream_frame_size = al_get_channel_count(format.channels) * al_get_audio_depth_size(stream_depth);
+        length = al_get_audio_stream_length_secs(stream);
+    }
+
+    ~AllegroDecoder() override {
+        al_destroy_audio_stream(stream);
+    }
+
+    size_t read(void* dst, size_t frames) override {
+        auto* internals = reinterpret_cast<mp3streaming::AUDIO_STREAM*>(stream);
+        if (stream_depth == format.depth) {
+            return internals->feeder(internals, dst, frames * stream_frame_size) / stream_frame_size;
+        }
+
+        convert_buffer.resize(frames * stream_frame_size);
+        const size_t read = internals->feeder(internals, convert_buffer.data(), convert_buffer.size()) / stream_frame_size;
+        pcmToFloat(convert_buffer.data(), static_cast<float*>(dst), read * al_get_channel_count(format.channels), stream_depth);
+        return read;
+    }
+
+    bool seek(double seconds) override {
+        return al_seek_audio_stream_secs(stream, seconds);
+    }
+
+    double getLength() const override { return length; }
+
+private:
+    ALLEGRO_AUDIO_STREAM* stream;
+    ALLEGRO_AUDIO_DEPTH stream_depth;
+    size_t stream_frame_size = 0;
+    double length = 0.0;
+    std::vector<unsigned char> convert_buffer;
+};
+}
+
+std::unique_ptr<Decoder> openAllegroDecoder(const std::string& path) {
+    ALLEGRO_AUDIO_STREAM* loaded = al_load_audio_stream(path.c_str(), kLoaderFragmentCount, kLoaderFragmentFrames);
+    if (!loaded) {
+        return nullptr;
+    }
+
+    auto* internals = reinterpret_cast<mp3streaming::AUDIO_STREAM*>(loaded);
+    if (!internals->feeder) {
+        std::cerr << "AllegroDecoder: " << path << " has no feeder\n";
+        al_destroy_audio_stream(loaded);
+        return nullptr;
+    }
+
+    // Undo the loader's prefill so reads start at the first sample.
+    al_rewind_audio_stream(loaded);
+    return std::make_unique<AllegroDecoder>(loaded);
+}
+
+} // namespace core
@@ -15,6 +15,7 @@ bool AppState::init() {
     if (!this->config.load(util::Config::getConfigPath())) {
         std::cerr << "Warning: Could not load config file, using defaults.\n";
     }
+    mp3streaming::setMemoryBudget(static_cast<size_t>(this->config.getStreamMemoryKb()) * 1024);
 
     // update some flags
     al_set_new_bitmap_flags(ALLEGRO_MIN_LINEAR | ALLEGRO_MAG_LINEAR | ALLEGRO_VIDEO_BITMAP | ALLEGRO_MIPMAP);
@@ -49,12 +50,42 @@ bool AppState::init() {
     }
 
     // init the music engine
+    const std::string resampler = this->config.getResampler();
+    this->music_engine.configureOutput(
+        static_cast<unsigned int>(this->config.getSampleRate()),
+        this->config.getMixerDepth() == "int16" ? ALLEGRO_AUDIO_DEPTH_INT16 : ALLEGRO_AUDIO_DEPTH_FLOAT32,
+        resampler == "polyphase" ? core::ResamplerQuality::Polyphase
+            : resampler == "cubic" ? core::ResamplerQuality::Cubic
+            : core::ResamplerQuality::Linear
+    );
     if (!this->music_engine.initialize()) {
         return false; // Failed to initialize music engine
     } else {
         this->music_engine.setEventQueue(this->event_queue);
         const float startupGain = static_cast<float>(this->config.getVolumePercent()) / 100.0f;
         this->music_engine.setGain(startupGain);
+        this->music_engine.setPreloadSeconds(this->config.getPreloadSeconds());
+        this->music_engine.setCrossfadeSeconds(this->config.getCrossfadeSeconds());
+        this->music_engine.setOutputLatencyOffset(this->config.getOutputLatencyMs() / 1000.0);
+
+        core::ParametricEq& equalizer = this->music_engine.getEqualizer();
+        core::ParametricEq::Settings eq = equalizer.getSettings();
+        eq.preamp_db = this->config.getEqualizerPreampDb();
+        const std::vector<float> gains = this->config.getEqualizerGains();
+        for (size_t i = 0; i < gains.size() && i < eq.bands.size(); ++i) {
+            eq.bands[i].gain_db = gains[i];
+        }
+        equalizer.setSettings(eq);
+        equalizer.setEnabled(this->config.getEqualizerEnabled());
+
+        const std::string replayGain = this->config.getReplayGainMode();
+        if (replayGain == "off") {
+            this->music_engine.setReplayGainMode(core::ReplayGainMode::Off);
+        } else if (replayGain == "album") {
+            this->music_engine.setReplayGainMode(core::ReplayGainMode::Album);
+        } else {
+            this->music_engine.setReplayGainMode(core::ReplayGainMode::Track);
+        }
     }
 
     // Inject the callback timer into Discord integration so it can stop itself when ready
@@ -117,13 +148,25 @@ bool AppState::init() {
     // on the application-owned queue.
     this->music_engine.setPlayQueue(this->play_queue);
     this->music_engine.setLibrary(this->library.get());
+    this->music_engine.onResumePosition = [this](const std::string& file_path, double position) {
+        if (!this->library) {
+            return;
+        }
+        for (const auto& song : this->library->getSongViews()) {
+            if (song.filename == file_path) {
+                this->db.setSongResumePosition(song.id, position);
+                this->library->setResumePosition(song.id, position);
+                return;
+            }
+        }
+    };
 
     // Optionally start playback of the first song in the queue (if any)
     int first = this->play_queue->current();
     if (first >= 0) {
         const music::SongView* s = this->library->getSongById(first);
         if (s) {
-            this->music_engine.playSound(s->filename);
+            this->music_engine.playSound(*s);
         }
     }
 
@@ -0,0 +1,370 @@
+#include "core/beat_tracker.hpp"
+#include <algorithm>
+#include <cmath>
+#include "core/sample_kernels.hpp"
+
+namespace core {
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+// Log compression of bin magnitudes (full-scale sine = 1) before the flux,
+// so quiet and loud passages produce comparable onsets.
+constexpr float kLogCompression = 1000.0f;
+// Flux below this is never an onset, whatever the threshold says (silence).
+constexpr float kMinOnsetFlux = 0.02f;
+// Width of the tempo preference around kPreferredBpm.
+constexpr float kTempoSpreadOctaves = 1.0f;
+// Estimates within this fraction of the current period refine it; others
+// must repeat once before the tempo changes.
+constexpr float kTempoTolerance = 0.04f;
+constexpr float kTempoSmoothing = 0.2f;
+// An onset this close to a predicted beat (fraction of the period) moves
+// the grid by kGridPull of the difference.
+constexpr double kGridCapture = 0.15;
+constexpr double kGridPull = 0.25;
+constexpr float kTempoIntervalSeconds = 0.5f;
+constexpr float kThresholdSeconds = 0.5f;
+
+size_t roundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Moves `frame` onto the grid through `beat` with `period` and returns the
+// nearest grid beat.
+double nearestBeat(double beat, double period, double frame) {
+    return beat + std::round((frame - beat) / period) * period;
+}
+}
+
+BeatTracker::BeatTracker() {
+    configure(sample_rate, settings);
+}
+
+void BeatTracker::configure(float rate, const Settings& requested) {
+    settings = requested;
+    sample_rate = rate > 0.0f ? rate : 44100.0f;
+    hop_rate = sample_rate / static_cast<float>(kHopFrames);
+
+    const float max_bpm = std::max(settings.max_bpm, settings.min_bpm + 1.0f);
+    min_lag = std::max<size_t>(2, static_cast<size_t>(std::floor(hop_rate * 60.0f / max_bpm)));
+    max_lag = std::max(min_lag + 1, static_cast<size_t>(std::ceil(hop_rate * 60.0f / std::max(1.0f, settings.min_bpm))));
+    history_hops = std::max(max_lag * 2, static_cast<size_t>(std::lround(settings.history_seconds * hop_rate)));
+    tempo_interval_hops = std::max<size_t>(1, static_cast<size_t>(std::lround(kTempoIntervalSeconds * hop_rate)));
+    threshold_hops = std::max<size_t>(1, static_cast<size_t>(std::lround(kThresholdSeconds * hop_rate)));
+    min_onset_gap_hops = std::max<size_t>(1, static_cast<size_t>(std::lround(settings.min_onset_gap_seconds * hop_rate)));
+
+    fft.configure(kFftSize);
+    window.resize(kFftSize);
+    float window_sum = 0.0f;
+    for (size_t i = 0; i < kFftSize; ++i) {
+        window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * static_cast<double>(i) / kFftSize));
+        window_sum += window[i];
+    }
+    magnitude_scale = 2.0f / window_sum;
+
+    samples.assign(kFftSize, 0.0f);
+    sample_pos = 0;
+    pending_frames = 0;
+    mono_scratch.assign(kPushChunkFrames, 0.0f);
+    bin_power.assign(kFftSize / 2 + 1, 0.0f);
+    log_magnitude.assign(kFftSize / 2 + 1, 0.0f);
+    previous_log_magnitude.assign(kFftSize / 2 + 1, 0.0f);
+
+    flux_history.assign(threshold_hops, 0.0f);
+    flux_pos = 0;
+    flux_sum = 0.0;
+    envelope.assign(roundUpToPowerOfTwo(history_hops), 0.0f);
+    envelope_scratch.assign(history_hops, 0.0f);
+    envelope_pos = 0;
+    hops = 0;
+
+    candidate_flux = 0.0f;
+    candidate_threshold = 0.0f;
+    before_candidate_flux = 0.0f;
+    candidate_frame = 0;
+    last_onset_hop = 0;
+    have_onset = false;
+
+    correlation.assign(kRefineMultiples * (max_lag + 1) + 2, 0.0);
+    total_correlation.assign(correlation.size(), 0.0);
+    pending_period = 0.0;
+
+    state = BeatSnapshot{};
+    for (auto& slot : slots) {
+        slot = BeatSnapshot{};
+    }
+    published.store(0, std::memory_order_release);
+}
+
+void BeatTracker::push(const float* interleaved, size_t frames, size_t channels, uint64_t first_frame) {
+    if (!interleaved || frames == 0 || channels == 0) {
+        return;
+    }
+
+    const SampleKernels& kernels = sampleKernels();
+    uint64_t frame = first_frame;
+    while (frames > 0) {
+        const size_t chunk = std::min(frames, kPushChunkFrames);
+        kernels.downmixToMono(interleaved, mono_scratch.data(), chunk, channels);
+
+        for (size_t i = 0; i < chunk; ++i) {
+            samples[sample_pos] = mono_scratch[i];
+            sample_pos = (sample_pos + 1) & (kFftSize - 1);
+            if (++pending_frames == kHopFrames) {
+                pending_frames = 0;
+                analyzeHop(frame + i + 1);
+            }
+        }
+
+        interleaved += chunk * channels;
+        frames -= chunk;
+        frame += chunk;
+    }
+}
+
+void BeatTracker::analyzeHop(uint64_t end_frame) {
+    fft.power([this](size_t i) {
+        return samples[(sample_pos + i) & (kFftSize - 1)] * window[i];
+    }, bin_power.data());
+
+    // Spectral flux: the mean rise in log magnitude over all bins but DC.
+    const size_t bins = bin_power.size();
+    float rise = 0.0f;
+    for (size_t k = 1; k < bins; ++k) {
+        log_magnitude[k] = std::log1p(kLogCompression * magnitude_scale * std::sqrt(bin_power[k]));
+        rise += std::max(0.0f, log_magnitude[k] - previous_log_magnitude[k]);
+    }
+    std::swap(log_magnitude, previous_log_magnitude);
+    const float flux = hops > 0 ? rise / static_cast<float>(bins - 1) : 0.0f;
+
+    flux_sum += static_cast<double>(flux) - flux_history[flux_pos];
+    flux_history[flux_pos] = flux;
+    flux_pos = (flux_pos + 1) % threshold_hops;
+    const size_t flux_count = static_cast<size_t>(std::min<uint64_t>(hops + 1, threshold_hops));
+    const float mean = static_cast<float>(std::max(0.0, flux_sum) / static_cast<double>(flux_count));
+
+    // The flux describes the window, so it is timed at the window's centre.
+    const uint64_t hop_frame = end_frame > kFftSize / 2 ? end_frame - kFftSize / 2 : 0;
+    detectOnset(flux, mean, hop_frame);
+
+    envelope[envelope_pos] = std::max(0.0f, flux - mean);
+    envelope_pos = (envelope_pos + 1) & (envelope.size() - 1);
+    ++hops;
+
+    if (hops >= max_lag * 2 && hops % tempo_interval_hops == 0) {
+        estimateTempo(hop_frame);
+    }
+    publish();
+}
+
+void BeatTracker::detectOnset(float flux, float mean, uint64_t hop_frame) {
+    // The previous hop is an onset if it peaks above its threshold and
+    // is far enough from the last one.
+    const uint64_t candidate_hop = hops > 0 ? hops - 1 : 0;
+    const bool peak = candidate_flux > before_candidate_flux && candidate_flux >= flux;
+    const bool spaced = !have_onset || candidate_hop - last_onset_hop >= min_onset_gap_hops;
+    if (hops > 1 && peak && spaced && candidate_flux > candidate_threshold) {
+        have_onset = true;
+        last_onset_hop = candidate_hop;
+        state.onset_frame = candidate_frame;
+        state.onset_strength = candidate_flux / candidate_threshold;
+
+        if (state.beat_period > 0.0) {
+            const double onset = static_cast<double>(candidate_frame);
+            const double predicted = nearestBeat(state.beat_frame, state.beat_period, onset);
+            const double error = onset - predicted;
+            if (std::abs(error) < kGridCapture * state.beat_period) {
+                state.beat_frame = predicted + kGridPull * error;
+            }
+        }
+    }
+
+    before_candidate_flux = candidate_flux;
+    candidate_flux = flux;
+    candidate_threshold = std::max(kMinOnsetFlux, mean * settings.threshold_ratio);
+    candidate_frame = hop_frame;
+}
+
+float BeatTracker::envelopeAt(size_t hops_ago) const {
+    return envelope[(envelope_pos + envelope.size() - 1 - hops_ago) & (envelope.size() - 1)];
+}
+
+float BeatTracker::tempoWeight(float lag) const {
+    const float octaves = std::log2((60.0f * hop_rate / lag) / kPreferredBpm) / kTempoSpreadOctaves;
+    return std::exp(-0.5f * octaves * octaves);
+}
+
+// Offset of the parabola through values[index - 1 .. index + 1] from index.
+double BeatTracker::peakOffset(const std::vector<double>& values, size_t index) {
+    const double left = values[index - 1];
+    const double right = values[index + 1];
+    const double curvature = left - 2.0 * values[index] + right;
+    return curvature < 0.0 ? std::clamp(0.5 * (left - right) / curvature, -0.5, 0.5) : 0.0;
+}
+
+float BeatTracker::pickLag(const std::vector<double>& values) const {
+    size_t best = 0;
+    double best_score = 0.0;
+    for (size_t lag = min_lag; lag <= max_lag; ++lag) {
+        const double score = values[lag] * tempoWeight(static_cast<float>(lag));
+        if (score > best_score) {
+            best_score = score;
+            best = lag;
+        }
+    }
+    if (best == 0) {
+        return 0.0f;
+    }
+
+    // Peaks at multiples of the period pin it down more finely than one
+    // hop; each implies a period, averaged by peak height.
+    double lag = static_cast<double>(best) + peakOffset(values, best);
+    double sum = lag * values[best];
+    double weight = values[best];
+    for (size_t multiple = 2; multiple <= kRefineMultiples; ++multiple) {
+        const size_t center = static_cast<size_t>(std::lround(lag * static_cast<double>(multiple)));
+        const size_t reach = multiple / 2;
+        if (center + reach + 1 >= values.size()) {
+            break;
+        }
+        size_t peak = center;
+        for (size_t candidate = center - reach; candidate <= center + reach; ++candidate) {
+            if (values[candidate] > values[peak]) {
+                peak = candidate;
+            }
+        }
+        if (values[peak] <= 0.0) {
+            continue;
+        }
+        sum += (static_cast<double>(peak) + peakOffset(values, peak)) / static_cast<double>(multiple) * values[peak];
+        weight += values[peak];
+    }
+    lag = sum / weight;
+    return static_cast<float>(lag);
+}
+
+void BeatTracker::estimateTempo(uint64_t hop_frame) {
+    // The newest envelope values, oldest first, without their mean.
+    const size_t count = static_cast<size_t>(std::min<uint64_t>(hops, history_hops));
+    double mean = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        envelope_scratch[i] = envelopeAt(count - 1 - i);
+        mean += envelope_scratch[i];
+    }
+    mean /= static_cast<double>(count);
+
+    double energy = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        envelope_scratch[i] -= static_cast<float>(mean);
+        energy += static_cast<double>(envelope_scratch[i]) * envelope_scratch[i];
+    }
+    energy /= static_cast<double>(count);
+    if (energy <= 1e-12) {
+        state.confidence *= 0.5f;
+        return;
+    }
+
+    for (size_t lag = min_lag - 1; lag < correlation.size(); ++lag) {
+        if (lag >= count) {
+            correlation[lag] = 0.0;
+            continue;
+        }
+        double sum = 0.0;
+        for (size_t i = lag; i < count; ++i) {
+            sum += static_cast<double>(envelope_scratch[i]) * envelope_scratch[i - lag];
+        }
+        correlation[lag] = sum / static_cast<double>(count - lag) / energy;
+        total_correlation[lag] += correlation[lag];
+    }
+
+    const float lag = pickLag(correlation);
+    if (lag <= 0.0f) {
+        state.confidence *= 0.5f;
+        return;
+    }
+    const double period = static_cast<double>(lag) * kHopFrames;
+    const bool had_grid = state.beat_period > 0.0;
+    state.confidence = static_cast<float>(std::clamp(correlation[static_cast<size_t>(std::lround(lag))], 0.0, 1.0));
+
+    if (state.beat_period <= 0.0 || std::abs(period - state.beat_period) < kTempoTolerance * state.beat_period) {
+        state.beat_period = state.beat_period > 0.0
+            ? state.beat_period + (period - state.beat_period) * kTempoSmoothing
+            : period;
+        pending_period = 0.0;
+    } else if (pending_period > 0.0 && std::abs(period - pending_period) < kTempoTolerance * pending_period) {
+        state.beat_period = period;
+        pending_period = 0.0;
+    } else {
+        pending_period = period;
+    }
+    state.bpm = static_cast<float>(60.0 * sample_rate / state.beat_period);
+
+    // Place the grid: the phase whose comb through the envelope collects
+    // the most onset energy.
+    const double period_hops = state.beat_period / kHopFrames;
+    const size_t phases = static_cast<size_t>(std::ceil(period_hops));
+    size_t best_phase = 0;
+    double best_score = -1.0;
+    for (size_t phase = 0; phase < phases; ++phase) {
+        double score = 0.0;
+        size_t teeth = 0;
+        for (double ago = static_cast<double>(phase); ago < static_cast<double>(count - 1); ago += period_hops) {
+            const size_t lower = static_cast<size_t>(ago);
+            const float blend = static_cast<float>(ago - static_cast<double>(lower));
+            score += envelopeAt(lower) * (1.0f - blend) + envelopeAt(lower + 1) * blend;
+            ++teeth;
+        }
+        score /= static_cast<double>(std::max<size_t>(1, teeth));
+        if (score > best_score) {
+            best_score = score;
+            best_phase = phase;
+        }
+    }
+
+    const double beat = static_cast<double>(hop_frame) - static_cast<double>(best_phase) * kHopFrames;
+    if (had_grid) {
+        // Close to the running grid: settle towards the estimate; otherwise
+        // the grid was wrong and jumps.
+        const double predicted = nearestBeat(state.beat_frame, state.beat_period, beat);
+        const double error = beat - predicted;
+        state.beat_frame = std::abs(error) < 0.25 * state.beat_period ? predicted + 0.5 * error : beat;
+    } else {
+        state.beat_frame = beat;
+    }
+}
+
+float BeatTracker::getOverallBpm() const {
+    const float lag = pickLag(total_correlation);
+    return lag > 0.0f ? 60.0f * hop_rate / lag : 0.0f;
+}
+
+void BeatTracker::publish() {
+    const uint64_t sequence = published.load(std::memory_order_relaxed) + 1;
+    BeatSnapshot& slot = slots[sequence & 1];
+    slot = state;
+    slot.sequence = sequence;
+    published.store(sequence, std::memory_order_release);
+}
+
+bool BeatTracker::readSnapshot(BeatSnapshot& out) const {
+    for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt) {
+        const uint64_t sequence = published.load(std::memory_order_acquire);
+        if (sequence == 0) {
+            return false;
+        }
+
+        out = slots[sequence & 1];
+
+        // Same protocol as SpectrumAnalyzer::readSnapshot.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (published.load(std::memory_order_relaxed) == sequence) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace core
@@ -0,0 +1,148 @@
+#include "core/deck_feed.hpp"
+#include <algorithm>
+#include <utility>
+#include "core/pcm_format.hpp"
+
+namespace core {
+namespace {
+constexpr size_t kResampleChunkFrames = 1024;
+constexpr double kMinCrossfadeSeconds = 0.05;
+
+bool spliceNextSource(DeckFeed& deck, std::unique_ptr<StreamSource>& next, uint64_t& next_serial,
+                      RetiredSources& retired) {
+    if (deck.fading_out || !next || !next->hasSameFormat(*deck.source)) {
+        return false;
+    }
+
+    retired.push_back(std::move(deck.source));
+    deck.source = std::move(next);
+    deck.serial = ++next_serial;
+    deck.position = 0.0;
+    return true;
+}
+
+size_t readSource(DeckFeed& deck, void* dst, size_t frames) {
+    const size_t read = deck.source->read(dst, frames);
+    if (read > 0) {
+        if (deck.source->getGain() != 1.0f) {
+            scalePcm(dst, read, al_get_channel_count(deck.source->getChannels()), deck.source->getDepth(), deck.source->getGain());
+        }
+        deck.position += static_cast<double>(read) / deck.source->getFrequency();
+    }
+    return read;
+}
+
+size_t readResampled(DeckFeed& deck, void* dst, size_t frames, FragmentMark& mark, std::unique_ptr<StreamSource>& next,
+                     uint64_t& next_serial, RetiredSources& retired) {
+    auto* out = static_cast<float*>(dst);
+    const size_t channels = deck.resampler->getChannels();
+
+    size_t produced = 0;
+    while (produced < frames) {
+        produced += deck.resampler->pull(out + produced * channels, frames - produced);
+        if (produced == frames || deck.resampler_flushed) {
+            break;
+        }
+
+        deck.decode_buffer.resize(kResampleChunkFrames * deck.source->getFrameSize());
+        const size_t read = deck.source->read(deck.decode_buffer.data(), kResampleChunkFrames);
+        if (read == 0) {
+            // Splice before flushing so the next song continues through the
+            // same filter history instead of a padded tail.
+            if (spliceNextSource(deck, next, next_serial, retired)) {
+                mark.position = 0.0;
+            } else {
+                deck.resampler->flush();
+                deck.resampler_flushed = true;
+            }
+            continue;
+        }
+
+        deck.resample_input.resize(read * channels);
+        pcmToFloat(deck.decode_buffer.data(), deck.resample_input.data(), read * channels, deck.source->getDepth());
+        if (deck.source->getGain() != 1.0f) {
+            scalePcm(deck.resample_input.data(), read, channels, ALLEGRO_AUDIO_DEPTH_FLOAT32, deck.source->getGain());
+        }
+        deck.resampler->push(deck.resample_input.data(), read);
+        deck.position += static_cast<double>(read) / deck.source->getFrequency();
+    }
+    return produced;
+}
+}
+
+void fillFragment(DeckFeed& deck, void* fragment, FragmentMark& mark, std::unique_ptr<StreamSource>& next,
+                  uint64_t& next_serial, RetiredSources& retired) {
+    auto* out = static_cast<uint8_t*>(fragment);
+    const ALLEGRO_AUDIO_DEPTH depth = deck.stream_depth;
+    const ALLEGRO_CHANNEL_CONF channels = deck.stream_channels;
+    const size_t frame_size = al_get_channel_count(channels) * al_get_audio_depth_size(depth);
+
+    size_t filled = 0;
+    if (deck.frames_written < deck.lead_in_frames) {
+        filled = static_cast<size_t>(std::min<uint64_t>(deck.fragment_frames, deck.lead_in_frames - deck.frames_written));
+        al_fill_silence(out, filled, depth, channels);
+    }
+    const size_t lead_in = filled;
+
+    // Relative to the start of the fragment, so lead-in silence and splices
+    // inside it keep the playback clock anchored to the fragment boundary.
+    const double stream_rate = deck.stream_frequency;
+    mark.position = deck.position - static_cast<double>(lead_in) / stream_rate;
+    while (filled < deck.fragment_frames && deck.source && !deck.ended) {
+        void* dst = out + filled * frame_size;
+        const size_t frames = deck.resampler
+            ? readResampled(deck, dst, deck.fragment_frames - filled, mark, next, next_serial, retired)
+            : readSource(deck, dst, deck.fragment_frames - filled);
+        if (frames > 0) {
+            filled += frames;
+            continue;
+        }
+
+        // End of the current song. If the next one is ready in the same
+        // format, continue with it from this exact frame; otherwise let the
+        // stream run out (or hand over to the incoming deck when
+        // crossfading). Resampled decks splice inside their read.
+        if (!deck.resampler && spliceNextSource(deck, next, next_serial, retired)) {
+            mark.position = -static_cast<double>(filled) / stream_rate;
+        } else {
+            deck.ended = true;
+        }
+    }
+
+    if (filled < deck.fragment_frames) {
+        al_fill_silence(out + filled * frame_size, deck.fragment_frames - filled, depth, channels);
+    }
+    deck.gain.apply(out, deck.fragment_frames, al_get_channel_count(channels), depth, deck.frames_written);
+    deck.frames_written += deck.fragment_frames;
+
+    mark.source_serial = deck.serial;
+    mark.has_audio = filled > lead_in;
+}
+
+std::optional<double> crossfadeRemaining(const DeckFeed& outgoing, double crossfade_seconds) {
+    if (crossfade_seconds <= 0.0 || !outgoing.source || outgoing.ended || outgoing.fading_out) {
+        return std::nullopt;
+    }
+
+    const double remaining = outgoing.source->getLength() - outgoing.position;
+    if (remaining > crossfade_seconds || remaining < kMinCrossfadeSeconds) {
+        return std::nullopt;
+    }
+    return remaining;
+}
+
+void scheduleCrossfadeIn(DeckFeed& incoming, double remaining, double queued_seconds) {
+    // Ramps run on each stream's own frame clock.
+    const double rate = incoming.stream_frequency;
+    incoming.lead_in_frames = static_cast<uint64_t>(queued_seconds * rate);
+    incoming.gain.schedule(incoming.lead_in_frames, static_cast<uint64_t>(remaining * rate),
+                           GainAutomation::Curve::EqualPowerIn);
+}
+
+void scheduleCrossfadeOut(DeckFeed& outgoing, double remaining) {
+    outgoing.fading_out = true;
+    outgoing.gain.schedule(outgoing.frames_written, static_cast<uint64_t>(remaining * outgoing.stream_frequency),
+                           GainAutomation::Curve::EqualPowerOut);
+}
+
+} // namespace core
@@ -0,0 +1,110 @@
+#include "core/decode_scheduler.hpp"
+#include <algorithm>
+#include "core/stream_source.hpp"
+
+namespace core {
+namespace {
+// About 0.37 s at 44.1 kHz: several output fragments, so a worker that is
+// briefly descheduled does not push decoding back onto the feed thread.
+constexpr size_t kMinAheadFrames = 16384;
+// About 3 s; enough to ride out a disk saturated by other readers.
+constexpr size_t kMaxAheadFrames = 131072;
+}
+
+DecodeScheduler::DecodeScheduler() : ahead_frames(kMinAheadFrames) {}
+
+DecodeScheduler::~DecodeScheduler() {
+    stop();
+}
+
+size_t DecodeScheduler::defaultWorkerCount() {
+    const unsigned int cores = std::thread::hardware_concurrency();
+    return cores > 2 ? 2 : 1;
+}
+
+void DecodeScheduler::start(size_t worker_count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!workers.empty()) {
+        return;
+    }
+    quit = false;
+    for (size_t i = 0; i < std::max<size_t>(worker_count, 1); ++i) {
+        workers.emplace_back(&DecodeScheduler::workerMain, this);
+    }
+}
+
+void DecodeScheduler::stop() {
+    std::vector<std::thread> stopping;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+        stopping.swap(workers);
+    }
+    work_cv.notify_all();
+    for (auto& worker : stopping) {
+        worker.join();
+    }
+}
+
+void DecodeScheduler::attach(StreamSource* source) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sources.push_back(source);
+    }
+    work_cv.notify_one();
+}
+
+void DecodeScheduler::detach(StreamSource* source) {
+    std::unique_lock<std::mutex> lock(mutex);
+    sources.erase(std::remove(sources.begin(), sources.end(), source), sources.end());
+    idle_cv.wait(lock, [&] { return std::find(busy.begin(), busy.end(), source) == busy.end(); });
+}
+
+void DecodeScheduler::wake() {
+    // Taking the lock orders this against a worker about to wait.
+    { std::lock_guard<std::mutex> lock(mutex); }
+    work_cv.notify_one();
+}
+
+void DecodeScheduler::noteStall() {
+    ++stalls;
+    size_t frames = ahead_frames.load();
+    while (frames < kMaxAheadFrames && !ahead_frames.compare_exchange_weak(frames, frames * 2)) {
+    }
+}
+
+StreamSource* DecodeScheduler::pickLocked() const {
+    StreamSource* best = nullptr;
+    double best_fill = 1.0;
+    for (StreamSource* source : sources) {
+        if (std::find(busy.begin(), busy.end(), source) != busy.end()) {
+            continue;
+        }
+        const double fill = source->aheadFill();
+        if (fill < best_fill) {
+            best = source;
+            best_fill = fill;
+        }
+    }
+    return best;
+}
+
+void DecodeScheduler::workerMain() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!quit) {
+        StreamSource* source = pickLocked();
+        if (!source) {
+            work_cv.wait(lock);
+            continue;
+        }
+
+        busy.push_back(source);
+        lock.unlock();
+        source->decodeAhead();
+        lock.lock();
+        busy.erase(std::find(busy.begin(), busy.end(), source));
+        idle_cv.notify_all();
+    }
+}
+
+} // namespace core
@@ -0,0 +1,41 @@
+#include "core/decoder.hpp"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include "core/allegro_decoder.hpp"
+
+namespace core {
+namespace {
+std::string lowercaseExtension(const std::string& path) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension;
+}
+
+// Written at startup, read by the engine's preload thread and the library
+// scanner afterwards.
+std::mutex registry_mutex;
+std::unordered_map<std::string, DecoderFactory> registry;
+}
+
+void registerDecoder(const std::string& extension, DecoderFactory factory) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry[lowercaseExtension("x" + extension)] = factory;
+}
+
+std::unique_ptr<Decoder> openDecoder(const std::string& path) {
+    DecoderFactory factory = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        const auto it = registry.find(lowercaseExtension(path));
+        if (it != registry.end()) {
+            factory = it->second;
+        }
+    }
+    return factory ? factory(path) : openAllegroDecoder(path);
+}
+
+} // namespace core
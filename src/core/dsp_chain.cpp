@@ -0,0 +1,86 @@
+#include "core/dsp_chain.hpp"
+#include <algorithm>
+#include <thread>
+
+namespace core {
+
+DspChain::~DspChain() {
+    delete nodes.load(std::memory_order_acquire);
+}
+
+void DspChain::configure(double rate, size_t channel_count) {
+    sample_rate = rate;
+    channels = std::max<size_t>(1, channel_count);
+
+    // Take the list away from the audio thread while its nodes are re-prepared.
+    NodeList* list = nodes.exchange(nullptr, std::memory_order_seq_cst);
+    waitForProcessors();
+    if (list) {
+        for (auto& node : *list) {
+            node->prepare(sample_rate, channels);
+        }
+    }
+    nodes.store(list, std::memory_order_seq_cst);
+}
+
+void DspChain::add(std::shared_ptr<DspNode> node) {
+    if (!node) {
+        return;
+    }
+
+    node->prepare(sample_rate, channels);
+    const NodeList* current = nodes.load(std::memory_order_acquire);
+    NodeList* fresh = new NodeList(current ? *current : NodeList{});
+    fresh->push_back(std::move(node));
+    publish(fresh);
+}
+
+void DspChain::remove(const DspNode* node) {
+    const NodeList* current = nodes.load(std::memory_order_acquire);
+    if (!current) {
+        return;
+    }
+
+    NodeList* fresh = new NodeList(*current);
+    fresh->erase(std::remove_if(fresh->begin(), fresh->end(),
+                                [node](const std::shared_ptr<DspNode>& n) { return n.get() == node; }),
+                 fresh->end());
+    publish(fresh);
+}
+
+void DspChain::clear() {
+    publish(nullptr);
+}
+
+void DspChain::publish(NodeList* fresh) {
+    NodeList* old = nodes.exchange(fresh, std::memory_order_seq_cst);
+    waitForProcessors();
+    delete old;
+}
+
+void DspChain::waitForProcessors() const {
+    // The audio thread holds a list for one block at most.
+    while (active_processors.load(std::memory_order_seq_cst) != 0) {
+        std::this_thread::yield();
+    }
+}
+
+bool DspChain::process(float* interleaved, size_t frames) {
+    active_processors.fetch_add(1, std::memory_order_seq_cst);
+    const NodeList* list = nodes.load(std::memory_order_seq_cst);
+
+    bool processed = false;
+    if (list && interleaved) {
+        for (const auto& node : *list) {
+            if (node->isActive()) {
+                node->process(interleaved, frames);
+                processed = true;
+            }
+        }
+    }
+
+    active_processors.fetch_sub(1, std::memory_order_seq_cst);
+    return processed;
+}
+
+} // namespace core
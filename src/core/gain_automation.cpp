@@ -0,0 +1,53 @@
+#include "core/gain_automation.hpp"
+#include <algorithm>
+#include <cmath>
+#include "core/pcm_format.hpp"
+
+namespace core {
+namespace {
+constexpr float kHalfPi = 1.57079632679489661923f;
+}
+
+void GainAutomation::clear() {
+    active = false;
+    start_frame = 0;
+    length_frames = 0;
+}
+
+void GainAutomation::schedule(uint64_t start, uint64_t length, Curve type) {
+    active = true;
+    curve = type;
+    start_frame = start;
+    length_frames = std::max<uint64_t>(1, length);
+}
+
+float GainAutomation::gainAt(uint64_t frame) const {
+    if (!active) {
+        return 1.0f;
+    }
+
+    float t = 0.0f;
+    if (frame >= start_frame + length_frames) {
+        t = 1.0f;
+    } else if (frame > start_frame) {
+        t = static_cast<float>(frame - start_frame) / static_cast<float>(length_frames);
+    }
+
+    return curve == Curve::EqualPowerIn ? std::sin(t * kHalfPi) : std::cos(t * kHalfPi);
+}
+
+void GainAutomation::apply(void* pcm, size_t frames, size_t channels, ALLEGRO_AUDIO_DEPTH depth, uint64_t first_frame) const {
+    if (!active || !pcm || frames == 0 || channels == 0) {
+        return;
+    }
+
+    const float gain = gainAt(first_frame);
+    const float end_gain = gainAt(first_frame + frames);
+    if (gain == 1.0f && end_gain == 1.0f) {
+        return;
+    }
+    const float step = (end_gain - gain) / static_cast<float>(frames);
+    scalePcm(pcm, frames, channels, depth, gain, step);
+}
+
+} // namespace core
@@ -0,0 +1,168 @@
+#include "core/loudness_meter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "core/pcm_format.hpp"
+
+namespace core {
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kAbsoluteGateLufs = -70.0;
+constexpr double kRelativeGateLu = -10.0;
+constexpr size_t kSubBlocksPerBlock = 4; // 400 ms blocks, 100 ms hop
+constexpr size_t kConvertChunkFrames = 1024;
+
+double energyToLufs(double energy) {
+    return -0.691 + 10.0 * std::log10(energy);
+}
+
+double lufsToEnergy(double lufs) {
+    return std::pow(10.0, (lufs + 0.691) / 10.0);
+}
+
+}
+
+LoudnessMeter::LoudnessMeter(double sample_rate, size_t channel_count)
+    : channels(std::clamp<size_t>(channel_count, 1, kMaxChannels)) {
+    sub_block_frames = std::max<size_t>(1, static_cast<size_t>(std::lround(sample_rate / 10.0)));
+
+    // BS.1770 K-weighting, re-derived for the actual sample rate (the
+    // standard lists coefficients for 48 kHz only).
+    {
+        const double f0 = 1681.974450955533;
+        const double gain_db = 3.999843853973347;
+        const double q = 0.7071752369554196;
+        const double k = std::tan(kPi * f0 / sample_rate);
+        const double vh = std::pow(10.0, gain_db / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+        shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        shelf.b1 = 2.0 * (k * k - vh) / a0;
+        shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        shelf.a2 = (1.0 - k / q + k * k) / a0;
+    }
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+        const double k = std::tan(kPi * f0 / sample_rate);
+        const double a0 = 1.0 + k / q + k * k;
+        highpass.b0 = 1.0;
+        highpass.b1 = -2.0;
+        highpass.b2 = 1.0;
+        highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+        highpass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    // Channel weights for the usual layouts: LFE (index 3 of 5.1) is
+    // excluded and surrounds are boosted by 1.5 dB.
+    for (size_t c = 0; c < kMaxChannels; ++c) {
+        channel_weight[c] = 1.0;
+    }
+    if (channels >= 6) {
+        channel_weight[3] = 0.0;
+        channel_weight[4] = 1.41;
+        channel_weight[5] = 1.41;
+    }
+
+    scratch.resize(kConvertChunkFrames * channels);
+}
+
+double LoudnessMeter::run(const Biquad& f, FilterState& s, double x) {
+    // Transposed direct form II.
+    const double y = f.b0 * x + s.z1;
+    s.z1 = f.b1 * x - f.a1 * y + s.z2;
+    s.z2 = f.b2 * x - f.a2 * y;
+    return y;
+}
+
+void LoudnessMeter::addFrames(const float* interleaved, size_t frames) {
+    if (!interleaved) {
+        return;
+    }
+
+    for (size_t frame = 0; frame < frames; ++frame) {
+        const float* in = interleaved + frame * channels;
+        double frame_energy = 0.0;
+        for (size_t c = 0; c < channels; ++c) {
+            peak = std::max(peak, static_cast<double>(std::fabs(in[c])));
+            const double shelved = run(shelf, shelf_state[c], in[c]);
+            const double weighted = run(highpass, highpass_state[c], shelved);
+            frame_energy += channel_weight[c] * weighted * weighted;
+        }
+
+        sub_block_energy += frame_energy;
+        if (++sub_block_fill == sub_block_frames) {
+            finishSubBlock();
+        }
+    }
+}
+
+void LoudnessMeter::finishSubBlock() {
+    recent_sub_blocks[sub_block_count % kSubBlocksPerBlock] = sub_block_energy / static_cast<double>(sub_block_frames);
+    ++sub_block_count;
+    sub_block_energy = 0.0;
+    sub_block_fill = 0;
+
+    if (sub_block_count >= kSubBlocksPerBlock) {
+        double sum = 0.0;
+        for (double energy : recent_sub_blocks) {
+            sum += energy;
+        }
+        block_energy.push_back(sum / kSubBlocksPerBlock);
+    }
+}
+
+void LoudnessMeter::addPcm(const void* pcm, size_t frames, ALLEGRO_AUDIO_DEPTH depth) {
+    if (!pcm) {
+        return;
+    }
+    if (depth == ALLEGRO_AUDIO_DEPTH_FLOAT32) {
+        addFrames(static_cast<const float*>(pcm), frames);
+        return;
+    }
+
+    const size_t depth_size = al_get_audio_depth_size(depth);
+    const auto* bytes = static_cast<const uint8_t*>(pcm);
+    for (size_t done = 0; done < frames; done += kConvertChunkFrames) {
+        const size_t chunk = std::min(kConvertChunkFrames, frames - done);
+        const void* src = bytes + done * channels * depth_size;
+        if (!pcmToFloat(src, scratch.data(), chunk * channels, depth)) {
+            return;
+        }
+        addFrames(scratch.data(), chunk);
+    }
+}
+
+std::optional<double> LoudnessMeter::integratedLoudness() const {
+    const double absolute_gate = lufsToEnergy(kAbsoluteGateLufs);
+
+    double sum = 0.0;
+    size_t count = 0;
+    for (double energy : block_energy) {
+        if (energy > absolute_gate) {
+            sum += energy;
+            ++count;
+        }
+    }
+    if (count == 0) {
+        return std::nullopt;
+    }
+
+    const double relative_gate = lufsToEnergy(energyToLufs(sum / count) + kRelativeGateLu);
+    const double gate = std::max(absolute_gate, relative_gate);
+    sum = 0.0;
+    count = 0;
+    for (double energy : block_energy) {
+        if (energy > gate) {
+            sum += energy;
+            ++count;
+        }
+    }
+    if (count == 0) {
+        return std::nullopt;
+    }
+    return energyToLufs(sum / count);
+}
+
+} // namespace core
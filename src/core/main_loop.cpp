@@ -24,6 +24,7 @@ void runMainLoop() {
     auto albumListView = ui::AlbumListView(appState.fontManager, appState.library, &appState.music_engine, appState.event_dispatcher);
     auto playQueueView = ui::PlayQueueView(appState.fontManager, appState.event_dispatcher, &appState.music_engine, appState.library.get());
     auto audioVisView = ui::AudioVisualizerView(appState.fontManager, appState.event_dispatcher, &appState.music_engine);
+    audioVisView.setShaderHotReload(appState.config.getShaderHotReload());
     
     auto sidebarView = ui::SidebarView(appState.fontManager, appState.event_dispatcher);
 
@@ -158,7 +159,7 @@ void runMainLoop() {
         std::cout << "Playing random song: " << song->title << "\n";
         // Look up the concrete Song for filename using ID from SongView
         if (const music::SongView* songModel = appState.library->getSongById(song->id)) {
-            appState.music_engine.playSound(songModel->filename);
+            appState.music_engine.playSound(*songModel);
         }
     } else {
         std::cerr << "No songs in library.\n";
@@ -176,7 +177,10 @@ void runMainLoop() {
         switch (appState.event.type)
         {
         case ALLEGRO_EVENT_AUDIO_STREAM_FINISHED:
+        case ALLEGRO_EVENT_MUSIC_TRACK_ADVANCED:
             // TODO: expose currentStream so that we can verify it's the current stream
+            // On a gapless advance the next song is already audible; playNext()
+            // only catches the queue and UI up with it.
             if (appState.music_engine.onSongFinished) {
                 appState.music_engine.onSongFinished();
             }
@@ -238,7 +242,7 @@ void runMainLoop() {
 
                     const auto* song = appState.library->getSongById(pq->song_ids[idx]);
                     if (song) {
-                        appState.music_engine.playSound(song->filename);
+                        appState.music_engine.playSound(*song);
                     }
                 }
             }
@@ -3,124 +3,95 @@
 #include <allegro5/allegro_acodec.h>
 #include <allegro5/allegro_audio.h>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <utility>
 #include "core/app_state.hpp"
+#include "core/pcm_format.hpp"
+#include "core/sample_kernels.hpp"
 
 namespace core {
 namespace {
 constexpr size_t kDefaultSampleBufferCapacity = 44100 * 2 * 4; // ~4s stereo at 44.1kHz
+constexpr unsigned int kPreferredFrequency = 48000;
+constexpr unsigned int kFallbackFrequency = 44100;
+constexpr double kMaxCrossfadeSeconds = 12.0;
+constexpr double kCrossfadePreloadMargin = 5.0; // seconds between preload and crossfade start
+constexpr double kResumeMinSeconds = 20.0 * 60.0; // shorter songs always start at 0
+constexpr double kResumeSaveInterval = 15.0;
+constexpr double kResumeEndMargin = 30.0; // this close to the end counts as finished
+// A larger output buffer steps back down after this long without an underrun.
+constexpr double kBufferShrinkAfterSeconds = 10.0 * 60.0;
 }
 
 void MusicEngine::SampleCaptureState::setEnabled(bool value) {
-    std::lock_guard<std::mutex> lock(ring_mutex);
-    enabled = value;
+    enabled.store(value, std::memory_order_relaxed);
 }
 
 bool MusicEngine::SampleCaptureState::isEnabled() const {
-    std::lock_guard<std::mutex> lock(ring_mutex);
-    return enabled;
+    return enabled.load(std::memory_order_relaxed);
 }
 
 void MusicEngine::SampleCaptureState::setCapacity(size_t sample_count) {
-    std::lock_guard<std::mutex> lock(ring_mutex);
-    ring_capacity = sample_count;
-    ring_buffer.assign(ring_capacity, 0.0f);
-    ring_write_pos = 0;
-    ring_size = 0;
+    ring.setCapacity(sample_count);
 }
 
 size_t MusicEngine::SampleCaptureState::getCapacity() const {
-    std::lock_guard<std::mutex> lock(ring_mutex);
-    return ring_capacity;
+    return ring.getCapacity();
 }
 
 size_t MusicEngine::SampleCaptureState::getSize() const {
-    std::lock_guard<std::mutex> lock(ring_mutex);
-    return ring_size;
+    return ring.getSize();
 }
 
 void MusicEngine::SampleCaptureState::clear() {
-    std::lock_guard<std::mutex> lock(ring_mutex);
-    ring_write_pos = 0;
-    ring_size = 0;
+    ring.clear();
 }
 
 std::vector<float> MusicEngine::SampleCaptureState::copyRecent(size_t max_samples) const {
-    std::lock_guard<std::mutex> lock(ring_mutex);
-    if (ring_size == 0 || max_samples == 0 || ring_capacity == 0) {
-        return {};
-    }
-
-    const size_t sample_count = std::min(max_samples, ring_size);
-    std::vector<float> out(sample_count);
-    const size_t start = (ring_write_pos + ring_capacity - sample_count) % ring_capacity;
-
-    for (size_t i = 0; i < sample_count; ++i) {
-        out[i] = ring_buffer[(start + i) % ring_capacity];
-    }
-
+    std::vector<float> out(std::min(max_samples, ring.getSize()));
+    out.resize(readRecentInto(out.data(), out.size()));
     return out;
 }
 
 std::vector<float> MusicEngine::SampleCaptureState::copyRecentMono(size_t max_frames) const {
-    std::lock_guard<std::mutex> lock(ring_mutex);
-    if (ring_size == 0 || max_frames == 0 || ring_capacity == 0) {
-        return {};
-    }
-
-    const size_t channel_count = std::max<size_t>(1, channels);
-    const size_t available_frames = ring_size / channel_count;
-    const size_t frame_count = std::min(max_frames, available_frames);
-    if (frame_count == 0) {
-        return {};
-    }
-
-    std::vector<float> out(frame_count);
-    const size_t sample_count = frame_count * channel_count;
-    const size_t start = (ring_write_pos + ring_capacity - sample_count) % ring_capacity;
-
-    for (size_t frame = 0; frame < frame_count; ++frame) {
-        float sum = 0.0f;
-        const size_t frame_start = (start + frame * channel_count) % ring_capacity;
-
-        for (size_t channel = 0; channel < channel_count; ++channel) {
-            sum += ring_buffer[(frame_start + channel) % ring_capacity];
-        }
+    const size_t channel_count = std::max<size_t>(1, channels.load(std::memory_order_relaxed));
+    std::vector<float> out(std::min(max_frames, ring.getSize() / channel_count));
+    out.resize(readRecentMonoInto(out.data(), out.size()));
+    return out;
+}
 
-        out[frame] = sum / static_cast<float>(channel_count);
-    }
+size_t MusicEngine::SampleCaptureState::readRecentInto(float* dst, size_t max_samples, size_t skip_frames) const {
+    const size_t channel_count = std::max<size_t>(1, channels.load(std::memory_order_relaxed));
+    return ring.readRecent(dst, max_samples, skip_frames * channel_count);
+}
 
-    return out;
+size_t MusicEngine::SampleCaptureState::readRecentMonoInto(float* dst, size_t max_frames, size_t skip_frames) const {
+    const size_t channel_count = std::max<size_t>(1, channels.load(std::memory_order_relaxed));
+    return ring.readRecentMono(dst, max_frames, channel_count, skip_frames);
 }
 
-void MusicEngine::SampleCaptureState::appendInterleavedInt16(const void* buf, unsigned int frames) {
-    std::lock_guard<std::mutex> lock(ring_mutex);
-    if (!enabled || ring_capacity == 0 || !buf || frames == 0) {
+void MusicEngine::SampleCaptureState::appendInterleaved(const float* samples, size_t sample_count) {
+    if (!enabled.load(std::memory_order_relaxed) || !samples || sample_count == 0) {
         return;
     }
 
-    const auto* interleaved = static_cast<const int16_t*>(buf);
-    const size_t total_samples = static_cast<size_t>(frames) * channels;
-
-    for (size_t i = 0; i < total_samples; ++i) {
-        ring_buffer[ring_write_pos] = static_cast<float>(interleaved[i]) / 32768.0f;
-        ring_write_pos = (ring_write_pos + 1) % ring_capacity;
-        if (ring_size < ring_capacity) {
-            ++ring_size;
-        }
-    }
+    ring.write(samples, sample_count);
 }
 
 MusicEngine::MusicEngine() {
     // Constructor
     voice = nullptr;
     mixer = nullptr;
-    current_stream = nullptr;
     is_shutdown = false;
     song_finished_fired = false;
     sample_capture.channels = 2;
     sample_capture.setCapacity(kDefaultSampleBufferCapacity);
+    postprocess_scratch.assign(kPostprocessChunkSamples, 0.0f);
+    dsp_chain.add(equalizer);
 }
 
 MusicEngine::~MusicEngine() {
@@ -128,29 +99,66 @@ MusicEngine::~MusicEngine() {
     shutdown();
 }
 
+void MusicEngine::configureOutput(unsigned int frequency, ALLEGRO_AUDIO_DEPTH depth, ResamplerQuality quality) {
+    requested_frequency = frequency;
+    requested_depth = depth;
+    resampler_quality = quality;
+}
+
 bool MusicEngine::initialize() {
     // Initialization code
-    voice = al_create_voice(44100, ALLEGRO_AUDIO_DEPTH_INT16, ALLEGRO_CHANNEL_CONF_2);
+    const unsigned int frequencies[] = {
+        requested_frequency ? requested_frequency : kPreferredFrequency,
+        kFallbackFrequency
+    };
+    for (unsigned int frequency : frequencies) {
+        voice = al_create_voice(frequency, requested_depth, ALLEGRO_CHANNEL_CONF_2);
+        if (!voice && requested_depth != ALLEGRO_AUDIO_DEPTH_INT16) {
+            // The mixer converts to the voice depth on output.
+            voice = al_create_voice(frequency, ALLEGRO_AUDIO_DEPTH_INT16, ALLEGRO_CHANNEL_CONF_2);
+        }
+        if (voice) {
+            mixer_frequency = frequency;
+            break;
+        }
+        std::cerr << "Audio device refused " << frequency << " Hz output\n";
+    }
     if (!voice) {
         return false;
     }
 
-    mixer = al_create_mixer(44100, ALLEGRO_AUDIO_DEPTH_INT16, ALLEGRO_CHANNEL_CONF_2);
+    mixer = al_create_mixer(mixer_frequency, requested_depth, ALLEGRO_CHANNEL_CONF_2);
     if (!mixer) {
         al_destroy_voice(voice);
+        voice = nullptr;
         return false;
     }
+    mixer_depth = requested_depth;
+
+    // Polyphase decks arrive at the mixer rate already; the mixer only
+    // resamples them when the playback speed changes.
+    al_set_mixer_quality(mixer, resampler_quality == ResamplerQuality::Cubic
+        ? ALLEGRO_MIXER_QUALITY_CUBIC
+        : ALLEGRO_MIXER_QUALITY_LINEAR);
 
     if (!al_attach_mixer_to_voice(mixer, voice)) {
         al_destroy_mixer(mixer);
         al_destroy_voice(voice);
+        mixer = nullptr;
+        voice = nullptr;
         return false;
     }
+    std::cout << "Audio output: " << mixer_frequency << " Hz, "
+              << (mixer_depth == ALLEGRO_AUDIO_DEPTH_FLOAT32 ? "float32" : "int16") << " mixer\n";
 
     sample_capture.channels = std::max<size_t>(
         1,
         al_get_channel_count(al_get_mixer_channels(mixer))
     );
+    spectrum_analyzer.configure(static_cast<float>(al_get_mixer_frequency(mixer)), SpectrumAnalyzer::Settings{});
+    playback_clock.configure(mixer_frequency);
+    beat_tracker.configure(static_cast<float>(mixer_frequency), BeatTracker::Settings{});
+    dsp_chain.configure(mixer_frequency, sample_capture.channels.load());
 
     if (!al_set_mixer_postprocess_callback(mixer, &MusicEngine::mixerPostprocessCallback, this)) {
         std::cerr << "Failed to register mixer postprocess callback\n";
@@ -163,6 +171,14 @@ bool MusicEngine::initialize() {
 
     al_set_mixer_gain(mixer, current_gain);
 
+    al_init_user_event_source(&playback_events);
+    playback_events_ready = true;
+
+    quit_threads = false;
+    decode_scheduler.start();
+    feed_thread = std::thread(&MusicEngine::feedThreadMain, this);
+    preload_thread = std::thread(&MusicEngine::preloadThreadMain, this);
+
     return true;
 }
 
@@ -170,12 +186,21 @@ void MusicEngine::shutdown() {
     if (is_shutdown) {
         return; // Already shut down
     }
-    
-    // Destroy in reverse order of creation: stream -> mixer -> voice
-    if (current_stream) {
-        al_destroy_audio_stream(current_stream);
-        current_stream = nullptr;
+
+    saveResumePosition(current_time);
+    stopThreads();
+
+    // Destroy in reverse order of creation: streams -> sources -> mixer -> voice
+    {
+        RetiredSources retired;
+        {
+            std::lock_guard<std::mutex> lock(playback_mutex);
+            stopDecksLocked(retired);
+            retired.push_back(std::move(preloaded_source));
+        }
     }
+    decode_scheduler.stop();
+
     if (mixer) {
         al_set_mixer_postprocess_callback(mixer, nullptr, nullptr);
         al_destroy_mixer(mixer);
@@ -185,78 +210,582 @@ void MusicEngine::shutdown() {
         al_destroy_voice(voice);
         voice = nullptr;
     }
+    if (playback_events_ready) {
+        al_destroy_user_event_source(&playback_events);
+        playback_events_ready = false;
+    }
     
     is_shutdown = true;
 }
 
-void MusicEngine::playSound(const std::string& file_path) {
-    if (current_stream) {
-        al_destroy_audio_stream(current_stream);
-        current_stream = nullptr;
+void MusicEngine::stopThreads() {
+    {
+        std::lock_guard<std::mutex> lock(playback_mutex);
+        quit_threads = true;
+    }
+    feed_cv.notify_all();
+    preload_cv.notify_all();
+
+    if (feed_thread.joinable()) {
+        feed_thread.join();
+    }
+    if (preload_thread.joinable()) {
+        preload_thread.join();
+    }
+}
+
+void MusicEngine::setEventQueue(ALLEGRO_EVENT_QUEUE* queue) {
+    event_queue = queue;
+    if (event_queue && playback_events_ready) {
+        al_register_event_source(event_queue, &playback_events);
     }
-    current_stream = al_load_audio_stream(file_path.c_str(), 4, 4096);
+}
+
+void MusicEngine::setPreloadSeconds(double seconds) {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    preload_seconds = std::max(1.0, seconds);
+}
 
-    if (current_stream) {
-        current_time = 0.0;
-        duration = al_get_audio_stream_length_secs(current_stream);
-        progressBarModel->setFinishesAt(duration);
-        song_finished_fired = false; // Reset the flag for the new song
-        std::cout << "Loaded audio stream. Duration: " << duration << " seconds.\n";
-        auto attachResult = al_attach_audio_stream_to_mixer(current_stream, mixer);
-        auto playResult = al_set_audio_stream_playing(current_stream, true);
+void MusicEngine::setCrossfadeSeconds(double seconds) {
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    crossfade_seconds = std::clamp(seconds, 0.0, kMaxCrossfadeSeconds);
+}
 
-        if (!attachResult || !playResult) {
-            std::cerr << "Failed to play audio stream: attachResult=" << attachResult
-                      << ", playResult=" << playResult << "\n";
+void MusicEngine::playSound(const music::SongView& song) {
+    // Copied: saving the old song's resume position below updates the library.
+    const std::string file_path = song.filename;
+    const int song_id = song.id;
+    const float gain = replayGainFor(song);
+
+    std::unique_ptr<StreamSource> source;
+    RetiredSources retired;
+    bool adopted_splice = false;
+    {
+        std::lock_guard<std::mutex> lock(playback_mutex);
+        const Deck& audible = audibleDeckLocked();
+        if (gapless_advanced && audible.source && audible.source->getPath() == file_path) {
+            // The feed thread already switched (or is crossfading) to this song.
+            adopted_splice = true;
+        } else if (preloaded_source && preloaded_source->getPath() == file_path) {
+            source = std::move(preloaded_source);
         }
 
-        if (event_queue) {
-            al_register_event_source(event_queue, al_get_audio_stream_event_source(current_stream));
+        // Any other preload belongs to the old position in the queue.
+        gapless_advanced = false;
+        retired.push_back(std::move(preloaded_source));
+        preload_request_path.clear();
+        preload_requested = false;
+        ++preload_generation;
+    }
+
+    // An adopted splice means the previous song played to its end.
+    saveResumePosition(adopted_splice ? duration : current_time);
+
+    if (!adopted_splice) {
+        if (!source) {
+            source = StreamSource::open(file_path, &decode_scheduler);
+            if (source) {
+                source->setGain(gain);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(playback_mutex);
+        if (!source || !startSourceLocked(std::move(source), retired)) {
+            std::cerr << "Failed to play audio stream: " << file_path << "\n";
+            stopDecksLocked(retired);
+            resume_path.clear();
+            return;
+        }
+
+        const double length = primary.source->getLength();
+        const double resume = length >= kResumeMinSeconds ? resumePositionFor(song_id) : 0.0;
+        if (resume > 0.0 && resume < length - kResumeEndMargin) {
+            seekLocked(resume, retired);
         }
+    }
+    retired.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(playback_mutex);
+        const Deck& audible = audibleDeckLocked();
+        duration = audible.source ? audible.source->getLength() : 0.0;
+        current_time = playing_position;
+    }
+    resume_path = file_path;
+    resume_saved_at = current_time;
+    progressBarModel->setFinishesAt(duration);
+    progressBarModel->setProgress(current_time);
+    song_finished_fired = false; // Reset the flag for the new song
+    std::cout << "Loaded audio stream. Duration: " << duration << " seconds.\n";
+
+    if (const music::SongView* playing = library ? library->getSongById(song_id) : nullptr; playing && onSongChanged) {
+        onSongChanged(*playing);
+    }
+    
+    // If not playing from a queue context (album/playlist), mark as individual song
+    if (playQueueModel && playQueueModel->context_type != music::PlaybackContextType::Album &&
+        playQueueModel->context_type != music::PlaybackContextType::Playlist) {
+        playQueueModel->context_type = music::PlaybackContextType::Individual;
+        playQueueModel->context_id = -1;
+    }
+}
 
-        al_get_audio_stream_event_source(current_stream); // ensure event source is valid
-        // If possible, find Song model in the global library and notify
-        // listeners about the change.
-        // (This is best-effort: filenames may be relative or differently
-        // normalized; adjust lookup as needed.)
-        const music::SongView* song = nullptr;
-        for (const auto& s : AppState::instance().library->getSongViews()) {
-            if (s.filename == file_path) {
-                song = &s;
-                break;
+bool MusicEngine::startSourceLocked(std::unique_ptr<StreamSource> source, RetiredSources& retired) {
+    stopDecksLocked(retired);
+
+    primary.source = std::move(source);
+    primary.serial = ++next_serial;
+    announced_serial = primary.serial;
+    end_announced = false;
+    playing_position = 0.0;
+
+    return createOutputStreamLocked(primary, retired);
+}
+
+bool MusicEngine::createOutputStreamLocked(Deck& deck, RetiredSources& retired, bool keep_resampler) {
+    if (!deck.source || !mixer) {
+        return false;
+    }
+
+    const double now = al_get_time();
+    if (output_buffer_level > 0 && now - buffer_level_changed_at > kBufferShrinkAfterSeconds) {
+        --output_buffer_level;
+        buffer_level_changed_at = now;
+    }
+    const OutputBufferShape& shape = kOutputBufferShapes[output_buffer_level];
+
+    const bool resample = resamplesItself(*deck.source);
+    deck.stream = al_create_audio_stream(
+        shape.fragment_count,
+        shape.fragment_frames,
+        streamFrequencyFor(*deck.source),
+        resample ? ALLEGRO_AUDIO_DEPTH_FLOAT32 : deck.source->getDepth(),
+        deck.source->getChannels()
+    );
+    if (!deck.stream) {
+        return false;
+    }
+    deck.fragment_frames = shape.fragment_frames;
+    deck.fragment_count = shape.fragment_count;
+    deck.stream_depth = al_get_audio_stream_depth(deck.stream);
+    deck.stream_channels = al_get_audio_stream_channels(deck.stream);
+    deck.stream_frequency = al_get_audio_stream_frequency(deck.stream);
+
+    if (!keep_resampler) {
+        deck.resampler = resample
+            ? std::make_unique<PolyphaseResampler>(deck.source->getFrequency(), mixer_frequency,
+                                                   al_get_channel_count(deck.source->getChannels()))
+            : nullptr;
+        deck.resampler_flushed = false;
+    }
+    deck.fragments_filled = 0;
+    deck.frames_written = 0;
+    deck.drained = false;
+    for (auto& mark : deck.marks) {
+        mark = FragmentMark{};
+    }
+
+    // Prime every fragment before attaching so playback starts with real audio.
+    fillAvailableFragmentsLocked(deck, retired);
+
+    const bool attached = al_attach_audio_stream_to_mixer(deck.stream, mixer);
+    const bool playing = attached && al_set_audio_stream_playing(deck.stream, true);
+    if (!attached || !playing) {
+        std::cerr << "Failed to play audio stream: attachResult=" << attached
+                  << ", playResult=" << playing << "\n";
+        al_destroy_audio_stream(deck.stream);
+        deck.stream = nullptr;
+        return false;
+    }
+
+    // The stream's first fragment plays from the next mixer block on.
+    deck.clock_fragment = 0;
+    deck.clock_mixer_frame = playback_clock.getMixerFrames();
+    if (&deck == &primary) {
+        last_fragment_time = 0.0;
+    }
+    if (deck.serial == announced_serial) {
+        paused = false;
+        playback_clock.anchor(deck.marks[0].position, deck.clock_mixer_frame, current_speed);
+    }
+
+    feed_cv.notify_one();
+    return true;
+}
+
+void MusicEngine::resetDeckLocked(Deck& deck, RetiredSources& retired) {
+    if (deck.stream) {
+        al_destroy_audio_stream(deck.stream);
+    }
+    retired.push_back(std::move(deck.source));
+    deck = Deck{};
+}
+
+void MusicEngine::stopDecksLocked(RetiredSources& retired) {
+    // A seek still waiting was meant for the song being stopped.
+    takePendingSeek();
+    resetDeckLocked(primary, retired);
+    if (incoming) {
+        resetDeckLocked(*incoming, retired);
+        incoming.reset();
+    }
+}
+
+void MusicEngine::promoteIncomingLocked(RetiredSources& retired) {
+    resetDeckLocked(primary, retired);
+    primary = std::move(*incoming);
+    incoming.reset();
+}
+
+MusicEngine::Deck& MusicEngine::audibleDeckLocked() {
+    // The outgoing deck never splices, so its serial only falls behind the
+    // announced one once the incoming song has been heard.
+    if (incoming && announced_serial > primary.serial) {
+        return *incoming;
+    }
+    return primary;
+}
+
+void MusicEngine::serviceDecksLocked(RetiredSources& retired) {
+    previous_service_mixer_frame = service_mixer_frame;
+    service_mixer_frame = playback_clock.getMixerFrames();
+
+    fillAvailableFragmentsLocked(primary, retired);
+    if (incoming) {
+        fillAvailableFragmentsLocked(*incoming, retired);
+    }
+
+    if (!primary.drained) {
+        return;
+    }
+
+    if (incoming) {
+        // The outgoing song has faded out completely.
+        promoteIncomingLocked(retired);
+    } else if (!end_announced) {
+        // The last audible fragment has finished; stop like a drained stream.
+        end_announced = true;
+        al_set_audio_stream_playing(primary.stream, false);
+        playback_clock.hold(primary.source ? primary.source->getLength() : playing_position);
+        emitPlaybackEvent(ALLEGRO_EVENT_AUDIO_STREAM_FINISHED);
+    }
+}
+
+void MusicEngine::fillAvailableFragmentsLocked(Deck& deck, RetiredSources& retired) {
+    if (!deck.stream) {
+        return;
+    }
+
+    // Every fragment handed back at once: the mixer played out everything
+    // queued and has been playing silence since.
+    if (deck.fragments_filled >= deck.fragment_count && !deck.ended && !paused &&
+        al_get_available_audio_stream_fragments(deck.stream) >= deck.fragment_count &&
+        noteUnderrunLocked(deck, retired)) {
+        return;
+    }
+
+    void* fragment = nullptr;
+    while ((fragment = al_get_audio_stream_fragment(deck.stream)) != nullptr) {
+        // Once the initial fragments are queued, every fragment handed back
+        // means the one before it finished and the next queued one is playing.
+        if (deck.fragments_filled >= deck.fragment_count) {
+            notePlayingFragmentLocked(deck, deck.fragments_filled - deck.fragment_count + 1);
+            if (&deck == &primary) {
+                const double now = al_get_time();
+                if (last_fragment_time > 0.0) {
+                    fragment_interval_total += now - last_fragment_time;
+                    fragment_interval_max = std::max(fragment_interval_max, now - last_fragment_time);
+                    ++fragments_played;
+                }
+                last_fragment_time = now;
             }
         }
-        if (song && onSongChanged) {
-            onSongChanged(*song);
+
+        if (&deck == &primary) {
+            maybeStartCrossfadeLocked(retired);
         }
-        
-        // If not playing from a queue context (album/playlist), mark as individual song
-        if (playQueueModel && playQueueModel->context_type != music::PlaybackContextType::Album &&
-            playQueueModel->context_type != music::PlaybackContextType::Playlist) {
-            playQueueModel->context_type = music::PlaybackContextType::Individual;
-            playQueueModel->context_id = -1;
+        FragmentMark& mark = deck.marks[deck.fragments_filled % deck.fragment_count];
+        fillFragment(deck, fragment, mark, preloaded_source, next_serial, retired);
+        al_set_audio_stream_fragment(deck.stream, fragment);
+        ++deck.fragments_filled;
+    }
+}
+
+bool MusicEngine::noteUnderrunLocked(Deck& deck, RetiredSources& retired) {
+    ++underrun_count;
+    if (output_buffer_level + 1 < std::size(kOutputBufferShapes)) {
+        ++output_buffer_level;
+        const OutputBufferShape& shape = kOutputBufferShapes[output_buffer_level];
+        std::cerr << "Audio output underrun; buffering " << shape.fragment_count << " x "
+                  << shape.fragment_frames << " frames from now on\n";
+    }
+    buffer_level_changed_at = al_get_time();
+
+    // Nothing is queued, so the stream can be swapped for a larger one without
+    // losing audio. Ramps and lead-in count the old stream's frames, so a
+    // crossfading deck keeps its shape.
+    const OutputBufferShape& shape = kOutputBufferShapes[output_buffer_level];
+    if (&deck != &primary || incoming || deck.gain.isActive() || deck.lead_in_frames > 0 ||
+        (deck.fragment_frames == shape.fragment_frames && deck.fragment_count == shape.fragment_count)) {
+        return false;
+    }
+
+    al_destroy_audio_stream(deck.stream);
+    deck.stream = nullptr;
+    if (!createOutputStreamLocked(deck, retired, true)) {
+        std::cerr << "Failed to rebuild audio stream after underrun\n";
+    }
+    return true;
+}
+
+bool MusicEngine::resamplesItself(const StreamSource& source) const {
+    return resampler_quality == ResamplerQuality::Polyphase && source.getFrequency() != mixer_frequency;
+}
+
+unsigned int MusicEngine::streamFrequencyFor(const StreamSource& source) const {
+    return resamplesItself(source) ? mixer_frequency : source.getFrequency();
+}
+
+void MusicEngine::maybeStartCrossfadeLocked(RetiredSources& retired) {
+    if (incoming || !preloaded_source) {
+        return;
+    }
+    const std::optional<double> remaining = crossfadeRemaining(primary, crossfade_seconds);
+    if (!remaining) {
+        return;
+    }
+
+    auto deck = std::make_unique<Deck>();
+    deck->source = std::move(preloaded_source);
+    deck->serial = ++next_serial;
+    deck->stream_frequency = streamFrequencyFor(*deck->source);
+
+    // The fragment about to be faded sits behind the ones already queued on
+    // the outgoing stream.
+    const double queued_seconds = static_cast<double>((primary.fragment_count - 1) * primary.fragment_frames) / primary.stream_frequency;
+    scheduleCrossfadeIn(*deck, *remaining, queued_seconds);
+
+    incoming = std::move(deck);
+    if (!createOutputStreamLocked(*incoming, retired)) {
+        std::cerr << "Failed to start crossfade; the next song will follow without one\n";
+        preloaded_source = std::move(incoming->source);
+        preloaded_source->seek(0.0);
+        incoming.reset();
+        return;
+    }
+
+    scheduleCrossfadeOut(primary, *remaining);
+}
+
+uint64_t MusicEngine::fragmentStartLocked(const Deck& deck, uint64_t fragment_index) const {
+    // Mixer frames per stream fragment at the current speed.
+    const double stream_rate = al_get_audio_stream_frequency(deck.stream);
+    const double fragment_frames = deck.fragment_frames * mixer_frequency / (stream_rate * current_speed);
+    const uint64_t predicted = deck.clock_mixer_frame +
+        static_cast<uint64_t>(static_cast<double>(fragment_index - deck.clock_fragment) * fragment_frames);
+
+    // The previous fragment was handed back since the last feed pass, so this
+    // one started in between. An underrun delays it past the prediction.
+    return std::clamp(predicted, previous_service_mixer_frame, std::max(previous_service_mixer_frame, service_mixer_frame));
+}
+
+void MusicEngine::notePlayingFragmentLocked(Deck& deck, uint64_t fragment_index) {
+    deck.clock_mixer_frame = fragmentStartLocked(deck, fragment_index);
+    deck.clock_fragment = fragment_index;
+
+    const FragmentMark& mark = deck.marks[fragment_index % deck.fragment_count];
+    if (!mark.has_audio) {
+        if (deck.ended) {
+            deck.drained = true;
+        }
+        return;
+    }
+
+    if (mark.source_serial > announced_serial) {
+        announced_serial = mark.source_serial;
+        gapless_advanced = true;
+        emitPlaybackEvent(ALLEGRO_EVENT_MUSIC_TRACK_ADVANCED);
+    }
+    if (mark.source_serial == announced_serial) {
+        playing_position = std::max(0.0, mark.position);
+        playback_clock.anchor(mark.position, deck.clock_mixer_frame, current_speed);
+    }
+}
+
+void MusicEngine::emitPlaybackEvent(unsigned int type) {
+    if (!playback_events_ready) {
+        return;
+    }
+
+    ALLEGRO_EVENT event{};
+    event.user.type = type;
+    event.user.data1 = static_cast<intptr_t>(announced_serial);
+    al_emit_user_event(&playback_events, &event, nullptr);
+}
+
+void MusicEngine::feedThreadMain() {
+    // Polls at a fraction of a fragment's duration; fragments are handed back
+    // by the mixer one at a time, so this keeps the queue topped up without
+    // relying on the stream's event source.
+    constexpr auto kPollInterval = std::chrono::milliseconds(10);
+
+    std::unique_lock<std::mutex> lock(playback_mutex);
+    while (!quit_threads) {
+        RetiredSources retired;
+        if (const auto position = takePendingSeek()) {
+            seekLocked(*position, retired);
         }
+        serviceDecksLocked(retired);
+        if (!retired.empty()) {
+            // Destroying a source joins its loader thread; do it unlocked.
+            lock.unlock();
+            retired.clear();
+            lock.lock();
+            continue;
+        }
+        feed_cv.wait_for(lock, kPollInterval);
+    }
+}
+
+float MusicEngine::replayGainFor(const music::SongView& song) const {
+    if (replay_gain_mode == ReplayGainMode::Off) {
+        return 1.0f;
+    }
+
+    const music::ReplayGain& rg = song.replay_gain;
+    float gain_db = 0.0f;
+    float peak = 0.0f;
+    if (replay_gain_mode == ReplayGainMode::Album && rg.has_album) {
+        gain_db = rg.album_gain_db;
+        peak = rg.album_peak;
+    } else if (rg.has_track) {
+        gain_db = rg.track_gain_db;
+        peak = rg.track_peak;
+    } else {
+        return 1.0f;
+    }
+
+    // Never boost past the measured peak; lowering is always fine.
+    float gain = std::pow(10.0f, gain_db / 20.0f);
+    if (peak > 0.0f) {
+        gain = std::min(gain, 1.0f / peak);
+    }
+    return gain;
+}
+
+double MusicEngine::resumePositionFor(int song_id) const {
+    const music::SongView* song = library ? library->getSongById(song_id) : nullptr;
+    return song ? song->resume_position : 0.0;
+}
+
+void MusicEngine::saveResumePosition(double position) {
+    if (resume_path.empty() || duration < kResumeMinSeconds || !onResumePosition) {
+        return;
+    }
+    resume_saved_at = position;
+    onResumePosition(resume_path, position >= duration - kResumeEndMargin ? 0.0 : position);
+}
+
+void MusicEngine::requestPreload() {
+    if (!playQueueModel || !library) {
+        return;
+    }
+
+    const int nextId = playQueueModel->peekNext();
+    const music::SongView* song = nextId >= 0 ? library->getSongById(nextId) : nullptr;
+    const float gain = song ? replayGainFor(*song) : 1.0f;
+
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    preload_requested = true;
+    if (song) {
+        preload_request_path = song->filename;
+        preload_request_gain = gain;
+        ++preload_generation;
+        preload_cv.notify_one();
+    }
+}
+
+void MusicEngine::preloadThreadMain() {
+    std::unique_lock<std::mutex> lock(playback_mutex);
+    while (!quit_threads) {
+        preload_cv.wait(lock, [this]() { return quit_threads || !preload_request_path.empty(); });
+        if (quit_threads) {
+            break;
+        }
+
+        const std::string path = std::move(preload_request_path);
+        preload_request_path.clear();
+        const float gain = preload_request_gain;
+        const uint64_t generation = preload_generation;
+
+        // Opening parses headers, builds seek tables and primes the decoder;
+        // keep that off both the UI and feed threads.
+        lock.unlock();
+        std::unique_ptr<StreamSource> source = StreamSource::open(path, &decode_scheduler);
+        if (source) {
+            source->setGain(gain);
+        }
+        lock.lock();
+
+        std::unique_ptr<StreamSource> stale;
+        if (generation == preload_generation && !quit_threads) {
+            stale = std::move(preloaded_source);
+            preloaded_source = std::move(source);
+        } else {
+            stale = std::move(source);
+        }
+
+        lock.unlock();
+        stale.reset();
+        lock.lock();
     }
 }
 
 void MusicEngine::pauseSound() {
-    if (current_stream) {
-        al_set_audio_stream_playing(current_stream, false);
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    for (Deck* deck : {&primary, incoming.get()}) {
+        if (deck && deck->stream) {
+            al_set_audio_stream_playing(deck->stream, false);
+        }
+    }
+    if (!paused && primary.stream) {
+        // Streams stop at the next mixer block; resume picks up from there.
+        paused = true;
+        paused_mixer_frame = playback_clock.getMixerFrames();
+        playback_clock.hold(playback_clock.positionAtFrame(paused_mixer_frame));
     }
 }
 
 void MusicEngine::resumeSound() {
-    if (current_stream) {
-        al_set_audio_stream_playing(current_stream, true);
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    if (end_announced) {
+        return;
+    }
+    for (Deck* deck : {&primary, incoming.get()}) {
+        if (deck && deck->stream) {
+            al_set_audio_stream_playing(deck->stream, true);
+        }
+    }
+    if (paused) {
+        // Fragment clocks stood still while the mixer kept running.
+        const uint64_t now = playback_clock.getMixerFrames();
+        for (Deck* deck : {&primary, incoming.get()}) {
+            if (deck) {
+                deck->clock_mixer_frame += now - paused_mixer_frame;
+            }
+        }
+        paused = false;
+        playback_clock.anchor(playback_clock.positionAt(al_get_time()), now, current_speed);
     }
 }
 
 void MusicEngine::stopSound() {
-    // Stop sound code
-    if (current_stream) {
-        al_set_audio_stream_playing(current_stream, false);
-        current_stream = nullptr;
-    }
+    RetiredSources retired;
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    stopDecksLocked(retired);
+    retired.push_back(std::move(preloaded_source));
+    gapless_advanced = false;
+    playback_clock.hold(playback_clock.positionAt(al_get_time()));
 }
 
 double MusicEngine::getCurrentTime() const {
@@ -267,6 +796,36 @@ double MusicEngine::getDuration() const {
     return duration;
 }
 
+double MusicEngine::getPlayheadAt(double wallTime) const {
+    const double position = playback_clock.positionAt(wallTime);
+    return duration > 0.0 ? std::min(position, duration) : position;
+}
+
+MusicEngine::BufferStats MusicEngine::getBufferStats() const {
+    BufferStats stats;
+    {
+        std::lock_guard<std::mutex> lock(playback_mutex);
+        const OutputBufferShape& shape = kOutputBufferShapes[output_buffer_level];
+        stats.underruns = underrun_count;
+        stats.fragments_played = fragments_played;
+        stats.mean_fragment_interval = fragments_played > 0 ? fragment_interval_total / fragments_played : 0.0;
+        stats.max_fragment_interval = fragment_interval_max;
+        stats.fragment_frames = shape.fragment_frames;
+        stats.fragment_count = shape.fragment_count;
+    }
+    stats.decode_stalls = decode_scheduler.getStallCount();
+    stats.decode_ahead_frames = decode_scheduler.getAheadFrames();
+    return stats;
+}
+
+double MusicEngine::getOutputLatency() const {
+    return playback_clock.getOutputLatency();
+}
+
+void MusicEngine::setOutputLatencyOffset(double seconds) {
+    playback_clock.setLatencyOffset(seconds);
+}
+
 void MusicEngine::setGain(float gain) {
     current_gain = std::clamp(gain, 0.0f, 1.0f);
     if (mixer) {
@@ -280,40 +839,129 @@ float MusicEngine::getGain() const {
 
 void MusicEngine::setPan(float pan) {
     // Set pan code
-    if (current_stream) al_set_audio_stream_pan(current_stream, pan);
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    for (Deck* deck : {&primary, incoming.get()}) {
+        if (deck && deck->stream) al_set_audio_stream_pan(deck->stream, pan);
+    }
 }
 
 void MusicEngine::setSpeed(float speed) {
     // Set speed code
-    if (current_stream) al_set_audio_stream_speed(current_stream, speed);
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    for (Deck* deck : {&primary, incoming.get()}) {
+        if (deck && deck->stream) al_set_audio_stream_speed(deck->stream, speed);
+    }
+    if (speed > 0.0f) {
+        current_speed = speed;
+    }
+    if (!paused && primary.stream) {
+        const uint64_t now = playback_clock.getMixerFrames();
+        playback_clock.anchor(playback_clock.positionAtFrame(now), now, current_speed);
+    }
 }
 
 bool MusicEngine::isPlaying() const {
     // Check if playing code
-    return current_stream && al_get_audio_stream_playing(current_stream);
+    std::lock_guard<std::mutex> lock(playback_mutex);
+    return primary.stream && al_get_audio_stream_playing(primary.stream);
 }
 
 void MusicEngine::update() {
-    if (current_stream) {
-        current_time = al_get_audio_stream_position_secs(current_stream);
-        progressBarModel->setProgress(current_time);
-    } 
-    /*
-    else {
-        current_time = 0.0;
-        duration = 0.0;
-        progressBarModel->setProgress(0.0f);
-        progressBarModel->setFinishesAt(1.0f);
+    bool wantPreload = false;
+    bool wantResumeSave = false;
+    {
+        std::lock_guard<std::mutex> lock(playback_mutex);
+        if (!primary.source) {
+            return;
+        }
+        current_time = getPlayheadAt(al_get_time());
+        // Once a splice makes the next song audible the playhead is no longer
+        // resume_path's.
+        const Deck& audible = audibleDeckLocked();
+        wantResumeSave = duration >= kResumeMinSeconds && audible.source && audible.source->getPath() == resume_path &&
+                         std::abs(current_time - resume_saved_at) >= kResumeSaveInterval;
+        {
+            // Keep showing a requested seek until the feed thread runs it.
+            std::lock_guard<std::mutex> seek_lock(seek_mutex);
+            if (pending_seek) {
+                current_time = *pending_seek;
+            }
+        }
+        // The next song has to be open before a crossfade can start.
+        const double preload_lead = std::max(preload_seconds, crossfade_seconds + kCrossfadePreloadMargin);
+        wantPreload = !preload_requested && duration > 0.0 && (duration - current_time) <= preload_lead;
+    }
+    progressBarModel->setProgress(current_time);
+
+    if (wantResumeSave) {
+        saveResumePosition(current_time);
+    }
+    if (wantPreload) {
+        requestPreload();
     }
-    */
 }
 
 void MusicEngine::setProgress(double position) {
-    if (current_stream) {
-        al_seek_audio_stream_secs(current_stream, position);
-        current_time = position;
-        progressBarModel->setProgress(current_time);
+    RetiredSources retired;
+    {
+        std::lock_guard<std::mutex> lock(playback_mutex);
+        // An explicit seek supersedes any scrub still waiting.
+        takePendingSeek();
+        if (!seekLocked(position, retired)) {
+            return;
+        }
     }
+    current_time = position;
+    progressBarModel->setProgress(current_time);
+}
+
+void MusicEngine::requestSeek(double position) {
+    {
+        std::lock_guard<std::mutex> lock(seek_mutex);
+        pending_seek = position;
+    }
+    feed_cv.notify_one();
+    progressBarModel->setProgress(position);
+}
+
+std::optional<double> MusicEngine::takePendingSeek() {
+    std::lock_guard<std::mutex> lock(seek_mutex);
+    return std::exchange(pending_seek, std::nullopt);
+}
+
+bool MusicEngine::seekLocked(double position, RetiredSources& retired) {
+    if (incoming) {
+        // Seeking ends a crossfade; keep whichever song is being shown.
+        if (announced_serial > primary.serial) {
+            promoteIncomingLocked(retired);
+        } else {
+            incoming->source->seek(0.0);
+            retired.push_back(std::move(preloaded_source));
+            preloaded_source = std::move(incoming->source);
+            resetDeckLocked(*incoming, retired);
+            incoming.reset();
+        }
+    }
+
+    if (!primary.source || !primary.source->seek(position)) {
+        return false;
+    }
+
+    // Rebuild the output stream so queued audio from before the seek is
+    // dropped and the fragment marks start at the new position.
+    if (primary.stream) {
+        al_destroy_audio_stream(primary.stream);
+        primary.stream = nullptr;
+    }
+    primary.position = position;
+    primary.ended = false;
+    primary.fading_out = false;
+    primary.lead_in_frames = 0;
+    primary.gain.clear();
+    end_announced = false;
+    playing_position = position;
+    createOutputStreamLocked(primary, retired);
+    return true;
 }
 
 void MusicEngine::setSampleCaptureEnabled(bool enabled) {
@@ -348,13 +996,86 @@ std::vector<float> MusicEngine::copyRecentMonoSamples(size_t max_frames) const {
     return sample_capture.copyRecentMono(max_frames);
 }
 
+size_t MusicEngine::readRecentInto(float* dst, size_t max_samples) const {
+    return sample_capture.readRecentInto(dst, max_samples);
+}
+
+size_t MusicEngine::readRecentMonoInto(float* dst, size_t max_frames) const {
+    return sample_capture.readRecentMonoInto(dst, max_frames);
+}
+
+size_t MusicEngine::readAudibleInto(float* dst, size_t max_samples, double wallTime) const {
+    return sample_capture.readRecentInto(dst, max_samples, playback_clock.framesAheadOfAudible(wallTime));
+}
+
+size_t MusicEngine::readAudibleMonoInto(float* dst, size_t max_frames, double wallTime) const {
+    return sample_capture.readRecentMonoInto(dst, max_frames, playback_clock.framesAheadOfAudible(wallTime));
+}
+
+bool MusicEngine::readSpectrum(SpectrumSnapshot& out) const {
+    return spectrum_analyzer.readSnapshot(out);
+}
+
+MusicEngine::BeatInfo MusicEngine::getBeatAt(double wallTime) const {
+    BeatInfo info;
+    BeatSnapshot beat;
+    if (!beat_tracker.readSnapshot(beat) || beat.beat_period <= 0.0) {
+        return info;
+    }
+
+    const uint64_t mixed = playback_clock.getMixerFrames();
+    const uint64_t ahead = std::min(mixed, playback_clock.framesAheadOfAudible(wallTime));
+    const double beats = (static_cast<double>(mixed - ahead) - beat.beat_frame) / beat.beat_period;
+    info.bpm = beat.bpm;
+    info.confidence = beat.confidence;
+    info.phase = static_cast<float>(beats - std::floor(beats));
+    return info;
+}
+
 void MusicEngine::mixerPostprocessCallback(void* buf, unsigned int samples, void* data) {
     if (!data || !buf || samples == 0) {
         return;
     }
 
     auto* engine = static_cast<MusicEngine*>(data);
-    engine->sample_capture.appendInterleavedInt16(buf, samples);
+    const size_t channels = engine->sample_capture.channels.load(std::memory_order_relaxed);
+
+    if (engine->mixer_depth == ALLEGRO_AUDIO_DEPTH_FLOAT32) {
+        // A float mixer block is processed in place and is already in the
+        // capture format.
+        auto* interleaved = static_cast<float*>(buf);
+        engine->dsp_chain.process(interleaved, samples);
+        engine->sample_capture.appendInterleaved(interleaved, static_cast<size_t>(samples) * channels);
+        engine->spectrum_analyzer.push(interleaved, samples, channels);
+        engine->spectrum_analyzer.analyze();
+        engine->beat_tracker.push(interleaved, samples, channels, engine->playback_clock.getMixerFrames());
+        engine->playback_clock.advance(samples);
+        return;
+    }
+
+    const size_t chunk_frames = kPostprocessChunkSamples / channels;
+    auto* interleaved = static_cast<int16_t*>(buf);
+    const SampleKernels& kernels = sampleKernels();
+    const uint64_t block_frame = engine->playback_clock.getMixerFrames();
+
+    // Convert once per chunk, run the DSP chain (writing back only if a node
+    // changed something) and feed the capture ring, the analyzer and the beat
+    // tracker.
+    for (size_t frame = 0; frame < samples; frame += chunk_frames) {
+        const size_t frames = std::min<size_t>(chunk_frames, samples - frame);
+        float* scratch = engine->postprocess_scratch.data();
+        kernels.int16ToFloat(interleaved + frame * channels, scratch, frames * channels);
+        if (engine->dsp_chain.process(scratch, frames)) {
+            kernels.floatToInt16(scratch, interleaved + frame * channels, frames * channels);
+        }
+        engine->sample_capture.appendInterleaved(scratch, frames * channels);
+        engine->spectrum_analyzer.push(scratch, frames, channels);
+        engine->beat_tracker.push(scratch, frames, channels, block_frame + frame);
+    }
+
+    engine->spectrum_analyzer.analyze();
+    // After the capture write, so readers never skip frames not yet in the ring.
+    engine->playback_clock.advance(samples);
 }
 
 void MusicEngine::playNext() {
@@ -372,7 +1093,7 @@ void MusicEngine::playNext() {
         return;
     }
 
-    playSound(song->filename);
+    playSound(*song);
 }
 
 void MusicEngine::playPrevious() {
@@ -389,7 +1110,7 @@ void MusicEngine::playPrevious() {
         return;
     }
 
-    playSound(song->filename);
+    playSound(*song);
 }
 
 void MusicEngine::playAlbum(int album_id) {
@@ -431,7 +1152,7 @@ void MusicEngine::playAlbum(int album_id) {
     // Play the first song directly (don't use playNext which advances first)
     const music::SongView* firstSong = library->getSongById(albumSongs[0]->id);
     if (firstSong) {
-        playSound(firstSong->filename);
+        playSound(*firstSong);
     }
 }
 
@@ -0,0 +1,266 @@
+#include "core/parametric_eq.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define AUDIOVIS_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace core {
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+constexpr float kMinFrequency = 10.0f;
+constexpr float kMaxGainDb = 24.0f;
+constexpr float kFlatGainDb = 0.01f;
+constexpr float kDenormalThreshold = 1e-20f;
+
+bool cpuHasSse2() {
+#ifdef AUDIOVIS_X86_KERNELS
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#else
+    return false;
+#endif
+}
+}
+
+std::array<ParametricEq::Band, ParametricEq::kBandCount> ParametricEq::defaultBands() {
+    constexpr float kCenters[kBandCount] = {31.25f, 62.5f, 125.0f, 250.0f, 500.0f,
+                                            1000.0f, 2000.0f, 4000.0f, 8000.0f, 16000.0f};
+    std::array<Band, kBandCount> bands{};
+    for (size_t i = 0; i < kBandCount; ++i) {
+        bands[i].frequency = kCenters[i];
+    }
+    bands.front().type = BandType::LowShelf;
+    bands.front().q = 0.707f;
+    bands.back().type = BandType::HighShelf;
+    bands.back().q = 0.707f;
+    return bands;
+}
+
+ParametricEq::ParametricEq() {
+    slots[1] = Settings{};
+}
+
+void ParametricEq::prepare(double rate, size_t channel_count) {
+    sample_rate = rate > 0.0 ? rate : 44100.0;
+    channels = std::clamp<size_t>(channel_count, 1, kMaxChannels);
+    use_sse2 = channels == 2 && cpuHasSse2();
+    state = {};
+    applied = 0; // recompute coefficients for the new rate
+}
+
+bool ParametricEq::isFlat(const Settings& settings) {
+    if (std::fabs(settings.preamp_db) >= kFlatGainDb) {
+        return false;
+    }
+    return std::all_of(settings.bands.begin(), settings.bands.end(),
+                       [](const Band& band) { return std::fabs(band.gain_db) < kFlatGainDb; });
+}
+
+bool ParametricEq::isActive() const {
+    return isEnabled() && !flat.load(std::memory_order_relaxed);
+}
+
+void ParametricEq::setSettings(const Settings& settings) {
+    const uint64_t sequence = published.load(std::memory_order_relaxed) + 1;
+    slots[sequence & 1] = settings;
+    flat.store(isFlat(settings), std::memory_order_relaxed);
+    published.store(sequence, std::memory_order_release);
+}
+
+ParametricEq::Settings ParametricEq::getSettings() const {
+    // Only the UI thread writes slots, so its own reads need no retry.
+    return slots[published.load(std::memory_order_relaxed) & 1];
+}
+
+void ParametricEq::applyPendingSettings() {
+    const uint64_t sequence = published.load(std::memory_order_acquire);
+    if (sequence == applied) {
+        return;
+    }
+
+    const Settings settings = slots[sequence & 1];
+    // The UI thread only reuses this slot after publishing sequence + 1;
+    // if it did, keep the old coefficients and pick it up next block.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (published.load(std::memory_order_relaxed) != sequence) {
+        return;
+    }
+
+    computeCoefficients(settings);
+    applied = sequence;
+}
+
+void ParametricEq::computeCoefficients(const Settings& settings) {
+    preamp = std::pow(10.0f, std::clamp(settings.preamp_db, -kMaxGainDb, kMaxGainDb) / 20.0f);
+
+    const float nyquist_limit = static_cast<float>(sample_rate * 0.45);
+    for (size_t i = 0; i < kBandCount; ++i) {
+        const Band& band = settings.bands[i];
+        const float gain_db = std::clamp(band.gain_db, -kMaxGainDb, kMaxGainDb);
+        band_active[i] = std::fabs(gain_db) >= kFlatGainDb;
+        if (!band_active[i]) {
+            continue;
+        }
+
+        const double a = std::pow(10.0, gain_db / 40.0);
+        const double w0 = 2.0 * kPi * std::clamp(band.frequency, kMinFrequency, nyquist_limit) / sample_rate;
+        const double cos_w0 = std::cos(w0);
+        const double alpha = std::sin(w0) / (2.0 * std::max(0.1f, band.q));
+        const double shelf = 2.0 * std::sqrt(a) * alpha;
+
+        double b0, b1, b2, a0, a1, a2;
+        switch (band.type) {
+        case BandType::LowShelf:
+            b0 = a * ((a + 1.0) - (a - 1.0) * cos_w0 + shelf);
+            b1 = 2.0 * a * ((a - 1.0) - (a + 1.0) * cos_w0);
+            b2 = a * ((a + 1.0) - (a - 1.0) * cos_w0 - shelf);
+            a0 = (a + 1.0) + (a - 1.0) * cos_w0 + shelf;
+            a1 = -2.0 * ((a - 1.0) + (a + 1.0) * cos_w0);
+            a2 = (a + 1.0) + (a - 1.0) * cos_w0 - shelf;
+            break;
+        case BandType::HighShelf:
+            b0 = a * ((a + 1.0) + (a - 1.0) * cos_w0 + shelf);
+            b1 = -2.0 * a * ((a - 1.0) + (a + 1.0) * cos_w0);
+            b2 = a * ((a + 1.0) + (a - 1.0) * cos_w0 - shelf);
+            a0 = (a + 1.0) - (a - 1.0) * cos_w0 + shelf;
+            a1 = 2.0 * ((a - 1.0) - (a + 1.0) * cos_w0);
+            a2 = (a + 1.0) - (a - 1.0) * cos_w0 - shelf;
+            break;
+        case BandType::Peaking:
+        default:
+            b0 = 1.0 + alpha * a;
+            b1 = -2.0 * cos_w0;
+            b2 = 1.0 - alpha * a;
+            a0 = 1.0 + alpha / a;
+            a1 = -2.0 * cos_w0;
+            a2 = 1.0 - alpha / a;
+            break;
+        }
+
+        Coefficients& c = coefficients[i];
+        c.b0 = static_cast<float>(b0 / a0);
+        c.b1 = static_cast<float>(b1 / a0);
+        c.b2 = static_cast<float>(b2 / a0);
+        c.a1 = static_cast<float>(a1 / a0);
+        c.a2 = static_cast<float>(a2 / a0);
+    }
+}
+
+void ParametricEq::process(float* interleaved, size_t frames) {
+    if (!interleaved || frames == 0) {
+        return;
+    }
+
+    applyPendingSettings();
+#ifdef AUDIOVIS_X86_KERNELS
+    if (use_sse2) {
+        processStereoSse2(interleaved, frames);
+        flushDenormals();
+        return;
+    }
+#endif
+    processScalar(interleaved, frames);
+    flushDenormals();
+}
+
+void ParametricEq::processScalar(float* interleaved, size_t frames) {
+    const size_t count = frames * channels;
+
+    // One band over the whole block at a time keeps each section's state in
+    // registers; the block stays in L1 between passes.
+    for (size_t band = 0; band < kBandCount; ++band) {
+        if (!band_active[band]) {
+            continue;
+        }
+        const Coefficients& c = coefficients[band];
+        for (size_t channel = 0; channel < channels; ++channel) {
+            float z1 = state[band][channel].z1;
+            float z2 = state[band][channel].z2;
+            for (size_t i = channel; i < count; i += channels) {
+                const float x = interleaved[i];
+                const float y = c.b0 * x + z1;
+                z1 = c.b1 * x - c.a1 * y + z2;
+                z2 = c.b2 * x - c.a2 * y;
+                interleaved[i] = y;
+            }
+            state[band][channel].z1 = z1;
+            state[band][channel].z2 = z2;
+        }
+    }
+
+    if (preamp != 1.0f) {
+        for (size_t i = 0; i < count; ++i) {
+            interleaved[i] *= preamp;
+        }
+    }
+}
+
+#ifdef AUDIOVIS_X86_KERNELS
+__attribute__((target("sse2")))
+void ParametricEq::processStereoSse2(float* interleaved, size_t frames) {
+    // Lanes 0 and 1 carry left and right; lanes 2 and 3 are unused.
+    const __m128 gain = _mm_set1_ps(preamp);
+    for (size_t band = 0; band < kBandCount; ++band) {
+        if (!band_active[band]) {
+            continue;
+        }
+        const Coefficients& c = coefficients[band];
+        const __m128 b0 = _mm_set1_ps(c.b0);
+        const __m128 b1 = _mm_set1_ps(c.b1);
+        const __m128 b2 = _mm_set1_ps(c.b2);
+        const __m128 a1 = _mm_set1_ps(c.a1);
+        const __m128 a2 = _mm_set1_ps(c.a2);
+        __m128 z1 = _mm_setr_ps(state[band][0].z1, state[band][1].z1, 0.0f, 0.0f);
+        __m128 z2 = _mm_setr_ps(state[band][0].z2, state[band][1].z2, 0.0f, 0.0f);
+
+        for (size_t frame = 0; frame < frames; ++frame) {
+            // __m64 may alias the floats; moves the L/R pair in one load and store.
+            __m64* pair = reinterpret_cast<__m64*>(interleaved + frame * 2);
+            const __m128 x = _mm_loadl_pi(_mm_setzero_ps(), pair);
+            const __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), z1);
+            z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), z2);
+            z2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+            _mm_storel_pi(pair, y);
+        }
+
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, z1);
+        state[band][0].z1 = lanes[0];
+        state[band][1].z1 = lanes[1];
+        _mm_store_ps(lanes, z2);
+        state[band][0].z2 = lanes[0];
+        state[band][1].z2 = lanes[1];
+    }
+
+    if (preamp != 1.0f) {
+        size_t i = 0;
+        const size_t count = frames * 2;
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_ps(interleaved + i, _mm_mul_ps(_mm_loadu_ps(interleaved + i), gain));
+        }
+        for (; i < count; ++i) {
+            interleaved[i] *= preamp;
+        }
+    }
+}
+#else
+void ParametricEq::processStereoSse2(float* interleaved, size_t frames) {
+    processScalar(interleaved, frames);
+}
+#endif
+
+void ParametricEq::flushDenormals() {
+    // Filter memories decaying through silence would otherwise end up in
+    // denormal range, which is very slow on x86.
+    for (auto& band : state) {
+        for (auto& s : band) {
+            if (std::fabs(s.z1) < kDenormalThreshold) s.z1 = 0.0f;
+            if (std::fabs(s.z2) < kDenormalThreshold) s.z2 = 0.0f;
+        }
+    }
+}
+
+} // namespace core
@@ -0,0 +1,122 @@
+#include "core/pcm_format.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "core/sample_kernels.hpp"
+
+namespace core {
+namespace {
+// Signed PCM stored in an integer type, scaled and clamped to its range.
+template <typename Sample, int32_t Min, int32_t Max>
+void scaleSigned(Sample* samples, size_t frames, size_t channels, float gain, float step) {
+    for (size_t frame = 0; frame < frames; ++frame, gain += step) {
+        for (size_t channel = 0; channel < channels; ++channel) {
+            Sample& sample = samples[frame * channels + channel];
+            const float scaled = std::round(static_cast<float>(sample) * gain);
+            sample = static_cast<Sample>(std::clamp(scaled, static_cast<float>(Min), static_cast<float>(Max)));
+        }
+    }
+}
+
+// Unsigned PCM centered on Bias.
+template <typename Sample, int32_t Bias, int32_t Max>
+void scaleUnsigned(Sample* samples, size_t frames, size_t channels, float gain, float step) {
+    for (size_t frame = 0; frame < frames; ++frame, gain += step) {
+        for (size_t channel = 0; channel < channels; ++channel) {
+            Sample& sample = samples[frame * channels + channel];
+            const float centered = static_cast<float>(static_cast<int32_t>(sample) - Bias);
+            const float scaled = std::round(centered * gain) + static_cast<float>(Bias);
+            sample = static_cast<Sample>(std::clamp(scaled, 0.0f, static_cast<float>(Max)));
+        }
+    }
+}
+template <typename Sample>
+void signedToFloat(const void* pcm, float* dst, size_t count, float scale) {
+    const auto* in = static_cast<const Sample*>(pcm);
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = static_cast<float>(in[i]) * scale;
+    }
+}
+
+template <typename Sample>
+void unsignedToFloat(const void* pcm, float* dst, size_t count, int32_t bias, float scale) {
+    const auto* in = static_cast<const Sample*>(pcm);
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = static_cast<float>(static_cast<int32_t>(in[i]) - bias) * scale;
+    }
+}
+}
+
+void scalePcm(void* pcm, size_t frames, size_t channels, ALLEGRO_AUDIO_DEPTH depth, float gain, float step) {
+    if (!pcm || frames == 0 || channels == 0) {
+        return;
+    }
+
+    switch (depth) {
+        case ALLEGRO_AUDIO_DEPTH_INT8:
+            scaleSigned<int8_t, -128, 127>(static_cast<int8_t*>(pcm), frames, channels, gain, step);
+            break;
+        case ALLEGRO_AUDIO_DEPTH_INT16:
+            scaleSigned<int16_t, -32768, 32767>(static_cast<int16_t*>(pcm), frames, channels, gain, step);
+            break;
+        case ALLEGRO_AUDIO_DEPTH_INT24:
+            // Allegro keeps 24-bit samples in 32-bit words.
+            scaleSigned<int32_t, -8388608, 8388607>(static_cast<int32_t*>(pcm), frames, channels, gain, step);
+            break;
+        case ALLEGRO_AUDIO_DEPTH_UINT8:
+            scaleUnsigned<uint8_t, 0x80, 0xFF>(static_cast<uint8_t*>(pcm), frames, channels, gain, step);
+            break;
+        case ALLEGRO_AUDIO_DEPTH_UINT16:
+            scaleUnsigned<uint16_t, 0x8000, 0xFFFF>(static_cast<uint16_t*>(pcm), frames, channels, gain, step);
+            break;
+        case ALLEGRO_AUDIO_DEPTH_UINT24:
+            scaleUnsigned<uint32_t, 0x800000, 0xFFFFFF>(static_cast<uint32_t*>(pcm), frames, channels, gain, step);
+            break;
+        case ALLEGRO_AUDIO_DEPTH_FLOAT32: {
+            auto* samples = static_cast<float*>(pcm);
+            for (size_t frame = 0; frame < frames; ++frame, gain += step) {
+                for (size_t channel = 0; channel < channels; ++channel) {
+                    samples[frame * channels + channel] *= gain;
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bool pcmToFloat(const void* pcm, float* dst, size_t count, ALLEGRO_AUDIO_DEPTH depth) {
+    if (!pcm || !dst) {
+        return false;
+    }
+
+    switch (depth) {
+        case ALLEGRO_AUDIO_DEPTH_FLOAT32:
+            std::memcpy(dst, pcm, count * sizeof(float));
+            return true;
+        case ALLEGRO_AUDIO_DEPTH_INT16:
+            sampleKernels().int16ToFloat(static_cast<const int16_t*>(pcm), dst, count);
+            return true;
+        case ALLEGRO_AUDIO_DEPTH_INT8:
+            signedToFloat<int8_t>(pcm, dst, count, 1.0f / 128.0f);
+            return true;
+        case ALLEGRO_AUDIO_DEPTH_INT24:
+            signedToFloat<int32_t>(pcm, dst, count, 1.0f / 8388608.0f);
+            return true;
+        case ALLEGRO_AUDIO_DEPTH_UINT8:
+            unsignedToFloat<uint8_t>(pcm, dst, count, 0x80, 1.0f / 128.0f);
+            return true;
+        case ALLEGRO_AUDIO_DEPTH_UINT16:
+            unsignedToFloat<uint16_t>(pcm, dst, count, 0x8000, 1.0f / 32768.0f);
+            return true;
+        case ALLEGRO_AUDIO_DEPTH_UINT24:
+            unsignedToFloat<uint32_t>(pcm, dst, count, 0x800000, 1.0f / 8388608.0f);
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace core
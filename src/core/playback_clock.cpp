@@ -0,0 +1,113 @@
+#include "core/playback_clock.hpp"
+#include <algorithm>
+#include <allegro5/allegro.h>
+
+namespace core {
+
+void PlaybackClock::configure(unsigned int mixer_frequency) {
+    frequency.store(std::max(1u, mixer_frequency), std::memory_order_relaxed);
+}
+
+void PlaybackClock::advance(unsigned int frames) {
+    const uint64_t sequence = block_sequence.load(std::memory_order_relaxed) + 1;
+    const Block& previous = blocks[(sequence - 1) & 1];
+    Block& slot = blocks[sequence & 1];
+    slot.end_frame = previous.end_frame + frames;
+    slot.frames = frames;
+    slot.rendered_at = al_get_time();
+    block_sequence.store(sequence, std::memory_order_release);
+}
+
+PlaybackClock::Block PlaybackClock::readBlock() const {
+    Block out;
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        const uint64_t sequence = block_sequence.load(std::memory_order_acquire);
+        out = blocks[sequence & 1];
+        // The writer only reuses this slot after publishing sequence + 1.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (block_sequence.load(std::memory_order_relaxed) == sequence) {
+            break;
+        }
+    }
+    return out;
+}
+
+uint64_t PlaybackClock::getMixerFrames() const {
+    return readBlock().end_frame;
+}
+
+void PlaybackClock::anchor(double position, uint64_t mixer_frame, double speed) {
+    const uint64_t sequence = anchor_sequence.load(std::memory_order_relaxed) + 1;
+    anchors[sequence & 1] = Anchor{position, mixer_frame, speed};
+    anchor_sequence.store(sequence, std::memory_order_release);
+}
+
+void PlaybackClock::hold(double position) {
+    anchor(position, getMixerFrames(), 0.0);
+}
+
+PlaybackClock::Anchor PlaybackClock::readAnchor() const {
+    Anchor out;
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        const uint64_t sequence = anchor_sequence.load(std::memory_order_acquire);
+        out = anchors[sequence & 1];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (anchor_sequence.load(std::memory_order_relaxed) == sequence) {
+            break;
+        }
+    }
+    return out;
+}
+
+void PlaybackClock::setLatencyOffset(double seconds) {
+    latency_offset.store(std::max(0.0, seconds), std::memory_order_relaxed);
+}
+
+double PlaybackClock::getOutputLatency() const {
+    const Block block = readBlock();
+    const double rate = frequency.load(std::memory_order_relaxed);
+    return kQueuedBlocks * block.frames / rate + latency_offset.load(std::memory_order_relaxed);
+}
+
+double PlaybackClock::audibleFrameAt(const Block& block, double wall_time) const {
+    const double rate = frequency.load(std::memory_order_relaxed);
+    const double elapsed = std::clamp(wall_time - block.rendered_at, 0.0, kMaxExtrapolation);
+
+    // The first frame of the newest block is heard once the queued blocks
+    // ahead of it have played.
+    const double block_start = static_cast<double>(block.end_frame) -
+                               static_cast<double>(block.frames) * (1 + kQueuedBlocks);
+    return block_start + elapsed * rate - latency_offset.load(std::memory_order_relaxed) * rate;
+}
+
+double PlaybackClock::positionAt(double wall_time) const {
+    return extrapolate(audibleFrameAt(readBlock(), wall_time));
+}
+
+double PlaybackClock::positionAtFrame(uint64_t mixer_frame) const {
+    return extrapolate(static_cast<double>(mixer_frame));
+}
+
+double PlaybackClock::extrapolate(double mixer_frame) const {
+    const Anchor anchored = readAnchor();
+    if (anchored.speed <= 0.0) {
+        return anchored.position;
+    }
+
+    const double since_anchor = mixer_frame - static_cast<double>(anchored.mixer_frame);
+    if (since_anchor <= 0.0) {
+        // The anchored audio is still in the output queue.
+        return std::max(0.0, anchored.position);
+    }
+    const double rate = frequency.load(std::memory_order_relaxed);
+    return std::max(0.0, anchored.position + since_anchor * anchored.speed / rate);
+}
+
+uint64_t PlaybackClock::framesAheadOfAudible(double wall_time) const {
+    const Block block = readBlock();
+    const double audible = std::max(0.0, audibleFrameAt(block, wall_time));
+    const double ahead = static_cast<double>(block.end_frame) - audible;
+    return ahead > 0.0 ? static_cast<uint64_t>(ahead) : 0;
+}
+
+} // namespace core
@@ -0,0 +1,124 @@
+#include "core/polyphase_resampler.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace core {
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kKaiserBeta = 8.6; // ~90 dB stopband
+constexpr double kPassband = 0.95;  // cutoff as a fraction of the lower Nyquist
+constexpr size_t kHalfTaps = PolyphaseResampler::kTaps / 2;
+
+double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+}
+
+PolyphaseResampler::PolyphaseResampler(double input_rate, double output_rate, size_t channel_count)
+    : channels(std::max<size_t>(1, channel_count)),
+      step(input_rate / output_rate) {
+    const double cutoff = kPassband * std::min(1.0, output_rate / input_rate);
+    const double window_norm = besselI0(kKaiserBeta);
+
+    // Row p holds the kernel for an output that falls p/kPhases of the way
+    // from input frame i to i+1; tap k multiplies input frame i - kHalfTaps + 1 + k.
+    table.resize((kPhases + 1) * kTaps);
+    for (size_t p = 0; p <= kPhases; ++p) {
+        const double frac = static_cast<double>(p) / kPhases;
+        double sum = 0.0;
+        for (size_t k = 0; k < kTaps; ++k) {
+            const double t = static_cast<double>(k) - static_cast<double>(kHalfTaps - 1) - frac;
+            const double x = t / kHalfTaps;
+            const double window = std::abs(x) >= 1.0
+                ? 0.0
+                : besselI0(kKaiserBeta * std::sqrt(1.0 - x * x)) / window_norm;
+            const double arg = kPi * cutoff * t;
+            const double sinc = std::abs(arg) < 1e-9 ? 1.0 : std::sin(arg) / arg;
+            const double h = cutoff * sinc * window;
+            table[p * kTaps + k] = static_cast<float>(h);
+            sum += h;
+        }
+        // Unity DC gain for every phase.
+        for (size_t k = 0; k < kTaps; ++k) {
+            table[p * kTaps + k] = static_cast<float>(table[p * kTaps + k] / sum);
+        }
+    }
+
+    reset();
+}
+
+void PolyphaseResampler::reset() {
+    // Start with half a kernel of silence so the first output is centered on
+    // the first real input frame.
+    input.assign((kHalfTaps - 1) * channels, 0.0f);
+    input_frames = kHalfTaps - 1;
+    position = static_cast<double>(kHalfTaps - 1);
+}
+
+void PolyphaseResampler::push(const float* interleaved, size_t frames) {
+    if (!interleaved || frames == 0) {
+        return;
+    }
+    input.insert(input.end(), interleaved, interleaved + frames * channels);
+    input_frames += frames;
+}
+
+void PolyphaseResampler::flush() {
+    input.resize(input.size() + kHalfTaps * channels, 0.0f);
+    input_frames += kHalfTaps;
+}
+
+size_t PolyphaseResampler::pull(float* interleaved, size_t frames) {
+    if (!interleaved) {
+        return 0;
+    }
+
+    size_t produced = 0;
+    while (produced < frames) {
+        const size_t base = static_cast<size_t>(position);
+        if (base + kHalfTaps >= input_frames) {
+            break; // need more input
+        }
+
+        const double phase = (position - static_cast<double>(base)) * kPhases;
+        const size_t p = std::min(static_cast<size_t>(phase), kPhases - 1);
+        const float alpha = static_cast<float>(phase - static_cast<double>(p));
+        const float* row0 = table.data() + p * kTaps;
+        const float* row1 = row0 + kTaps;
+        const float* first = input.data() + (base + 1 - kHalfTaps) * channels;
+
+        float* out = interleaved + produced * channels;
+        for (size_t c = 0; c < channels; ++c) {
+            float acc = 0.0f;
+            for (size_t k = 0; k < kTaps; ++k) {
+                const float h = row0[k] + alpha * (row1[k] - row0[k]);
+                acc += h * first[k * channels + c];
+            }
+            out[c] = acc;
+        }
+
+        ++produced;
+        position += step;
+    }
+
+    // Drop input that no future output can reach.
+    const size_t base = static_cast<size_t>(position);
+    if (base >= kHalfTaps) {
+        const size_t drop = std::min(base + 1 - kHalfTaps, input_frames);
+        input.erase(input.begin(), input.begin() + drop * channels);
+        input_frames -= drop;
+        position -= static_cast<double>(drop);
+    }
+    return produced;
+}
+
+} // namespace core
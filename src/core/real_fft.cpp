@@ -0,0 +1,79 @@
+#include "core/real_fft.hpp"
+#include <cmath>
+#include <utility>
+
+namespace core {
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+
+// Plain complex product. std::complex's operator* also handles infinities
+// and NaNs, which without -ffast-math costs a library call check per
+// butterfly; the results for finite values are the same.
+inline std::complex<float> multiply(std::complex<float> a, std::complex<float> b) {
+    return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+}
+}
+
+void RealFft::configure(size_t requested) {
+    size = requested;
+    half_size = size / 2;
+
+    size_t bits = 0;
+    while ((size_t{1} << bits) < half_size) {
+        ++bits;
+    }
+    bit_reverse.resize(half_size);
+    for (size_t i = 0; i < half_size; ++i) {
+        uint32_t reversed = 0;
+        for (size_t bit = 0; bit < bits; ++bit) {
+            reversed |= static_cast<uint32_t>(((i >> bit) & 1u) << (bits - 1 - bit));
+        }
+        bit_reverse[i] = reversed;
+    }
+
+    fft_twiddles.resize(half_size / 2);
+    for (size_t k = 0; k < fft_twiddles.size(); ++k) {
+        const double angle = -2.0 * kPi * static_cast<double>(k) / static_cast<double>(half_size);
+        fft_twiddles[k] = {static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle))};
+    }
+    real_twiddles.resize(half_size + 1);
+    for (size_t k = 0; k <= half_size; ++k) {
+        const double angle = -2.0 * kPi * static_cast<double>(k) / static_cast<double>(size);
+        real_twiddles[k] = {static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle))};
+    }
+    buffer.assign(half_size, {0.0f, 0.0f});
+}
+
+void RealFft::transform(float* out) {
+    for (size_t i = 0; i < half_size; ++i) {
+        const size_t j = bit_reverse[i];
+        if (j > i) {
+            std::swap(buffer[i], buffer[j]);
+        }
+    }
+
+    for (size_t length = 2; length <= half_size; length <<= 1) {
+        const size_t half = length / 2;
+        const size_t step = half_size / length;
+        for (size_t start = 0; start < half_size; start += length) {
+            for (size_t k = 0; k < half; ++k) {
+                const std::complex<float> even = buffer[start + k];
+                const std::complex<float> odd = multiply(buffer[start + k + half], fft_twiddles[k * step]);
+                buffer[start + k] = even + odd;
+                buffer[start + k + half] = even - odd;
+            }
+        }
+    }
+
+    // Split the half-size result back into the spectrum of the real input.
+    for (size_t k = 0; k <= half_size; ++k) {
+        const std::complex<float> z = buffer[k % half_size];
+        const std::complex<float> mirrored = std::conj(buffer[(half_size - k) % half_size]);
+        const std::complex<float> even = (z + mirrored) * 0.5f;
+        const std::complex<float> difference = z - mirrored;
+        const std::complex<float> odd(difference.imag() * 0.5f, difference.real() * -0.5f); // * -0.5i
+        out[k] = std::norm(even + multiply(real_twiddles[k], odd));
+    }
+}
+
+} // namespace core
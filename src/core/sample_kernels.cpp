@@ -0,0 +1,185 @@
+#include "core/sample_kernels.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define AUDIOVIS_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace core {
+namespace {
+constexpr float kInt16Scale = 1.0f / 32768.0f; // exact power of two, same result as dividing
+
+void int16ToFloatScalar(const int16_t* src, float* dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = static_cast<float>(src[i]) * kInt16Scale;
+    }
+}
+
+void floatToInt16Scalar(const float* src, int16_t* dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        // Written like SSE max/min so NaN saturates the same way.
+        float v = src[i] * 32768.0f;
+        v = v > -32768.0f ? v : -32768.0f;
+        v = v < 32767.0f ? v : 32767.0f;
+        dst[i] = static_cast<int16_t>(std::nearbyint(v));
+    }
+}
+
+void downmixToMonoScalar(const float* src, float* dst, size_t frames, size_t channels) {
+    const float divisor = static_cast<float>(channels);
+    for (size_t frame = 0; frame < frames; ++frame) {
+        const float* in = src + frame * channels;
+        float sum = 0.0f;
+        for (size_t channel = 0; channel < channels; ++channel) {
+            sum += in[channel];
+        }
+        dst[frame] = sum / divisor;
+    }
+}
+
+#ifdef AUDIOVIS_X86_KERNELS
+__attribute__((target("sse2")))
+void int16ToFloatSse2(const int16_t* src, float* dst, size_t count) {
+    const __m128 scale = _mm_set1_ps(kInt16Scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        // Interleave each int16 with itself, then arithmetic-shift to sign-extend.
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    int16ToFloatScalar(src + i, dst + i, count - i);
+}
+
+__attribute__((target("sse2")))
+void floatToInt16Sse2(const float* src, int16_t* dst, size_t count) {
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), lo), hi);
+        const __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), lo), hi);
+        const __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+    floatToInt16Scalar(src + i, dst + i, count - i);
+}
+
+__attribute__((target("sse2")))
+void downmixToMonoSse2(const float* src, float* dst, size_t frames, size_t channels) {
+    if (channels != 2) {
+        downmixToMonoScalar(src, dst, frames, channels);
+        return;
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 divisor = _mm_set1_ps(2.0f);
+    size_t frame = 0;
+    for (; frame + 4 <= frames; frame += 4) {
+        const __m128 a = _mm_loadu_ps(src + frame * 2);
+        const __m128 b = _mm_loadu_ps(src + frame * 2 + 4);
+        const __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        // Keep the scalar summation order (0 + L) + R so signed zeros match.
+        const __m128 sum = _mm_add_ps(_mm_add_ps(zero, left), right);
+        _mm_storeu_ps(dst + frame, _mm_div_ps(sum, divisor));
+    }
+    downmixToMonoScalar(src + frame * 2, dst + frame, frames - frame, 2);
+}
+
+__attribute__((target("avx2")))
+void int16ToFloatAvx2(const int16_t* src, float* dst, size_t count) {
+    const __m256 scale = _mm256_set1_ps(kInt16Scale);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a)), scale));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b)), scale));
+    }
+    int16ToFloatScalar(src + i, dst + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void downmixToMonoAvx2(const float* src, float* dst, size_t frames, size_t channels) {
+    if (channels != 2) {
+        downmixToMonoScalar(src, dst, frames, channels);
+        return;
+    }
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 divisor = _mm256_set1_ps(2.0f);
+    size_t frame = 0;
+    for (; frame + 8 <= frames; frame += 8) {
+        const __m256 a = _mm256_loadu_ps(src + frame * 2);
+        const __m256 b = _mm256_loadu_ps(src + frame * 2 + 8);
+        // Per 128-bit lane this yields L0 L1 L4 L5 | L2 L3 L6 L7; the 64-bit
+        // permute restores frame order.
+        const __m256 leftLanes = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m256 rightLanes = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        const __m256 left = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(leftLanes), _MM_SHUFFLE(3, 1, 2, 0)));
+        const __m256 right = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(rightLanes), _MM_SHUFFLE(3, 1, 2, 0)));
+        const __m256 sum = _mm256_add_ps(_mm256_add_ps(zero, left), right);
+        _mm256_storeu_ps(dst + frame, _mm256_div_ps(sum, divisor));
+    }
+    downmixToMonoScalar(src + frame * 2, dst + frame, frames - frame, 2);
+}
+#endif
+
+const SampleKernels kScalarKernels{"scalar", &int16ToFloatScalar, &floatToInt16Scalar, &downmixToMonoScalar};
+#ifdef AUDIOVIS_X86_KERNELS
+// Saturating conversion is store-bound; the SSE2 version keeps up with AVX2.
+const SampleKernels kAvx2Kernels{"avx2", &int16ToFloatAvx2, &floatToInt16Sse2, &downmixToMonoAvx2};
+const SampleKernels kSse2Kernels{"sse2", &int16ToFloatSse2, &floatToInt16Sse2, &downmixToMonoSse2};
+#endif
+
+const SampleKernels* supportedKernels(const std::string& name) {
+#ifdef AUDIOVIS_X86_KERNELS
+    __builtin_cpu_init();
+    if (name == kAvx2Kernels.name) {
+        return __builtin_cpu_supports("avx2") ? &kAvx2Kernels : nullptr;
+    }
+    if (name == kSse2Kernels.name) {
+        return __builtin_cpu_supports("sse2") ? &kSse2Kernels : nullptr;
+    }
+#endif
+    return name == kScalarKernels.name ? &kScalarKernels : nullptr;
+}
+
+const SampleKernels& selectSampleKernels() {
+    if (const char* forced = std::getenv("AUDIOVIS_SAMPLE_KERNELS")) {
+        if (const SampleKernels* kernels = supportedKernels(forced)) {
+            return *kernels;
+        }
+        std::cerr << "AUDIOVIS_SAMPLE_KERNELS=" << forced << " is not supported here; picking the best kernels\n";
+    }
+    for (const char* name : {"avx2", "sse2"}) {
+        if (const SampleKernels* kernels = supportedKernels(name)) {
+            return *kernels;
+        }
+    }
+    return kScalarKernels;
+}
+}
+
+const SampleKernels& sampleKernels() {
+    static const SampleKernels& kernels = selectSampleKernels();
+    return kernels;
+}
+
+const SampleKernels& scalarSampleKernels() {
+    return kScalarKernels;
+}
+
+const SampleKernels* sampleKernelsNamed(const char* name) {
+    return name ? supportedKernels(name) : nullptr;
+}
+
+} // namespace core
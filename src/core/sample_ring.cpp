@@ -0,0 +1,214 @@
+#include "core/sample_ring.hpp"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include "core/sample_kernels.hpp"
+
+namespace core {
+namespace {
+size_t roundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+}
+
+SampleRing::Storage::Storage(size_t capacity)
+    : samples(new float[capacity]()), capacity(capacity), mask(capacity - 1) {}
+
+SampleRing::SampleRing() : kernels(&sampleKernels()) {}
+
+SampleRing::~SampleRing() {
+    delete storage.load(std::memory_order_acquire);
+}
+
+void SampleRing::setCapacity(size_t sample_count) {
+    Storage* fresh = sample_count > 0 ? new Storage(roundUpToPowerOfTwo(sample_count)) : nullptr;
+    Storage* old = storage.exchange(fresh, std::memory_order_seq_cst);
+
+    // A producer may still be writing into the old storage; it never holds on
+    // to it for longer than one callback, so this wait is short and only ever
+    // happens on the consumer side.
+    while (active_producers.load(std::memory_order_seq_cst) != 0) {
+        std::this_thread::yield();
+    }
+
+    read_index.store(write_index.load(std::memory_order_acquire), std::memory_order_release);
+    delete old;
+}
+
+size_t SampleRing::getCapacity() const {
+    const Storage* ring = storage.load(std::memory_order_acquire);
+    return ring ? ring->capacity : 0;
+}
+
+size_t SampleRing::getSize() const {
+    const Storage* ring = storage.load(std::memory_order_acquire);
+    return ring ? availableSamples(*ring, write_index.load(std::memory_order_acquire)) : 0;
+}
+
+void SampleRing::clear() {
+    read_index.store(write_index.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+size_t SampleRing::availableSamples(const Storage& ring, uint64_t end) const {
+    const uint64_t begin = read_index.load(std::memory_order_acquire);
+    const uint64_t buffered = end > begin ? end - begin : 0;
+    return static_cast<size_t>(std::min<uint64_t>(buffered, ring.capacity));
+}
+
+size_t SampleRing::tornSamples(const Storage& ring, uint64_t start) const {
+    // Order the sample loads above before re-reading the reservation, so any
+    // slot the producer started overwriting during the copy is visible here.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t reserved = write_reserve.load(std::memory_order_relaxed);
+    // Slot i is reused by sample i + capacity, so everything older than
+    // reserved - capacity may have been overwritten.
+    return reserved - start > ring.capacity ? static_cast<size_t>(reserved - start - ring.capacity) : 0;
+}
+
+size_t SampleRing::readRecent(float* dst, size_t max_samples, size_t skip_newest) const {
+    const Storage* ring = storage.load(std::memory_order_acquire);
+    if (!ring || !dst || max_samples == 0) {
+        return 0;
+    }
+
+    size_t sample_count = 0;
+    size_t torn = 0;
+    for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt) {
+        const uint64_t newest = write_index.load(std::memory_order_acquire);
+        const size_t available = availableSamples(*ring, newest);
+        const size_t skipped = std::min(skip_newest, available);
+        sample_count = std::min(max_samples, available - skipped);
+        const uint64_t start = newest - skipped - sample_count;
+
+        const size_t offset = static_cast<size_t>(start & ring->mask);
+        const size_t first = std::min(sample_count, ring->capacity - offset);
+        std::memcpy(dst, ring->samples.get() + offset, first * sizeof(float));
+        std::memcpy(dst + first, ring->samples.get(), (sample_count - first) * sizeof(float));
+
+        torn = tornSamples(*ring, start);
+        if (torn == 0) {
+            break;
+        }
+    }
+
+    // Still lapped after the last attempt: keep only the newer part the
+    // producer cannot have reached.
+    if (torn >= sample_count) {
+        return 0;
+    }
+    if (torn > 0) {
+        sample_count -= torn;
+        std::memmove(dst, dst + torn, sample_count * sizeof(float));
+    }
+    return sample_count;
+}
+
+size_t SampleRing::readRecentMono(float* dst, size_t max_frames, size_t channels, size_t skip_newest) const {
+    const Storage* ring = storage.load(std::memory_order_acquire);
+    if (!ring || !dst || max_frames == 0) {
+        return 0;
+    }
+
+    const size_t channel_count = std::clamp<size_t>(channels, 1, kMaxChannels);
+    size_t frame_count = 0;
+    size_t torn_frames = 0;
+    for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt) {
+        const uint64_t newest = write_index.load(std::memory_order_acquire);
+        const size_t available_frames = availableSamples(*ring, newest) / channel_count;
+        const size_t skipped = std::min(skip_newest, available_frames);
+        frame_count = std::min(max_frames, available_frames - skipped);
+        const uint64_t start = newest - (skipped + frame_count) * channel_count;
+
+        // The requested range wraps at most once. With a non power-of-two
+        // channel count one frame may straddle the wrap; gather just that one.
+        const size_t offset = static_cast<size_t>(start & ring->mask);
+        const size_t head_frames = std::min(frame_count, (ring->capacity - offset) / channel_count);
+        kernels->downmixToMono(ring->samples.get() + offset, dst, head_frames, channel_count);
+
+        size_t frame = head_frames;
+        if (frame < frame_count && (ring->capacity - offset) % channel_count != 0) {
+            float straddling[kMaxChannels];
+            const uint64_t frame_start = start + frame * channel_count;
+            for (size_t channel = 0; channel < channel_count; ++channel) {
+                straddling[channel] = ring->samples[(frame_start + channel) & ring->mask];
+            }
+            kernels->downmixToMono(straddling, dst + frame, 1, channel_count);
+            ++frame;
+        }
+
+        if (frame < frame_count) {
+            const size_t tail_offset = static_cast<size_t>((start + frame * channel_count) & ring->mask);
+            kernels->downmixToMono(ring->samples.get() + tail_offset, dst + frame, frame_count - frame, channel_count);
+        }
+
+        torn_frames = (tornSamples(*ring, start) + channel_count - 1) / channel_count;
+        if (torn_frames == 0) {
+            break;
+        }
+    }
+
+    if (torn_frames >= frame_count) {
+        return 0;
+    }
+    if (torn_frames > 0) {
+        frame_count -= torn_frames;
+        std::memmove(dst, dst + torn_frames, frame_count * sizeof(float));
+    }
+    return frame_count;
+}
+
+SampleRing::Storage* SampleRing::beginWrite() {
+    active_producers.fetch_add(1, std::memory_order_seq_cst);
+    return storage.load(std::memory_order_seq_cst);
+}
+
+void SampleRing::endWrite() {
+    active_producers.fetch_sub(1, std::memory_order_release);
+}
+
+template <typename ConvertFn>
+void SampleRing::writeRuns(Storage& ring, size_t count, ConvertFn&& convert) {
+    const uint64_t begin = write_index.load(std::memory_order_relaxed);
+    write_reserve.store(begin + count, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Only the newest `capacity` samples can survive, so skip the rest, then
+    // convert in at most two contiguous runs split at the wrap point.
+    const size_t skipped = count > ring.capacity ? count - ring.capacity : 0;
+    const size_t kept = count - skipped;
+    const size_t offset = static_cast<size_t>((begin + skipped) & ring.mask);
+    const size_t first = std::min(kept, ring.capacity - offset);
+    convert(skipped, ring.samples.get() + offset, first);
+    if (first < kept) {
+        convert(skipped + first, ring.samples.get(), kept - first);
+    }
+
+    write_index.store(begin + count, std::memory_order_release);
+}
+
+void SampleRing::write(const float* src, size_t count) {
+    Storage* ring = beginWrite();
+    if (ring && src && count > 0) {
+        writeRuns(*ring, count, [src](size_t src_offset, float* dst, size_t run) {
+            std::memcpy(dst, src + src_offset, run * sizeof(float));
+        });
+    }
+    endWrite();
+}
+
+void SampleRing::writeInt16(const int16_t* src, size_t count) {
+    Storage* ring = beginWrite();
+    if (ring && src && count > 0) {
+        const SampleKernels* active = kernels;
+        writeRuns(*ring, count, [src, active](size_t src_offset, float* dst, size_t run) {
+            active->int16ToFloat(src + src_offset, dst, run);
+        });
+    }
+    endWrite();
+}
+
+} // namespace core
@@ -0,0 +1,180 @@
+#include "core/spectrum_analyzer.hpp"
+#include <algorithm>
+#include <cmath>
+#include "core/sample_kernels.hpp"
+
+namespace core {
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+constexpr float kPowerEpsilon = 1e-12f;
+
+size_t roundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+float windowValue(SpectrumAnalyzer::Window type, size_t i, size_t size) {
+    const double phase = 2.0 * kPi * static_cast<double>(i) / static_cast<double>(size);
+    switch (type) {
+        case SpectrumAnalyzer::Window::Blackman:
+            return static_cast<float>(0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase));
+        case SpectrumAnalyzer::Window::Hann:
+        default:
+            return static_cast<float>(0.5 - 0.5 * std::cos(phase));
+    }
+}
+}
+
+SpectrumAnalyzer::SpectrumAnalyzer() {
+    configure(sample_rate, settings);
+}
+
+void SpectrumAnalyzer::configure(float rate, const Settings& requested) {
+    settings = requested;
+    sample_rate = rate > 0.0f ? rate : 44100.0f;
+    fft_size = std::max<size_t>(64, roundUpToPowerOfTwo(settings.fft_size));
+    settings.fft_size = fft_size;
+    half_size = fft_size / 2;
+
+    history.assign(fft_size, 0.0f);
+    history_pos = 0;
+    pending_frames = 0;
+    mono_scratch.assign(kPushChunkFrames, 0.0f);
+
+    window.resize(fft_size);
+    float window_sum = 0.0f;
+    for (size_t i = 0; i < fft_size; ++i) {
+        window[i] = windowValue(settings.window, i, fft_size);
+        window_sum += window[i];
+    }
+    // Scales a full-scale sine to 0 dBFS.
+    amplitude_scale = window_sum > 0.0f ? 2.0f / window_sum : 0.0f;
+
+    fft.configure(fft_size);
+    bin_power.assign(half_size + 1, 0.0f);
+
+    // Log-spaced band edges between min and max frequency. Narrow low bands
+    // that fall between two bins borrow the nearest bin.
+    const size_t band_count = std::clamp<size_t>(settings.band_count, 1, SpectrumSnapshot::kMaxBands);
+    settings.band_count = band_count;
+    const float nyquist = sample_rate * 0.5f;
+    const float min_hz = std::clamp(settings.min_frequency, 1.0f, nyquist);
+    const float max_hz = std::clamp(settings.max_frequency, min_hz, nyquist);
+    const float bin_hz = sample_rate / static_cast<float>(fft_size);
+    const float ratio = max_hz / min_hz;
+
+    bands.resize(band_count);
+    std::array<float, SpectrumSnapshot::kMaxBands> centers{};
+    for (size_t b = 0; b < band_count; ++b) {
+        const float low = min_hz * std::pow(ratio, static_cast<float>(b) / static_cast<float>(band_count));
+        const float high = min_hz * std::pow(ratio, static_cast<float>(b + 1) / static_cast<float>(band_count));
+        centers[b] = std::sqrt(low * high);
+
+        auto first = static_cast<size_t>(std::ceil(low / bin_hz));
+        auto last = static_cast<size_t>(std::floor(high / bin_hz));
+        if (last < first) {
+            first = last = static_cast<size_t>(std::lround(centers[b] / bin_hz));
+        }
+        bands[b].first_bin = std::clamp<size_t>(first, 1, half_size);
+        bands[b].last_bin = std::clamp<size_t>(last, bands[b].first_bin, half_size);
+    }
+
+    smoothed_db.fill(settings.floor_db);
+    for (auto& slot : slots) {
+        slot = SpectrumSnapshot{};
+        slot.band_count = band_count;
+        slot.sample_rate = sample_rate;
+        slot.floor_db = settings.floor_db;
+        slot.band_center_hz = centers;
+    }
+    published.store(0, std::memory_order_release);
+}
+
+void SpectrumAnalyzer::push(const float* interleaved, size_t frames, size_t channels) {
+    if (!interleaved || frames == 0 || channels == 0 || fft_size == 0) {
+        return;
+    }
+
+    const SampleKernels& kernels = sampleKernels();
+    while (frames > 0) {
+        const size_t chunk = std::min(frames, kPushChunkFrames);
+        kernels.downmixToMono(interleaved, mono_scratch.data(), chunk, channels);
+
+        for (size_t i = 0; i < chunk; ++i) {
+            history[history_pos] = mono_scratch[i];
+            history_pos = (history_pos + 1) & (fft_size - 1);
+        }
+
+        interleaved += chunk * channels;
+        frames -= chunk;
+        pending_frames += chunk;
+    }
+}
+
+void SpectrumAnalyzer::analyze() {
+    if (fft_size == 0 || pending_frames == 0) {
+        return;
+    }
+
+    // Windowed history, oldest sample first.
+    fft.power([this](size_t i) {
+        return history[(history_pos + i) & (fft_size - 1)] * window[i];
+    }, bin_power.data());
+    const float power_scale = amplitude_scale * amplitude_scale;
+    for (size_t k = 0; k <= half_size; ++k) {
+        bin_power[k] *= power_scale;
+    }
+
+    const float elapsed = static_cast<float>(pending_frames) / sample_rate;
+    pending_frames = 0;
+    const float attack = settings.attack_seconds > 0.0f ? std::exp(-elapsed / settings.attack_seconds) : 0.0f;
+    const float release = settings.release_seconds > 0.0f ? std::exp(-elapsed / settings.release_seconds) : 0.0f;
+
+    const uint64_t sequence = published.load(std::memory_order_relaxed) + 1;
+    SpectrumSnapshot& slot = slots[sequence & 1];
+    const float floor_db = settings.floor_db;
+
+    for (size_t b = 0; b < bands.size(); ++b) {
+        float power = 0.0f;
+        for (size_t bin = bands[b].first_bin; bin <= bands[b].last_bin; ++bin) {
+            power += bin_power[bin];
+        }
+        power /= static_cast<float>(bands[b].last_bin - bands[b].first_bin + 1);
+
+        const float db = std::max(floor_db, 10.0f * std::log10(power + kPowerEpsilon));
+        const float coefficient = db > smoothed_db[b] ? attack : release;
+        smoothed_db[b] = db + (smoothed_db[b] - db) * coefficient;
+
+        slot.band_db[b] = smoothed_db[b];
+        slot.band_level[b] = floor_db < 0.0f
+            ? std::clamp((smoothed_db[b] - floor_db) / -floor_db, 0.0f, 1.0f)
+            : 0.0f;
+    }
+    slot.sequence = sequence;
+
+    published.store(sequence, std::memory_order_release);
+}
+
+bool SpectrumAnalyzer::readSnapshot(SpectrumSnapshot& out) const {
+    for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt) {
+        const uint64_t sequence = published.load(std::memory_order_acquire);
+        if (sequence == 0) {
+            return false;
+        }
+
+        out = slots[sequence & 1];
+
+        // The writer only touches this slot again once it starts publishing
+        // sequence + 2, which first requires publishing sequence + 1.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (published.load(std::memory_order_relaxed) == sequence) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace core
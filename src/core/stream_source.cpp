@@ -0,0 +1,154 @@
+#include "core/stream_source.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "core/decode_scheduler.hpp"
+
+namespace core {
+namespace {
+// Frames a worker decodes per turn, so one source cannot hold a worker (or
+// its reader) for long.
+constexpr size_t kAheadBlockFrames = 4096;
+}
+
+StreamSource::~StreamSource() {
+    if (scheduler) {
+        scheduler->detach(this);
+    }
+}
+
+std::unique_ptr<StreamSource> StreamSource::open(const std::string& file_path, DecodeScheduler* scheduler) {
+    std::unique_ptr<Decoder> decoder = openDecoder(file_path);
+    if (!decoder) {
+        std::cerr << "StreamSource: failed to open " << file_path << "\n";
+        return nullptr;
+    }
+
+    std::unique_ptr<StreamSource> source(new StreamSource());
+    const DecoderFormat& format = decoder->getFormat();
+    source->path = file_path;
+    source->frequency = format.frequency;
+    source->depth = format.depth;
+    source->channels = format.channels;
+    source->frame_size = format.frameSize();
+    source->length = decoder->getLength();
+    source->decoder = std::move(decoder);
+
+    if (scheduler) {
+        source->ahead_capacity = scheduler->getAheadFrames();
+        source->ahead.resize(source->ahead_capacity * source->frame_size);
+        source->scheduler = scheduler;
+        scheduler->attach(source.get());
+    }
+    return source;
+}
+
+size_t StreamSource::read(void* dst, size_t frames) {
+    if (!decoder || !dst || frames == 0 || frame_size == 0) {
+        return 0;
+    }
+
+    auto* out = static_cast<unsigned char*>(dst);
+    size_t done = 0;
+    {
+        std::lock_guard<std::mutex> lock(decode_mutex);
+        // Buffered frames first, in at most two pieces around the ring's end.
+        while (done < frames && ahead_frames > 0) {
+            const size_t piece = std::min({frames - done, ahead_frames.load(), ahead_capacity - ahead_start});
+            std::memcpy(out + done * frame_size, ahead.data() + ahead_start * frame_size, piece * frame_size);
+            ahead_start = (ahead_start + piece) % ahead_capacity;
+            ahead_frames -= piece;
+            done += piece;
+        }
+
+        // The workers fell behind, or there are none: decode the rest here.
+        // Only a buffer that had filled counts as a stall; right after opening
+        // or seeking the reader is expected to get there first.
+        if (done < frames && !decoder_ended && ahead_filled) {
+            ahead_filled = false;
+            scheduler->noteStall();
+        }
+        while (done < frames && !decoder_ended) {
+            const size_t decoded = decoder->read(out + done * frame_size, frames - done);
+            if (decoded == 0) {
+                decoder_ended = true;
+            }
+            done += decoded;
+        }
+    }
+
+    if (scheduler) {
+        scheduler->wake();
+    }
+    return done;
+}
+
+bool StreamSource::seek(double seconds) {
+    if (!decoder) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(decode_mutex);
+        if (!decoder->seek(seconds)) {
+            // The decoder stays where it was, so the buffer is still valid.
+            return false;
+        }
+        ahead_start = 0;
+        ahead_frames = 0;
+        ahead_filled = false;
+        decoder_ended = false;
+    }
+
+    if (scheduler) {
+        scheduler->wake();
+    }
+    return true;
+}
+
+double StreamSource::aheadFill() const {
+    if (decoder_ended) {
+        return 1.0;
+    }
+    return static_cast<double>(ahead_frames) / ahead_capacity;
+}
+
+void StreamSource::decodeAhead() {
+    std::lock_guard<std::mutex> lock(decode_mutex);
+    if (scheduler->getAheadFrames() > ahead_capacity) {
+        growAheadLocked(scheduler->getAheadFrames());
+    }
+    if (decoder_ended || ahead_frames >= ahead_capacity) {
+        return;
+    }
+
+    // Only the contiguous free space after the buffered frames; the next
+    // turn wraps around.
+    const size_t end = (ahead_start + ahead_frames) % ahead_capacity;
+    const size_t space = std::min(ahead_capacity - ahead_frames, ahead_capacity - end);
+    const size_t decoded = decoder->read(ahead.data() + end * frame_size, std::min(space, kAheadBlockFrames));
+    if (decoded == 0) {
+        decoder_ended = true;
+    }
+    ahead_frames += decoded;
+    if (ahead_frames == ahead_capacity) {
+        ahead_filled = true;
+    }
+}
+
+void StreamSource::growAheadLocked(size_t frames) {
+    // Unwrap the buffered frames to the start of the larger ring.
+    std::vector<unsigned char> grown(frames * frame_size);
+    const size_t first = std::min(ahead_frames.load(), ahead_capacity - ahead_start);
+    std::memcpy(grown.data(), ahead.data() + ahead_start * frame_size, first * frame_size);
+    std::memcpy(grown.data() + first * frame_size, ahead.data(), (ahead_frames - first) * frame_size);
+    ahead.swap(grown);
+    ahead_start = 0;
+    ahead_capacity = frames;
+}
+
+bool StreamSource::hasSameFormat(const StreamSource& other) const {
+    return frequency == other.frequency && depth == other.depth && channels == other.channels;
+}
+
+} // namespace core
@@ -0,0 +1,49 @@
+#include "core/track_analysis.hpp"
+#include <vector>
+#include "core/beat_tracker.hpp"
+#include "core/loudness_meter.hpp"
+#include "core/pcm_format.hpp"
+#include "core/stream_source.hpp"
+
+namespace core {
+namespace {
+// Frames decoded per read.
+constexpr size_t kChunkFrames = 8192;
+}
+
+std::optional<TrackAnalysis> analyzeTrack(const std::string& path, const std::atomic<bool>* cancel) {
+    auto source = StreamSource::open(path);
+    if (!source) {
+        return std::nullopt;
+    }
+
+    const size_t channels = al_get_channel_count(source->getChannels());
+    LoudnessMeter meter(source->getFrequency(), channels);
+    BeatTracker tracker;
+    tracker.configure(static_cast<float>(source->getFrequency()), BeatTracker::Settings{});
+    std::vector<unsigned char> buffer(kChunkFrames * source->getFrameSize());
+    std::vector<float> samples(kChunkFrames * channels);
+
+    // Converted once and shared by the meter and the tempo tracker.
+    size_t frames = 0;
+    uint64_t position = 0;
+    while ((frames = source->read(buffer.data(), kChunkFrames)) > 0) {
+        if (cancel && cancel->load()) {
+            return std::nullopt;
+        }
+        if (!pcmToFloat(buffer.data(), samples.data(), frames * channels, source->getDepth())) {
+            return std::nullopt;
+        }
+        meter.addFrames(samples.data(), frames);
+        tracker.push(samples.data(), frames, channels, position);
+        position += frames;
+    }
+
+    TrackAnalysis result;
+    result.loudness_lufs = meter.integratedLoudness();
+    result.peak = meter.samplePeak();
+    result.bpm = tracker.getOverallBpm();
+    return result;
+}
+
+} // namespace core
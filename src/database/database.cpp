@@ -30,6 +30,9 @@ bool MusicDatabase::open() {
     }
     // Enable foreign keys
     exec("PRAGMA foreign_keys = ON;");
+    // The background loudness analysis writes through its own connection;
+    // wait out its short transactions instead of failing.
+    sqlite3_busy_timeout(db, 5000);
 
     // Ensure schema exists
     createSchema();
@@ -56,7 +59,35 @@ bool MusicDatabase::exec(const std::string &sql) {
 
 bool MusicDatabase::createSchema() {
     // INIT_SQL comes from include/database/init.hpp
-    return exec(INIT_SQL);
+    return exec(INIT_SQL) && migrateSchema();
+}
+
+bool MusicDatabase::migrateSchema() {
+    for (const auto& col : SCHEMA_COLUMNS) {
+        if (hasColumn(col.table, col.column)) {
+            continue;
+        }
+        const std::string sql = std::string("ALTER TABLE ") + col.table + " ADD COLUMN " + col.column + " " + col.type + ";";
+        if (!exec(sql)) {
+            std::cerr << "Failed to add column " << col.table << "." << col.column << ": " << lastErr << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MusicDatabase::hasColumn(const std::string& table, const std::string& column) const {
+    if (!db) { lastErr = "DB not open"; return false; }
+    sqlite3_stmt* stmt = nullptr;
+    const std::string sql = "PRAGMA table_info(" + table + ");";
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) { lastErr = sqlite3_errmsg(db); return false; }
+    bool found = false;
+    while (!found && sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char* nameTxt = sqlite3_column_text(stmt, 1);
+        found = nameTxt && column == reinterpret_cast<const char*>(nameTxt);
+    }
+    sqlite3_finalize(stmt);
+    return found;
 }
 
 bool MusicDatabase::beginTransaction() {
@@ -275,6 +306,119 @@ int64_t MusicDatabase::getLastPositionInPlaylist(int64_t playlist_id) {
     return position;
 }
 
+std::vector<LoudnessTask> MusicDatabase::getSongsMissingLoudness() const {
+    std::vector<LoudnessTask> out;
+    if (!db) { lastErr = "DB not open"; return out; }
+    sqlite3_stmt* stmt = nullptr;
+    // Songs with both values from before analysis_state existed count as done.
+    const char* sql = "SELECT id, album_id, song_path FROM songs WHERE analysis_state IS NULL AND (loudness_lufs IS NULL OR bpm IS NULL) ORDER BY id ASC";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastErr = sqlite3_errmsg(db); return out; }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int64_t sid = sqlite3_column_int64(stmt, 0);
+        int64_t album_id = sqlite3_column_type(stmt,1) == SQLITE_NULL ? 0 : sqlite3_column_int64(stmt,1);
+        const unsigned char* pathTxt = sqlite3_column_text(stmt, 2);
+        std::string path = pathTxt ? reinterpret_cast<const char*>(pathTxt) : std::string();
+        out.push_back(LoudnessTask{ sid, album_id, std::move(path) });
+    }
+    sqlite3_finalize(stmt);
+    return out;
+}
+
+bool MusicDatabase::setSongLoudness(int64_t song_id, std::optional<double> loudness_lufs, double gain_db, double peak) {
+    if (!db) { lastErr = "DB not open"; return false; }
+    const char* sql = "UPDATE songs SET loudness_lufs = ?1, track_gain_db = ?2, track_peak = ?3, analysis_state = ?4 WHERE id = ?5";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastErr = sqlite3_errmsg(db); return false; }
+    if (loudness_lufs) {
+        sqlite3_bind_double(stmt, 1, *loudness_lufs);
+    } else {
+        sqlite3_bind_null(stmt, 1);
+    }
+    sqlite3_bind_double(stmt, 2, gain_db);
+    sqlite3_bind_double(stmt, 3, peak);
+    sqlite3_bind_int(stmt, 4, static_cast<int>(loudness_lufs ? AnalysisState::Measured : AnalysisState::Silent));
+    sqlite3_bind_int64(stmt, 5, song_id);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) { lastErr = sqlite3_errmsg(db); return false; }
+    return true;
+}
+
+bool MusicDatabase::setSongAnalysisFailed(int64_t song_id) {
+    if (!db) { lastErr = "DB not open"; return false; }
+    const char* sql = "UPDATE songs SET analysis_state = ?1 WHERE id = ?2";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastErr = sqlite3_errmsg(db); return false; }
+    sqlite3_bind_int(stmt, 1, static_cast<int>(AnalysisState::Failed));
+    sqlite3_bind_int64(stmt, 2, song_id);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) { lastErr = sqlite3_errmsg(db); return false; }
+    return true;
+}
+
+bool MusicDatabase::setSongBpm(int64_t song_id, double bpm) {
+    if (!db) { lastErr = "DB not open"; return false; }
+    const char* sql = "UPDATE songs SET bpm = ?1 WHERE id = ?2 AND bpm IS NULL";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastErr = sqlite3_errmsg(db); return false; }
+    sqlite3_bind_double(stmt, 1, bpm);
+    sqlite3_bind_int64(stmt, 2, song_id);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) { lastErr = sqlite3_errmsg(db); return false; }
+    return true;
+}
+
+bool MusicDatabase::setSongResumePosition(int64_t song_id, double seconds) {
+    if (!db) { lastErr = "DB not open"; return false; }
+    const char* sql = "UPDATE songs SET resume_position = ?1 WHERE id = ?2";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastErr = sqlite3_errmsg(db); return false; }
+    if (seconds > 0.0) {
+        sqlite3_bind_double(stmt, 1, seconds);
+    } else {
+        sqlite3_bind_null(stmt, 1);
+    }
+    sqlite3_bind_int64(stmt, 2, song_id);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) { lastErr = sqlite3_errmsg(db); return false; }
+    return true;
+}
+
+std::vector<TrackLoudness> MusicDatabase::getAlbumTrackLoudness(int64_t album_id) const {
+    std::vector<TrackLoudness> out;
+    if (!db) { lastErr = "DB not open"; return out; }
+    sqlite3_stmt* stmt = nullptr;
+    const char* sql = "SELECT loudness_lufs, track_peak, duration FROM songs WHERE album_id = ?1 AND loudness_lufs IS NOT NULL";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastErr = sqlite3_errmsg(db); return out; }
+    sqlite3_bind_int64(stmt, 1, album_id);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        double loudness = sqlite3_column_double(stmt, 0);
+        double peak = sqlite3_column_type(stmt,1) == SQLITE_NULL ? 0.0 : sqlite3_column_double(stmt,1);
+        int duration = sqlite3_column_type(stmt,2) == SQLITE_NULL ? 0 : sqlite3_column_int(stmt,2);
+        out.push_back(TrackLoudness{ loudness, peak, duration });
+    }
+    sqlite3_finalize(stmt);
+    return out;
+}
+
+bool MusicDatabase::setAlbumLoudness(int64_t album_id, double loudness_lufs, double gain_db, double peak) {
+    if (!db) { lastErr = "DB not open"; return false; }
+    const char* sql = "UPDATE albums SET loudness_lufs = ?1, album_gain_db = ?2, album_peak = ?3 WHERE id = ?4";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastErr = sqlite3_errmsg(db); return false; }
+    sqlite3_bind_double(stmt, 1, loudness_lufs);
+    sqlite3_bind_double(stmt, 2, gain_db);
+    sqlite3_bind_double(stmt, 3, peak);
+    sqlite3_bind_int64(stmt, 4, album_id);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) { lastErr = sqlite3_errmsg(db); return false; }
+    return true;
+}
+
 bool MusicDatabase::deleteSong(int64_t song_id) {
     if (!db) { lastErr = "DB not open"; return false; }
     // Foreign keys will cascade delete song_artists, song_genres, and playlist_songs
@@ -331,7 +475,7 @@ std::optional<music::Artist> MusicDatabase::getArtistById(int64_t id) const {
 std::optional<music::Album> MusicDatabase::getAlbumById(int64_t id) const {
     if (!db) { lastErr = "DB not open"; return std::nullopt; }
     sqlite3_stmt* stmt = nullptr;
-    const char* sql = "SELECT id, name, year, picture_path, artist_id, musicbrainz_release_group_id, cover_art_block, cover_art_mime FROM albums WHERE id = ?1";
+    const char* sql = "SELECT id, name, year, picture_path, artist_id, musicbrainz_release_group_id, cover_art_block, cover_art_mime, album_gain_db, album_peak FROM albums WHERE id = ?1";
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastErr = sqlite3_errmsg(db); return std::nullopt; }
     sqlite3_bind_int64(stmt, 1, id);
     int rc = sqlite3_step(stmt);
@@ -373,6 +517,11 @@ std::optional<music::Album> MusicDatabase::getAlbumById(int64_t id) const {
         }
         
         result = music::Album(aid, title, year, pic, artist_id, mbid, std::move(cover_art_model), cover_art_mime);
+        if (sqlite3_column_type(stmt, 8) != SQLITE_NULL) {
+            result->has_replay_gain = true;
+            result->album_gain_db = static_cast<float>(sqlite3_column_double(stmt, 8));
+            result->album_peak = static_cast<float>(sqlite3_column_double(stmt, 9));
+        }
     }
     sqlite3_finalize(stmt);
     return result;
@@ -381,7 +530,7 @@ std::optional<music::Album> MusicDatabase::getAlbumById(int64_t id) const {
 std::optional<music::Song> MusicDatabase::getSongById(int64_t id) const {
     if (!db) { lastErr = "DB not open"; return std::nullopt; }
     sqlite3_stmt* stmt = nullptr;
-    const char* sql = "SELECT id, song_path, title, album_id, track, comment, duration FROM songs WHERE id = ?1";
+    const char* sql = "SELECT id, song_path, title, album_id, track, comment, duration, track_gain_db, track_peak, resume_position FROM songs WHERE id = ?1";
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastErr = sqlite3_errmsg(db); return std::nullopt; }
     sqlite3_bind_int64(stmt, 1, id);
     int rc = sqlite3_step(stmt);
@@ -398,6 +547,14 @@ std::optional<music::Song> MusicDatabase::getSongById(int64_t id) const {
         std::string title = titleTxt ? reinterpret_cast<const char*>(titleTxt) : std::string();
         std::string comment = commentTxt ? reinterpret_cast<const char*>(commentTxt) : std::string();
         result = music::Song(sid, path, title, album_id, track, comment, duration);
+        if (sqlite3_column_type(stmt, 7) != SQLITE_NULL) {
+            result->replay_gain.has_track = true;
+            result->replay_gain.track_gain_db = static_cast<float>(sqlite3_column_double(stmt, 7));
+            result->replay_gain.track_peak = static_cast<float>(sqlite3_column_double(stmt, 8));
+        }
+        if (sqlite3_column_type(stmt, 9) != SQLITE_NULL) {
+            result->resume_position = sqlite3_column_double(stmt, 9);
+        }
     }
     sqlite3_finalize(stmt);
     return result;
@@ -541,7 +698,7 @@ std::vector<music::Album> MusicDatabase::getAllAlbums() const {
     std::vector<music::Album> out;
     if (!db) { lastErr = "DB not open"; return out; }
     sqlite3_stmt* stmt = nullptr;
-    const char* sql = "SELECT id, name, year, picture_path, artist_id, musicbrainz_release_group_id, cover_art_block, cover_art_mime FROM albums ORDER BY id ASC";
+    const char* sql = "SELECT id, name, year, picture_path, artist_id, musicbrainz_release_group_id, cover_art_block, cover_art_mime, album_gain_db, album_peak FROM albums ORDER BY id ASC";
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastErr = sqlite3_errmsg(db); return out; }
     out.reserve(256);
     while (sqlite3_step(stmt) == SQLITE_ROW) {
@@ -580,7 +737,12 @@ std::vector<music::Album> MusicDatabase::getAllAlbums() const {
             cover_art_model.loadFromMemory(cover_art_data.data(), cover_art_data.size(), cover_art_mime);
         }
         
-        out.emplace_back(aid, title, year, pic, artist_id, mbid, std::move(cover_art_model), cover_art_mime);
+        music::Album& album = out.emplace_back(aid, title, year, pic, artist_id, mbid, std::move(cover_art_model), cover_art_mime);
+        if (sqlite3_column_type(stmt, 8) != SQLITE_NULL) {
+            album.has_replay_gain = true;
+            album.album_gain_db = static_cast<float>(sqlite3_column_double(stmt, 8));
+            album.album_peak = static_cast<float>(sqlite3_column_double(stmt, 9));
+        }
     }
     sqlite3_finalize(stmt);
     return out;
@@ -590,7 +752,7 @@ std::vector<music::Song> MusicDatabase::getAllSongs() const {
     std::vector<music::Song> out;
     if (!db) { lastErr = "DB not open"; return out; }
     sqlite3_stmt* stmt = nullptr;
-    const char* sql = "SELECT id, song_path, title, album_id, track, comment, duration FROM songs ORDER BY id ASC";
+    const char* sql = "SELECT id, song_path, title, album_id, track, comment, duration, track_gain_db, track_peak, resume_position FROM songs ORDER BY id ASC";
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastErr = sqlite3_errmsg(db); return out; }
     out.reserve(1024);
     
@@ -614,7 +776,15 @@ std::vector<music::Song> MusicDatabase::getAllSongs() const {
             continue; // Skip adding to output
         }
         
-        out.emplace_back(sid, path, title, album_id, track, comment, duration);
+        music::Song& song = out.emplace_back(sid, path, title, album_id, track, comment, duration);
+        if (sqlite3_column_type(stmt, 7) != SQLITE_NULL) {
+            song.replay_gain.has_track = true;
+            song.replay_gain.track_gain_db = static_cast<float>(sqlite3_column_double(stmt, 7));
+            song.replay_gain.track_peak = static_cast<float>(sqlite3_column_double(stmt, 8));
+        }
+        if (sqlite3_column_type(stmt, 9) != SQLITE_NULL) {
+            song.resume_position = sqlite3_column_double(stmt, 9);
+        }
     }
     sqlite3_finalize(stmt);
     
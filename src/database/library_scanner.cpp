@@ -1,14 +1,22 @@
 #include "database/library_scanner.hpp"
 #include "database/database.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <filesystem>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <cctype>
 
 #include <taglib/tag.h>
+#include <taglib/tpropertymap.h>
 #include <taglib/fileref.h>
 #include <taglib/mpegfile.h>
 #include <taglib/id3v2tag.h>
@@ -25,6 +33,9 @@
 #include <taglib/xiphcomment.h>
 #include <allegro5/allegro_audio.h>
 
+#include "core/loudness_meter.hpp"
+#include "core/track_analysis.hpp"
+
 using namespace database;
 
 static std::string normalize_extension(std::string ext)
@@ -124,6 +135,153 @@ static std::string extractMusicBrainzReleaseGroupId(const std::string& path)
     return {};
 }
 
+// Keeps near-silent tracks from getting absurd boosts.
+static constexpr double MAX_REPLAY_GAIN_DB = 24.0;
+
+static double replayGainFor(double loudness_lufs)
+{
+    return std::clamp(core::LoudnessMeter::gainForLoudness(loudness_lufs), -MAX_REPLAY_GAIN_DB, MAX_REPLAY_GAIN_DB);
+}
+
+LoudnessResult LibraryScanner::analyzeLoudness(MusicDatabase &db,
+                                               const LoudnessOptions &opts,
+                                               ProgressCallback progress,
+                                               std::atomic<bool> *cancel)
+{
+    LoudnessResult res;
+    const std::vector<LoudnessTask> tasks = db.getSongsMissingLoudness();
+    if (tasks.empty())
+        return res;
+
+    unsigned int workers = opts.workers ? opts.workers : std::thread::hardware_concurrency();
+    workers = std::clamp<unsigned int>(workers, 1, static_cast<unsigned int>(tasks.size()));
+
+    std::vector<std::optional<core::TrackAnalysis>> results(tasks.size());
+    std::atomic<size_t> next{0};
+    std::atomic<uint64_t> bytes{0};
+    // Finished tasks wait here until the calling thread stores them.
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    std::vector<size_t> done;
+    unsigned int running = workers;
+    size_t finished = 0;
+    size_t analyzed = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    auto worker = [&]()
+    {
+        size_t i = 0;
+        while ((i = next.fetch_add(1)) < tasks.size())
+        {
+            if (cancel && cancel->load())
+                break;
+            std::optional<core::TrackAnalysis> analysis = core::analyzeTrack(tasks[i].path, cancel);
+            // A cancelled decode is not a failure; the song is retried next time.
+            if (cancel && cancel->load())
+                break;
+
+            std::error_code ec;
+            const auto size = std::filesystem::file_size(tasks[i].path, ec);
+            if (analysis && !ec)
+                bytes += size;
+
+            std::lock_guard<std::mutex> lock(done_mutex);
+            results[i] = std::move(analysis);
+            done.push_back(i);
+            ++finished;
+            if (results[i])
+                ++analyzed;
+            if (progress)
+                progress(finished, analyzed);
+            done_cv.notify_one();
+        }
+        std::lock_guard<std::mutex> lock(done_mutex);
+        --running;
+        done_cv.notify_one();
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(workers);
+    for (unsigned int w = 0; w < workers; ++w)
+        pool.emplace_back(worker);
+
+    // Database writes stay on the calling thread, one short transaction per
+    // batch of finished songs, so results survive an interrupted run and other
+    // connections are never locked out for long.
+    std::unordered_set<int64_t> touchedAlbums;
+    std::vector<size_t> batch;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(done_mutex);
+            done_cv.wait(lock, [&]() { return !done.empty() || running == 0; });
+            if (done.empty())
+                break;
+            batch.swap(done);
+        }
+
+        db.beginTransaction();
+        for (size_t i : batch)
+        {
+            if (!results[i])
+            {
+                if (!db.setSongAnalysisFailed(tasks[i].song_id))
+                    std::cerr << "Failed to mark " << tasks[i].path << " as unanalyzable: " << db.lastError() << "\n";
+                res.failed++;
+                continue;
+            }
+            const auto &r = *results[i];
+            // Silence gets no boost; without a peak the playback cap could not limit one.
+            const double gain_db = r.loudness_lufs ? replayGainFor(*r.loudness_lufs) : 0.0;
+            if (!db.setSongLoudness(tasks[i].song_id, r.loudness_lufs, gain_db, r.peak))
+            {
+                std::cerr << "Failed to store loudness for " << tasks[i].path << ": " << db.lastError() << "\n";
+                res.failed++;
+                continue;
+            }
+            if (!db.setSongBpm(tasks[i].song_id, r.bpm))
+                std::cerr << "Failed to store tempo for " << tasks[i].path << ": " << db.lastError() << "\n";
+            res.analyzed++;
+            if (tasks[i].album_id > 0 && r.loudness_lufs)
+                touchedAlbums.insert(tasks[i].album_id);
+        }
+        db.commit();
+        batch.clear();
+    }
+    for (auto &t : pool)
+        t.join();
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    res.bytes = bytes.load();
+
+    // Album loudness is the duration-weighted energy mean of its tracks'
+    // integrated loudness. That is close to, but not exactly, gating the whole
+    // album at once; it lets an album be updated without re-decoding old tracks.
+    // Silent tracks have no loudness and are left out.
+    db.beginTransaction();
+    for (int64_t album_id : touchedAlbums)
+    {
+        const auto tracks = db.getAlbumTrackLoudness(album_id);
+        double energy = 0.0;
+        double weight = 0.0;
+        double peak = 0.0;
+        for (const auto &t : tracks)
+        {
+            const double w = std::max(1, t.duration);
+            energy += w * std::pow(10.0, t.loudness_lufs / 10.0);
+            weight += w;
+            peak = std::max(peak, t.peak);
+        }
+        if (weight <= 0.0)
+            continue;
+        const double loudness = 10.0 * std::log10(energy / weight);
+        if (db.setAlbumLoudness(album_id, loudness, replayGainFor(loudness), peak))
+            res.albums_updated++;
+    }
+    db.commit();
+
+    return res;
+}
+
 bool LibraryScanner::isAudioFile(const std::string &path)
 {
     const char* id = al_identify_sample(path.c_str());
@@ -336,6 +494,9 @@ ScanResult LibraryScanner::scan(MusicDatabase &db,
                 continue;
             }
             st.imported++;
+            // A tagged tempo wins; analyzeLoudness() fills in the rest.
+            if (meta.bpm > 0.0f)
+                db.setSongBpm(*song_id_opt, meta.bpm);
             // associate artist(s)
             if (!meta.artist.empty())
             {
@@ -383,7 +544,11 @@ music::SongMetadata LibraryScanner::readSongMetadata(const std::string &path)
         meta.comment = tag->comment().to8Bit(true);
         meta.track = tag->track();
         meta.duration = f.audioProperties()->lengthInSeconds();
-        // meta.bpm = f.audioProperties()->bpm();
+        // TBPM, BPM or tmpo, whichever the format has; may be fractional.
+        const TagLib::PropertyMap properties = f.file()->properties();
+        const auto bpm = properties.find("BPM");
+        if (bpm != properties.end() && !bpm->second.isEmpty())
+            meta.bpm = std::max(0.0f, std::strtof(bpm->second.front().to8Bit(true).c_str(), nullptr));
     }
 
     // Extract album_artist (but NOT cover art - handled per-album in scan())
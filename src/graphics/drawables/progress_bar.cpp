@@ -1,6 +1,7 @@
 #include "graphics/drawables/progress_bar.hpp"
 #include "graphics/draw_shapes.hpp"
 #include <allegro5/allegro_primitives.h>
+#include <algorithm>
 #include <iostream>
 
 void ui::ProgressBarDrawable::draw(const graphics::RenderContext& context) const
@@ -13,6 +14,44 @@ bool ui::ProgressBarDrawable::hitTest(float x, float y, const graphics::RenderCo
     return hitTestRect(x, y, context);
 }
 
+bool ui::ProgressBarDrawable::onMouseDown(const graphics::MouseEvent& event)
+{
+    if (!model || !onSeek || !event.context || event.button != 1) return false;
+    dragging = true;
+    return seekToMouseX(event.x, *event.context);
+}
+
+bool ui::ProgressBarDrawable::onMouseMove(const graphics::MouseEvent& event)
+{
+    if (!dragging || !event.context) return false;
+    return seekToMouseX(event.x, *event.context);
+}
+
+bool ui::ProgressBarDrawable::onMouseUp(const graphics::MouseEvent& event)
+{
+    if (!event.context || event.button != 1) return false;
+
+    const bool wasDragging = dragging;
+    if (dragging) {
+        seekToMouseX(event.x, *event.context);
+    }
+    dragging = false;
+    return wasDragging;
+}
+
+bool ui::ProgressBarDrawable::seekToMouseX(float x, const graphics::RenderContext& context)
+{
+    auto size = getSize().toScreenPos(static_cast<float>(context.screenWidth), static_cast<float>(context.screenHeight));
+    auto position = getPosition().toScreenPos(static_cast<float>(context.screenWidth), static_cast<float>(context.screenHeight));
+    position.first += context.offsetX;
+
+    if (size.first <= 0.0f) return false;
+
+    const float rel = std::clamp((x - position.first) / size.first, 0.0f, 1.0f);
+    onSeek(rel * model->getFinishesAt());
+    return true;
+}
+
 void ui::ProgressBarDrawable::drawSquared(const graphics::RenderContext& context) const
 {
     if (!model) return;
@@ -12,11 +12,21 @@
 
 #include "core/music_engine.hpp"
 #include "util/font.hpp"
-#include "util/config.hpp"
+#include "vis/audio_texture.hpp"
 #include "vis/visualizations.hpp"
 #include "vis/shader.hpp"
+#include "vis/shader_cache.hpp"
 
 namespace ui {
+namespace {
+// Sizes buffer for up to max_count values, lets read fill it and trims it to
+// what was actually read. The vector keeps its capacity between calls.
+template <typename ReadFn>
+void readSamplesInto(std::vector<float>& buffer, std::size_t max_count, ReadFn&& read) {
+    buffer.resize(max_count);
+    buffer.resize(read(buffer.data(), max_count));
+}
+}
 
 // Visualization implementations moved to /src/vis. Use the factory helpers there.
 
@@ -51,7 +61,9 @@ AudioVisualizerView::AudioVisualizerView(std::shared_ptr<util::FontManager> font
       eventDispatcher(eventDispatcher),
       musicEngine(musicEngine),
       previousButton(std::make_shared<ButtonDrawable>(graphics::UV(), graphics::UV(), "Prev")),
-      nextButton(std::make_shared<ButtonDrawable>(graphics::UV(), graphics::UV(), "Next")) {
+      nextButton(std::make_shared<ButtonDrawable>(graphics::UV(), graphics::UV(), "Next")),
+      audioTexture(std::make_unique<vis::AudioTexture>()),
+      shaderCache(std::make_unique<vis::ShaderCache>()) {
     auto kanitFont = this->fontManager ? this->fontManager->getFont("kanit") : nullptr;
     controlFont = kanitFont ? kanitFont->getFont(14) : nullptr;
     previousButton->setFont(controlFont);
@@ -73,17 +85,15 @@ AudioVisualizerView::AudioVisualizerView(std::shared_ptr<util::FontManager> font
     eventDispatcher.addEventTarget(previousButton);
     eventDispatcher.addEventTarget(nextButton);
 
-    const std::string vertexSource = util::Config::resolveAssetPath("shaders/vertex.glsl");
-    const std::string polarFragmentSource = util::Config::resolveAssetPath("shaders/pixel.glsl");
-    const std::string barsFragmentSource = util::Config::resolveAssetPath("shaders/rainbow.glsl");
+    // Every program up front, so no visualization compiles on its first
+    // frame or on a switch.
+    shaderCache->compileAll();
 
     const std::size_t polarIndex = visualizationToIndex(VisualizationType::PolarWaveform);
     visualizations[polarIndex] = vis::createPolarWaveformVisualization();
-    visualizations[polarIndex]->setShader(new vis::Shader(vertexSource.c_str(), polarFragmentSource.c_str(), true));
 
     const std::size_t barsIndex = visualizationToIndex(VisualizationType::MirrorBars);
     visualizations[barsIndex] = vis::createMirrorBarsVisualization();
-    visualizations[barsIndex]->setShader(new vis::Shader(vertexSource.c_str(), barsFragmentSource.c_str(), true));
 
     const std::size_t dualEchoIndex = visualizationToIndex(VisualizationType::DualEchoWave);
     visualizations[dualEchoIndex] = vis::createDualEchoWaveVisualization();
@@ -136,6 +146,10 @@ vis::Shader* AudioVisualizerView::getShader() const {
     return visualizations[activeIndex]->getShader();
 }
 
+void AudioVisualizerView::setShaderHotReload(bool enabled) {
+    shaderCache->setHotReload(enabled);
+}
+
 void AudioVisualizerView::setVisualization(VisualizationType visualization) {
     const std::size_t index = visualizationToIndex(visualization);
     if (index >= visualizations.size()) {
@@ -195,15 +209,26 @@ void AudioVisualizerView::draw(const graphics::RenderContext& context) {
     }
 
     layoutControls(context, x, y, w, h);
+    shaderCache->poll();
 
-    SampleFrame sampleFrame;
+    sampleFrame.clear();
+    const double now = al_get_time();
+    const bool hasSpectrum = musicEngine && musicEngine->readSpectrum(spectrum);
     if (musicEngine) {
+        // Windows end at the audible frame rather than the newest mixed one.
+        const auto readInterleaved = [this, now](float* dst, std::size_t count) {
+            return musicEngine->readAudibleInto(dst, count, now);
+        };
+        const auto readMono = [this, now](float* dst, std::size_t count) {
+            return musicEngine->readAudibleMonoInto(dst, count, now);
+        };
+
         if (activeVisualization == VisualizationType::DualEchoWave) {
-            sampleFrame.interleaved = musicEngine->copyRecentSamples(vis::kDualEchoStereoSampleWindow);
+            readSamplesInto(sampleFrame.interleaved, vis::kDualEchoStereoSampleWindow, readInterleaved);
             if (sampleFrame.interleaved.size() >= 4 && (sampleFrame.interleaved.size() % 2 == 0)) {
                 vis::splitInterleavedStereoSamples(sampleFrame.interleaved, sampleFrame.left, sampleFrame.right);
             } else {
-                sampleFrame.mono = musicEngine->copyRecentMonoSamples(vis::kDualEchoMonoFallbackWindow);
+                readSamplesInto(sampleFrame.mono, vis::kDualEchoMonoFallbackWindow, readMono);
                 sampleFrame.left = sampleFrame.mono;
                 sampleFrame.right = sampleFrame.mono;
             }
@@ -211,7 +236,7 @@ void AudioVisualizerView::draw(const graphics::RenderContext& context) {
             const std::size_t monoWindow = (activeVisualization == VisualizationType::MirrorBars)
                 ? vis::kMirrorBarsSampleWindow
                 : vis::kPolarWaveformSampleWindow;
-            sampleFrame.mono = musicEngine->copyRecentMonoSamples(monoWindow);
+            readSamplesInto(sampleFrame.mono, monoWindow, readMono);
         }
     }
 
@@ -233,8 +258,21 @@ void AudioVisualizerView::draw(const graphics::RenderContext& context) {
         frameContext.y = y;
         frameContext.w = w;
         frameContext.h = h;
-        frameContext.timeSeconds = static_cast<float>(al_get_time());
+        frameContext.timeSeconds = static_cast<float>(now);
+        frameContext.playheadSeconds = musicEngine ? static_cast<float>(musicEngine->getPlayheadAt(now)) : 0.0f;
         frameContext.samples = &sampleFrame;
+        frameContext.spectrum = hasSpectrum ? &spectrum : nullptr;
+        if (musicEngine) {
+            const core::MusicEngine::BeatInfo beat = musicEngine->getBeatAt(now);
+            frameContext.bpm = beat.bpm;
+            frameContext.beatPhase = beat.phase;
+            frameContext.beatConfidence = beat.confidence;
+        }
+        if (audioTexture->ensure()) {
+            audioTexture->upload(sampleFrame.mono, sampleFrame.left, sampleFrame.right, frameContext.spectrum);
+            frameContext.audioTexture = audioTexture.get();
+        }
+        frameContext.shaders = shaderCache.get();
         visualization->update(frameContext);
         visualization->draw(frameContext);
     }
@@ -81,6 +81,11 @@ NowPlayingView::NowPlayingView(std::shared_ptr<util::FontManager> fontManager,
   // Progress bar - positioned in lower third
   progressBar.setPosition(graphics::UV(0.3f, 1.0f, 10.0f, 0.0f));
   progressBar.setSize(graphics::UV(0.4f, 0.0f, 0.0f, 8.0f));
+  progressBar.setOnSeek([this](float seconds) {
+    if (this->musicEngine) {
+      this->musicEngine->requestSeek(seconds);
+    }
+  });
 
   // Album art image - left side
   defaultAlbumArtBitmap = al_load_bitmap(util::Config::resolveAssetPath("icons/default_art.png").c_str());
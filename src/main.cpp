@@ -1,9 +1,14 @@
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <thread>
 
 #include "core/app_state.hpp"
 #include "core/allegro_init.hpp"
 #include "core/main_loop.hpp"
+#include "database/database.hpp"
 #include "database/library_scanner.hpp"
+#include "util/config.hpp"
 #include "scrob.h"
 
 int main() {
@@ -34,8 +39,36 @@ int main() {
   auto result = scanner.scan(appState.db, musicDir, scanOptions);
   std::cout << "Scanned " << result.scanned << " files, imported " << result.imported << " songs, skipped " << result.skipped << " songs.\n";
 
+  // Only songs without a stored analysis are decoded, so after the first run this
+  // covers newly imported files. It runs beside the UI on its own database
+  // connection, with half the cores to leave room for playback; the library picks
+  // the stored gains up on the next start.
+  std::atomic<bool> stopAnalysis{false};
+  std::thread analysis;
+  if (appState.config.getAnalyzeLoudness()) {
+    analysis = std::thread([&stopAnalysis]() {
+      database::MusicDatabase db(util::Config::getDatabasePath());
+      if (!db.open()) {
+        std::cerr << "Loudness analysis could not open the database: " << db.lastError() << "\n";
+        return;
+      }
+      database::LoudnessOptions options;
+      options.workers = std::max(1u, std::thread::hardware_concurrency() / 2);
+      auto loudness = database::LibraryScanner().analyzeLoudness(db, options, nullptr, &stopAnalysis);
+      if (loudness.analyzed > 0 || loudness.failed > 0) {
+        std::cout << "Analyzed loudness of " << loudness.analyzed << " songs (" << loudness.failed << " failed, "
+                  << loudness.albums_updated << " albums).\n";
+      }
+    });
+  }
+
   core::runMainLoop();
 
+  stopAnalysis = true;
+  if (analysis.joinable()) {
+    analysis.join();
+  }
+
   std::cout << "Shutting down application...\n";
   appState.shutdown();
   std::cout << "Application shutdown complete.\n";
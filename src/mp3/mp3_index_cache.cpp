@@ -0,0 +1,250 @@
+#include "mp3/mp3_index_cache.hpp"
+#include "util/config.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+
+namespace mp3streaming {
+namespace {
+constexpr char kMagic[4] = {'A', 'V', 'I', 'X'};
+constexpr uint32_t kVersion = 3;
+constexpr const char* kDirectoryName = "mp3index";
+constexpr const char* kExtension = ".idx";
+
+// FNV-1a, so entry names stay stable across builds and platforms.
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+std::optional<int64_t> modificationTime(const std::string& path) {
+    std::error_code ec;
+    const auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    return static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+void putFixed(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+class Reader {
+public:
+    explicit Reader(const std::string& data) : data(data) {}
+
+    bool fixed(uint64_t& value, int bytes) {
+        if (data.size() - pos < static_cast<size_t>(bytes)) {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(data[pos++])) << (8 * i);
+        }
+        return true;
+    }
+
+    bool varint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+            const auto byte = static_cast<unsigned char>(data[pos++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool bytes(std::string& value, size_t size) {
+        if (data.size() - pos < size) {
+            return false;
+        }
+        value.assign(data, pos, size);
+        pos += size;
+        return true;
+    }
+
+    bool atEnd() const { return pos == data.size(); }
+
+private:
+    const std::string& data;
+    size_t pos = 0;
+};
+}
+
+std::string FrameIndexCache::entryPath(const std::string& path, int64_t file_size, int64_t mtime) {
+    uint64_t key = fnv1a(path.data(), path.size());
+    key = fnv1a(&file_size, sizeof(file_size), key);
+    key = fnv1a(&mtime, sizeof(mtime), key);
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx%s", static_cast<unsigned long long>(key), kExtension);
+    return (std::filesystem::path(util::Config::getCacheDir()) / kDirectoryName / name).string();
+}
+
+bool FrameIndexCache::load(const std::string& path, int64_t file_size, FrameIndex& index) {
+    const auto mtime = modificationTime(path);
+    if (!mtime) {
+        return false;
+    }
+    const std::string entry = entryPath(path, file_size, *mtime);
+
+    std::string data;
+    {
+        std::ifstream in(entry, std::ios::binary);
+        if (!in) {
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    Reader reader(data);
+    std::string magic, stored_path;
+    uint64_t version = 0, stored_size = 0, stored_mtime = 0, path_length = 0, total_samples = 0, count = 0;
+    uint64_t frame_count = 0, stride = 0, resume_offset = 0, resume_main_data_bytes = 0;
+    bool valid = reader.bytes(magic, sizeof(kMagic)) && magic == std::string(kMagic, sizeof(kMagic)) &&
+                 reader.fixed(version, 4) && version == kVersion &&
+                 reader.fixed(stored_size, 8) && static_cast<int64_t>(stored_size) == file_size &&
+                 reader.fixed(stored_mtime, 8) && static_cast<int64_t>(stored_mtime) == *mtime &&
+                 reader.fixed(path_length, 4) && reader.bytes(stored_path, path_length) && stored_path == path &&
+                 reader.fixed(total_samples, 8) && reader.fixed(frame_count, 4) && frame_count <= INT32_MAX &&
+                 reader.fixed(stride, 4) && stride > 0 && stride <= INT32_MAX &&
+                 reader.fixed(resume_offset, 8) && static_cast<int64_t>(resume_offset) <= file_size &&
+                 reader.fixed(resume_main_data_bytes, 4) &&
+                 reader.fixed(count, 4) && count > 0 && count == (frame_count + stride - 1) / stride;
+
+    FrameIndex loaded;
+    if (valid) {
+        loaded.total_samples = static_cast<int64_t>(total_samples);
+        loaded.frame_count = static_cast<int32_t>(frame_count);
+        loaded.stride = static_cast<int32_t>(stride);
+        loaded.resume_offset = static_cast<int64_t>(resume_offset);
+        loaded.resume_main_data_bytes = static_cast<int32_t>(static_cast<uint32_t>(resume_main_data_bytes));
+        loaded.frame_offsets.reserve(count);
+        int64_t offset = 0;
+        for (uint64_t i = 0; i < count && valid; ++i) {
+            uint64_t delta = 0;
+            valid = reader.varint(delta) && (delta > 0 || i == 0);
+            offset += static_cast<int64_t>(delta);
+            loaded.frame_offsets.push_back(offset);
+        }
+        valid = valid && offset < file_size;
+    }
+
+    uint64_t sync_count = 0;
+    valid = valid && reader.fixed(sync_count, 4) && sync_count <= count;
+    if (valid) {
+        loaded.sync_frames.reserve(sync_count);
+        uint64_t frame = 0;
+        for (uint64_t i = 0; i < sync_count && valid; ++i) {
+            uint64_t delta = 0;
+            valid = reader.varint(delta) && (delta > 0 || i == 0) && delta < frame_count - frame;
+            frame += delta;
+            loaded.sync_frames.push_back(static_cast<int32_t>(frame));
+        }
+        valid = valid && reader.atEnd();
+    }
+
+    std::error_code ec;
+    if (!valid) {
+        std::filesystem::remove(entry, ec);
+        return false;
+    }
+
+    // Recently used entries survive trim().
+    std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), ec);
+    index = std::move(loaded);
+    return true;
+}
+
+bool FrameIndexCache::store(const std::string& path, int64_t file_size, const FrameIndex& index) {
+    const auto mtime = modificationTime(path);
+    if (!mtime || index.frame_offsets.empty()) {
+        return false;
+    }
+
+    std::string data(kMagic, sizeof(kMagic));
+    putFixed(data, kVersion, 4);
+    putFixed(data, static_cast<uint64_t>(file_size), 8);
+    putFixed(data, static_cast<uint64_t>(*mtime), 8);
+    putFixed(data, path.size(), 4);
+    data += path;
+    putFixed(data, static_cast<uint64_t>(index.total_samples), 8);
+    putFixed(data, static_cast<uint64_t>(index.frame_count), 4);
+    putFixed(data, static_cast<uint64_t>(index.stride), 4);
+    putFixed(data, static_cast<uint64_t>(index.resume_offset), 8);
+    putFixed(data, static_cast<uint32_t>(index.resume_main_data_bytes), 4);
+    putFixed(data, index.frame_offsets.size(), 4);
+    int64_t previous = 0;
+    for (int64_t offset : index.frame_offsets) {
+        putVarint(data, static_cast<uint64_t>(offset - previous));
+        previous = offset;
+    }
+    putFixed(data, index.sync_frames.size(), 4);
+    int32_t previous_frame = 0;
+    for (int32_t frame : index.sync_frames) {
+        putVarint(data, static_cast<uint64_t>(frame - previous_frame));
+        previous_frame = frame;
+    }
+
+    const std::filesystem::path entry = entryPath(path, file_size, *mtime);
+    std::error_code ec;
+    std::filesystem::create_directories(entry.parent_path(), ec);
+
+    // Write beside the entry and rename, so a reader never sees half a file.
+    std::filesystem::path temporary = entry;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out || !out.write(data.data(), static_cast<std::streamsize>(data.size()))) {
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, entry, ec);
+    if (ec) {
+        std::filesystem::remove(temporary, ec);
+        return false;
+    }
+
+    trim(entry.parent_path().string());
+    return true;
+}
+
+void FrameIndexCache::trim(const std::string& directory) {
+    std::error_code ec;
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> entries;
+    for (const auto& item : std::filesystem::directory_iterator(directory, ec)) {
+        if (item.path().extension() == kExtension) {
+            entries.emplace_back(item.last_write_time(ec), item.path());
+        }
+    }
+    if (entries.size() <= kMaxEntries) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end());
+    const size_t excess = entries.size() - kMaxEntries;
+    for (size_t i = 0; i < excess; ++i) {
+        std::filesystem::remove(entries[i].second, ec);
+    }
+}
+
+} // namespace mp3streaming
@@ -1,2 +1,53 @@
 #define MINIMP3_IMPLEMENTATION
 #include "mp3/mp3_streaming.hpp"
+#include "mp3/mp3_support.hpp"
+#include "core/decoder.hpp"
+#include <atomic>
+
+namespace mp3streaming {
+namespace {
+// Enough for a dense index of about 70 minutes of audio.
+std::atomic<size_t> memory_budget{2 * 1024 * 1024};
+
+class Mp3Decoder : public core::Decoder {
+public:
+    explicit Mp3Decoder(MP3FILE* file) : file(file) {
+        format.frequency = static_cast<unsigned int>(file->freq);
+        format.depth = sizeof(mp3d_sample_t) == sizeof(float) ? ALLEGRO_AUDIO_DEPTH_FLOAT32 : ALLEGRO_AUDIO_DEPTH_INT16;
+        format.channels = file->chan_conf;
+    }
+
+    ~Mp3Decoder() override {
+        mp3_free(file);
+    }
+
+    size_t read(void* dst, size_t frames) override {
+        const size_t frame_size = format.frameSize();
+        return mp3_stream_read(file, dst, frames * frame_size) / frame_size;
+    }
+
+    bool seek(double seconds) override { return mp3_stream_seek(file, seconds); }
+    double getLength() const override { return mp3_stream_get_length(file); }
+
+private:
+    MP3FILE* file;
+};
+
+std::unique_ptr<core::Decoder> openMp3(const std::string& path) {
+    MP3FILE* file = mp3_open_file(path.c_str(), memory_budget.load());
+    if (!file) {
+        return nullptr;
+    }
+    return std::make_unique<Mp3Decoder>(file);
+}
+}
+
+void addMP3Support() {
+    core::registerDecoder(".mp3", openMp3);
+}
+
+void setMemoryBudget(size_t bytes) {
+    memory_budget = bytes;
+}
+
+} // namespace mp3streaming
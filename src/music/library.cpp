@@ -136,6 +136,15 @@ void Library::recreateViews() {
             song.album_id
         );
 
+        SongView& view = songViews.back();
+        view.replay_gain = song.replay_gain;
+        view.resume_position = song.resume_position;
+        if (album && album->has_replay_gain) {
+            view.replay_gain.has_album = true;
+            view.replay_gain.album_gain_db = album->album_gain_db;
+            view.replay_gain.album_peak = album->album_peak;
+        }
+
         songViewIndex.emplace(song.id, songViews.size() - 1);
 
         songsByAlbum[song.album_id].push_back(songViews.back());
@@ -199,6 +208,17 @@ const SongView* Library::getSongById(int id) const {
     return (it != songViewIndex.end()) ? &songViews[it->second] : nullptr;
 }
 
+void Library::setResumePosition(int song_id, double seconds) {
+    auto song = songs.find(song_id);
+    if (song != songs.end()) {
+        song->second.resume_position = seconds;
+    }
+    auto view = songViewIndex.find(song_id);
+    if (view != songViewIndex.end()) {
+        songViews[view->second].resume_position = seconds;
+    }
+}
+
 const Album* Library::getAlbumById(int id) const {
     auto it = albums.find(id);
     return (it != albums.end()) ? &it->second : nullptr;
@@ -410,9 +410,22 @@ bool Config::generateDefaultConfig(const std::string& filename) {
     
     al_set_config_value(defaultConfig, "display", "width", "1024");
     al_set_config_value(defaultConfig, "display", "height", "300");
+    al_set_config_value(defaultConfig, "display", "shader_hot_reload", "0");
     
     al_set_config_value(defaultConfig, "discord", "application_id", "0");
     al_set_config_value(defaultConfig, "audio", "volume_percent", "100");
+    al_set_config_value(defaultConfig, "audio", "preload_seconds", "10");
+    al_set_config_value(defaultConfig, "audio", "crossfade_seconds", "0");
+    al_set_config_value(defaultConfig, "audio", "replaygain", "track");
+    al_set_config_value(defaultConfig, "audio", "sample_rate", "0");
+    al_set_config_value(defaultConfig, "audio", "mixer_depth", "float32");
+    al_set_config_value(defaultConfig, "audio", "resampler", "linear");
+    al_set_config_value(defaultConfig, "audio", "output_latency_ms", "0");
+    al_set_config_value(defaultConfig, "audio", "stream_memory_kb", "2048");
+    al_set_config_value(defaultConfig, "equalizer", "enabled", "0");
+    al_set_config_value(defaultConfig, "equalizer", "preamp_db", "0");
+    al_set_config_value(defaultConfig, "equalizer", "gains_db", "0,0,0,0,0,0,0,0,0,0");
+    al_set_config_value(defaultConfig, "library", "analyze_loudness", "1");
 
     // Save the config file
     bool success = al_save_config_file(filename.c_str(), defaultConfig);
@@ -508,6 +521,10 @@ int Config::getDisplayHeight() const {
     return getInt("display", "height", 300);
 }
 
+bool Config::getShaderHotReload() const {
+    return getInt("display", "shader_hot_reload", 0) != 0;
+}
+
 int Config::getVolumePercent() const {
     const int value = getInt("audio", "volume_percent", 100);
     return std::clamp(value, 0, 100);
@@ -517,4 +534,73 @@ void Config::setVolumePercent(int percent) {
     setInt("audio", "volume_percent", std::clamp(percent, 0, 100));
 }
 
+int Config::getPreloadSeconds() const {
+    const int value = getInt("audio", "preload_seconds", 10);
+    return std::clamp(value, 1, 60);
+}
+
+int Config::getCrossfadeSeconds() const {
+    const int value = getInt("audio", "crossfade_seconds", 0);
+    return std::clamp(value, 0, 12);
+}
+
+std::string Config::getReplayGainMode() const {
+    return getString("audio", "replaygain", "track");
+}
+
+int Config::getSampleRate() const {
+    const int value = getInt("audio", "sample_rate", 0);
+    return value <= 0 ? 0 : std::clamp(value, 8000, 192000);
+}
+
+std::string Config::getMixerDepth() const {
+    return getString("audio", "mixer_depth", "float32");
+}
+
+std::string Config::getResampler() const {
+    return getString("audio", "resampler", "linear");
+}
+
+int Config::getOutputLatencyMs() const {
+    const int value = getInt("audio", "output_latency_ms", 0);
+    return std::clamp(value, 0, 1000);
+}
+
+int Config::getStreamMemoryKb() const {
+    const int value = getInt("audio", "stream_memory_kb", 2048);
+    return std::clamp(value, 256, 262144);
+}
+
+bool Config::getEqualizerEnabled() const {
+    return getInt("equalizer", "enabled", 0) != 0;
+}
+
+float Config::getEqualizerPreampDb() const {
+    const std::string value = getString("equalizer", "preamp_db", "0");
+    return std::clamp(std::strtof(value.c_str(), nullptr), -24.0f, 24.0f);
+}
+
+std::vector<float> Config::getEqualizerGains() const {
+    std::vector<float> gains;
+    const std::string value = getString("equalizer", "gains_db", "");
+    const char* cursor = value.c_str();
+    while (*cursor) {
+        char* end = nullptr;
+        const float gain = std::strtof(cursor, &end);
+        if (end == cursor) {
+            break;
+        }
+        gains.push_back(std::clamp(gain, -24.0f, 24.0f));
+        cursor = end;
+        while (*cursor == ',' || *cursor == ' ') {
+            ++cursor;
+        }
+    }
+    return gains;
+}
+
+bool Config::getAnalyzeLoudness() const {
+    return getInt("library", "analyze_loudness", 1) != 0;
+}
+
 } // namespace util
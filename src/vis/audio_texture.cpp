@@ -0,0 +1,108 @@
+#include "vis/audio_texture.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+#include "core/spectrum_analyzer.hpp"
+
+namespace vis {
+namespace {
+// Stores `count` values through `put` the way row `row` keeps them: samples
+// mapped from [-1, 1] to [0, 1], band levels as they are. Anything past
+// `count` is left unwritten; the shaders never read beyond the *_count uniforms.
+template <typename PutFn>
+void writeRow(const float* values, std::size_t count, int row, PutFn&& put) {
+    if (row == AudioTexture::Spectrum) {
+        for (std::size_t i = 0; i < count; ++i) {
+            put(i, std::clamp(values[i], 0.0f, 1.0f));
+        }
+    } else {
+        for (std::size_t i = 0; i < count; ++i) {
+            put(i, std::clamp(values[i], -1.0f, 1.0f) * 0.5f + 0.5f);
+        }
+    }
+}
+}
+
+AudioTexture::~AudioTexture() {
+    if (bitmap) {
+        al_destroy_bitmap(bitmap);
+    }
+}
+
+bool AudioTexture::ensure() {
+    if (bitmap || failed) {
+        return bitmap != nullptr;
+    }
+
+    // Point sampling: each texel packs four unrelated values, so the
+    // application-wide linear filtering and mipmaps must not apply.
+    const int previousFlags = al_get_new_bitmap_flags();
+    const int previousFormat = al_get_new_bitmap_format();
+    al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP | ALLEGRO_NO_PRESERVE_TEXTURE);
+    for (const int format : {ALLEGRO_PIXEL_FORMAT_ABGR_F32, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE}) {
+        al_set_new_bitmap_format(format);
+        bitmap = al_create_bitmap(kWidth, kRows);
+        if (bitmap && al_get_bitmap_format(bitmap) == format) {
+            floatTexels = format == ALLEGRO_PIXEL_FORMAT_ABGR_F32;
+            break;
+        }
+        if (bitmap) {
+            al_destroy_bitmap(bitmap);
+            bitmap = nullptr;
+        }
+    }
+    al_set_new_bitmap_flags(previousFlags);
+    al_set_new_bitmap_format(previousFormat);
+
+    if (!bitmap) {
+        std::cerr << "AudioTexture: no float or 8-bit video texture; visualizations stay on the CPU\n";
+        failed = true;
+    }
+    return bitmap != nullptr;
+}
+
+void AudioTexture::upload(const std::vector<float>& mono, const std::vector<float>& left,
+                          const std::vector<float>& right, const core::SpectrumSnapshot* spectrum) {
+    if (!bitmap) {
+        return;
+    }
+
+    const float* rows[kRows] = {};
+    const std::vector<float>* samples[3] = {&mono, &left, &right};
+    for (int row = Mono; row <= Right; ++row) {
+        counts[row] = std::min(samples[row]->size(), kMaxValues);
+        rows[row] = samples[row]->data() + (samples[row]->size() - counts[row]);
+    }
+    counts[Spectrum] = spectrum ? std::min(spectrum->band_count, kMaxValues) : 0;
+    rows[Spectrum] = spectrum ? spectrum->band_level.data() : nullptr;
+
+    // Only the texels that can hold data this frame are uploaded.
+    const std::size_t texels = std::max<std::size_t>(1, (*std::max_element(counts, counts + kRows) + 3) / 4);
+    const int format = floatTexels ? ALLEGRO_PIXEL_FORMAT_ABGR_F32 : ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE;
+    ALLEGRO_LOCKED_REGION* locked = al_lock_bitmap_region(bitmap, 0, 0, static_cast<int>(texels), kRows, format, ALLEGRO_LOCK_WRITEONLY);
+    if (!locked) {
+        return;
+    }
+
+    for (int row = 0; row < kRows; ++row) {
+        packRow(static_cast<Row>(row), rows[row], counts[row], floatTexels,
+                static_cast<uint8_t*>(locked->data) + row * locked->pitch);
+    }
+    al_unlock_bitmap(bitmap);
+}
+
+void AudioTexture::packRow(Row row, const float* values, std::size_t count, bool floatTexels, void* line) {
+    if (floatTexels) {
+        auto* out = static_cast<float*>(line);
+        writeRow(values, count, row, [out](std::size_t i, float value) { out[i] = value; });
+    } else {
+        auto* out = static_cast<uint8_t*>(line);
+        writeRow(values, count, row, [out](std::size_t i, float value) {
+            out[i] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+        });
+    }
+}
+
+} // namespace vis
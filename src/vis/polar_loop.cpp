@@ -0,0 +1,28 @@
+#include "vis/polar_loop.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vis {
+
+void PolarLoop::build(const float* samples, std::size_t count, float centerX, float centerY, float baseRadius,
+                      float maxRadius, ALLEGRO_COLOR color, ALLEGRO_VERTEX* out) {
+    if (cosTable.size() != count) {
+        const float twoPi = 2.0f * 3.14159265359f;
+        cosTable.resize(count);
+        sinTable.resize(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            const float angle = (static_cast<float>(i) / count) * twoPi;
+            cosTable[i] = std::cos(angle);
+            sinTable[i] = std::sin(angle);
+        }
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const float sample = std::clamp(samples[i], -1.0f, 1.0f);
+        const float radius = baseRadius + std::abs(sample) * maxRadius;
+        out[i] = {centerX + radius * cosTable[i], centerY + radius * sinTable[i], 0.0f, 0.0f, 0.0f, color};
+    }
+}
+
+} // namespace vis
@@ -1,7 +1,16 @@
 #include "vis/shader.hpp"
 #include <iostream>
 
+#include <allegro5/allegro_opengl.h>
+
+#include "vis/audio_texture.hpp"
+
 namespace vis {
+namespace {
+// Link serials are unique across all shaders, so a handle resolved against
+// one program is never mistaken as valid for another.
+unsigned nextLinkSerial = 0;
+}
 
 Shader::Shader() {
     shader = al_create_shader(ALLEGRO_SHADER_AUTO);
@@ -31,18 +40,31 @@ Shader::~Shader() {
 }
 
 bool Shader::load(const std::string &vertexSource, const std::string &fragmentSource, bool fromFile) {
+    // Build into a fresh program and replace the current one only once it
+    // links, so a failed rebuild keeps the last working program.
+    ALLEGRO_SHADER* previous = shader;
+    const unsigned previousSerial = linkSerial;
+    shader = al_create_shader(ALLEGRO_SHADER_AUTO);
+    linkSerial = 0;
+
+    bool built = false;
     if (shader) {
-        al_destroy_shader(shader);
-        shader = nullptr;
+        built = fromFile ? loadFromFile(vertexSource, fragmentSource) : loadFromSource(vertexSource, fragmentSource);
     }
 
-    shader = al_create_shader(ALLEGRO_SHADER_AUTO);
+    if (built) {
+        if (previous) {
+            al_destroy_shader(previous);
+        }
+        return true;
+    }
 
-    if (fromFile) {
-        return loadFromFile(vertexSource, fragmentSource);
-    } else {
-        return loadFromSource(vertexSource, fragmentSource);
+    if (shader) {
+        al_destroy_shader(shader);
     }
+    shader = previous;
+    linkSerial = previousSerial;
+    return false;
 }
 
 void Shader::use() const {
@@ -64,6 +86,7 @@ bool Shader::loadFromSource(const std::string &vertexSource, const std::string &
             std::cerr << "Shader build failed: " << al_get_shader_log(shader) << std::endl;
             return false;
         }
+        linkSerial = ++nextLinkSerial;
     }
     return r1 && r2;
 }
@@ -77,6 +100,7 @@ bool Shader::loadFromFile(const std::string &vertexPath, const std::string &frag
             std::cerr << "Shader build failed: " << al_get_shader_log(shader) << std::endl;
             return false;
         } else {
+            linkSerial = ++nextLinkSerial;
             std::cout << "Shader loaded successfully from files: " << vertexPath << " and " << fragmentPath << std::endl;
         }
     }
@@ -118,4 +142,82 @@ bool Shader::setMatrix(const char *name, const ALLEGRO_TRANSFORM *matrix) {
     return al_set_shader_matrix(name, matrix);
 };
 
+Uniform Shader::uniform(const char *name) {
+    Uniform handle(name);
+    resolve(handle);
+    return handle;
+}
+
+bool Shader::resolve(Uniform &uniform) const {
+    if (linkSerial == 0) return false;
+    if (uniform.link != linkSerial) {
+        uniform.location = glGetUniformLocation(al_get_opengl_program_object(shader), uniform.name);
+        uniform.link = linkSerial;
+    }
+    return uniform.location >= 0;
+}
+
+bool Shader::set(Uniform &uniform, float value) {
+    if (!isCurrentShader() || !resolve(uniform)) return false;
+    glUniform1f(uniform.location, value);
+    return true;
+}
+
+bool Shader::set(Uniform &uniform, int value) {
+    if (!isCurrentShader() || !resolve(uniform)) return false;
+    glUniform1i(uniform.location, value);
+    return true;
+}
+
+bool Shader::setVector(Uniform &uniform, int num_components, const float *values, int count) {
+    if (!isCurrentShader() || !resolve(uniform)) return false;
+    switch (num_components) {
+        case 1: glUniform1fv(uniform.location, count, values); return true;
+        case 2: glUniform2fv(uniform.location, count, values); return true;
+        case 3: glUniform3fv(uniform.location, count, values); return true;
+        case 4: glUniform4fv(uniform.location, count, values); return true;
+        default: return false;
+    }
+}
+
+bool Shader::setTexture(Uniform &uniform, ALLEGRO_BITMAP *texture, int unit) {
+    if (!isCurrentShader() || !resolve(uniform)) return false;
+    // Bound through Allegro, which looks the name up again: glBindTexture is
+    // core GL 1.1, not one of the entry points Allegro loads, and the binary
+    // does not link libGL itself.
+    return al_set_shader_sampler(uniform.name, texture, unit);
+}
+
+bool Shader::setAudio(const AudioUniforms &audio) {
+    if (!isCurrentShader()) return false;
+    AudioHandles& h = audioHandles;
+    set(h.time, audio.time);
+    set(h.rms, audio.rms);
+    set(h.peak, audio.peak);
+    set(h.transient, audio.transient);
+    set(h.beatPulse, audio.beatPulse);
+
+    const AudioTexture* texture = audio.texture;
+    if (texture && texture->getBitmap()) {
+        ALLEGRO_BITMAP* bitmap = texture->getBitmap();
+        // The GL texture can be larger than the bitmap (power-of-two sizes,
+        // minimum heights), so address texels the way the primitives addon
+        // does: by the real texture size and the bitmap's position in it.
+        int texW = AudioTexture::kWidth, texH = AudioTexture::kRows;
+        int texU = 0, texV = 0;
+        al_get_opengl_texture_size(bitmap, &texW, &texH);
+        al_get_opengl_texture_position(bitmap, &texU, &texV);
+        const float size[2] = {static_cast<float>(texW), static_cast<float>(texH)};
+        const float offset[2] = {static_cast<float>(texU), static_cast<float>(texV)};
+        setTexture(h.texture, bitmap, audio.textureUnit);
+        setVector(h.textureSize, 2, size, 1);
+        setVector(h.textureOffset, 2, offset, 1);
+        set(h.monoCount, static_cast<float>(texture->getCount(AudioTexture::Mono)));
+        set(h.leftCount, static_cast<float>(texture->getCount(AudioTexture::Left)));
+        set(h.rightCount, static_cast<float>(texture->getCount(AudioTexture::Right)));
+        set(h.bandCount, static_cast<float>(texture->getCount(AudioTexture::Spectrum)));
+    }
+    return true;
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "vis/shader_cache.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "util/config.hpp"
+#include "vis/shader.hpp"
+
+namespace vis {
+namespace {
+namespace fs = std::filesystem;
+
+constexpr const char* kVertexAsset = "shaders/vertex.glsl";
+
+// Same directory and file name; the asset root may be relative.
+bool isFile(const std::string& path, const std::string& dir, const std::string& name) {
+    const fs::path file(path);
+    return file.filename() == name && file.parent_path().lexically_normal() == fs::path(dir).lexically_normal();
+}
+}
+
+ShaderCache::ShaderCache()
+    : entries{{
+          {kVertexAsset, "shaders/pixel.glsl", nullptr},
+          {kVertexAsset, "shaders/rainbow.glsl", nullptr},
+          {kVertexAsset, "shaders/dual_echo_feedback.glsl", nullptr},
+          {kVertexAsset, "shaders/polar_waveform.glsl", nullptr},
+          {kVertexAsset, "shaders/mirror_bars.glsl", nullptr},
+      }} {
+}
+
+ShaderCache::~ShaderCache() {
+    setHotReload(false);
+}
+
+void ShaderCache::compileAll() {
+    for (Entry& entry : entries) {
+        compile(entry);
+    }
+}
+
+Shader* ShaderCache::get(Program program) const {
+    return entries[static_cast<std::size_t>(program)].shader.get();
+}
+
+bool ShaderCache::compile(Entry& entry) {
+    const std::string vertexPath = util::Config::resolveAssetPath(entry.vertexAsset);
+    const std::string fragmentPath = util::Config::resolveAssetPath(entry.fragmentAsset);
+    if (!entry.shader) {
+        entry.shader = std::make_unique<Shader>(vertexPath, fragmentPath, true);
+        if (entry.shader->isLoaded()) {
+            return true;
+        }
+        std::cerr << "ShaderCache: " << entry.fragmentAsset << " did not build; its visualization draws without it\n";
+        return false;
+    }
+
+    const bool hadBuild = entry.shader->isLoaded();
+    if (entry.shader->load(vertexPath, fragmentPath, true)) {
+        return true;
+    }
+
+    if (hadBuild) {
+        std::cerr << "ShaderCache: keeping the previous build of " << entry.fragmentAsset << "\n";
+    } else {
+        std::cerr << "ShaderCache: " << entry.fragmentAsset << " did not build; its visualization draws without it\n";
+    }
+    return false;
+}
+
+#ifdef __linux__
+void ShaderCache::setHotReload(bool enabled) {
+    if (enabled == (watchFd >= 0)) {
+        return;
+    }
+
+    if (!enabled) {
+        close(watchFd);
+        watchFd = -1;
+        watches.clear();
+        return;
+    }
+
+    watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watchFd < 0) {
+        std::cerr << "ShaderCache: inotify unavailable; shader hot reload is off\n";
+        return;
+    }
+
+    // Directories rather than files: editors that save by renaming a new
+    // file over the old one would otherwise drop the watch.
+    for (const Entry& entry : entries) {
+        for (const char* asset : {entry.vertexAsset, entry.fragmentAsset}) {
+            const std::string dir = fs::path(util::Config::resolveAssetPath(asset)).parent_path().string();
+            const bool known = std::any_of(watches.begin(), watches.end(), [&dir](const auto& watch) {
+                return watch.second == dir;
+            });
+            if (known) {
+                continue;
+            }
+            const int wd = inotify_add_watch(watchFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (wd < 0) {
+                std::cerr << "ShaderCache: cannot watch " << dir << "\n";
+                continue;
+            }
+            watches.emplace_back(wd, dir);
+        }
+    }
+    std::cout << "ShaderCache: watching shaders for changes\n";
+}
+
+void ShaderCache::poll() {
+    if (watchFd < 0) {
+        return;
+    }
+
+    // An editor save can raise several events; each program rebuilds once.
+    std::array<bool, kProgramCount> changed{};
+    bool anyChanged = false;
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+        const ssize_t length = read(watchFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            if (length < 0 && errno != EAGAIN && errno != EINTR) {
+                std::cerr << "ShaderCache: lost the shader watch; hot reload is off\n";
+                setHotReload(false);
+                return;
+            }
+            break;
+        }
+
+        for (ssize_t offset = 0; offset < length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            if (event->len == 0) {
+                continue;
+            }
+
+            const auto watch = std::find_if(watches.begin(), watches.end(), [event](const auto& w) {
+                return w.first == event->wd;
+            });
+            if (watch == watches.end()) {
+                continue;
+            }
+
+            for (std::size_t i = 0; i < kProgramCount; ++i) {
+                const Entry& entry = entries[i];
+                if (isFile(util::Config::resolveAssetPath(entry.vertexAsset), watch->second, event->name) ||
+                    isFile(util::Config::resolveAssetPath(entry.fragmentAsset), watch->second, event->name)) {
+                    changed[i] = true;
+                    anyChanged = true;
+                }
+            }
+        }
+    }
+
+    if (!anyChanged) {
+        return;
+    }
+
+    // Keep whatever shader was in use bound across the rebuilds.
+    ALLEGRO_SHADER* current = al_get_current_shader();
+    for (std::size_t i = 0; i < kProgramCount; ++i) {
+        if (changed[i] && compile(entries[i])) {
+            std::cout << "ShaderCache: reloaded " << entries[i].fragmentAsset << "\n";
+        }
+    }
+    al_use_shader(current);
+}
+#else
+void ShaderCache::setHotReload(bool enabled) {
+    if (enabled) {
+        std::cerr << "ShaderCache: shader hot reload needs inotify and is Linux only\n";
+    }
+}
+
+void ShaderCache::poll() {
+}
+#endif
+
+} // namespace vis
@@ -9,8 +9,10 @@
 #include <allegro5/allegro.h>
 #include <allegro5/allegro_primitives.h>
 
+#include "vis/audio_texture.hpp"
+#include "vis/polar_loop.hpp"
 #include "vis/shader.hpp"
-#include "util/config.hpp"
+#include "vis/shader_cache.hpp"
 
 namespace {
 
@@ -20,7 +22,8 @@ struct AudioMetrics {
     float transient = 0.0f;
 };
 
-constexpr std::size_t kPolarWaveformSampleWindow = 1024;
+// Level metrics follow the newest samples only, however long the window drawn.
+constexpr std::size_t kAudioMetricsWindow = 1024;
 constexpr std::size_t kMirrorBarsSampleWindow = 768;
 constexpr std::size_t kDualEchoStereoSampleWindow = 1024;
 constexpr std::size_t kDualEchoMonoFallbackWindow = 512;
@@ -88,6 +91,92 @@ void splitInterleavedStereoSamples(const std::vector<float>& interleavedSamples,
     }
 }
 
+using Program = vis::ShaderCache::Program;
+
+// The cache's build of `program`, or null if it has none; the visualization
+// then draws without it.
+vis::Shader* cachedProgram(const ui::AudioVisualizerView::FrameContext& context, Program program) {
+    vis::Shader* shader = context.shaders ? context.shaders->get(program) : nullptr;
+    return (shader && shader->isLoaded()) ? shader : nullptr;
+}
+
+// 1 on a beat of the tracked tempo, decaying over the first part of the beat;
+// fades out as the tracker's confidence drops, and is 0 without a tempo.
+float beatPulse(const ui::AudioVisualizerView::FrameContext& context) {
+    if (context.bpm <= 0.0f) {
+        return 0.0f;
+    }
+    const float t = std::clamp((context.beatConfidence - 0.1f) / 0.25f, 0.0f, 1.0f);
+    return (t * t * (3.0f - 2.0f * t)) * std::exp(-5.0f * context.beatPhase);
+}
+
+// Covers the visualization's area for a shader that draws all of it from the
+// audio texture. Texture coordinates are pixels from the area's top-left.
+void drawAudioTextureArea(const ui::AudioVisualizerView::FrameContext& context, ALLEGRO_COLOR color) {
+    const float right = context.x + context.w;
+    const float bottom = context.y + context.h;
+    const ALLEGRO_VERTEX quad[4] = {
+        {context.x, context.y, 0.0f, 0.0f, 0.0f, color},
+        {right, context.y, 0.0f, context.w, 0.0f, color},
+        {right, bottom, 0.0f, context.w, context.h, color},
+        {context.x, bottom, 0.0f, 0.0f, context.h, color},
+    };
+    al_draw_prim(quad, nullptr, nullptr, 0, 4, ALLEGRO_PRIM_TRIANGLE_FAN);
+}
+
+// Waveform vertices kept across frames: a write-only dynamic vertex buffer
+// when the display can make one, otherwise a reused array for al_draw_prim.
+class WaveformVertices {
+public:
+    ~WaveformVertices() { release(); }
+
+    // Space for `count` vertices, valid until draw().
+    ALLEGRO_VERTEX* lock(int count) {
+        lockedCount = count;
+        if (!bufferFailed && (!buffer || capacity < count)) {
+            release();
+            buffer = al_create_vertex_buffer(nullptr, nullptr, count, ALLEGRO_PRIM_BUFFER_DYNAMIC);
+            bufferFailed = !buffer;
+            capacity = buffer ? count : 0;
+        }
+        if (buffer) {
+            if (auto* vertices = static_cast<ALLEGRO_VERTEX*>(al_lock_vertex_buffer(buffer, 0, count, ALLEGRO_LOCK_WRITEONLY))) {
+                bufferLocked = true;
+                return vertices;
+            }
+        }
+        fallback.resize(static_cast<std::size_t>(count));
+        return fallback.data();
+    }
+
+    void draw(int type) {
+        if (bufferLocked) {
+            al_unlock_vertex_buffer(buffer);
+            bufferLocked = false;
+            al_draw_vertex_buffer(buffer, nullptr, 0, lockedCount, type);
+        } else {
+            al_draw_prim(fallback.data(), nullptr, nullptr, 0, lockedCount, type);
+        }
+    }
+
+    void release() {
+        if (buffer) {
+            al_destroy_vertex_buffer(buffer);
+            buffer = nullptr;
+        }
+        capacity = 0;
+        fallback.clear();
+    }
+
+private:
+    ALLEGRO_VERTEX_BUFFER* buffer = nullptr;
+    int capacity = 0;
+    int lockedCount = 0;
+    bool bufferLocked = false;
+    bool bufferFailed = false;
+    std::vector<ALLEGRO_VERTEX> fallback;
+};
+
 struct DualEchoFeedbackState {
     ALLEGRO_BITMAP* historyA = nullptr;
     ALLEGRO_BITMAP* historyB = nullptr;
@@ -95,9 +184,17 @@ struct DualEchoFeedbackState {
     int width = 0;
     int height = 0;
     int historyIndex = 0;
-    std::unique_ptr<vis::Shader> feedbackShader;
-    std::vector<ALLEGRO_VERTEX> topChannelVertices;
-    std::vector<ALLEGRO_VERTEX> bottomChannelVertices;
+    vis::Uniform echoDecay{"echo_decay"};
+    vis::Uniform echoSpeed{"echo_speed"};
+    vis::Uniform echoCenter{"echo_center"};
+    vis::Uniform texelSize{"texel_size"};
+    vis::Uniform historyTex{"history_tex"};
+    WaveformVertices topChannelVertices;
+    WaveformVertices bottomChannelVertices;
+
+    ~DualEchoFeedbackState() {
+        releaseResources();
+    }
 
     void releaseResources() {
         if (historyA) {
@@ -116,9 +213,8 @@ struct DualEchoFeedbackState {
         width = 0;
         height = 0;
         historyIndex = 0;
-        feedbackShader.reset();
-        topChannelVertices.clear();
-        bottomChannelVertices.clear();
+        topChannelVertices.release();
+        bottomChannelVertices.release();
     }
 
     bool ensureRenderTargets(int newWidth, int newHeight) {
@@ -172,7 +268,7 @@ public:
     void update(const ui::AudioVisualizerView::FrameContext& context) override {
         const std::vector<float>* samples = context.samples ? &context.samples->mono : nullptr;
         if (samples && !samples->empty()) {
-            metrics = computeTailAudioMetrics(*samples, kPolarWaveformSampleWindow);
+            metrics = computeTailAudioMetrics(*samples, kAudioMetricsWindow);
         } else {
             metrics = {};
         }
@@ -189,54 +285,31 @@ public:
         const float baseRadius = std::min(context.w, context.h) * 0.15f;
         const float maxRadius = std::min(context.w, context.h) * 0.35f;
         const ALLEGRO_COLOR waveformColor = al_map_rgba(255, 255, 255, 220);
-        const float twoPi = 2.0f * 3.14159265359f;
 
+        if (context.audioTexture && drawFromTexture(context, waveformColor)) {
+            return;
+        }
+
+        vis::Shader* program = shader ? shader.get() : cachedProgram(context, Program::PolarWaveform);
         bool shaderActive = false;
-        if (shader && shader->isLoaded()) {
-            shader->use();
+        if (program && program->isLoaded()) {
+            program->use();
             shaderActive = true;
-            shader->setFloat("time", context.timeSeconds);
+            program->setAudio(audioUniforms(context));
 
             const float visCenter[2] = {
                 context.x + (context.w * 0.5f),
                 context.y + (context.h * 0.5f)
             };
             const float visRadius = (std::min(context.w, context.h) * 0.15f) + (std::min(context.w, context.h) * 0.35f * 0.5f);
-            shader->setFloatVector("vis_center", 2, visCenter, 1);
-            shader->setFloat("vis_radius", visRadius);
-            shader->setFloat("audio_rms", metrics.rms);
-            shader->setFloat("audio_peak", metrics.peak);
-            shader->setFloat("audio_transient", metrics.transient);
-        }
-
-        std::vector<ALLEGRO_VERTEX> vertices;
-        vertices.reserve(audioSamples->size() * 2);
-
-        for (std::size_t i = 0; i < audioSamples->size(); ++i) {
-            const std::size_t nextIdx = (i + 1) % audioSamples->size();
-
-            const float angle1 = (static_cast<float>(i) / audioSamples->size()) * twoPi;
-            const float angle2 = (static_cast<float>(nextIdx) / audioSamples->size()) * twoPi;
-
-            const float sample1 = std::clamp((*audioSamples)[i], -1.0f, 1.0f);
-            const float sample2 = std::clamp((*audioSamples)[nextIdx], -1.0f, 1.0f);
-            const float radius1 = baseRadius + std::abs(sample1) * maxRadius;
-            const float radius2 = baseRadius + std::abs(sample2) * maxRadius;
-
-            const float px1 = centerX + radius1 * std::cos(angle1);
-            const float py1 = centerY + radius1 * std::sin(angle1);
-            const float px2 = centerX + radius2 * std::cos(angle2);
-            const float py2 = centerY + radius2 * std::sin(angle2);
-
-            ALLEGRO_VERTEX v1 = {px1, py1, 0.0f, 0.0f, 0.0f, waveformColor};
-            ALLEGRO_VERTEX v2 = {px2, py2, 0.0f, 0.0f, 0.0f, waveformColor};
-            vertices.push_back(v1);
-            vertices.push_back(v2);
+            program->setVector(visCenterUniform, 2, visCenter, 1);
+            program->set(visRadiusUniform, visRadius);
         }
 
-        if (!vertices.empty()) {
-            al_draw_prim(vertices.data(), nullptr, nullptr, 0, static_cast<int>(vertices.size()), ALLEGRO_PRIM_LINE_LIST);
-        }
+        const std::size_t sampleCount = audioSamples->size();
+        loop.build(audioSamples->data(), sampleCount, centerX, centerY, baseRadius, maxRadius, waveformColor,
+                   vertices.lock(static_cast<int>(sampleCount)));
+        vertices.draw(ALLEGRO_PRIM_LINE_LOOP);
 
         if (shaderActive) {
             al_use_shader(nullptr);
@@ -244,7 +317,41 @@ public:
     }
 
 private:
+    bool drawFromTexture(const ui::AudioVisualizerView::FrameContext& context, ALLEGRO_COLOR color) {
+        vis::Shader* textureShader = cachedProgram(context, Program::PolarWaveformTexture);
+        if (!textureShader) {
+            return false;
+        }
+
+        textureShader->use();
+        vis::AudioUniforms audio = audioUniforms(context);
+        audio.texture = context.audioTexture;
+        textureShader->setAudio(audio);
+        const float visSize[2] = {context.w, context.h};
+        const float visRadius = (std::min(context.w, context.h) * 0.15f) + (std::min(context.w, context.h) * 0.35f * 0.5f);
+        textureShader->setVector(textureVisSize, 2, visSize, 1);
+        textureShader->set(textureVisRadius, visRadius);
+        drawAudioTextureArea(context, color);
+        al_use_shader(nullptr);
+        return true;
+    }
+
+    vis::AudioUniforms audioUniforms(const ui::AudioVisualizerView::FrameContext& context) const {
+        vis::AudioUniforms audio;
+        audio.time = context.timeSeconds;
+        audio.rms = metrics.rms;
+        audio.peak = metrics.peak;
+        audio.transient = metrics.transient;
+        return audio;
+    }
+
     AudioMetrics metrics;
+    vis::Uniform visCenterUniform{"vis_center"};
+    vis::Uniform visRadiusUniform{"vis_radius"};
+    vis::Uniform textureVisSize{"vis_size"};
+    vis::Uniform textureVisRadius{"vis_radius"};
+    vis::PolarLoop loop;
+    WaveformVertices vertices;
 };
 
 class MirrorBarsVisualization final : public ui::AudioVisualizerView::Visualization {
@@ -265,34 +372,59 @@ public:
             return;
         }
 
+        const float tint[3] = {
+            0.30f + (0.55f * intensity),
+            0.55f + (0.35f * intensity),
+            0.95f
+        };
+        const ALLEGRO_COLOR barColor = al_map_rgba(246, 250, 255, 210);
+        if (context.audioTexture && drawFromTexture(context, tint, barColor)) {
+            return;
+        }
+
+        vis::Shader* program = shader ? shader.get() : cachedProgram(context, Program::MirrorBars);
         bool shaderActive = false;
-        if (shader && shader->isLoaded()) {
-            shader->use();
+        if (program && program->isLoaded()) {
+            program->use();
             shaderActive = true;
-            shader->setFloat("time", context.timeSeconds);
-            const float tint[3] = {
-                0.30f + (0.55f * intensity),
-                0.55f + (0.35f * intensity),
-                0.95f
-            };
-            shader->setFloatVector("tint", 3, tint, 1);
+            vis::AudioUniforms audio;
+            audio.time = context.timeSeconds;
+            program->setAudio(audio);
+            program->setVector(tintUniform, 3, tint, 1);
         }
 
         const float centerY = context.y + (context.h * 0.5f);
         const float columnWidth = std::max(1.0f, context.w / 160.0f);
         const float spacing = std::max(1.0f, columnWidth * 1.35f);
         const int barCount = static_cast<int>(std::max(8.0f, std::floor(context.w / spacing)));
-        const int sampleStride = std::max<int>(1, static_cast<int>(audioSamples->size() / static_cast<std::size_t>(barCount)));
-        const ALLEGRO_COLOR barColor = al_map_rgba(246, 250, 255, 210);
-
-        for (int i = 0; i < barCount; ++i) {
-            const std::size_t sampleIndex = std::min(audioSamples->size() - 1, static_cast<std::size_t>(i * sampleStride));
-            const float magnitude = std::abs(std::clamp((*audioSamples)[sampleIndex], -1.0f, 1.0f));
-            const float halfHeight = std::max(1.0f, magnitude * context.h * 0.45f);
-            const float left = context.x + (i * spacing);
-            const float right = left + columnWidth;
-
-            al_draw_filled_rectangle(left, centerY - halfHeight, right, centerY + halfHeight, barColor);
+        const core::SpectrumSnapshot* spectrum = context.spectrum;
+
+        if (spectrum && spectrum->band_count > 0) {
+            // Spread the log-frequency bands across the bars, low on the left.
+            const float lastBand = static_cast<float>(spectrum->band_count - 1);
+            for (int i = 0; i < barCount; ++i) {
+                const float bandPos = barCount > 1 ? (lastBand * static_cast<float>(i) / static_cast<float>(barCount - 1)) : 0.0f;
+                const std::size_t lower = static_cast<std::size_t>(bandPos);
+                const std::size_t upper = std::min(lower + 1, spectrum->band_count - 1);
+                const float blend = bandPos - static_cast<float>(lower);
+                const float level = spectrum->band_level[lower] + (spectrum->band_level[upper] - spectrum->band_level[lower]) * blend;
+                const float halfHeight = std::max(1.0f, level * context.h * 0.45f);
+                const float left = context.x + (i * spacing);
+                const float right = left + columnWidth;
+
+                al_draw_filled_rectangle(left, centerY - halfHeight, right, centerY + halfHeight, barColor);
+            }
+        } else {
+            const int sampleStride = std::max<int>(1, static_cast<int>(audioSamples->size() / static_cast<std::size_t>(barCount)));
+            for (int i = 0; i < barCount; ++i) {
+                const std::size_t sampleIndex = std::min(audioSamples->size() - 1, static_cast<std::size_t>(i * sampleStride));
+                const float magnitude = std::abs(std::clamp((*audioSamples)[sampleIndex], -1.0f, 1.0f));
+                const float halfHeight = std::max(1.0f, magnitude * context.h * 0.45f);
+                const float left = context.x + (i * spacing);
+                const float right = left + columnWidth;
+
+                al_draw_filled_rectangle(left, centerY - halfHeight, right, centerY + halfHeight, barColor);
+            }
         }
 
         if (shaderActive) {
@@ -301,7 +433,29 @@ public:
     }
 
 private:
+    bool drawFromTexture(const ui::AudioVisualizerView::FrameContext& context, const float tint[3], ALLEGRO_COLOR color) {
+        vis::Shader* textureShader = cachedProgram(context, Program::MirrorBarsTexture);
+        if (!textureShader) {
+            return false;
+        }
+
+        textureShader->use();
+        vis::AudioUniforms audio;
+        audio.time = context.timeSeconds;
+        audio.texture = context.audioTexture;
+        textureShader->setAudio(audio);
+        const float visSize[2] = {context.w, context.h};
+        textureShader->setVector(textureVisSize, 2, visSize, 1);
+        textureShader->setVector(textureTint, 3, tint, 1);
+        drawAudioTextureArea(context, color);
+        al_use_shader(nullptr);
+        return true;
+    }
+
     float intensity = 0.0f;
+    vis::Uniform tintUniform{"tint"};
+    vis::Uniform textureVisSize{"vis_size"};
+    vis::Uniform textureTint{"tint"};
 };
 
 class DualEchoWaveVisualization final : public ui::AudioVisualizerView::Visualization {
@@ -319,41 +473,27 @@ public:
             return;
         }
 
-        if (!feedbackState.feedbackShader) {
-            const std::string vertexSource = util::Config::resolveAssetPath("shaders/vertex.glsl");
-            const std::string fragmentSource = util::Config::resolveAssetPath("shaders/dual_echo_feedback.glsl");
-            feedbackState.feedbackShader = std::make_unique<vis::Shader>(vertexSource.c_str(), fragmentSource.c_str(), true);
-        }
-
         const float topBaseline = texH * 0.28f;
         const float bottomBaseline = texH * 0.72f;
-        const float amplitude = texH * 0.25f;
+        const float pulse = beatPulse(context);
+        const float amplitude = texH * 0.25f * (1.0f + 0.25f * pulse);
 
         auto drawChannel = [&](const std::vector<float>* samples,
                                float baselineY,
                                ALLEGRO_COLOR color,
-                               std::vector<ALLEGRO_VERTEX>& vertices) {
+                               WaveformVertices& vertices) {
             if (!samples || samples->size() < 2) {
-                vertices.clear();
                 return;
             }
 
-            const std::size_t segmentCount = samples->size() - 1;
-            vertices.resize(segmentCount * 2);
-            const float invWidthDenom = 1.0f / static_cast<float>(segmentCount);
-
-            for (std::size_t i = 1, vertexIndex = 0; i < samples->size(); ++i, vertexIndex += 2) {
-                const float x1 = (static_cast<float>(i - 1) * invWidthDenom) * texW;
-                const float x2 = (static_cast<float>(i) * invWidthDenom) * texW;
-
-                const float y1 = baselineY - std::clamp((*samples)[i - 1], -1.0f, 1.0f) * amplitude;
-                const float y2 = baselineY - std::clamp((*samples)[i], -1.0f, 1.0f) * amplitude;
-
-                vertices[vertexIndex] = {x1, y1, 0.0f, 0.0f, 0.0f, color};
-                vertices[vertexIndex + 1] = {x2, y2, 0.0f, 0.0f, 0.0f, color};
+            const std::size_t sampleCount = samples->size();
+            const float xStep = static_cast<float>(texW) / static_cast<float>(sampleCount - 1);
+            ALLEGRO_VERTEX* out = vertices.lock(static_cast<int>(sampleCount));
+            for (std::size_t i = 0; i < sampleCount; ++i) {
+                const float y = baselineY - std::clamp((*samples)[i], -1.0f, 1.0f) * amplitude;
+                out[i] = {static_cast<float>(i) * xStep, y, 0.0f, 0.0f, 0.0f, color};
             }
-
-            al_draw_prim(vertices.data(), nullptr, nullptr, 0, static_cast<int>(vertices.size()), ALLEGRO_PRIM_LINE_LIST);
+            vertices.draw(ALLEGRO_PRIM_LINE_STRIP);
         };
 
         ALLEGRO_BITMAP* previousTarget = al_get_target_bitmap();
@@ -371,8 +511,9 @@ public:
         al_set_target_bitmap(historyDst);
         al_clear_to_color(al_map_rgba(0, 0, 0, 0));
 
-        if (feedbackState.feedbackShader && feedbackState.feedbackShader->isLoaded()) {
-            feedbackState.feedbackShader->use();
+        vis::Shader* feedbackShader = cachedProgram(context, Program::DualEchoFeedback);
+        if (feedbackShader) {
+            feedbackShader->use();
 
             float peak = 0.0f;
             float transient = 0.0f;
@@ -382,23 +523,27 @@ public:
             }
 
             if (metricSource && !metricSource->empty()) {
-                const AudioMetrics metrics = computeTailAudioMetrics(*metricSource, kPolarWaveformSampleWindow);
+                const AudioMetrics metrics = computeTailAudioMetrics(*metricSource, kAudioMetricsWindow);
                 peak = metrics.peak;
                 transient = metrics.transient;
             }
 
-            feedbackState.feedbackShader->setFloat("audio_peak", peak);
-            feedbackState.feedbackShader->setFloat("audio_transient", transient);
+            vis::AudioUniforms audio;
+            audio.time = context.timeSeconds;
+            audio.peak = peak;
+            audio.transient = transient;
+            audio.beatPulse = pulse;
+            feedbackShader->setAudio(audio);
 
             const float decay = std::clamp(0.955f + (peak * 0.03f), 0.955f, 0.992f);
-            feedbackState.feedbackShader->setFloat("echo_decay", decay);
-            feedbackState.feedbackShader->setFloat("echo_speed", 0.0018f + (peak * 0.0034f));
+            feedbackShader->set(feedbackState.echoDecay, decay);
+            feedbackShader->set(feedbackState.echoSpeed, 0.0018f + (peak * 0.0034f));
 
             const float centerUv[2] = {0.5f, 0.5f};
             const float texelSize[2] = {1.0f / static_cast<float>(texW), 1.0f / static_cast<float>(texH)};
-            feedbackState.feedbackShader->setFloatVector("echo_center", 2, centerUv, 1);
-            feedbackState.feedbackShader->setFloatVector("texel_size", 2, texelSize, 1);
-            feedbackState.feedbackShader->setTexture("history_tex", historySrc, 1);
+            feedbackShader->setVector(feedbackState.echoCenter, 2, centerUv, 1);
+            feedbackShader->setVector(feedbackState.texelSize, 2, texelSize, 1);
+            feedbackShader->setTexture(feedbackState.historyTex, historySrc, 1);
         }
 
         al_draw_scaled_bitmap(feedbackState.currentFrame, 0.0f, 0.0f, texW, texH, 0.0f, 0.0f, texW, texH, 0);
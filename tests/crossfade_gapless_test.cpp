@@ -0,0 +1,314 @@
+// Crossfade and gapless continuity on synthetic WAV fixtures.
+//
+// The fixtures are written to a temporary directory and decoded through
+// StreamSource like any song. The test then feeds them through the same
+// DeckFeed code MusicEngine runs on its decks: core::fillFragment() for each
+// fixed-size output fragment, and crossfadeRemaining() and
+// scheduleCrossfadeIn/Out() before each of the outgoing deck's fragments.
+// Summing the decks' fragments on one timeline stands in for the mixer and
+// the output streams' fragment queues.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#if defined(_WIN32) || defined(WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_acodec.h>
+#include <allegro5/allegro_audio.h>
+
+#include "core/deck_feed.hpp"
+#include "core/decode_scheduler.hpp"
+#include "core/pcm_format.hpp"
+#include "core/stream_source.hpp"
+#include "test_util.hpp"
+
+namespace {
+
+constexpr unsigned int kRate = 44100;
+constexpr size_t kChannels = 2;
+// The smallest and largest output shapes MusicEngine uses.
+constexpr size_t kFragmentSizes[] = {1024, 4096};
+// Fragments queued per output stream; the incoming deck of a crossfade is
+// held back by all but one of them.
+constexpr size_t kFragmentCount = 4;
+// RMS is compared over windows of this many frames (50 ms).
+constexpr size_t kWindowFrames = kRate / 20;
+
+// Per process, so concurrent ctest runs do not share fixtures.
+std::filesystem::path fixtureDirectory() {
+#if defined(_WIN32) || defined(WIN32)
+    const unsigned long pid = GetCurrentProcessId();
+#else
+    const long pid = static_cast<long>(getpid());
+#endif
+    std::error_code ec;
+    return std::filesystem::temp_directory_path(ec) / ("audiovis-test-" + std::to_string(pid));
+}
+
+bool writeWav(const std::string& path, const std::vector<int16_t>& pcm) {
+    std::ofstream out(path, std::ios::binary);
+    auto put32 = [&out](uint32_t v) { out.put(char(v)).put(char(v >> 8)).put(char(v >> 16)).put(char(v >> 24)); };
+    auto put16 = [&out](uint16_t v) { out.put(char(v)).put(char(v >> 8)); };
+    const uint32_t data_bytes = static_cast<uint32_t>(pcm.size() * sizeof(int16_t));
+    out.write("RIFF", 4);
+    put32(36 + data_bytes);
+    out.write("WAVEfmt ", 8);
+    put32(16);
+    put16(1); // PCM
+    put16(kChannels);
+    put32(kRate);
+    put32(kRate * kChannels * sizeof(int16_t));
+    put16(kChannels * sizeof(int16_t));
+    put16(16);
+    out.write("data", 4);
+    put32(data_bytes);
+    for (int16_t sample : pcm) {
+        put16(static_cast<uint16_t>(sample));
+    }
+    return static_cast<bool>(out);
+}
+
+// Independent noise per channel and seed, so two fixtures are uncorrelated
+// and an equal-power fade keeps their summed power constant.
+std::vector<int16_t> noise(size_t frames, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> gauss(0.0f, 4000.0f);
+    std::vector<int16_t> pcm(frames * kChannels);
+    for (auto& sample : pcm) {
+        sample = static_cast<int16_t>(std::clamp(gauss(rng), -32768.0f, 32767.0f));
+    }
+    return pcm;
+}
+
+std::vector<int16_t> sine(size_t frames, double hz) {
+    std::vector<int16_t> pcm(frames * kChannels);
+    for (size_t i = 0; i < frames; ++i) {
+        const double phase = 6.283185307179586 * hz * static_cast<double>(i) / kRate;
+        pcm[i * 2] = static_cast<int16_t>(std::lround(12000.0 * std::sin(phase)));
+        pcm[i * 2 + 1] = static_cast<int16_t>(std::lround(12000.0 * std::cos(phase)));
+    }
+    return pcm;
+}
+
+double rms(const float* samples, size_t count) {
+    double sum = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += static_cast<double>(samples[i]) * samples[i];
+    }
+    return count ? std::sqrt(sum / static_cast<double>(count)) : 0.0;
+}
+
+double decibels(double ratio) {
+    return 20.0 * std::log10(std::max(ratio, 1e-12));
+}
+
+core::DeckFeed openDeck(const std::string& path, core::DecodeScheduler* scheduler, size_t fragment_frames) {
+    core::DeckFeed deck;
+    deck.source = core::StreamSource::open(path, scheduler);
+    deck.fragment_frames = static_cast<unsigned int>(fragment_frames);
+    deck.stream_depth = ALLEGRO_AUDIO_DEPTH_INT16;
+    deck.stream_channels = ALLEGRO_CHANNEL_CONF_2;
+    deck.stream_frequency = kRate;
+    return deck;
+}
+
+void appendAsFloat(std::vector<float>& mix, size_t at, const std::vector<int16_t>& fragment) {
+    std::vector<float> converted(fragment.size());
+    core::pcmToFloat(fragment.data(), converted.data(), converted.size(), ALLEGRO_AUDIO_DEPTH_INT16);
+    if (mix.size() < at + converted.size()) {
+        mix.resize(at + converted.size(), 0.0f);
+    }
+    for (size_t i = 0; i < converted.size(); ++i) {
+        mix[at + i] += converted[i];
+    }
+}
+
+// Song A fades out over its last `fade_seconds` while song B fades in on a
+// second deck; the summed RMS must stay at the level of either song alone.
+void checkCrossfade(const std::string& a_path, const std::string& b_path, double fade_seconds, size_t fragment_frames,
+                    core::DecodeScheduler* scheduler) {
+    core::DeckFeed outgoing = openDeck(a_path, scheduler, fragment_frames);
+    std::unique_ptr<core::StreamSource> next = core::StreamSource::open(b_path, scheduler);
+    CHECK(outgoing.source && next);
+    if (!outgoing.source || !next) {
+        return;
+    }
+    outgoing.serial = 1;
+    uint64_t next_serial = 1;
+    core::RetiredSources retired;
+    std::unique_ptr<core::StreamSource> no_splice;
+
+    // The outgoing deck's fragment n plays at output frame n * fragment_frames.
+    // When the crossfade starts on fragment n, fragments n - 3 .. n - 1 are
+    // still queued, so the incoming stream starts playing at n - 3.
+    std::unique_ptr<core::DeckFeed> incoming;
+    uint64_t incoming_frame = 0; // output frame of the incoming deck's next fragment
+    uint64_t fade_start = 0;
+    double fade_seconds_scheduled = 0.0;
+    std::vector<float> mix;
+    std::vector<int16_t> fragment(fragment_frames * kChannels);
+    core::FragmentMark mark;
+
+    for (uint64_t out_frame = 0; !(outgoing.ended && incoming && incoming->ended); out_frame += fragment_frames) {
+        if (!incoming && next) {
+            if (const auto remaining = core::crossfadeRemaining(outgoing, fade_seconds)) {
+                const double queued_seconds = static_cast<double>((kFragmentCount - 1) * fragment_frames) / kRate;
+                incoming = std::make_unique<core::DeckFeed>(openDeck(b_path, scheduler, fragment_frames));
+                incoming->source = std::move(next);
+                incoming->serial = ++next_serial;
+                core::scheduleCrossfadeIn(*incoming, *remaining, queued_seconds);
+                core::scheduleCrossfadeOut(outgoing, *remaining);
+                CHECK(incoming->lead_in_frames == (kFragmentCount - 1) * fragment_frames);
+                incoming_frame = out_frame - incoming->lead_in_frames;
+                fade_start = out_frame;
+                fade_seconds_scheduled = *remaining;
+            }
+        }
+        if (!outgoing.ended) {
+            // Fading out, so it must not splice even if a source were ready.
+            core::fillFragment(outgoing, fragment.data(), mark, no_splice, next_serial, retired);
+            appendAsFloat(mix, out_frame * kChannels, fragment);
+        }
+        if (incoming) {
+            core::fillFragment(*incoming, fragment.data(), mark, no_splice, next_serial, retired);
+            appendAsFloat(mix, incoming_frame * kChannels, fragment);
+            incoming_frame += fragment_frames;
+        }
+        CHECK(out_frame < 60 * kRate);
+        if (out_frame >= 60 * kRate) {
+            return;
+        }
+    }
+    CHECK(fade_seconds_scheduled > 0.0 && fade_seconds_scheduled <= fade_seconds);
+    CHECK(outgoing.fading_out && !incoming->fading_out);
+    const uint64_t fade_frames = static_cast<uint64_t>(fade_seconds_scheduled * kRate);
+
+    // Reference level: song A alone, well before the fade.
+    const double reference = rms(mix.data(), kRate * kChannels);
+    double worst_db = 0.0;
+    double lowest_db = 0.0;
+    const uint64_t first = fade_start > kRate ? fade_start - kRate : 0;
+    const uint64_t last = fade_start + fade_frames + kRate;
+    for (uint64_t frame = first; frame + kWindowFrames <= last; frame += kWindowFrames) {
+        const double level = decibels(rms(mix.data() + frame * kChannels, kWindowFrames * kChannels) / reference);
+        worst_db = std::max(worst_db, std::abs(level));
+        lowest_db = std::min(lowest_db, level);
+    }
+    // A linear fade would dip 3 dB halfway through; a misplaced lead-in
+    // would overlap the songs at full level or leave a gap.
+    CHECK_MSG(worst_db < 0.5, "crossfade level strays " << worst_db << " dB (lowest " << lowest_db
+                                  << " dB), fragment " << fragment_frames);
+    std::printf("crossfade %.1f s, fragment %zu%s: worst window %.3f dB\n", fade_seconds, fragment_frames,
+                scheduler ? ", decoded ahead" : "", worst_db);
+}
+
+// Song B continues song A from the next frame inside the same fragment; the
+// output must be the uncut signal, with no level change at the seam.
+void checkGapless(const std::string& a_path, const std::string& b_path, const std::vector<int16_t>& whole,
+                  size_t split_frame, size_t fragment_frames, core::DecodeScheduler* scheduler) {
+    core::DeckFeed deck = openDeck(a_path, scheduler, fragment_frames);
+    std::unique_ptr<core::StreamSource> next = core::StreamSource::open(b_path, scheduler);
+    CHECK(deck.source && next);
+    if (!deck.source || !next) {
+        return;
+    }
+    deck.serial = 1;
+    uint64_t next_serial = 1;
+    core::RetiredSources retired;
+
+    // The fragment holding the seam is marked with song B and a negative
+    // position: song B starts that far into the fragment.
+    const uint64_t seam_fragment = (split_frame / fragment_frames) * fragment_frames;
+    std::vector<float> out;
+    std::vector<int16_t> fragment(fragment_frames * kChannels);
+    core::FragmentMark mark;
+    for (uint64_t out_frame = 0; !deck.ended && out_frame < 60 * kRate; out_frame += fragment_frames) {
+        core::fillFragment(deck, fragment.data(), mark, next, next_serial, retired);
+        appendAsFloat(out, out_frame * kChannels, fragment);
+        if (out_frame == seam_fragment) {
+            CHECK(mark.source_serial == 2 && mark.has_audio);
+            CHECK_MSG(std::abs(mark.position + static_cast<double>(split_frame - seam_fragment) / kRate) < 1e-9,
+                      "seam marked at " << mark.position << " s, fragment " << fragment_frames);
+        }
+    }
+    CHECK(!next);
+    CHECK(deck.serial == 2 && retired.size() == 1);
+
+    std::vector<float> expected(whole.size());
+    core::pcmToFloat(whole.data(), expected.data(), expected.size(), ALLEGRO_AUDIO_DEPTH_INT16);
+    CHECK_MSG(out.size() >= expected.size(), "decoded " << out.size() << " of " << expected.size() << " samples");
+    if (out.size() < expected.size()) {
+        return;
+    }
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        mismatches += out[i] != expected[i];
+    }
+    CHECK_MSG(mismatches == 0, mismatches << " samples differ from the uncut signal, fragment " << fragment_frames);
+    CHECK_MSG(rms(out.data() + expected.size(), out.size() - expected.size()) == 0.0, "audio after the end");
+
+    double worst_db = 0.0;
+    const double reference = rms(expected.data(), expected.size());
+    for (size_t frame = 0; frame + kWindowFrames <= expected.size() / kChannels; frame += kWindowFrames / 2) {
+        const double level = rms(out.data() + frame * kChannels, kWindowFrames * kChannels) / reference;
+        worst_db = std::max(worst_db, std::abs(decibels(level)));
+    }
+    CHECK_MSG(worst_db < 0.1, "gapless level strays " << worst_db << " dB, fragment " << fragment_frames);
+    std::printf("gapless, fragment %zu%s: worst window %.3f dB\n", fragment_frames,
+                scheduler ? ", decoded ahead" : "", worst_db);
+}
+
+} // namespace
+
+int main() {
+    if (!al_install_system(ALLEGRO_VERSION_INT, nullptr) || !al_init_acodec_addon()) {
+        std::fprintf(stderr, "failed to initialize Allegro audio codecs\n");
+        return 1;
+    }
+    // Fails on machines without a sound device; decoding does not need one.
+    al_install_audio();
+
+    std::error_code ec;
+    const std::filesystem::path dir = fixtureDirectory();
+    std::filesystem::create_directories(dir, ec);
+
+    // Crossfade fixtures: 8 s and 6 s of independent noise at the same level.
+    const std::string a_noise = (dir / "a_noise.wav").string();
+    const std::string b_noise = (dir / "b_noise.wav").string();
+    // Gapless fixtures: one sine split off any fragment boundary.
+    const std::vector<int16_t> whole = sine(5 * kRate, 441.0);
+    const size_t split_frame = 2 * kRate + 333;
+    const std::string a_sine = (dir / "a_sine.wav").string();
+    const std::string b_sine = (dir / "b_sine.wav").string();
+    CHECK(writeWav(a_noise, noise(8 * kRate, 1)));
+    CHECK(writeWav(b_noise, noise(6 * kRate, 2)));
+    CHECK(writeWav(a_sine, std::vector<int16_t>(whole.begin(), whole.begin() + split_frame * kChannels)));
+    CHECK(writeWav(b_sine, std::vector<int16_t>(whole.begin() + split_frame * kChannels, whole.end())));
+
+    core::DecodeScheduler scheduler;
+    scheduler.start(1);
+    for (core::DecodeScheduler* ahead : {static_cast<core::DecodeScheduler*>(nullptr), &scheduler}) {
+        for (size_t fragment_frames : kFragmentSizes) {
+            checkCrossfade(a_noise, b_noise, 3.0, fragment_frames, ahead);
+            checkGapless(a_sine, b_sine, whole, split_frame, fragment_frames, ahead);
+        }
+    }
+    checkCrossfade(a_noise, b_noise, 0.5, 1024, nullptr);
+    scheduler.stop();
+
+    std::filesystem::remove_all(dir, ec);
+    al_uninstall_system();
+    return test::result();
+}
@@ -0,0 +1,66 @@
+// LoudnessMeter against the BS.1770-4 calibration point: a full-scale 997 Hz
+// sine in one channel reads -3.01 LUFS. Silence and input shorter than one
+// gating block have no integrated loudness.
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "core/loudness_meter.hpp"
+#include "test_util.hpp"
+
+namespace {
+
+constexpr double kRate = 48000.0;
+constexpr double kCalibrationLufs = -3.01;
+constexpr double kToleranceLu = 0.05;
+
+// `seconds` of a full-scale 997 Hz sine in channel 0 of `channels`, the
+// others silent.
+std::vector<float> sine(size_t channels, double seconds) {
+    const size_t frames = static_cast<size_t>(seconds * kRate);
+    std::vector<float> pcm(frames * channels, 0.0f);
+    for (size_t i = 0; i < frames; ++i) {
+        pcm[i * channels] = static_cast<float>(std::sin(6.283185307179586 * 997.0 * static_cast<double>(i) / kRate));
+    }
+    return pcm;
+}
+
+void checkSine(size_t channels) {
+    core::LoudnessMeter meter(kRate, channels);
+    const std::vector<float> pcm = sine(channels, 10.0);
+    meter.addFrames(pcm.data(), pcm.size() / channels);
+    const std::optional<double> loudness = meter.integratedLoudness();
+    CHECK(loudness.has_value());
+    if (!loudness) {
+        return;
+    }
+    CHECK_MSG(std::abs(*loudness - kCalibrationLufs) < kToleranceLu,
+              "997 Hz sine reads " << *loudness << " LUFS, " << channels << " channel(s)");
+    CHECK(meter.samplePeak() > 0.999 && meter.samplePeak() <= 1.0);
+    std::printf("997 Hz full scale, %zu channel(s): %.3f LUFS\n", channels, *loudness);
+}
+
+void checkSilence() {
+    core::LoudnessMeter meter(kRate, 2);
+    const std::vector<float> pcm(static_cast<size_t>(10.0 * kRate) * 2, 0.0f);
+    meter.addFrames(pcm.data(), pcm.size() / 2);
+    CHECK(!meter.integratedLoudness());
+    CHECK(meter.samplePeak() == 0.0);
+}
+
+void checkShorterThanOneBlock() {
+    core::LoudnessMeter meter(kRate, 1);
+    const std::vector<float> pcm = sine(1, 0.3);
+    meter.addFrames(pcm.data(), pcm.size());
+    CHECK(!meter.integratedLoudness());
+}
+
+} // namespace
+
+int main() {
+    checkSine(1);
+    checkSine(2);
+    checkSilence();
+    checkShorterThanOneBlock();
+    return test::result();
+}
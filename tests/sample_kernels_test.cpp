@@ -0,0 +1,165 @@
+// Every SIMD kernel table the CPU supports must match the scalar kernels bit
+// for bit, including NaN, saturation and lengths that leave a scalar tail.
+// AUDIOVIS_SAMPLE_KERNELS, when set, also checks that dispatch honors it.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/sample_kernels.hpp"
+#include "test_util.hpp"
+
+namespace {
+
+constexpr const char* kKernelNames[] = {"avx2", "sse2", "scalar"};
+// Longer than two AVX2 blocks, so every length 0..kMaxLength exercises a
+// different split between vector body and scalar tail.
+constexpr size_t kMaxLength = 67;
+
+bool sameBits(const void* a, const void* b, size_t bytes) {
+    return std::memcmp(a, b, bytes) == 0;
+}
+
+std::vector<float> floatInputs(std::mt19937& rng) {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float inf = std::numeric_limits<float>::infinity();
+    std::vector<float> values = {
+        0.0f, -0.0f, 1.0f, -1.0f, 0.5f, -0.5f, nan, -nan, inf, -inf,
+        // Saturation edges and just inside them.
+        32767.0f / 32768.0f, 32767.5f / 32768.0f, 32768.5f / 32768.0f, -32768.5f / 32768.0f, 1.5f, -1.5f, 1e9f, -1e9f,
+        // Ties: round to nearest even.
+        0.5f / 32768.0f, 1.5f / 32768.0f, 2.5f / 32768.0f, -0.5f / 32768.0f, -2.5f / 32768.0f,
+        std::numeric_limits<float>::denorm_min(), -std::numeric_limits<float>::min(),
+    };
+    std::uniform_real_distribution<float> wide(-1.25f, 1.25f);
+    while (values.size() < 4096) {
+        values.push_back(wide(rng));
+    }
+    std::shuffle(values.begin() + 32, values.end(), rng);
+    return values;
+}
+
+void checkInt16ToFloat(const core::SampleKernels& kernels) {
+    const core::SampleKernels& scalar = core::scalarSampleKernels();
+    std::vector<int16_t> all(65536);
+    for (size_t i = 0; i < all.size(); ++i) {
+        all[i] = static_cast<int16_t>(static_cast<int>(i) - 32768);
+    }
+    std::vector<float> expected(all.size() + 1);
+    std::vector<float> actual(all.size() + 1);
+    scalar.int16ToFloat(all.data(), expected.data(), all.size());
+    kernels.int16ToFloat(all.data(), actual.data(), all.size());
+    CHECK_MSG(sameBits(expected.data(), actual.data(), all.size() * sizeof(float)), kernels.name << " full int16 range");
+
+    // Every short length from an unaligned start, with a guard after the end.
+    for (size_t length = 0; length <= kMaxLength; ++length) {
+        actual.assign(actual.size(), -7.0f);
+        scalar.int16ToFloat(all.data() + 1, expected.data(), length);
+        kernels.int16ToFloat(all.data() + 1, actual.data(), length);
+        CHECK_MSG(sameBits(expected.data(), actual.data(), length * sizeof(float)), kernels.name << " length " << length);
+        CHECK_MSG(actual[length] == -7.0f, kernels.name << " wrote past length " << length);
+    }
+}
+
+void checkFloatToInt16(const core::SampleKernels& kernels, const std::vector<float>& inputs) {
+    const core::SampleKernels& scalar = core::scalarSampleKernels();
+    std::vector<int16_t> expected(inputs.size());
+    std::vector<int16_t> actual(inputs.size() + 1);
+
+    scalar.floatToInt16(inputs.data(), expected.data(), inputs.size());
+    kernels.floatToInt16(inputs.data(), actual.data(), inputs.size());
+    CHECK_MSG(sameBits(expected.data(), actual.data(), inputs.size() * sizeof(int16_t)), kernels.name << " all inputs");
+
+    // The special values sit in the first 32; slide a short window over them.
+    for (size_t start = 0; start < 32; ++start) {
+        for (size_t length = 0; length <= kMaxLength; ++length) {
+            actual.assign(actual.size(), 1234);
+            scalar.floatToInt16(inputs.data() + start, expected.data(), length);
+            kernels.floatToInt16(inputs.data() + start, actual.data(), length);
+            CHECK_MSG(sameBits(expected.data(), actual.data(), length * sizeof(int16_t)),
+                      kernels.name << " start " << start << " length " << length);
+            CHECK_MSG(actual[length] == 1234, kernels.name << " wrote past length " << length);
+        }
+    }
+
+    // The documented saturation, whichever kernel runs.
+    const float edges[] = {std::numeric_limits<float>::quiet_NaN(), 2.0f, -2.0f, 1.0f, -1.0f, 0.5f / 32768.0f};
+    const int16_t wanted[] = {-32768, 32767, -32768, 32767, -32768, 0};
+    int16_t converted[6];
+    kernels.floatToInt16(edges, converted, 6);
+    for (int i = 0; i < 6; ++i) {
+        CHECK_MSG(converted[i] == wanted[i], kernels.name << " edge " << i << " gave " << converted[i]);
+    }
+}
+
+void checkDownmix(const core::SampleKernels& kernels, const std::vector<float>& inputs) {
+    const core::SampleKernels& scalar = core::scalarSampleKernels();
+    std::vector<float> expected(kMaxLength + 1);
+    std::vector<float> actual(kMaxLength + 1);
+    for (size_t channels = 1; channels <= 8; ++channels) {
+        for (size_t frames = 0; frames <= kMaxLength && frames * channels <= inputs.size(); ++frames) {
+            for (size_t start : {size_t{0}, size_t{1}, size_t{3}}) {
+                actual.assign(actual.size(), -7.0f);
+                scalar.downmixToMono(inputs.data() + start, expected.data(), frames, channels);
+                kernels.downmixToMono(inputs.data() + start, actual.data(), frames, channels);
+                CHECK_MSG(sameBits(expected.data(), actual.data(), frames * sizeof(float)),
+                          kernels.name << " channels " << channels << " frames " << frames << " start " << start);
+                CHECK_MSG(actual[frames] == -7.0f, kernels.name << " wrote past frame " << frames);
+            }
+        }
+    }
+
+    // Signed zeros keep the scalar summation order: (0 + -0) + -0 is +0.
+    const float zeros[8] = {-0.0f, -0.0f, -0.0f, -0.0f, -0.0f, -0.0f, -0.0f, -0.0f};
+    float mono[4];
+    kernels.downmixToMono(zeros, mono, 4, 2);
+    for (float value : mono) {
+        CHECK_MSG(!std::signbit(value), kernels.name << " negative zero from a -0/-0 frame");
+    }
+}
+
+void checkDispatch() {
+    const core::SampleKernels& active = core::sampleKernels();
+    const char* forced = std::getenv("AUDIOVIS_SAMPLE_KERNELS");
+    if (forced && core::sampleKernelsNamed(forced)) {
+        CHECK_MSG(std::string(active.name) == forced, "forced " << forced << ", dispatched " << active.name);
+        return;
+    }
+    for (const char* name : kKernelNames) {
+        if (core::sampleKernelsNamed(name)) {
+            CHECK_MSG(std::string(active.name) == name, "best supported is " << name << ", dispatched " << active.name);
+            return;
+        }
+    }
+    CHECK(false);
+}
+
+} // namespace
+
+int main() {
+    std::mt19937 rng(20240603);
+    const std::vector<float> inputs = floatInputs(rng);
+
+    CHECK(core::sampleKernelsNamed("scalar") == &core::scalarSampleKernels());
+    CHECK(core::sampleKernelsNamed("neon") == nullptr);
+    CHECK(core::sampleKernelsNamed(nullptr) == nullptr);
+
+    for (const char* name : kKernelNames) {
+        const core::SampleKernels* kernels = core::sampleKernelsNamed(name);
+        if (!kernels) {
+            std::cout << name << ": not supported here, skipped\n";
+            continue;
+        }
+        checkInt16ToFloat(*kernels);
+        checkFloatToInt16(*kernels, inputs);
+        checkDownmix(*kernels, inputs);
+        std::cout << name << ": checked\n";
+    }
+    checkDispatch();
+    return test::result();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <iostream>
+
+// Minimal assertions for the ctest executables: a failed CHECK reports the
+// expression and location and makes test::result() nonzero, and the test
+// carries on so one run shows every failure.
+namespace test {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline int result() {
+    if (failures() > 0) {
+        std::cerr << failures() << " check(s) failed\n";
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace test
+
+#define CHECK(expr)                                                                  \
+    do {                                                                             \
+        if (!(expr)) {                                                               \
+            ++test::failures();                                                      \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #expr ") failed\n"; \
+        }                                                                            \
+    } while (0)
+
+// Like CHECK, with extra context streamed after the message.
+#define CHECK_MSG(expr, message)                                                                        \
+    do {                                                                                                \
+        if (!(expr)) {                                                                                  \
+            ++test::failures();                                                                         \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #expr ") failed: " << message << "\n"; \
+        }                                                                                               \
+    } while (0)